@@ -68,6 +68,7 @@ typedef struct pa_daemon_conf {
         disable_shm,
         disable_memfd,
         avoid_resampling,
+        resample_quality_governor,
         disable_remixing,
         remixing_use_all_sink_channels,
         disable_lfe_remixing,
@@ -77,7 +78,8 @@ typedef struct pa_daemon_conf {
         log_time,
         flat_volumes,
         lock_memory,
-        deferred_volume;
+        deferred_volume,
+        incremental_rewind;
     pa_server_type_t local_server_type;
     int exit_idle_time,
         scache_idle_time,
@@ -85,6 +87,7 @@ typedef struct pa_daemon_conf {
         nice_level,
         resample_method;
     char *script_commands, *dl_search_path, *default_script_file;
+    char *realtime_cpu_affinity;
     pa_log_target *log_target;
     pa_log_level_t log_level;
     unsigned log_backtrace;
@@ -1047,11 +1047,14 @@ int main(int argc, char *argv[]) {
     c->resample_method = conf->resample_method;
     c->realtime_priority = conf->realtime_priority;
     c->realtime_scheduling = conf->realtime_scheduling;
+    c->realtime_cpu_affinity = pa_xstrdup(conf->realtime_cpu_affinity);
     c->avoid_resampling = conf->avoid_resampling;
+    c->resample_quality_governor = conf->resample_quality_governor;
     c->disable_remixing = conf->disable_remixing;
     c->remixing_use_all_sink_channels = conf->remixing_use_all_sink_channels;
     c->disable_lfe_remixing = conf->disable_lfe_remixing;
     c->deferred_volume = conf->deferred_volume;
+    c->incremental_rewind = conf->incremental_rewind;
     c->running_as_daemon = conf->daemonize;
     c->disallow_exit = conf->disallow_exit;
     c->flat_volumes = conf->flat_volumes;
@@ -87,6 +87,7 @@ struct userdata {
     pa_thread *thread;
     pa_thread_mq thread_mq;
     pa_rtpoll *rtpoll;
+    pa_io_thread_config thread_config;
 
     snd_pcm_t *pcm_handle;
 
@@ -1505,8 +1506,7 @@ static void thread_func(void *userdata) {
 
     pa_log_debug("Thread starting up");
 
-    if (u->core->realtime_scheduling)
-        pa_thread_make_realtime(u->core->realtime_priority);
+    pa_core_setup_io_thread(u->core, &u->thread_config);
 
     pa_thread_mq_install(&u->thread_mq);
 
@@ -1902,6 +1902,12 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
     u->deferred_volume = deferred_volume;
     u->fixed_latency_range = fixed_latency_range;
     u->first = true;
+
+    if (pa_modargs_get_io_thread_config(ma, &u->thread_config) < 0) {
+        pa_log("Failed to parse thread_cpu_affinity or thread_priority_offset argument.");
+        goto fail;
+    }
+
     u->rtpoll = pa_rtpoll_new();
 
     if (pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll) < 0) {
@@ -2275,6 +2281,8 @@ static void userdata_free(struct userdata *u) {
     reserve_done(u);
     monitor_done(u);
 
+    pa_io_thread_config_done(&u->thread_config);
+
     pa_xfree(u->device_name);
     pa_xfree(u->control_device);
     pa_xfree(u->paths_dir);
@@ -65,6 +65,8 @@ PA_MODULE_USAGE(
         "fixed_latency_range=<disable latency range changes on underrun?> "
         "ignore_dB=<ignore dB information from the device?> "
         "deferred_volume=<Synchronize software and hardware volume changes to avoid momentary jumps?> "
+        "thread_cpu_affinity=<list of CPUs for the IO thread> "
+        "thread_priority_offset=<realtime priority of the IO thread relative to realtime-priority> "
         "profile_set=<profile set configuration file> "
         "paths_dir=<directory containing the path configuration files> "
         "use_ucm=<load use case manager> "
@@ -93,6 +95,8 @@ static const char* const valid_modargs[] = {
     "profile",
     "ignore_dB",
     "deferred_volume",
+    "thread_cpu_affinity",
+    "thread_priority_offset",
     "profile_set",
     "paths_dir",
     "use_ucm",
@@ -57,7 +57,9 @@ PA_MODULE_USAGE(
         "deferred_volume=<Synchronize software and hardware volume changes to avoid momentary jumps?> "
         "deferred_volume_safety_margin=<usec adjustment depending on volume direction> "
         "deferred_volume_extra_delay=<usec adjustment to HW volume changes> "
-        "fixed_latency_range=<disable latency range changes on underrun?>");
+        "fixed_latency_range=<disable latency range changes on underrun?> "
+        "thread_cpu_affinity=<list of CPUs for the IO thread> "
+        "thread_priority_offset=<realtime priority of the IO thread relative to realtime-priority>");
 
 static const char* const valid_modargs[] = {
     "name",
@@ -84,6 +86,8 @@ static const char* const valid_modargs[] = {
     "deferred_volume_safety_margin",
     "deferred_volume_extra_delay",
     "fixed_latency_range",
+    "thread_cpu_affinity",
+    "thread_priority_offset",
     NULL
 };
 
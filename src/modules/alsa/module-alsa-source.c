@@ -65,7 +65,9 @@ PA_MODULE_USAGE(
         "deferred_volume=<Synchronize software and hardware volume changes to avoid momentary jumps?> "
         "deferred_volume_safety_margin=<usec adjustment depending on volume direction> "
         "deferred_volume_extra_delay=<usec adjustment to HW volume changes> "
-        "fixed_latency_range=<disable latency range changes on overrun?>");
+        "fixed_latency_range=<disable latency range changes on overrun?> "
+        "thread_cpu_affinity=<list of CPUs for the IO thread> "
+        "thread_priority_offset=<realtime priority of the IO thread relative to realtime-priority>");
 
 static const char* const valid_modargs[] = {
     "name",
@@ -91,6 +93,8 @@ static const char* const valid_modargs[] = {
     "deferred_volume_safety_margin",
     "deferred_volume_extra_delay",
     "fixed_latency_range",
+    "thread_cpu_affinity",
+    "thread_priority_offset",
     NULL
 };
 
@@ -55,7 +55,9 @@ PA_MODULE_DESCRIPTION("BlueZ 5 Bluetooth audio sink and source");
 PA_MODULE_VERSION(PACKAGE_VERSION);
 PA_MODULE_LOAD_ONCE(false);
 PA_MODULE_USAGE("path=<device object path>"
-                "autodetect_mtu=<boolean>");
+                "autodetect_mtu=<boolean> "
+                "thread_cpu_affinity=<list of CPUs for the IO thread> "
+                "thread_priority_offset=<realtime priority of the IO thread relative to realtime-priority>");
 
 #define FIXED_LATENCY_PLAYBACK_A2DP (25 * PA_USEC_PER_MSEC)
 #define FIXED_LATENCY_PLAYBACK_SCO  (25 * PA_USEC_PER_MSEC)
@@ -69,6 +71,8 @@ PA_MODULE_USAGE("path=<device object path>"
 static const char* const valid_modargs[] = {
     "path",
     "autodetect_mtu",
+    "thread_cpu_affinity",
+    "thread_priority_offset",
     NULL
 };
 
@@ -131,6 +135,7 @@ struct userdata {
     pa_thread *thread;
     pa_thread_mq thread_mq;
     pa_rtpoll *rtpoll;
+    pa_io_thread_config thread_config;
     pa_rtpoll_item *rtpoll_item;
     bluetooth_msg *msg;
 
@@ -1500,8 +1505,7 @@ static void thread_func(void *userdata) {
 
     pa_log_debug("IO Thread starting up");
 
-    if (u->core->realtime_scheduling)
-        pa_thread_make_realtime(u->core->realtime_priority);
+    pa_core_setup_io_thread(u->core, &u->thread_config);
 
     pa_thread_mq_install(&u->thread_mq);
 
@@ -2415,6 +2419,11 @@ int pa__init(pa_module* m) {
 
     u->device->autodetect_mtu = autodetect_mtu;
 
+    if (pa_modargs_get_io_thread_config(ma, &u->thread_config) < 0) {
+        pa_log("Failed to parse thread_cpu_affinity or thread_priority_offset argument.");
+        goto fail_free_modargs;
+    }
+
     pa_modargs_free(ma);
 
     u->device_connection_changed_slot =
@@ -2510,6 +2519,8 @@ void pa__done(pa_module *m) {
     pa_xfree(u->output_port_name);
     pa_xfree(u->input_port_name);
 
+    pa_io_thread_config_done(&u->thread_config);
+
     pa_xfree(u);
 }
 
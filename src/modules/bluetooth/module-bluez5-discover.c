@@ -36,12 +36,16 @@ PA_MODULE_VERSION(PACKAGE_VERSION);
 PA_MODULE_LOAD_ONCE(true);
 PA_MODULE_USAGE(
     "headset=ofono|native|auto"
-    "autodetect_mtu=<boolean>"
+    "autodetect_mtu=<boolean> "
+    "thread_cpu_affinity=<list of CPUs for the IO threads> "
+    "thread_priority_offset=<realtime priority of the IO threads relative to realtime-priority>"
 );
 
 static const char* const valid_modargs[] = {
     "headset",
     "autodetect_mtu",
+    "thread_cpu_affinity",
+    "thread_priority_offset",
     NULL
 };
 
@@ -52,6 +56,7 @@ struct userdata {
     pa_hook_slot *device_connection_changed_slot;
     pa_bluetooth_discovery *discovery;
     bool autodetect_mtu;
+    pa_io_thread_config thread_config;
 };
 
 static pa_hook_result_t device_connection_changed_cb(pa_bluetooth_discovery *y, const pa_bluetooth_device *d, struct userdata *u) {
@@ -72,7 +77,10 @@ static pa_hook_result_t device_connection_changed_cb(pa_bluetooth_discovery *y,
     if (!module_loaded && pa_bluetooth_device_any_transport_connected(d)) {
         /* a new device has been connected */
         pa_module *m;
-        char *args = pa_sprintf_malloc("path=%s autodetect_mtu=%i", d->path, (int)u->autodetect_mtu);
+        char *args = pa_sprintf_malloc("path=%s autodetect_mtu=%i thread_priority_offset=%i%s%s",
+                                       d->path, (int)u->autodetect_mtu, u->thread_config.priority_offset,
+                                       u->thread_config.cpu_affinity ? " thread_cpu_affinity=" : "",
+                                       pa_strempty(u->thread_config.cpu_affinity));
 
         pa_log_debug("Loading module-bluez5-device %s", args);
         pa_module_load(&m, u->module->core, "module-bluez5-device", args);
@@ -133,6 +141,12 @@ int pa__init(pa_module *m) {
     u->module = m;
     u->core = m->core;
     u->autodetect_mtu = autodetect_mtu;
+
+    if (pa_modargs_get_io_thread_config(ma, &u->thread_config) < 0) {
+        pa_log("Failed to parse thread_cpu_affinity or thread_priority_offset argument.");
+        goto fail;
+    }
+
     u->loaded_device_paths = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
 
     if (!(u->discovery = pa_bluetooth_discovery_get(u->core, headset_backend)))
@@ -169,5 +183,7 @@ void pa__done(pa_module *m) {
     if (u->loaded_device_paths)
         pa_hashmap_free(u->loaded_device_paths);
 
+    pa_io_thread_config_done(&u->thread_config);
+
     pa_xfree(u);
 }
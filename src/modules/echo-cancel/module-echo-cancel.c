@@ -38,6 +38,7 @@
 #include <pulse/rtclock.h>
 
 #include <pulsecore/i18n.h>
+#include <pulsecore/asyncq.h>
 #include <pulsecore/atomic.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/namereg.h>
@@ -50,6 +51,13 @@
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/ltdl-helper.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/thread.h>
+
+#ifdef ECHO_CANCEL_BENCH
+#include <pulsecore/sconv.h>
+#include <pulsecore/sndfile-util.h>
+#endif
 
 PA_MODULE_AUTHOR("Wim Taymans");
 PA_MODULE_DESCRIPTION("Echo Cancellation");
@@ -74,6 +82,7 @@ PA_MODULE_USAGE(
           "autoloaded=<set if this module is being loaded automatically> "
           "use_volume_sharing=<yes or no> "
           "use_master_format=<yes or no> "
+          "pipelined=<run the canceller on a worker thread?> "
         ));
 
 /* NOTE: Make sure the enum and ec_table are maintained in the correct order */
@@ -140,11 +149,19 @@ static const pa_echo_canceller ec_table[] = {
 #define DEFAULT_SAVE_AEC false
 #define DEFAULT_AUTOLOADED false
 #define DEFAULT_USE_MASTER_FORMAT false
+#define DEFAULT_PIPELINED false
 
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 
 #define MAX_LATENCY_BLOCKS 10
 
+/* Blocks that can be on their way to and from the worker thread, must be
+ * a power of two */
+#define PIPELINE_JOBS 16
+
+/* The CPU load of the canceller is taken over this much capture */
+#define LOAD_WINDOW_USEC PA_USEC_PER_SEC
+
 /* Can only be used in main context */
 #define IS_ACTIVE(u) (((u)->source->state == PA_SOURCE_RUNNING) && \
                       ((u)->sink->state == PA_SINK_RUNNING))
@@ -176,6 +193,13 @@ static const pa_echo_canceller ec_table[] = {
  *    be before capture and the difference should not be bigger than one frame
  *    size. We would ideally like to resample the sink_input but most driver
  *    don't give enough accuracy to be able to do that right now.
+ *
+ * With pipelined=1 the canceller itself runs on a worker thread. The
+ * source IO thread still does the alignment, and hands each aligned block
+ * of capture and playback samples to the worker as a job. Finished jobs
+ * come back to the source IO thread, which posts the canceled data. This
+ * adds (at least) one block of latency, which is reported in the latency
+ * of the source.
  */
 
 struct userdata;
@@ -203,6 +227,44 @@ struct snapshot {
     size_t plen;
 };
 
+/* One block of work for the canceller */
+typedef enum {
+    EC_JOB_RUN,
+    EC_JOB_PLAY,
+    EC_JOB_RECORD,
+    EC_JOB_QUIT
+} ec_job_type_t;
+
+struct ec_job {
+    ec_job_type_t type;
+
+    pa_memchunk rchunk, pchunk, cchunk;
+    float drift;
+
+    /* The capture volume when the job was submitted, and the one the
+     * canceller asked for, if set_volume */
+    pa_volume_t volume;
+    pa_volume_t new_volume;
+    bool set_volume;
+
+    PA_LLIST_FIELDS(struct ec_job);
+};
+
+struct ec_worker {
+    pa_thread *thread;
+
+    /* Lock-free rings of jobs, from the source IO thread to the worker and
+     * back */
+    pa_asyncq *todo, *done;
+
+    struct ec_job jobs[PIPELINE_JOBS];
+    struct ec_job quit;
+
+    /* Only accessed from the source IO thread */
+    PA_LLIST_HEAD(struct ec_job, free_jobs);
+    size_t pending; /* capture bytes the worker has not given back yet */
+};
+
 struct userdata {
     pa_core *core;
     pa_module *module;
@@ -211,6 +273,9 @@ struct userdata {
     bool save_aec;
 
     pa_echo_canceller *ec;
+    struct ec_worker *worker; /* only if pipelined */
+    struct ec_job inline_job;
+    struct ec_job *running_job; /* only accessed from the thread running the canceller */
     uint32_t source_output_blocksize;
     uint32_t source_blocksize;
     uint32_t sink_blocksize;
@@ -219,7 +284,7 @@ struct userdata {
 
     /* to wakeup the source I/O thread */
     pa_asyncmsgq *asyncmsgq;
-    pa_rtpoll_item *rtpoll_item_read, *rtpoll_item_write;
+    pa_rtpoll_item *rtpoll_item_read;
 
     pa_source *source;
     bool source_auto_desc;
@@ -252,6 +317,15 @@ struct userdata {
 
     bool use_volume_sharing;
 
+    /* CPU load of the canceller. The counters are kept by the thread
+     * running the canceller, which publishes the load (in permille of the
+     * processed capture time) and the longest call once per window. */
+    struct {
+        pa_usec_t block, busy, audio, max_call;
+        pa_atomic_t permille, max_call_usec;
+        int reported; /* in percent, main context */
+    } load;
+
     struct {
         pa_cvolume current_volume;
     } thread_info;
@@ -278,6 +352,7 @@ static const char* const valid_modargs[] = {
     "autoloaded",
     "use_volume_sharing",
     "use_master_format",
+    "pipelined",
     NULL
 };
 
@@ -285,7 +360,8 @@ enum {
     SOURCE_OUTPUT_MESSAGE_POST = PA_SOURCE_OUTPUT_MESSAGE_MAX,
     SOURCE_OUTPUT_MESSAGE_REWIND,
     SOURCE_OUTPUT_MESSAGE_LATENCY_SNAPSHOT,
-    SOURCE_OUTPUT_MESSAGE_APPLY_DIFF_TIME
+    SOURCE_OUTPUT_MESSAGE_APPLY_DIFF_TIME,
+    SOURCE_OUTPUT_MESSAGE_COLLECT
 };
 
 enum {
@@ -334,6 +410,24 @@ static int64_t calc_diff(struct userdata *u, struct snapshot *snapshot) {
     return diff_time;
 }
 
+/* Called from main context */
+static void update_load(struct userdata *u) {
+    int permille;
+    pa_proplist *pl;
+
+    permille = pa_atomic_load(&u->load.permille);
+    if (permille / 10 == u->load.reported)
+        return;
+
+    u->load.reported = permille / 10;
+
+    pl = pa_proplist_new();
+    pa_proplist_setf(pl, "echo_cancel.cpu_load", "%d.%d", permille / 10, permille % 10);
+    pa_proplist_setf(pl, "echo_cancel.max_call_usec", "%d", pa_atomic_load(&u->load.max_call_usec));
+    pa_source_update_proplist(u->source, PA_UPDATE_REPLACE, pl);
+    pa_proplist_free(pl);
+}
+
 /* Called from main context */
 static void time_callback(pa_mainloop_api *a, pa_time_event *e, const struct timeval *t, void *userdata) {
     struct userdata *u = userdata;
@@ -350,6 +444,8 @@ static void time_callback(pa_mainloop_api *a, pa_time_event *e, const struct tim
     if (!IS_ACTIVE(u))
         return;
 
+    update_load(u);
+
     /* update our snapshots */
     pa_asyncmsgq_send(u->source_output->source->asyncmsgq, PA_MSGOBJECT(u->source_output), SOURCE_OUTPUT_MESSAGE_LATENCY_SNAPSHOT, &latency_snapshot, 0, NULL);
     pa_asyncmsgq_send(u->sink_input->sink->asyncmsgq, PA_MSGOBJECT(u->sink_input), SINK_INPUT_MESSAGE_LATENCY_SNAPSHOT, &latency_snapshot, 0, NULL);
@@ -420,7 +516,9 @@ static int source_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t
                 /* Add the latency internal to our source output on top */
                 pa_bytes_to_usec(pa_memblockq_get_length(u->source_output->thread_info.delay_memblockq), &u->source_output->source->sample_spec) +
                 /* and the buffering we do on the source */
-                pa_bytes_to_usec(u->source_output_blocksize, &u->source_output->source->sample_spec);
+                pa_bytes_to_usec(u->source_output_blocksize, &u->source_output->source->sample_spec) +
+                /* and the blocks the worker thread is busy with */
+                pa_bytes_to_usec(u->worker ? u->worker->pending : 0, &u->source_output->source->sample_spec);
 
             return 0;
 
@@ -720,6 +818,193 @@ static void do_resync(struct userdata *u) {
     apply_diff_time(u, diff_time);
 }
 
+/* Called from the thread running the canceller. */
+static void account_load(struct userdata *u, pa_usec_t start, bool block_done) {
+    pa_usec_t busy;
+
+    busy = pa_rtclock_now() - start;
+    u->load.busy += busy;
+    u->load.max_call = PA_MAX(u->load.max_call, busy);
+
+    if (!block_done)
+        return;
+
+    u->load.audio += u->load.block;
+
+    if (u->load.audio >= LOAD_WINDOW_USEC) {
+        pa_atomic_store(&u->load.permille, (int) (u->load.busy * 1000 / u->load.audio));
+        pa_atomic_store(&u->load.max_call_usec, (int) PA_MIN(u->load.max_call, (pa_usec_t) INT_MAX));
+
+        u->load.busy = u->load.audio = u->load.max_call = 0;
+    }
+}
+
+/* Called from the thread running the canceller: the source I/O thread, or
+ * the worker thread if pipelined. */
+static void run_job(struct userdata *u, struct ec_job *j) {
+    const uint8_t *rdata = NULL, *pdata = NULL;
+    uint8_t *cdata = NULL;
+    pa_usec_t start;
+
+    if (j->rchunk.memblock)
+        rdata = pa_memblock_acquire_chunk(&j->rchunk);
+    if (j->pchunk.memblock)
+        pdata = pa_memblock_acquire_chunk(&j->pchunk);
+    if (j->cchunk.memblock)
+        cdata = pa_memblock_acquire_chunk(&j->cchunk);
+
+    u->running_job = j;
+    start = pa_rtclock_now();
+
+    switch (j->type) {
+        case EC_JOB_RUN:
+            u->ec->run(u->ec, rdata, pdata, cdata);
+            break;
+
+        case EC_JOB_PLAY:
+            u->ec->play(u->ec, pdata);
+            break;
+
+        case EC_JOB_RECORD:
+            u->ec->set_drift(u->ec, j->drift);
+            u->ec->record(u->ec, rdata, cdata);
+            break;
+
+        default:
+            pa_assert_not_reached();
+    }
+
+    account_load(u, start, j->type != EC_JOB_PLAY);
+    u->running_job = NULL;
+
+    if (j->cchunk.memblock)
+        pa_memblock_release(j->cchunk.memblock);
+    if (j->pchunk.memblock)
+        pa_memblock_release(j->pchunk.memblock);
+    if (j->rchunk.memblock)
+        pa_memblock_release(j->rchunk.memblock);
+}
+
+static void job_unref_chunks(struct ec_job *j) {
+    if (j->rchunk.memblock)
+        pa_memblock_unref(j->rchunk.memblock);
+    if (j->pchunk.memblock)
+        pa_memblock_unref(j->pchunk.memblock);
+    if (j->cchunk.memblock)
+        pa_memblock_unref(j->cchunk.memblock);
+}
+
+static void save_chunk(FILE *f, const pa_memchunk *chunk) {
+    int unused PA_GCC_UNUSED;
+
+    if (!f)
+        return;
+
+    unused = fwrite(pa_memblock_acquire_chunk(chunk), 1, chunk->length, f);
+    pa_memblock_release(chunk->memblock);
+}
+
+/* Called from the worker thread. */
+static void worker_thread_func(void *userdata) {
+    struct userdata *u = userdata;
+    struct ec_job *j;
+
+    pa_log_debug("Echo canceller worker starting up");
+
+    pa_core_setup_io_thread(u->core, NULL);
+
+    while ((j = pa_asyncq_pop(u->worker->todo, true)) != &u->worker->quit) {
+        run_job(u, j);
+
+        pa_assert_se(pa_asyncq_push(u->worker->done, j, false) == 0);
+
+        /* wake up the source I/O thread to post the result */
+        pa_asyncmsgq_post_idempotent(u->asyncmsgq, PA_MSGOBJECT(u->source_output), SOURCE_OUTPUT_MESSAGE_COLLECT,
+            NULL, 0, NULL, NULL);
+    }
+
+    pa_log_debug("Echo canceller worker shutting down");
+}
+
+/* Called from source I/O thread context. */
+static void finish_job(struct userdata *u, struct ec_job *j) {
+    if (j->cchunk.memblock) {
+        if (u->save_aec)
+            save_chunk(u->canceled_file, &j->cchunk);
+
+        if (u->worker)
+            u->worker->pending -= j->rchunk.length;
+
+        /* forward the (echo-canceled) data to the virtual source */
+        if (PA_SOURCE_IS_LINKED(u->source->thread_info.state))
+            pa_source_post(u->source, &j->cchunk);
+    }
+
+    job_unref_chunks(j);
+
+    if (j->set_volume && pa_cvolume_avg(&u->thread_info.current_volume) != j->new_volume)
+        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(u->ec->msg), ECHO_CANCELLER_MESSAGE_SET_VOLUME,
+                PA_UINT_TO_PTR(j->new_volume), 0, NULL, NULL);
+
+    if (u->worker)
+        PA_LLIST_PREPEND(struct ec_job, u->worker->free_jobs, j);
+}
+
+/* Called from source I/O thread context. */
+static void collect_jobs(struct userdata *u) {
+    struct ec_job *j;
+
+    if (!u->worker)
+        return;
+
+    while ((j = pa_asyncq_pop(u->worker->done, false)))
+        finish_job(u, j);
+}
+
+/* Returns NULL if the worker has all the jobs.
+ *
+ * Called from source I/O thread context. */
+static struct ec_job *get_job(struct userdata *u, ec_job_type_t type) {
+    struct ec_job *j;
+
+    if (!u->worker)
+        j = &u->inline_job;
+    else {
+        if (!u->worker->free_jobs)
+            collect_jobs(u);
+
+        if (!(j = u->worker->free_jobs))
+            return NULL;
+
+        PA_LLIST_REMOVE(struct ec_job, u->worker->free_jobs, j);
+    }
+
+    j->type = type;
+    pa_memchunk_reset(&j->rchunk);
+    pa_memchunk_reset(&j->pchunk);
+    pa_memchunk_reset(&j->cchunk);
+    j->volume = pa_cvolume_avg(&u->thread_info.current_volume);
+    j->set_volume = false;
+
+    return j;
+}
+
+/* Runs the job right away, or hands it to the worker if pipelined.
+ *
+ * Called from source I/O thread context. */
+static void submit_job(struct userdata *u, struct ec_job *j) {
+    if (!u->worker) {
+        run_job(u, j);
+        finish_job(u, j);
+        return;
+    }
+
+    if (j->cchunk.memblock)
+        u->worker->pending += j->rchunk.length;
+
+    pa_assert_se(pa_asyncq_push(u->worker->todo, j, false) == 0);
+}
+
 /* 1. Calculate drift at this point, pass to canceller
  * 2. Push out playback samples in blocksize chunks
  * 3. Push out capture samples in blocksize chunks
@@ -730,10 +1015,8 @@ static void do_resync(struct userdata *u) {
  */
 static void do_push_drift_comp(struct userdata *u) {
     size_t rlen, plen;
-    pa_memchunk rchunk, pchunk, cchunk;
-    uint8_t *rdata, *pdata, *cdata;
+    struct ec_job *j;
     float drift;
-    int unused PA_GCC_UNUSED;
 
     rlen = pa_memblockq_get_length(u->source_memblockq);
     plen = pa_memblockq_get_length(u->sink_memblockq);
@@ -749,8 +1032,6 @@ static void do_push_drift_comp(struct userdata *u) {
      * those remainder samples.
      */
     drift = ((float)(plen - u->sink_rem) - (rlen - u->source_rem)) / ((float)(rlen - u->source_rem));
-    u->sink_rem = plen % u->sink_blocksize;
-    u->source_rem = rlen % u->source_output_blocksize;
 
     if (u->save_aec) {
         if (u->drift_file)
@@ -759,61 +1040,50 @@ static void do_push_drift_comp(struct userdata *u) {
 
     /* Send in the playback samples first */
     while (plen >= u->sink_blocksize) {
-        pa_memblockq_peek_fixed_size(u->sink_memblockq, u->sink_blocksize, &pchunk);
-        pdata = pa_memblock_acquire(pchunk.memblock);
-        pdata += pchunk.index;
+        if (!(j = get_job(u, EC_JOB_PLAY)))
+            break;
 
-        u->ec->play(u->ec, pdata);
+        pa_memblockq_peek_fixed_size(u->sink_memblockq, u->sink_blocksize, &j->pchunk);
 
         if (u->save_aec) {
             if (u->drift_file)
                 fprintf(u->drift_file, "p %d\n", u->sink_blocksize);
-            if (u->played_file)
-                unused = fwrite(pdata, 1, u->sink_blocksize, u->played_file);
+            save_chunk(u->played_file, &j->pchunk);
         }
 
-        pa_memblock_release(pchunk.memblock);
         pa_memblockq_drop(u->sink_memblockq, u->sink_blocksize);
-        pa_memblock_unref(pchunk.memblock);
-
         plen -= u->sink_blocksize;
-    }
 
-    /* And now the capture samples */
-    while (rlen >= u->source_output_blocksize) {
-        pa_memblockq_peek_fixed_size(u->source_memblockq, u->source_output_blocksize, &rchunk);
+        submit_job(u, j);
+    }
 
-        rdata = pa_memblock_acquire(rchunk.memblock);
-        rdata += rchunk.index;
+    /* And now the capture samples, unless we ran out of jobs for the
+     * playback samples */
+    while (plen < u->sink_blocksize && rlen >= u->source_output_blocksize) {
+        if (!(j = get_job(u, EC_JOB_RECORD)))
+            break;
 
-        cchunk.index = 0;
-        cchunk.length = u->source_output_blocksize;
-        cchunk.memblock = pa_memblock_new(u->source->core->mempool, cchunk.length);
-        cdata = pa_memblock_acquire(cchunk.memblock);
+        pa_memblockq_peek_fixed_size(u->source_memblockq, u->source_output_blocksize, &j->rchunk);
 
-        u->ec->set_drift(u->ec, drift);
-        u->ec->record(u->ec, rdata, cdata);
+        j->cchunk.index = 0;
+        j->cchunk.length = u->source_output_blocksize;
+        j->cchunk.memblock = pa_memblock_new(u->source->core->mempool, j->cchunk.length);
+        j->drift = drift;
 
         if (u->save_aec) {
             if (u->drift_file)
                 fprintf(u->drift_file, "c %d\n", u->source_output_blocksize);
-            if (u->captured_file)
-                unused = fwrite(rdata, 1, u->source_output_blocksize, u->captured_file);
-            if (u->canceled_file)
-                unused = fwrite(cdata, 1, u->source_output_blocksize, u->canceled_file);
+            save_chunk(u->captured_file, &j->rchunk);
         }
 
-        pa_memblock_release(cchunk.memblock);
-        pa_memblock_release(rchunk.memblock);
-
-        pa_memblock_unref(rchunk.memblock);
-
-        pa_source_post(u->source, &cchunk);
-        pa_memblock_unref(cchunk.memblock);
-
         pa_memblockq_drop(u->source_memblockq, u->source_output_blocksize);
         rlen -= u->source_output_blocksize;
+
+        submit_job(u, j);
     }
+
+    u->sink_rem = plen;
+    u->source_rem = rlen;
 }
 
 /* This one's simpler than the drift compensation case -- we just iterate over
@@ -823,69 +1093,47 @@ static void do_push_drift_comp(struct userdata *u) {
  * Called from source I/O thread context. */
 static void do_push(struct userdata *u) {
     size_t rlen, plen;
-    pa_memchunk rchunk, pchunk, cchunk;
-    uint8_t *rdata, *pdata, *cdata;
-    int unused PA_GCC_UNUSED;
+    struct ec_job *j;
 
     rlen = pa_memblockq_get_length(u->source_memblockq);
     plen = pa_memblockq_get_length(u->sink_memblockq);
 
     while (rlen >= u->source_output_blocksize) {
 
+        if (!(j = get_job(u, EC_JOB_RUN)))
+            break;
+
         /* take fixed blocks from recorded and played samples */
-        pa_memblockq_peek_fixed_size(u->source_memblockq, u->source_output_blocksize, &rchunk);
-        pa_memblockq_peek_fixed_size(u->sink_memblockq, u->sink_blocksize, &pchunk);
+        pa_memblockq_peek_fixed_size(u->source_memblockq, u->source_output_blocksize, &j->rchunk);
+        pa_memblockq_peek_fixed_size(u->sink_memblockq, u->sink_blocksize, &j->pchunk);
 
         /* we ran out of played data and pchunk has been filled with silence bytes */
         if (plen < u->sink_blocksize)
             pa_memblockq_seek(u->sink_memblockq, u->sink_blocksize - plen, PA_SEEK_RELATIVE, true);
 
-        rdata = pa_memblock_acquire(rchunk.memblock);
-        rdata += rchunk.index;
-        pdata = pa_memblock_acquire(pchunk.memblock);
-        pdata += pchunk.index;
-
-        cchunk.index = 0;
-        cchunk.length = u->source_blocksize;
-        cchunk.memblock = pa_memblock_new(u->source->core->mempool, cchunk.length);
-        cdata = pa_memblock_acquire(cchunk.memblock);
-
-        if (u->save_aec) {
-            if (u->captured_file)
-                unused = fwrite(rdata, 1, u->source_output_blocksize, u->captured_file);
-            if (u->played_file)
-                unused = fwrite(pdata, 1, u->sink_blocksize, u->played_file);
-        }
-
-        /* perform echo cancellation */
-        u->ec->run(u->ec, rdata, pdata, cdata);
+        j->cchunk.index = 0;
+        j->cchunk.length = u->source_blocksize;
+        j->cchunk.memblock = pa_memblock_new(u->source->core->mempool, j->cchunk.length);
 
         if (u->save_aec) {
-            if (u->canceled_file)
-                unused = fwrite(cdata, 1, u->source_blocksize, u->canceled_file);
+            save_chunk(u->captured_file, &j->rchunk);
+            save_chunk(u->played_file, &j->pchunk);
         }
 
-        pa_memblock_release(cchunk.memblock);
-        pa_memblock_release(pchunk.memblock);
-        pa_memblock_release(rchunk.memblock);
-
         /* drop consumed source samples */
         pa_memblockq_drop(u->source_memblockq, u->source_output_blocksize);
-        pa_memblock_unref(rchunk.memblock);
         rlen -= u->source_output_blocksize;
 
         /* drop consumed sink samples */
         pa_memblockq_drop(u->sink_memblockq, u->sink_blocksize);
-        pa_memblock_unref(pchunk.memblock);
 
         if (plen >= u->sink_blocksize)
             plen -= u->sink_blocksize;
         else
             plen = 0;
 
-        /* forward the (echo-canceled) data to the virtual source */
-        pa_source_post(u->source, &cchunk);
-        pa_memblock_unref(cchunk.memblock);
+        /* perform echo cancellation, the job keeps the blocks */
+        submit_job(u, j);
     }
 }
 
@@ -1109,6 +1357,10 @@ static int source_output_process_msg_cb(pa_msgobject *obj, int code, void *data,
             apply_diff_time(u, offset);
             return 0;
 
+        case SOURCE_OUTPUT_MESSAGE_COLLECT:
+            collect_jobs(u);
+            return 0;
+
     }
 
     return pa_source_output_process_msg(obj, code, data, offset, chunk);
@@ -1312,11 +1564,6 @@ static void sink_input_attach_cb(pa_sink_input *i) {
 
     pa_log_debug("Sink input %d attach", i->index);
 
-    u->rtpoll_item_write = pa_rtpoll_item_new_asyncmsgq_write(
-            i->sink->thread_info.rtpoll,
-            PA_RTPOLL_LATE,
-            u->asyncmsgq);
-
     if (PA_SINK_IS_LINKED(u->sink->thread_info.state))
         pa_sink_attach_within_thread(u->sink);
 }
@@ -1354,11 +1601,6 @@ static void sink_input_detach_cb(pa_sink_input *i) {
     pa_sink_set_rtpoll(u->sink, NULL);
 
     pa_log_debug("Sink input %d detach", i->index);
-
-    if (u->rtpoll_item_write) {
-        pa_rtpoll_item_free(u->rtpoll_item_write);
-        u->rtpoll_item_write = NULL;
-    }
 }
 
 /* Called from source I/O thread context except when cork() is called without valid source. */
@@ -1596,19 +1838,33 @@ static int canceller_process_msg_cb(pa_msgobject *o, int code, void *userdata, i
     return 0;
 }
 
-/* Called by the canceller, so source I/O thread context. */
+/* Called by the canceller, so source I/O thread or worker thread context. */
 pa_volume_t pa_echo_canceller_get_capture_volume(pa_echo_canceller *ec) {
 #ifndef ECHO_CANCEL_TEST
-    return pa_cvolume_avg(&ec->msg->userdata->thread_info.current_volume);
+    struct userdata *u = ec->msg->userdata;
+
+    if (u->running_job)
+        return u->running_job->volume;
+
+    return pa_cvolume_avg(&u->thread_info.current_volume);
 #else
     return PA_VOLUME_NORM;
 #endif
 }
 
-/* Called by the canceller, so source I/O thread context. */
+/* Called by the canceller, so source I/O thread or worker thread context. */
 void pa_echo_canceller_set_capture_volume(pa_echo_canceller *ec, pa_volume_t v) {
 #ifndef ECHO_CANCEL_TEST
-    if (pa_cvolume_avg(&ec->msg->userdata->thread_info.current_volume) != v) {
+    struct userdata *u = ec->msg->userdata;
+
+    /* The source I/O thread takes care of this once the job is finished */
+    if (u->running_job) {
+        u->running_job->new_volume = v;
+        u->running_job->set_volume = true;
+        return;
+    }
+
+    if (pa_cvolume_avg(&u->thread_info.current_volume) != v) {
         pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(ec->msg), ECHO_CANCELLER_MESSAGE_SET_VOLUME, PA_UINT_TO_PTR(v),
                 0, NULL, NULL);
     }
@@ -1705,6 +1961,7 @@ int pa__init(pa_module*m) {
     uint32_t temp;
     uint32_t nframes = 0;
     bool use_master_format;
+    bool pipelined;
     pa_usec_t blocksize_usec;
 
     pa_assert(m);
@@ -1738,6 +1995,12 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    pipelined = DEFAULT_PIPELINED;
+    if (pa_modargs_get_value_boolean(ma, "pipelined", &pipelined) < 0) {
+        pa_log("pipelined= expects a boolean argument");
+        goto fail;
+    }
+
     source_ss = source_master->sample_spec;
     sink_ss = sink_master->sample_spec;
 
@@ -1838,6 +2101,9 @@ int pa__init(pa_module*m) {
     u->source_blocksize = nframes * pa_frame_size(&source_ss);
     u->sink_blocksize = nframes * pa_frame_size(&sink_ss);
 
+    u->load.block = pa_bytes_to_usec(u->source_output_blocksize, &source_output_ss);
+    u->load.reported = -1;
+
     if (u->ec->params.drift_compensation)
         pa_assert(u->ec->set_drift);
 
@@ -2081,6 +2347,27 @@ int pa__init(pa_module*m) {
         pa_sink_set_latency_range(u->sink, blocksize_usec, blocksize_usec * MAX_LATENCY_BLOCKS);
     pa_sink_input_set_requested_latency(u->sink_input, blocksize_usec * MAX_LATENCY_BLOCKS);
 
+    if (pipelined) {
+        unsigned i;
+
+        u->worker = pa_xnew0(struct ec_worker, 1);
+        u->worker->quit.type = EC_JOB_QUIT;
+
+        for (i = 0; i < PIPELINE_JOBS; i++)
+            PA_LLIST_PREPEND(struct ec_job, u->worker->free_jobs, &u->worker->jobs[i]);
+
+        if (!(u->worker->todo = pa_asyncq_new(PIPELINE_JOBS)) ||
+            !(u->worker->done = pa_asyncq_new(PIPELINE_JOBS))) {
+            pa_log("Failed to create job queues.");
+            goto fail;
+        }
+
+        if (!(u->worker->thread = pa_thread_new("echo-cancel", worker_thread_func, u))) {
+            pa_log("Failed to create worker thread.");
+            goto fail;
+        }
+    }
+
     /* The order here is important. The input/output must be put first,
      * otherwise streams might attach to the sink/source before the
      * sink input or source output is attached to the master. */
@@ -2106,6 +2393,30 @@ fail:
     return -1;
 }
 
+/* Called from main context, once the source output is unlinked. */
+static void worker_free(struct userdata *u) {
+    struct ec_job *j;
+
+    if (u->worker->thread) {
+        pa_assert_se(pa_asyncq_push(u->worker->todo, &u->worker->quit, true) == 0);
+        pa_thread_free(u->worker->thread);
+    }
+
+    /* Whatever the source I/O thread did not collect any more */
+    if (u->worker->done) {
+        while ((j = pa_asyncq_pop(u->worker->done, false)))
+            job_unref_chunks(j);
+
+        pa_asyncq_free(u->worker->done, NULL);
+    }
+
+    if (u->worker->todo)
+        pa_asyncq_free(u->worker->todo, NULL);
+
+    pa_xfree(u->worker);
+    u->worker = NULL;
+}
+
 /* Called from main context. */
 int pa__get_n_used(pa_module *m) {
     struct userdata *u;
@@ -2145,6 +2456,11 @@ void pa__done(pa_module*m) {
 
     if (u->source_output) {
         pa_source_output_unlink(u->source_output);
+
+        /* The worker posts to the source output */
+        if (u->worker)
+            worker_free(u);
+
         pa_source_output_unref(u->source_output);
     }
 
@@ -2192,7 +2508,7 @@ void pa__done(pa_module*m) {
     pa_xfree(u);
 }
 
-#ifdef ECHO_CANCEL_TEST
+#if defined(ECHO_CANCEL_TEST) && !defined(ECHO_CANCEL_BENCH)
 /*
  * Stand-alone test program for running in the canceller on pre-recorded files.
  */
@@ -2383,3 +2699,269 @@ fail:
     goto out;
 }
 #endif /* ECHO_CANCEL_TEST */
+
+#ifdef ECHO_CANCEL_BENCH
+/*
+ * Stand-alone benchmark for the cancellers. Feeds recorded far-end (played)
+ * and near-end (captured) audio files through a canceller and reports the
+ * real-time factor, the distribution of the processing time per block and
+ * the echo return loss enhancement (ERLE).
+ */
+
+/* Far-end blocks quieter than this don't count for the far-end ERLE */
+#define BENCH_FAR_END_THRESHOLD_DB (-50.0)
+
+static SNDFILE *bench_open(const char *path, pa_sample_spec *ss) {
+    SNDFILE *sf;
+    SF_INFO sfi;
+
+    pa_zero(sfi);
+
+    if (!(sf = sf_open(path, SFM_READ, &sfi))) {
+        pa_log("Failed to open file %s: %s", path, sf_strerror(NULL));
+        return NULL;
+    }
+
+    if (pa_sndfile_read_sample_spec(sf, ss) < 0) {
+        pa_log("Failed to determine sample format of %s", path);
+        sf_close(sf);
+        return NULL;
+    }
+
+    return sf;
+}
+
+/* Returns the mean square of the block, tmp must hold all its samples as
+ * floats */
+static double block_power(const void *data, unsigned n_frames, const pa_sample_spec *ss, float *tmp) {
+    unsigned n, i;
+    double sum = 0;
+
+    n = n_frames * ss->channels;
+    pa_get_convert_to_float32ne_function(ss->format)(n, data, tmp);
+
+    for (i = 0; i < n; i++)
+        sum += (double) tmp[i] * tmp[i];
+
+    return sum / n;
+}
+
+static double power_ratio_db(double a, double b) {
+    if (b <= 0)
+        return INFINITY;
+
+    return 10 * log10(a / b);
+}
+
+static int usec_compare(const void *a, const void *b) {
+    pa_usec_t x = *(const pa_usec_t *) a, y = *(const pa_usec_t *) b;
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+int main(int argc, char* argv[]) {
+    struct userdata u;
+    pa_sample_spec rec_ss, play_ss, out_ss, file_ss;
+    pa_channel_map rec_map, play_map, out_map;
+    SNDFILE *rec_sf = NULL, *play_sf = NULL, *out_sf = NULL;
+    pa_sndfile_readf_t readf_rec, readf_play;
+    pa_sndfile_writef_t writef_out = NULL;
+    pa_modargs *ma = NULL;
+    uint8_t *rdata = NULL, *pdata = NULL, *cdata = NULL;
+    float *tmp = NULL;
+    pa_usec_t *block_usec = NULL, start, total_usec = 0, block_length, misses = 0;
+    unsigned n_blocks = 0, n_alloc = 0, n_far_blocks = 0;
+    double rec_power = 0, out_power = 0, far_rec_power = 0, far_out_power = 0, threshold;
+    size_t rec_size, play_size;
+    sf_count_t n;
+    uint32_t nframes;
+    int ret = 0;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_INFO);
+
+    pa_memzero(&u, sizeof(u));
+
+    if (argc < 3 || argc > 5)
+        goto usage;
+
+    if (!(play_sf = bench_open(argv[1], &play_ss)) ||
+        !(rec_sf = bench_open(argv[2], &rec_ss)))
+        goto fail;
+
+    if (play_ss.rate != rec_ss.rate) {
+        pa_log("Played and captured files have different sample rates");
+        goto fail;
+    }
+
+    u.core = pa_xnew0(pa_core, 1);
+    pa_cpu_init(&u.core->cpu_info);
+
+    if (!(ma = pa_modargs_new(argc > 4 ? argv[4] : NULL, valid_modargs))) {
+        pa_log("Failed to parse module arguments.");
+        goto fail;
+    }
+
+    /* The files decide rate and channels, the module arguments may still
+     * override them to see what the canceller does with that */
+    out_ss.format = PA_SAMPLE_FLOAT32NE;
+    out_ss.rate = rec_ss.rate;
+    out_ss.channels = rec_ss.channels;
+    pa_channel_map_init_auto(&out_map, out_ss.channels, PA_CHANNEL_MAP_DEFAULT);
+
+    play_ss.format = PA_SAMPLE_FLOAT32NE;
+    pa_channel_map_init_auto(&play_map, play_ss.channels, PA_CHANNEL_MAP_DEFAULT);
+
+    if (init_common(ma, &u, &out_ss, &out_map) < 0)
+        goto fail;
+
+    rec_ss = out_ss;
+    rec_map = out_map;
+    file_ss = rec_ss;
+
+    if (!u.ec->init(u.core, u.ec, &rec_ss, &rec_map, &play_ss, &play_map, &out_ss, &out_map, &nframes,
+                     pa_modargs_get_value(ma, "aec_args", NULL))) {
+        pa_log("Failed to init AEC engine");
+        goto fail;
+    }
+
+    if (rec_ss.rate != file_ss.rate || rec_ss.channels != file_ss.channels || play_ss.rate != rec_ss.rate) {
+        pa_log("The canceller wants %u Hz, %u channels, resample the files first", rec_ss.rate, rec_ss.channels);
+        goto fail;
+    }
+
+    if (!(readf_rec = pa_sndfile_readf_function(&rec_ss)) || !(readf_play = pa_sndfile_readf_function(&play_ss))) {
+        pa_log("The canceller wants a sample format that can't be read from files");
+        goto fail;
+    }
+
+    if (argc > 3 && !pa_streq(argv[3], "-")) {
+        SF_INFO sfi;
+
+        pa_zero(sfi);
+        file_ss = out_ss;
+
+        if (pa_sndfile_write_sample_spec(&sfi, &file_ss) < 0 || file_ss.format != out_ss.format ||
+            !(writef_out = pa_sndfile_writef_function(&out_ss))) {
+            pa_log("The canceller's output format can't be written to files");
+            goto fail;
+        }
+
+        sfi.format |= SF_FORMAT_WAV;
+
+        if (!(out_sf = sf_open(argv[3], SFM_WRITE, &sfi))) {
+            pa_log("Failed to open file %s: %s", argv[3], sf_strerror(NULL));
+            goto fail;
+        }
+    }
+
+    rec_size = nframes * pa_frame_size(&rec_ss);
+    play_size = nframes * pa_frame_size(&play_ss);
+
+    rdata = pa_xmalloc(rec_size);
+    pdata = pa_xmalloc(play_size);
+    cdata = pa_xmalloc(nframes * pa_frame_size(&out_ss));
+    tmp = pa_xnew(float, nframes * PA_MAX(PA_MAX(rec_ss.channels, play_ss.channels), out_ss.channels));
+
+    block_length = pa_bytes_to_usec(rec_size, &rec_ss);
+    threshold = pow(10, BENCH_FAR_END_THRESHOLD_DB / 10);
+
+    while (readf_rec(rec_sf, rdata, nframes) == (sf_count_t) nframes) {
+        double rp, op;
+
+        /* Play silence once the played file ends */
+        if ((n = readf_play(play_sf, pdata, nframes)) < (sf_count_t) nframes)
+            pa_silence_memory(pdata + PA_MAX(n, 0) * pa_frame_size(&play_ss), play_size - PA_MAX(n, 0) * pa_frame_size(&play_ss), &play_ss);
+
+        start = pa_rtclock_now();
+
+        if (u.ec->params.drift_compensation) {
+            u.ec->play(u.ec, pdata);
+            u.ec->set_drift(u.ec, 0);
+            u.ec->record(u.ec, rdata, cdata);
+        } else
+            u.ec->run(u.ec, rdata, pdata, cdata);
+
+        if (n_blocks == n_alloc) {
+            n_alloc = PA_MAX(n_alloc * 2, 1024U);
+            block_usec = pa_xrenew(pa_usec_t, block_usec, n_alloc);
+        }
+
+        block_usec[n_blocks] = pa_rtclock_now() - start;
+        total_usec += block_usec[n_blocks];
+
+        if (block_usec[n_blocks] > block_length)
+            misses++;
+
+        n_blocks++;
+
+        rp = block_power(rdata, nframes, &rec_ss, tmp);
+        op = block_power(cdata, nframes, &out_ss, tmp);
+
+        rec_power += rp;
+        out_power += op;
+
+        if (block_power(pdata, nframes, &play_ss, tmp) >= threshold) {
+            far_rec_power += rp;
+            far_out_power += op;
+            n_far_blocks++;
+        }
+
+        if (out_sf)
+            writef_out(out_sf, cdata, nframes);
+    }
+
+    if (n_blocks == 0) {
+        pa_log("Captured file is shorter than one block");
+        goto fail;
+    }
+
+    qsort(block_usec, n_blocks, sizeof(pa_usec_t), usec_compare);
+
+    printf("%-20s %s\n", "aec_method", pa_modargs_get_value(ma, "aec_method", DEFAULT_ECHO_CANCELLER));
+    printf("%-20s %u frames, %llu usec\n", "block", nframes, (unsigned long long) block_length);
+    printf("%-20s %u, %.2f s\n", "blocks", n_blocks, (double) n_blocks * block_length / PA_USEC_PER_SEC);
+    printf("%-20s %.4f\n", "real_time_factor", (double) total_usec / ((double) n_blocks * block_length));
+    printf("%-20s min %llu, p50 %llu, p90 %llu, p99 %llu, max %llu, mean %.1f\n", "block_usec",
+           (unsigned long long) block_usec[0],
+           (unsigned long long) block_usec[n_blocks / 2],
+           (unsigned long long) block_usec[n_blocks * 9 / 10],
+           (unsigned long long) block_usec[n_blocks * 99 / 100],
+           (unsigned long long) block_usec[n_blocks - 1],
+           (double) total_usec / n_blocks);
+    printf("%-20s %llu\n", "late_blocks", (unsigned long long) misses);
+    printf("%-20s %.2f dB\n", "erle", power_ratio_db(rec_power, out_power));
+    printf("%-20s %.2f dB, %u blocks\n", "erle_far_end", power_ratio_db(far_rec_power, far_out_power), n_far_blocks);
+
+    u.ec->done(u.ec);
+
+out:
+    if (rec_sf)
+        sf_close(rec_sf);
+    if (play_sf)
+        sf_close(play_sf);
+    if (out_sf)
+        sf_close(out_sf);
+
+    pa_xfree(rdata);
+    pa_xfree(pdata);
+    pa_xfree(cdata);
+    pa_xfree(tmp);
+    pa_xfree(block_usec);
+
+    pa_xfree(u.ec);
+    pa_xfree(u.core);
+
+    if (ma)
+        pa_modargs_free(ma);
+
+    return ret;
+
+usage:
+    pa_log("Usage: %s play_file rec_file [out_file|-] [module args]", argv[0]);
+
+fail:
+    ret = -1;
+    goto out;
+}
+#endif /* ECHO_CANCEL_BENCH */
@@ -59,7 +59,9 @@ PA_MODULE_USAGE(
         "format=<sample format> "
         "rate=<sample rate> "
         "channels=<number of channels> "
-        "channel_map=<channel map>");
+        "channel_map=<channel map> "
+        "thread_cpu_affinity=<list of CPUs for the IO thread> "
+        "thread_priority_offset=<realtime priority of the IO thread relative to realtime-priority>");
 
 #define DEFAULT_SINK_NAME "combined"
 
@@ -79,6 +81,8 @@ static const char* const valid_modargs[] = {
     "rate",
     "channels",
     "channel_map",
+    "thread_cpu_affinity",
+    "thread_priority_offset",
     NULL
 };
 
@@ -108,9 +112,9 @@ struct output {
     /* Message queue from the output thread to the sink thread. */
     pa_asyncmsgq *outq;
 
-    pa_rtpoll_item *audio_inq_rtpoll_item_read, *audio_inq_rtpoll_item_write;
-    pa_rtpoll_item *control_inq_rtpoll_item_read, *control_inq_rtpoll_item_write;
-    pa_rtpoll_item *outq_rtpoll_item_read, *outq_rtpoll_item_write;
+    pa_rtpoll_item *audio_inq_rtpoll_item_read;
+    pa_rtpoll_item *control_inq_rtpoll_item_read;
+    pa_rtpoll_item *outq_rtpoll_item_read;
 
     pa_memblockq *memblockq;
 
@@ -133,6 +137,7 @@ struct userdata {
     pa_thread *thread;
     pa_thread_mq thread_mq;
     pa_rtpoll *rtpoll;
+    pa_io_thread_config thread_config;
 
     pa_time_event *time_event;
     pa_usec_t adjust_time;
@@ -319,8 +324,7 @@ static void thread_func(void *userdata) {
 
     pa_log_debug("Thread starting up");
 
-    if (u->core->realtime_scheduling)
-        pa_thread_make_realtime(u->core->realtime_priority+1);
+    pa_core_setup_io_thread(u->core, &u->thread_config);
 
     pa_thread_mq_install(&u->thread_mq);
 
@@ -533,7 +537,6 @@ static void sink_input_attach_cb(pa_sink_input *i) {
     /* Set up the queue from the sink thread to us */
     pa_assert(!o->audio_inq_rtpoll_item_read);
     pa_assert(!o->control_inq_rtpoll_item_read);
-    pa_assert(!o->outq_rtpoll_item_write);
 
     o->audio_inq_rtpoll_item_read = pa_rtpoll_item_new_asyncmsgq_read(
             i->sink->thread_info.rtpoll,
@@ -545,11 +548,6 @@ static void sink_input_attach_cb(pa_sink_input *i) {
             PA_RTPOLL_NORMAL,
             o->control_inq);
 
-    o->outq_rtpoll_item_write = pa_rtpoll_item_new_asyncmsgq_write(
-            i->sink->thread_info.rtpoll,
-            PA_RTPOLL_EARLY,
-            o->outq);
-
     pa_sink_input_request_rewind(i, 0, false, true, true);
 
     nbytes = pa_sink_input_get_max_request(i);
@@ -592,12 +590,6 @@ static void sink_input_detach_cb(pa_sink_input *i) {
         pa_rtpoll_item_free(o->control_inq_rtpoll_item_read);
         o->control_inq_rtpoll_item_read = NULL;
     }
-
-    if (o->outq_rtpoll_item_write) {
-        pa_rtpoll_item_free(o->outq_rtpoll_item_write);
-        o->outq_rtpoll_item_write = NULL;
-    }
-
 }
 
 /* Called from main context */
@@ -815,21 +807,11 @@ static void output_add_within_thread(struct output *o) {
     PA_LLIST_PREPEND(struct output, o->userdata->thread_info.active_outputs, o);
 
     pa_assert(!o->outq_rtpoll_item_read);
-    pa_assert(!o->audio_inq_rtpoll_item_write);
-    pa_assert(!o->control_inq_rtpoll_item_write);
 
     o->outq_rtpoll_item_read = pa_rtpoll_item_new_asyncmsgq_read(
             o->userdata->rtpoll,
             PA_RTPOLL_EARLY-1,  /* This item is very important */
             o->outq);
-    o->audio_inq_rtpoll_item_write = pa_rtpoll_item_new_asyncmsgq_write(
-            o->userdata->rtpoll,
-            PA_RTPOLL_EARLY,
-            o->audio_inq);
-    o->control_inq_rtpoll_item_write = pa_rtpoll_item_new_asyncmsgq_write(
-            o->userdata->rtpoll,
-            PA_RTPOLL_NORMAL,
-            o->control_inq);
 }
 
 /* Called from thread context of the io thread */
@@ -843,16 +825,6 @@ static void output_remove_within_thread(struct output *o) {
         pa_rtpoll_item_free(o->outq_rtpoll_item_read);
         o->outq_rtpoll_item_read = NULL;
     }
-
-    if (o->audio_inq_rtpoll_item_write) {
-        pa_rtpoll_item_free(o->audio_inq_rtpoll_item_write);
-        o->audio_inq_rtpoll_item_write = NULL;
-    }
-
-    if (o->control_inq_rtpoll_item_write) {
-        pa_rtpoll_item_free(o->control_inq_rtpoll_item_write);
-        o->control_inq_rtpoll_item_write = NULL;
-    }
 }
 
 /* Called from sink I/O thread context */
@@ -1083,18 +1055,12 @@ static void output_free(struct output *o) {
 
     if (o->audio_inq_rtpoll_item_read)
         pa_rtpoll_item_free(o->audio_inq_rtpoll_item_read);
-    if (o->audio_inq_rtpoll_item_write)
-        pa_rtpoll_item_free(o->audio_inq_rtpoll_item_write);
 
     if (o->control_inq_rtpoll_item_read)
         pa_rtpoll_item_free(o->control_inq_rtpoll_item_read);
-    if (o->control_inq_rtpoll_item_write)
-        pa_rtpoll_item_free(o->control_inq_rtpoll_item_write);
 
     if (o->outq_rtpoll_item_read)
         pa_rtpoll_item_free(o->outq_rtpoll_item_read);
-    if (o->outq_rtpoll_item_write)
-        pa_rtpoll_item_free(o->outq_rtpoll_item_write);
 
     if (o->audio_inq)
         pa_asyncmsgq_unref(o->audio_inq);
@@ -1313,6 +1279,14 @@ int pa__init(pa_module*m) {
     m->userdata = u = pa_xnew0(struct userdata, 1);
     u->core = m->core;
     u->module = m;
+
+    /* Run slightly above the devices we are feeding */
+    u->thread_config.priority_offset = 1;
+    if (pa_modargs_get_io_thread_config(ma, &u->thread_config) < 0) {
+        pa_log("Failed to parse thread_cpu_affinity or thread_priority_offset argument.");
+        goto fail;
+    }
+
     u->rtpoll = pa_rtpoll_new();
 
     if (pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll) < 0) {
@@ -1577,5 +1551,7 @@ void pa__done(pa_module*m) {
     if (u->thread_info.smoother)
         pa_smoother_free(u->thread_info.smoother);
 
+    pa_io_thread_config_done(&u->thread_config);
+
     pa_xfree(u);
 }
@@ -59,10 +59,12 @@
 #include <pulsecore/sample-util.h>
 #include <pulsecore/shared.h>
 #include <pulsecore/idxset.h>
+#include <pulsecore/hashmap.h>
 #include <pulsecore/strlist.h>
 #include <pulsecore/database.h>
 #include <pulsecore/protocol-dbus.h>
 #include <pulsecore/dbus-util.h>
+#include <pulsecore/filter/convolver.h>
 
 PA_MODULE_AUTHOR("Jason Newton");
 PA_MODULE_DESCRIPTION(_("General Purpose Equalizer"));
@@ -78,10 +80,13 @@ PA_MODULE_USAGE(
           "channel_map=<channel map> "
           "autoloaded=<set if this module is being loaded automatically> "
           "use_volume_sharing=<yes or no> "
+          "partitioned=<use low latency partitioned convolution instead of overlap-add> "
+          "partitioned_taps=<filter length in partitioned mode, up to the fft size; the default of a quarter of it loses low frequency detail> "
          ));
 
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 #define DEFAULT_AUTOLOADED false
+#define DEFAULT_PARTITIONED false
 
 struct userdata {
     pa_module *module;
@@ -107,9 +112,22 @@ struct userdata {
     float *W;//windowing function (time domain)
     float *work_buffer, **input, **overlap_accum;
     fftwf_complex *output_window;
+    struct fft_plans *plans;
     fftwf_plan forward_plan, inverse_plan;
     //size_t samplings;
 
+    //partitioned mode: the filters as minimum phase impulse responses
+    //(preamp included), run by a zero latency partitioned convolver.
+    //They are cut to partitioned_taps, which loses the detail of the
+    //filter below about rate / partitioned_taps Hz unless it's fft_size
+    bool partitioned;
+    size_t partitioned_taps;
+    pa_convolver *convolver;
+    float ***Is;//thread updatable copies, along with Hs
+    unsigned **I_versions;//which filter update the copies are from
+    unsigned I_version;//the last filter update (main thread)
+    unsigned *applied_versions;//the ones in the convolver (io thread)
+
     float **Xs;
     float ***Hs;//thread updatable copies of the freq response filters (magnitude based)
     pa_aupdate **a_H;
@@ -139,6 +157,8 @@ static const char* const valid_modargs[] = {
     "channel_map",
     "autoloaded",
     "use_volume_sharing",
+    "partitioned",
+    "partitioned_taps",
     NULL
 };
 
@@ -149,6 +169,20 @@ static const char* const valid_modargs[] = {
 #define FILTER_SIZE(u) ((u)->fft_size / 2 + 1)
 #define CHANNEL_PROFILE_SIZE(u) (FILTER_SIZE(u) + 1)
 #define FILTER_STATE_SIZE(u) (CHANNEL_PROFILE_SIZE(u) * (u)->channels)
+#define FFT_PLANS "equalizer_fft_plans"
+#define FFTW_WISDOM "equalizer-fftw-wisdom"
+#define PARTITION_SIZE 256
+#define DEFAULT_PARTITIONED_TAPS(u) ((u)->fft_size / 4)
+#define MIN_MAGNITUDE 1e-7f
+
+/* FFTW plans of one size, shared by the channels and all instances of the
+ * module. Plans are only made and destroyed in the main thread; executing
+ * them is thread safe. */
+struct fft_plans {
+    size_t fft_size;
+    unsigned ref;
+    fftwf_plan forward, inverse;
+};
 
 static void dbus_init(struct userdata *u);
 static void dbus_done(struct userdata *u);
@@ -220,6 +254,136 @@ static void * alloc(size_t x, size_t s) {
     return t;
 }
 
+/* Planning with FFTW_MEASURE takes a while, so it is only done if measure
+ * is set, and the plans are saved as wisdom. Otherwise the plans come
+ * from wisdom if there is any, and are estimated if not. A cached plan is
+ * used as it is either way. */
+static struct fft_plans *fft_plans_ref(pa_core *c, size_t fft_size, bool measure) {
+    pa_hashmap *cache;
+    struct fft_plans *p;
+    float *t;
+    fftwf_complex *f;
+    char *wisdom;
+
+    if (!(cache = pa_shared_get(c, FFT_PLANS))) {
+        cache = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+        pa_shared_set(c, FFT_PLANS, cache);
+    }
+
+    if ((p = pa_hashmap_get(cache, PA_UINT_TO_PTR(fft_size)))) {
+        p->ref++;
+        return p;
+    }
+
+    p = pa_xnew0(struct fft_plans, 1);
+    p->fft_size = fft_size;
+    p->ref = 1;
+
+    //planning overwrites the arrays, plan with scratch ones
+    t = alloc(fft_size, sizeof(float));
+    f = alloc(fft_size / 2 + 1, sizeof(fftwf_complex));
+
+    if ((wisdom = pa_state_path(FFTW_WISDOM, true)))
+        fftwf_import_wisdom_from_filename(wisdom);
+
+    p->forward = fftwf_plan_dft_r2c_1d(fft_size, t, f, FFTW_MEASURE | FFTW_WISDOM_ONLY);
+    p->inverse = fftwf_plan_dft_c2r_1d(fft_size, f, t, FFTW_MEASURE | FFTW_WISDOM_ONLY);
+
+    if ((!p->forward || !p->inverse) && measure) {
+        pa_log_info("No FFTW wisdom for size %zu, planning.", fft_size);
+
+        if (!p->forward)
+            pa_assert_se(p->forward = fftwf_plan_dft_r2c_1d(fft_size, t, f, FFTW_MEASURE));
+        if (!p->inverse)
+            pa_assert_se(p->inverse = fftwf_plan_dft_c2r_1d(fft_size, f, t, FFTW_MEASURE));
+
+        if (wisdom && !fftwf_export_wisdom_to_filename(wisdom))
+            pa_log_warn("Failed to save FFTW wisdom to %s", wisdom);
+    } else {
+        if (!p->forward)
+            pa_assert_se(p->forward = fftwf_plan_dft_r2c_1d(fft_size, t, f, FFTW_ESTIMATE));
+        if (!p->inverse)
+            pa_assert_se(p->inverse = fftwf_plan_dft_c2r_1d(fft_size, f, t, FFTW_ESTIMATE));
+    }
+
+    pa_xfree(wisdom);
+    fftwf_free(t);
+    fftwf_free(f);
+
+    pa_hashmap_put(cache, PA_UINT_TO_PTR(fft_size), p);
+
+    return p;
+}
+
+static void fft_plans_unref(pa_core *c, struct fft_plans *p) {
+    pa_hashmap *cache;
+
+    if (--p->ref > 0)
+        return;
+
+    pa_assert_se(cache = pa_shared_get(c, FFT_PLANS));
+    pa_hashmap_remove(cache, PA_UINT_TO_PTR(p->fft_size));
+
+    fftwf_destroy_plan(p->forward);
+    fftwf_destroy_plan(p->inverse);
+    pa_xfree(p);
+
+    if (pa_hashmap_isempty(cache)) {
+        pa_shared_remove(c, FFT_PLANS);
+        pa_hashmap_free(cache);
+    }
+}
+
+/* Turns the magnitude response H (with the fft gain divided out) into
+ * the minimum phase impulse response h with the same magnitudes, scaled
+ * by the preamp X. Uses the cepstrum: folding its anticausal half onto
+ * the causal one makes the response minimum phase. Called from main
+ * context, work_buffer and output_window are free in partitioned mode. */
+static void design_min_phase(struct userdata *u, const float *H, float X, float *h) {
+    const size_t n = u->fft_size, taps = u->partitioned_taps, fade = taps < n ? taps / 8 : 0;
+    float *t = u->work_buffer;
+    fftwf_complex *f = u->output_window;
+
+    for (size_t k = 0; k < FILTER_SIZE(u); ++k) {
+        f[k][0] = logf(PA_MAX(H[k] * n, MIN_MAGNITUDE));
+        f[k][1] = 0;
+    }
+    fftwf_execute_dft_c2r(u->inverse_plan, f, t);
+
+    //the cepstrum, folded
+    t[0] /= n;
+    for (size_t j = 1; j < n / 2; ++j)
+        t[j] *= 2.0f / n;
+    t[n / 2] /= n;
+    memset(t + n / 2 + 1, 0, (n / 2 - 1) * sizeof(float));
+
+    fftwf_execute_dft_r2c(u->forward_plan, t, f);
+    for (size_t k = 0; k < FILTER_SIZE(u); ++k) {
+        float m = expf(f[k][0]) / n, phase = f[k][1];
+        f[k][0] = m * cosf(phase);
+        f[k][1] = m * sinf(phase);
+    }
+    fftwf_execute_dft_c2r(u->inverse_plan, f, t);
+
+    //truncate with a fade out over the last eighth, unless all is kept
+    for (size_t j = 0; j < taps; ++j) {
+        float w = 1.0f;
+        if (j >= taps - fade)
+            w = (float) (.5 * (1 + cos(M_PI * (j - (taps - fade)) / fade)));
+        h[j] = X * w * t[j];
+    }
+}
+
+/* Called from main context, after the filter of a channel has been
+ * written and before the aupdate write ends */
+static void filter_updated(struct userdata *u, size_t channel, unsigned a_i) {
+    if (!u->partitioned)
+        return;
+
+    design_min_phase(u, u->Hs[channel][a_i], u->Xs[channel][a_i], u->Is[channel][a_i]);
+    u->I_versions[channel][a_i] = ++u->I_version;
+}
+
 static void alloc_input_buffers(struct userdata *u, size_t min_buffer_length) {
     if (min_buffer_length <= u->input_buffer_max)
         return;
@@ -603,6 +767,61 @@ static void input_buffer(struct userdata *u, pa_memchunk *in) {
     pa_memblock_release(in->memblock);
 }
 
+/* Called from I/O thread context */
+static void update_responses(struct userdata *u) {
+    for (size_t c = 0; c < u->channels; ++c) {
+        unsigned a_i = pa_aupdate_read_begin(u->a_H[c]);
+        if (u->I_versions[c][a_i] != u->applied_versions[c]) {
+            pa_convolver_set_response(u->convolver, c, c, u->Is[c][a_i]);
+            u->applied_versions[c] = u->I_versions[c][a_i];
+        }
+        pa_aupdate_read_end(u->a_H[c]);
+    }
+}
+
+/* Called from I/O thread context */
+static int partitioned_pop(struct userdata *u, size_t nbytes, pa_memchunk *chunk) {
+    size_t fs = pa_frame_size(&(u->sink->sample_spec));
+    pa_memchunk tchunk;
+    float *src, *dst;
+    unsigned n;
+
+    /* Hmm, process any rewind request that might be queued up */
+    pa_sink_process_rewind(u->sink, 0);
+
+    //no blocks to gather, the convolver takes any number of frames
+    while (pa_memblockq_peek(u->input_q, &tchunk) < 0) {
+        pa_memchunk nchunk;
+
+        pa_sink_render(u->sink, nbytes, &nchunk);
+        pa_memblockq_push(u->input_q, &nchunk);
+        pa_memblock_unref(nchunk.memblock);
+    }
+
+    tchunk.length = PA_MIN(nbytes, tchunk.length);
+    n = (unsigned) (tchunk.length / fs);
+    pa_assert(n > 0);
+
+    pa_memblockq_drop(u->input_q, n * fs);
+
+    update_responses(u);
+
+    chunk->index = 0;
+    chunk->length = n * fs;
+    chunk->memblock = pa_memblock_new(u->sink->core->mempool, chunk->length);
+
+    src = pa_memblock_acquire_chunk(&tchunk);
+    dst = pa_memblock_acquire(chunk->memblock);
+    pa_convolver_process(u->convolver, src, dst, n);
+    pa_sample_clamp(PA_SAMPLE_FLOAT32NE, dst, sizeof(float), dst, sizeof(float), n * u->channels);
+    pa_memblock_release(chunk->memblock);
+    pa_memblock_release(tchunk.memblock);
+
+    pa_memblock_unref(tchunk.memblock);
+
+    return 0;
+}
+
 /* Called from I/O thread context */
 static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
     struct userdata *u;
@@ -619,6 +838,9 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     if (!PA_SINK_IS_LINKED(u->sink->thread_info.state))
         return -1;
 
+    if (u->partitioned)
+        return partitioned_pop(u, nbytes, chunk);
+
     /* FIXME: Please clean this up. I see more commented code lines
      * than uncommented code lines. I am sorry, but I am too dumb to
      * understand this. */
@@ -760,13 +982,18 @@ static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
         if (amount > 0) {
             //invalidate the output q
             pa_memblockq_seek(u->input_q, - (int64_t) amount, PA_SEEK_RELATIVE, true);
-            pa_log("Resetting filter");
+            if (!u->partitioned)
+                pa_log("Resetting filter");
             //reset_filter(u); //this is the "proper" thing to do...
         }
     }
 
     pa_sink_process_rewind(u->sink, amount);
     pa_memblockq_rewind(u->input_q, nbytes);
+
+    //the frames read again from input_q will be filtered again
+    if (u->partitioned)
+        pa_convolver_rewind(u->convolver, nbytes / pa_frame_size(&u->sink->sample_spec));
 }
 
 /* Called from I/O thread context */
@@ -780,6 +1007,9 @@ static void sink_input_update_max_rewind_cb(pa_sink_input *i, size_t nbytes) {
      * https://bugs.freedesktop.org/show_bug.cgi?id=53709 */
     pa_memblockq_set_maxrewind(u->input_q, nbytes);
     pa_sink_set_max_rewind_within_thread(u->sink, nbytes);
+
+    if (u->partitioned)
+        pa_convolver_set_max_rewind(u->convolver, nbytes / pa_frame_size(&u->sink->sample_spec));
 }
 
 /* Called from I/O thread context */
@@ -791,7 +1021,10 @@ static void sink_input_update_max_request_cb(pa_sink_input *i, size_t nbytes) {
     pa_assert_se(u = i->userdata);
 
     fs = pa_frame_size(&u->sink_input->sample_spec);
-    pa_sink_set_max_request_within_thread(u->sink, PA_ROUND_UP(nbytes / fs, u->R) * fs);
+    if (u->partitioned)
+        pa_sink_set_max_request_within_thread(u->sink, nbytes);
+    else
+        pa_sink_set_max_request_within_thread(u->sink, PA_ROUND_UP(nbytes / fs, u->R) * fs);
 }
 
 /* Called from I/O thread context */
@@ -840,9 +1073,13 @@ static void sink_input_attach_cb(pa_sink_input *i) {
     pa_sink_set_fixed_latency_within_thread(u->sink, i->sink->thread_info.fixed_latency);
 
     fs = pa_frame_size(&u->sink_input->sample_spec);
-    /* set buffer size to max request, no overlap copy */
-    max_request = PA_ROUND_UP(pa_sink_input_get_max_request(u->sink_input) / fs, u->R);
-    max_request = PA_MAX(max_request, u->window_size);
+    if (u->partitioned)
+        max_request = pa_sink_input_get_max_request(u->sink_input) / fs;
+    else {
+        /* set buffer size to max request, no overlap copy */
+        max_request = PA_ROUND_UP(pa_sink_input_get_max_request(u->sink_input) / fs, u->R);
+        max_request = PA_MAX(max_request, u->window_size);
+    }
 
     pa_sink_set_max_request_within_thread(u->sink, max_request * fs);
 
@@ -850,6 +1087,9 @@ static void sink_input_attach_cb(pa_sink_input *i) {
      * https://bugs.freedesktop.org/show_bug.cgi?id=53709 */
     pa_sink_set_max_rewind_within_thread(u->sink, pa_sink_input_get_max_rewind(i));
 
+    if (u->partitioned)
+        pa_convolver_set_max_rewind(u->convolver, pa_sink_input_get_max_rewind(i) / fs);
+
     if (PA_SINK_IS_LINKED(u->sink->thread_info.state))
         pa_sink_attach_within_thread(u->sink);
 }
@@ -1002,6 +1242,7 @@ static const char* load_profile(struct userdata *u, size_t channel, char *name)
             u->Xs[channel][a_i] = profile[0];
             memcpy(u->Hs[channel][a_i], profile + 1, FILTER_SIZE(u) * sizeof(float));
             fix_filter(u->Hs[channel][a_i], u->fft_size);
+            filter_updated(u, channel, a_i);
             pa_aupdate_write_end(u->a_H[channel]);
             pa_xfree(u->base_profiles[channel]);
             u->base_profiles[channel] = pa_xstrdup(name);
@@ -1042,6 +1283,7 @@ static void load_state(struct userdata *u) {
                 H = state + c * CHANNEL_PROFILE_SIZE(u) + 1;
                 u->Xs[c][a_i] = state[c * CHANNEL_PROFILE_SIZE(u)];
                 memcpy(u->Hs[c][a_i], H, FILTER_SIZE(u) * sizeof(float));
+                filter_updated(u, c, a_i);
                 pa_aupdate_write_end(u->a_H[c]);
             }
             unpack(((char *)value.data) + FILTER_STATE_SIZE(u) * sizeof(float), value.size - FILTER_STATE_SIZE(u) * sizeof(float), &names, &n_profs);
@@ -1113,6 +1355,7 @@ int pa__init(pa_module*m) {
     float *H;
     unsigned a_i;
     bool use_volume_sharing = true;
+    uint32_t partitioned_taps;
 
     pa_assert(m);
 
@@ -1149,9 +1392,24 @@ int pa__init(pa_module*m) {
     u->module = m;
     m->userdata = u;
 
+    u->partitioned = DEFAULT_PARTITIONED;
+    if (pa_modargs_get_value_boolean(ma, "partitioned", &u->partitioned) < 0) {
+        pa_log("partitioned= expects a boolean argument");
+        goto fail;
+    }
+
     u->channels = ss.channels;
     u->fft_size = pow(2, ceil(log(ss.rate) / log(2)));//probably unstable near corner cases of powers of 2
     pa_log_debug("fft size: %zd", u->fft_size);
+
+    partitioned_taps = DEFAULT_PARTITIONED_TAPS(u);
+    if (pa_modargs_get_value_u32(ma, "partitioned_taps", &partitioned_taps) < 0 ||
+        partitioned_taps < PARTITION_SIZE || partitioned_taps > u->fft_size) {
+        pa_log("partitioned_taps= expects a number between %u and %zu", PARTITION_SIZE, u->fft_size);
+        goto fail;
+    }
+    u->partitioned_taps = partitioned_taps;
+
     u->window_size = 15999;
     if (u->window_size % 2 == 0)
         u->window_size--;
@@ -1181,8 +1439,21 @@ int pa__init(pa_module*m) {
         u->overlap_accum[c] = alloc(u->overlap_size, sizeof(float));
     }
     u->output_window = alloc(FILTER_SIZE(u), sizeof(fftwf_complex));
-    u->forward_plan = fftwf_plan_dft_r2c_1d(u->fft_size, u->work_buffer, u->output_window, FFTW_ESTIMATE);
-    u->inverse_plan = fftwf_plan_dft_c2r_1d(u->fft_size, u->output_window, u->work_buffer, FFTW_ESTIMATE);
+    u->plans = fft_plans_ref(m->core, u->fft_size, u->partitioned);
+    u->forward_plan = u->plans->forward;
+    u->inverse_plan = u->plans->inverse;
+
+    if (u->partitioned) {
+        u->Is = pa_xnew0(float **, u->channels);
+        u->I_versions = pa_xnew0(unsigned *, u->channels);
+        u->applied_versions = pa_xnew0(unsigned, u->channels);
+        for (c = 0; c < u->channels; ++c) {
+            u->Is[c] = pa_xnew0(float *, 2);
+            u->I_versions[c] = pa_xnew0(unsigned, 2);
+            for (i = 0; i < 2; ++i)
+                u->Is[c][i] = alloc(u->partitioned_taps, sizeof(float));
+        }
+    }
 
     hanning_window(u->W, u->window_size);
     u->first_iteration = true;
@@ -1302,12 +1573,29 @@ int pa__init(pa_module*m) {
             H[i] = 1.0 / sqrtf(2.0f);
 
         fix_filter(H, u->fft_size);
+        filter_updated(u, c, a_i);
         pa_aupdate_write_end(u->a_H[c]);
     }
 
     /* load old parameters */
     load_state(u);
 
+    if (u->partitioned) {
+        const float **responses = pa_xnew(const float *, u->channels);
+
+        for (c = 0; c < u->channels; ++c) {
+            a_i = pa_aupdate_read_begin(u->a_H[c]);
+            responses[c] = u->Is[c][a_i];
+            u->applied_versions[c] = u->I_versions[c][a_i];
+            pa_aupdate_read_end(u->a_H[c]);
+        }
+
+        u->convolver = pa_fir_new(u->channels, PARTITION_SIZE, responses, u->partitioned_taps);
+        pa_xfree(responses);
+
+        pa_log_debug("Partitioned convolution with %zu taps in blocks of %u frames.", u->partitioned_taps, PARTITION_SIZE);
+    }
+
     /* The order here is important. The input must be put first,
      * otherwise streams might attach to the sink before the sink
      * input is attached to the master. */
@@ -1375,8 +1663,22 @@ void pa__done(pa_module*m) {
     pa_memblockq_free(u->output_q);
     pa_memblockq_free(u->input_q);
 
-    fftwf_destroy_plan(u->inverse_plan);
-    fftwf_destroy_plan(u->forward_plan);
+    if (u->convolver)
+        pa_convolver_free(u->convolver);
+    if (u->Is) {
+        for (c = 0; c < u->channels; ++c) {
+            for (size_t i = 0; i < 2; ++i)
+                fftwf_free(u->Is[c][i]);
+            pa_xfree(u->Is[c]);
+            pa_xfree(u->I_versions[c]);
+        }
+        pa_xfree(u->Is);
+        pa_xfree(u->I_versions);
+        pa_xfree(u->applied_versions);
+    }
+
+    if (u->plans)
+        fft_plans_unref(u->module->core, u->plans);
     fftwf_free(u->output_window);
     for (c = 0; c < u->channels; ++c) {
         pa_aupdate_free(u->a_H[c]);
@@ -1886,9 +2188,11 @@ void equalizer_handle_seed_filter(DBusConnection *conn, DBusMessage *msg, void *
             float *H_p = u->Hs[c][b_i];
             u->Xs[c][b_i] = preamp;
             memcpy(H_p, H, FILTER_SIZE(u) * sizeof(float));
+            filter_updated(u, c, b_i);
             pa_aupdate_write_end(u->a_H[c]);
         }
     }
+    filter_updated(u, r_channel, a_i);
     pa_aupdate_write_end(u->a_H[r_channel]);
     pa_xfree(ys);
 
@@ -2036,9 +2340,11 @@ static void set_filter(struct userdata *u, size_t channel, double *H_, double pr
             unsigned b_i = pa_aupdate_write_begin(u->a_H[c]);
             u->Xs[c][b_i] = u->Xs[r_channel][a_i];
             memcpy(u->Hs[c][b_i], u->Hs[r_channel][a_i], FILTER_SIZE(u) * sizeof(float));
+            filter_updated(u, c, b_i);
             pa_aupdate_write_end(u->a_H[c]);
         }
     }
+    filter_updated(u, r_channel, a_i);
     pa_aupdate_write_end(u->a_H[r_channel]);
 }
 
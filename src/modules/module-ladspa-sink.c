@@ -38,6 +38,7 @@
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/ltdl-helper.h>
+#include <pulsecore/filter-graph.h>
 
 #ifdef HAVE_DBUS
 #include <pulsecore/protocol-dbus.h>
@@ -65,7 +66,8 @@ PA_MODULE_USAGE(
       "control=<comma separated list of input control values> "
       "input_ladspaport_map=<comma separated list of input LADSPA port names> "
       "output_ladspaport_map=<comma separated list of output LADSPA port names> "
-      "autoloaded=<set if this module is being loaded automatically> "));
+      "autoloaded=<set if this module is being loaded automatically> "
+      "fused=<run as a stage of a filter graph?> "));
 
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 #define DEFAULT_AUTOLOADED false
@@ -79,6 +81,10 @@ struct userdata {
     pa_sink *sink;
     pa_sink_input *sink_input;
 
+    /* Only if fused, instead of sink_input and memblockq. sink is then
+     * the sink of the stage. */
+    pa_filter_stage *stage;
+
     const LADSPA_Descriptor *descriptor;
     LADSPA_Handle handle[PA_CHANNELS_MAX];
     unsigned long max_ladspaport_count, input_count, output_count, channels;
@@ -121,6 +127,7 @@ static const char* const valid_modargs[] = {
     "input_ladspaport_map",
     "output_ladspaport_map",
     "autoloaded",
+    "fused",
     NULL
 };
 
@@ -336,6 +343,18 @@ static void dbus_done(struct userdata *u) {
 
 #endif /* HAVE_DBUS */
 
+/* Called from I/O thread context */
+static void update_parameters(struct userdata *u) {
+
+    /* rewind the stream to throw away the previously rendered data */
+
+    pa_log_debug("Requesting rewind due to parameter update.");
+    pa_sink_request_rewind(u->sink, -1);
+
+    /* change the sink parameters */
+    connect_control_ports(u);
+}
+
 /* Called from I/O thread context */
 static int sink_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
     struct userdata *u = PA_SINK(o)->userdata;
@@ -364,19 +383,23 @@ static int sink_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t of
         return 0;
 
     case LADSPA_SINK_MESSAGE_UPDATE_PARAMETERS:
+        update_parameters(u);
+        return 0;
+    }
 
-        /* rewind the stream to throw away the previously rendered data */
-
-        pa_log_debug("Requesting rewind due to parameter update.");
-        pa_sink_request_rewind(u->sink, -1);
+    return pa_sink_process_msg(o, code, data, offset, chunk);
+}
 
-        /* change the sink parameters */
-        connect_control_ports(u);
+/* Called from I/O thread context */
+static int stage_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    pa_filter_stage *s = PA_SINK(o)->userdata;
 
+    if (code == LADSPA_SINK_MESSAGE_UPDATE_PARAMETERS) {
+        update_parameters(s->userdata);
         return 0;
     }
 
-    return pa_sink_process_msg(o, code, data, offset, chunk);
+    return pa_filter_stage_process_msg(o, code, data, offset, chunk);
 }
 
 /* Called from main context */
@@ -459,12 +482,53 @@ static void sink_set_mute_cb(pa_sink *s) {
     pa_sink_input_set_mute(u->sink_input, s->muted, s->save_muted);
 }
 
+/* Called from I/O thread context */
+static void run_plugins(struct userdata *u, const float *src, float *dst, unsigned n) {
+    unsigned h, c;
+
+    /* Split all channels in one pass, then clamp them as plain arrays */
+    pa_deinterleave(src, (void **) u->input, (unsigned) u->channels, sizeof(float), n);
+    for (c = 0; c < u->channels; c++)
+        pa_sample_clamp(PA_SAMPLE_FLOAT32NE, u->input[c], sizeof(float), u->input[c], sizeof(float), n);
+
+    for (h = 0; h < (u->channels / u->max_ladspaport_count); h++)
+        u->descriptor->run(u->handle[h], n);
+
+    for (c = 0; c < u->channels; c++)
+        pa_sample_clamp(PA_SAMPLE_FLOAT32NE, u->output[c], sizeof(float), u->output[c], sizeof(float), n);
+    pa_interleave((const void **) u->output, (unsigned) u->channels, dst, sizeof(float), n);
+}
+
+/* Called from I/O thread context */
+static void reset_plugins(struct userdata *u) {
+    unsigned c;
+
+    pa_log_debug("Resetting plugin");
+
+    if (u->descriptor->deactivate)
+        for (c = 0; c < (u->channels / u->max_ladspaport_count); c++)
+            u->descriptor->deactivate(u->handle[c]);
+    if (u->descriptor->activate)
+        for (c = 0; c < (u->channels / u->max_ladspaport_count); c++)
+            u->descriptor->activate(u->handle[c]);
+}
+
+/* Called from I/O thread context */
+static void stage_process_cb(pa_filter_stage *s, const void *src, void *dst, unsigned n_frames) {
+    run_plugins(s->userdata, src, dst, n_frames);
+}
+
+/* Called from I/O thread context */
+static void stage_rewind_cb(pa_filter_stage *s, size_t n_frames) {
+    reset_plugins(s->userdata);
+}
+
 /* Called from I/O thread context */
 static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
     struct userdata *u;
     float *src, *dst;
-    size_t fs;
-    unsigned n, h, c;
+    size_t fs, length;
+    unsigned n;
     pa_memchunk tchunk;
 
     pa_sink_input_assert_ref(i);
@@ -477,19 +541,22 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     /* Hmm, process any rewind request that might be queued up */
     pa_sink_process_rewind(u->sink, 0);
 
-    while (pa_memblockq_peek(u->memblockq, &tchunk) < 0) {
+    /* Run the plugins on as much as we were asked for, up to a whole
+     * block, however small the chunks the sink renders are */
+    nbytes = PA_MIN(nbytes, u->block_size);
+
+    while ((length = pa_memblockq_get_length(u->memblockq)) < nbytes) {
         pa_memchunk nchunk;
 
-        pa_sink_render(u->sink, nbytes, &nchunk);
+        pa_sink_render(u->sink, nbytes - length, &nchunk);
         pa_memblockq_push(u->memblockq, &nchunk);
         pa_memblock_unref(nchunk.memblock);
     }
 
-    tchunk.length = PA_MIN(nbytes, tchunk.length);
-    pa_assert(tchunk.length > 0);
+    pa_memblockq_peek_fixed_size(u->memblockq, nbytes, &tchunk);
 
     fs = pa_frame_size(&i->sample_spec);
-    n = (unsigned) (PA_MIN(tchunk.length, u->block_size) / fs);
+    n = (unsigned) (nbytes / fs);
 
     pa_assert(n > 0);
 
@@ -502,13 +569,7 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     src = pa_memblock_acquire_chunk(&tchunk);
     dst = pa_memblock_acquire(chunk->memblock);
 
-    for (h = 0; h < (u->channels / u->max_ladspaport_count); h++) {
-        for (c = 0; c < u->input_count; c++)
-            pa_sample_clamp(PA_SAMPLE_FLOAT32NE, u->input[c], sizeof(float), src+ h*u->max_ladspaport_count + c, u->channels*sizeof(float), n);
-        u->descriptor->run(u->handle[h], n);
-        for (c = 0; c < u->output_count; c++)
-            pa_sample_clamp(PA_SAMPLE_FLOAT32NE, dst + h*u->max_ladspaport_count + c, u->channels*sizeof(float), u->output[c], sizeof(float), n);
-    }
+    run_plugins(u, src, dst, n);
 
     pa_memblock_release(tchunk.memblock);
     pa_memblock_release(chunk->memblock);
@@ -538,19 +599,8 @@ static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
         u->sink->thread_info.rewind_nbytes = 0;
 
         if (amount > 0) {
-            unsigned c;
-
             pa_memblockq_seek(u->memblockq, - (int64_t) amount, PA_SEEK_RELATIVE, true);
-
-            pa_log_debug("Resetting plugin");
-
-            /* Reset the plugin */
-            if (u->descriptor->deactivate)
-                for (c = 0; c < (u->channels / u->max_ladspaport_count); c++)
-                    u->descriptor->deactivate(u->handle[c]);
-            if (u->descriptor->activate)
-                for (c = 0; c < (u->channels / u->max_ladspaport_count); c++)
-                    u->descriptor->activate(u->handle[c]);
+            reset_plugins(u);
         }
     }
 
@@ -670,6 +720,23 @@ static bool sink_input_may_move_to_cb(pa_sink_input *i, pa_sink *dest) {
     return u->sink != dest;
 }
 
+/* Called from main context */
+static void update_description(struct userdata *u, pa_sink *dest) {
+    const char *z;
+    pa_proplist *pl;
+
+    if (!u->auto_desc)
+        return;
+
+    pl = pa_proplist_new();
+    z = pa_proplist_gets(dest->proplist, PA_PROP_DEVICE_DESCRIPTION);
+    pa_proplist_setf(pl, PA_PROP_DEVICE_DESCRIPTION, "LADSPA Plugin %s on %s",
+                     pa_proplist_gets(u->sink->proplist, "device.ladspa.name"), z ? z : dest->name);
+
+    pa_sink_update_proplist(u->sink, PA_UPDATE_REPLACE, pl);
+    pa_proplist_free(pl);
+}
+
 /* Called from main context */
 static void sink_input_moving_cb(pa_sink_input *i, pa_sink *dest) {
     struct userdata *u;
@@ -683,18 +750,19 @@ static void sink_input_moving_cb(pa_sink_input *i, pa_sink *dest) {
     } else
         pa_sink_set_asyncmsgq(u->sink, NULL);
 
-    if (u->auto_desc && dest) {
-        const char *z;
-        pa_proplist *pl;
+    if (dest)
+        update_description(u, dest);
+}
 
-        pl = pa_proplist_new();
-        z = pa_proplist_gets(dest->proplist, PA_PROP_DEVICE_DESCRIPTION);
-        pa_proplist_setf(pl, PA_PROP_DEVICE_DESCRIPTION, "LADSPA Plugin %s on %s",
-                         pa_proplist_gets(u->sink->proplist, "device.ladspa.name"), z ? z : dest->name);
+/* Called from main context */
+static void stage_moving_cb(pa_filter_stage *s, pa_sink *dest) {
+    struct userdata *u;
 
-        pa_sink_update_proplist(u->sink, PA_UPDATE_REPLACE, pl);
-        pa_proplist_free(pl);
-    }
+    pa_assert(s);
+    pa_assert_se(u = s->userdata);
+
+    if (dest)
+        update_description(u, dest);
 }
 
 /* Called from main context */
@@ -990,6 +1058,7 @@ int pa__init(pa_module*m) {
     const LADSPA_Descriptor *d;
     unsigned long p, h, j, n_control, c;
     pa_memchunk silence;
+    bool fused = false;
 
     pa_assert(m);
 
@@ -1195,20 +1264,19 @@ int pa__init(pa_module*m) {
 
     u->block_size = pa_frame_align(pa_mempool_block_size_max(m->core->mempool), &ss);
 
-    /* Create buffers */
+    /* Create buffers, one block of samples for each channel. Every plugin
+     * instance is connected to the buffers of its own channels, so all of
+     * them are filled by one deinterleaving pass. */
+    u->input = (LADSPA_Data**) pa_xnew(LADSPA_Data*, (unsigned) u->channels);
+    for (c = 0; c < u->channels; c++)
+        u->input[c] = (LADSPA_Data*) pa_xnew0(uint8_t, (unsigned) (u->block_size / u->channels));
     if (LADSPA_IS_INPLACE_BROKEN(d->Properties)) {
-        u->input = (LADSPA_Data**) pa_xnew(LADSPA_Data*, (unsigned) u->input_count);
-        for (c = 0; c < u->input_count; c++)
-            u->input[c] = (LADSPA_Data*) pa_xnew(uint8_t, (unsigned) u->block_size);
-        u->output = (LADSPA_Data**) pa_xnew(LADSPA_Data*, (unsigned) u->output_count);
-        for (c = 0; c < u->output_count; c++)
-            u->output[c] = (LADSPA_Data*) pa_xnew(uint8_t, (unsigned) u->block_size);
-    } else {
-        u->input = (LADSPA_Data**) pa_xnew(LADSPA_Data*, (unsigned) u->max_ladspaport_count);
-        for (c = 0; c < u->max_ladspaport_count; c++)
-            u->input[c] = (LADSPA_Data*) pa_xnew(uint8_t, (unsigned) u->block_size);
+        u->output = (LADSPA_Data**) pa_xnew(LADSPA_Data*, (unsigned) u->channels);
+        for (c = 0; c < u->channels; c++)
+            u->output[c] = (LADSPA_Data*) pa_xnew0(uint8_t, (unsigned) (u->block_size / u->channels));
+    } else
         u->output = u->input;
-    }
+
     /* Initialize plugin instances */
     for (h = 0; h < (u->channels / u->max_ladspaport_count); h++) {
         if (!(u->handle[h] = d->instantiate(d, ss.rate))) {
@@ -1217,9 +1285,9 @@ int pa__init(pa_module*m) {
         }
 
         for (c = 0; c < u->input_count; c++)
-            d->connect_port(u->handle[h], input_ladspaport[c], u->input[c]);
+            d->connect_port(u->handle[h], input_ladspaport[c], u->input[h * u->max_ladspaport_count + c]);
         for (c = 0; c < u->output_count; c++)
-            d->connect_port(u->handle[h], output_ladspaport[c], u->output[c]);
+            d->connect_port(u->handle[h], output_ladspaport[c], u->output[h * u->max_ladspaport_count + c]);
     }
 
     u->n_control = n_control;
@@ -1283,6 +1351,11 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "fused", &fused) < 0) {
+        pa_log("fused= expects a boolean argument");
+        goto fail;
+    }
+
     if ((u->auto_desc = !pa_proplist_contains(sink_data.proplist, PA_PROP_DEVICE_DESCRIPTION))) {
         const char *z;
 
@@ -1290,6 +1363,32 @@ int pa__init(pa_module*m) {
         pa_proplist_setf(sink_data.proplist, PA_PROP_DEVICE_DESCRIPTION, "LADSPA Plugin %s on %s", d->Name, z ? z : master->name);
     }
 
+    if (fused) {
+        u->stage = pa_filter_stage_new(m, master, &sink_data);
+        pa_sink_new_data_done(&sink_data);
+
+        if (!u->stage) {
+            pa_log("Failed to create sink.");
+            goto fail;
+        }
+
+        u->sink = u->stage->sink;
+        u->sink->parent.process_msg = stage_process_msg_cb;
+
+        u->stage->max_block_frames = (unsigned) (u->block_size / pa_frame_size(&ss));
+        u->stage->process = stage_process_cb;
+        u->stage->rewind = stage_rewind_cb;
+        u->stage->moving = stage_moving_cb;
+        u->stage->userdata = u;
+
+        if (pa_filter_stage_put(u->stage) < 0) {
+            pa_log("Failed to create filter graph.");
+            goto fail;
+        }
+
+        goto finish;
+    }
+
     u->sink = pa_sink_new(m->core, &sink_data,
                           (master->flags & (PA_SINK_LATENCY|PA_SINK_DYNAMIC_LATENCY)) | PA_SINK_SHARE_VOLUME_WITH_MASTER);
     pa_sink_new_data_done(&sink_data);
@@ -1361,6 +1460,7 @@ int pa__init(pa_module*m) {
     pa_sink_put(u->sink);
     pa_sink_input_cork(u->sink_input, false);
 
+finish:
 #ifdef HAVE_DBUS
     dbus_init(u);
 #endif
@@ -1403,6 +1503,11 @@ void pa__done(pa_module*m) {
     dbus_done(u);
 #endif
 
+    if (u->stage) {
+        pa_filter_stage_free(u->stage);
+        u->sink = NULL;
+    }
+
     if (u->sink_input)
         pa_sink_input_cork(u->sink_input, true);
 
@@ -1425,23 +1530,15 @@ void pa__done(pa_module*m) {
         }
     }
 
-    if (u->output == u->input) {
-        if (u->input != NULL) {
-            for (c = 0; c < u->max_ladspaport_count; c++)
-                pa_xfree(u->input[c]);
-            pa_xfree(u->input);
-        }
-    } else {
-        if (u->input != NULL) {
-            for (c = 0; c < u->input_count; c++)
-                pa_xfree(u->input[c]);
-            pa_xfree(u->input);
-        }
-        if (u->output != NULL) {
-            for (c = 0; c < u->output_count; c++)
-                pa_xfree(u->output[c]);
-            pa_xfree(u->output);
-        }
+    if (u->output != u->input && u->output != NULL) {
+        for (c = 0; c < u->channels; c++)
+            pa_xfree(u->output[c]);
+        pa_xfree(u->output);
+    }
+    if (u->input != NULL) {
+        for (c = 0; c < u->channels; c++)
+            pa_xfree(u->input[c]);
+        pa_xfree(u->input);
     }
 
     if (u->memblockq)
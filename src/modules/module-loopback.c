@@ -78,7 +78,7 @@ struct userdata {
     pa_asyncmsgq *asyncmsgq;
     pa_memblockq *memblockq;
 
-    pa_rtpoll_item *rtpoll_item_read, *rtpoll_item_write;
+    pa_rtpoll_item *rtpoll_item_read;
 
     pa_time_event *time_event;
 
@@ -631,34 +631,6 @@ static void set_source_output_latency(struct userdata *u, pa_source *source) {
         pa_log_warn("Cannot set requested source latency of %0.2f ms, adjusting to %0.2f ms", (double)requested_latency / PA_USEC_PER_MSEC, (double)u->configured_source_latency / PA_USEC_PER_MSEC);
 }
 
-/* Called from input thread context */
-static void source_output_attach_cb(pa_source_output *o) {
-    struct userdata *u;
-
-    pa_source_output_assert_ref(o);
-    pa_source_output_assert_io_context(o);
-    pa_assert_se(u = o->userdata);
-
-    u->rtpoll_item_write = pa_rtpoll_item_new_asyncmsgq_write(
-            o->source->thread_info.rtpoll,
-            PA_RTPOLL_LATE,
-            u->asyncmsgq);
-}
-
-/* Called from input thread context */
-static void source_output_detach_cb(pa_source_output *o) {
-    struct userdata *u;
-
-    pa_source_output_assert_ref(o);
-    pa_source_output_assert_io_context(o);
-    pa_assert_se(u = o->userdata);
-
-    if (u->rtpoll_item_write) {
-        pa_rtpoll_item_free(u->rtpoll_item_write);
-        u->rtpoll_item_write = NULL;
-    }
-}
-
 /* Called from main thread */
 static void source_output_kill_cb(pa_source_output *o) {
     struct userdata *u;
@@ -1439,8 +1411,6 @@ int pa__init(pa_module *m) {
     u->source_output->push = source_output_push_cb;
     u->source_output->process_rewind = source_output_process_rewind_cb;
     u->source_output->kill = source_output_kill_cb;
-    u->source_output->attach = source_output_attach_cb;
-    u->source_output->detach = source_output_detach_cb;
     u->source_output->may_move_to = source_output_may_move_to_cb;
     u->source_output->moving = source_output_moving_cb;
     u->source_output->suspend = source_output_suspend_cb;
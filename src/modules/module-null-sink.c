@@ -38,9 +38,7 @@
 #include <pulsecore/core-util.h>
 #include <pulsecore/modargs.h>
 #include <pulsecore/log.h>
-#include <pulsecore/thread.h>
-#include <pulsecore/thread-mq.h>
-#include <pulsecore/rtpoll.h>
+#include <pulsecore/io-executor.h>
 
 PA_MODULE_AUTHOR("Lennart Poettering");
 PA_MODULE_DESCRIPTION(_("Clocked NULL sink"));
@@ -62,9 +60,7 @@ struct userdata {
     pa_module *module;
     pa_sink *sink;
 
-    pa_thread *thread;
-    pa_thread_mq thread_mq;
-    pa_rtpoll *rtpoll;
+    pa_io_executor_slot *slot;
 
     pa_usec_t block_usec;
     pa_usec_t timestamp;
@@ -100,9 +96,22 @@ static int sink_process_msg(
         }
     }
 
+    /* The state or latency might change, let the slot catch up */
+    pa_io_executor_slot_wakeup(u->slot);
+
     return pa_sink_process_msg(o, code, data, offset, chunk);
 }
 
+/* Called from the IO thread. */
+static void sink_request_rewind_cb(pa_sink *s) {
+    struct userdata *u;
+
+    pa_sink_assert_ref(s);
+    pa_assert_se(u = s->userdata);
+
+    pa_io_executor_slot_wakeup(u->slot);
+}
+
 /* Called from the IO thread. */
 static int sink_set_state_in_io_thread_cb(pa_sink *s, pa_sink_state_t new_state, pa_suspend_cause_t new_suspend_cause) {
     struct userdata *u;
@@ -200,55 +209,27 @@ static void process_render(struct userdata *u, pa_usec_t now) {
 /*     pa_log_debug("Ate in sum %lu bytes (of %lu)", (unsigned long) ate, (unsigned long) nbytes); */
 }
 
-static void thread_func(void *userdata) {
+/* Called from the shared I/O thread when the slot is due */
+static pa_usec_t process_cb(pa_io_executor_slot *s, void *userdata) {
     struct userdata *u = userdata;
+    pa_usec_t now = 0;
 
     pa_assert(u);
 
-    pa_log_debug("Thread starting up");
-
-    if (u->core->realtime_scheduling)
-        pa_thread_make_realtime(u->core->realtime_priority);
+    if (PA_SINK_IS_OPENED(u->sink->thread_info.state))
+        now = pa_rtclock_now();
 
-    pa_thread_mq_install(&u->thread_mq);
-
-    u->timestamp = pa_rtclock_now();
-
-    for (;;) {
-        pa_usec_t now = 0;
-        int ret;
-
-        if (PA_SINK_IS_OPENED(u->sink->thread_info.state))
-            now = pa_rtclock_now();
+    if (PA_UNLIKELY(u->sink->thread_info.rewind_requested))
+        process_rewind(u, now);
 
-        if (PA_UNLIKELY(u->sink->thread_info.rewind_requested))
-            process_rewind(u, now);
+    /* Render some data and drop it immediately */
+    if (!PA_SINK_IS_OPENED(u->sink->thread_info.state))
+        return 0;
 
-        /* Render some data and drop it immediately */
-        if (PA_SINK_IS_OPENED(u->sink->thread_info.state)) {
-            if (u->timestamp <= now)
-                process_render(u, now);
-
-            pa_rtpoll_set_timer_absolute(u->rtpoll, u->timestamp);
-        } else
-            pa_rtpoll_set_timer_disabled(u->rtpoll);
-
-        /* Hmm, nothing to do. Let's sleep */
-        if ((ret = pa_rtpoll_run(u->rtpoll)) < 0)
-            goto fail;
-
-        if (ret == 0)
-            goto finish;
-    }
-
-fail:
-    /* If this was no regular exit from the loop we have to continue
-     * processing messages until we received PA_MESSAGE_SHUTDOWN */
-    pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->core), PA_CORE_MESSAGE_UNLOAD_MODULE, u->module, 0, NULL, NULL);
-    pa_asyncmsgq_wait_for(u->thread_mq.inq, PA_MESSAGE_SHUTDOWN);
+    if (u->timestamp <= now)
+        process_render(u, now);
 
-finish:
-    pa_log_debug("Thread shutting down");
+    return u->timestamp;
 }
 
 int pa__init(pa_module*m) {
@@ -276,10 +257,10 @@ int pa__init(pa_module*m) {
     m->userdata = u = pa_xnew0(struct userdata, 1);
     u->core = m->core;
     u->module = m;
-    u->rtpoll = pa_rtpoll_new();
+    u->timestamp = pa_rtclock_now();
 
-    if (pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll) < 0) {
-        pa_log("pa_thread_mq_init() failed.");
+    if (!(u->slot = pa_io_executor_slot_new(m->core, m, "null-sink", process_cb, u))) {
+        pa_log("Failed to attach to an I/O thread.");
         goto fail;
     }
 
@@ -309,24 +290,21 @@ int pa__init(pa_module*m) {
     u->sink->parent.process_msg = sink_process_msg;
     u->sink->set_state_in_io_thread = sink_set_state_in_io_thread_cb;
     u->sink->update_requested_latency = sink_update_requested_latency_cb;
+    u->sink->request_rewind = sink_request_rewind_cb;
     u->sink->userdata = u;
 
-    pa_sink_set_asyncmsgq(u->sink, u->thread_mq.inq);
-    pa_sink_set_rtpoll(u->sink, u->rtpoll);
+    pa_sink_set_asyncmsgq(u->sink, pa_io_executor_slot_get_asyncmsgq(u->slot));
+    pa_sink_set_rtpoll(u->sink, pa_io_executor_slot_get_rtpoll(u->slot));
 
     u->block_usec = BLOCK_USEC;
     nbytes = pa_usec_to_bytes(u->block_usec, &u->sink->sample_spec);
     pa_sink_set_max_rewind(u->sink, nbytes);
     pa_sink_set_max_request(u->sink, nbytes);
 
-    if (!(u->thread = pa_thread_new("null-sink", thread_func, u))) {
-        pa_log("Failed to create thread.");
-        goto fail;
-    }
-
     pa_sink_set_latency_range(u->sink, 0, BLOCK_USEC);
 
     pa_sink_put(u->sink);
+    pa_io_executor_slot_start(u->slot);
 
     pa_modargs_free(ma);
 
@@ -361,18 +339,11 @@ void pa__done(pa_module*m) {
     if (u->sink)
         pa_sink_unlink(u->sink);
 
-    if (u->thread) {
-        pa_asyncmsgq_send(u->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
-        pa_thread_free(u->thread);
-    }
-
-    pa_thread_mq_done(&u->thread_mq);
+    if (u->slot)
+        pa_io_executor_slot_free(u->slot);
 
     if (u->sink)
         pa_sink_unref(u->sink);
 
-    if (u->rtpoll)
-        pa_rtpoll_free(u->rtpoll);
-
     pa_xfree(u);
 }
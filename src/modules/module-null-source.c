@@ -33,14 +33,12 @@
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/core-util.h>
+#include <pulsecore/io-executor.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/modargs.h>
 #include <pulsecore/module.h>
-#include <pulsecore/rtpoll.h>
 #include <pulsecore/source.h>
-#include <pulsecore/thread-mq.h>
-#include <pulsecore/thread.h>
 
 PA_MODULE_AUTHOR("Lennart Poettering & Marc-Andre Lureau");
 PA_MODULE_DESCRIPTION("Clocked NULL source");
@@ -64,9 +62,7 @@ struct userdata {
     pa_module *module;
     pa_source *source;
 
-    pa_thread *thread;
-    pa_thread_mq thread_mq;
-    pa_rtpoll *rtpoll;
+    pa_io_executor_slot *slot;
 
     size_t block_size;
 
@@ -100,6 +96,9 @@ static int source_process_msg(pa_msgobject *o, int code, void *data, int64_t off
         }
     }
 
+    /* The state or latency might change, let the slot catch up */
+    pa_io_executor_slot_wakeup(u->slot);
+
     return pa_source_process_msg(o, code, data, offset, chunk);
 }
 
@@ -126,60 +125,31 @@ static void source_update_requested_latency_cb(pa_source *s) {
     u->block_usec = pa_source_get_requested_latency_within_thread(s);
 }
 
-static void thread_func(void *userdata) {
+/* Called from the shared I/O thread when the slot is due */
+static pa_usec_t process_cb(pa_io_executor_slot *s, void *userdata) {
     struct userdata *u = userdata;
+    pa_usec_t now;
+    pa_memchunk chunk;
 
     pa_assert(u);
 
-    pa_log_debug("Thread starting up");
-
-    if (u->core->realtime_scheduling)
-        pa_thread_make_realtime(u->core->realtime_priority);
-
-    pa_thread_mq_install(&u->thread_mq);
-
-    u->timestamp = pa_rtclock_now();
-
-    for (;;) {
-        int ret;
-
-        /* Generate some null data */
-        if (PA_SOURCE_IS_OPENED(u->source->thread_info.state)) {
-            pa_usec_t now;
-            pa_memchunk chunk;
-
-            now = pa_rtclock_now();
-
-            if ((chunk.length = pa_usec_to_bytes(now - u->timestamp, &u->source->sample_spec)) > 0) {
+    if (!PA_SOURCE_IS_OPENED(u->source->thread_info.state))
+        return 0;
 
-                chunk.memblock = pa_memblock_new(u->core->mempool, (size_t) -1); /* or chunk.length? */
-                chunk.index = 0;
-                pa_source_post(u->source, &chunk);
-                pa_memblock_unref(chunk.memblock);
+    /* Generate some null data */
+    now = pa_rtclock_now();
 
-                u->timestamp = now;
-            }
+    if ((chunk.length = pa_usec_to_bytes(now - u->timestamp, &u->source->sample_spec)) > 0) {
 
-            pa_rtpoll_set_timer_absolute(u->rtpoll, u->timestamp + u->latency_time * PA_USEC_PER_MSEC);
-        } else
-            pa_rtpoll_set_timer_disabled(u->rtpoll);
+        chunk.memblock = pa_memblock_new(u->core->mempool, (size_t) -1); /* or chunk.length? */
+        chunk.index = 0;
+        pa_source_post(u->source, &chunk);
+        pa_memblock_unref(chunk.memblock);
 
-        /* Hmm, nothing to do. Let's sleep */
-        if ((ret = pa_rtpoll_run(u->rtpoll)) < 0)
-            goto fail;
-
-        if (ret == 0)
-            goto finish;
+        u->timestamp = now;
     }
 
-fail:
-    /* If this was no regular exit from the loop we have to continue
-     * processing messages until we received PA_MESSAGE_SHUTDOWN */
-    pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->core), PA_CORE_MESSAGE_UNLOAD_MODULE, u->module, 0, NULL, NULL);
-    pa_asyncmsgq_wait_for(u->thread_mq.inq, PA_MESSAGE_SHUTDOWN);
-
-finish:
-    pa_log_debug("Thread shutting down");
+    return u->timestamp + u->latency_time * PA_USEC_PER_MSEC;
 }
 
 int pa__init(pa_module*m) {
@@ -207,10 +177,10 @@ int pa__init(pa_module*m) {
     m->userdata = u = pa_xnew0(struct userdata, 1);
     u->core = m->core;
     u->module = m;
-    u->rtpoll = pa_rtpoll_new();
+    u->timestamp = pa_rtclock_now();
 
-    if (pa_thread_mq_init(&u->thread_mq, m->core->mainloop, u->rtpoll) < 0) {
-        pa_log("pa_thread_mq_init() failed.");
+    if (!(u->slot = pa_io_executor_slot_new(m->core, m, "null-source", process_cb, u))) {
+        pa_log("Failed to attach to an I/O thread.");
         goto fail;
     }
 
@@ -243,8 +213,8 @@ int pa__init(pa_module*m) {
     u->source->update_requested_latency = source_update_requested_latency_cb;
     u->source->userdata = u;
 
-    pa_source_set_asyncmsgq(u->source, u->thread_mq.inq);
-    pa_source_set_rtpoll(u->source, u->rtpoll);
+    pa_source_set_asyncmsgq(u->source, pa_io_executor_slot_get_asyncmsgq(u->slot));
+    pa_source_set_rtpoll(u->source, pa_io_executor_slot_get_rtpoll(u->slot));
 
     pa_source_set_latency_range(u->source, 0, MAX_LATENCY_USEC);
     u->block_usec = u->source->thread_info.max_latency;
@@ -252,12 +222,8 @@ int pa__init(pa_module*m) {
     u->source->thread_info.max_rewind =
         pa_usec_to_bytes(u->block_usec, &u->source->sample_spec);
 
-    if (!(u->thread = pa_thread_new("null-source", thread_func, u))) {
-        pa_log("Failed to create thread.");
-        goto fail;
-    }
-
     pa_source_put(u->source);
+    pa_io_executor_slot_start(u->slot);
 
     pa_modargs_free(ma);
 
@@ -283,18 +249,11 @@ void pa__done(pa_module*m) {
     if (u->source)
         pa_source_unlink(u->source);
 
-    if (u->thread) {
-        pa_asyncmsgq_send(u->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
-        pa_thread_free(u->thread);
-    }
-
-    pa_thread_mq_done(&u->thread_mq);
+    if (u->slot)
+        pa_io_executor_slot_free(u->slot);
 
     if (u->source)
         pa_source_unref(u->source);
 
-    if (u->rtpoll)
-        pa_rtpoll_free(u->rtpoll);
-
     pa_xfree(u);
 }
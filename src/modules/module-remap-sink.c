@@ -23,6 +23,7 @@
 
 #include <pulse/xmalloc.h>
 
+#include <pulsecore/filter-graph.h>
 #include <pulsecore/namereg.h>
 #include <pulsecore/sink.h>
 #include <pulsecore/module.h>
@@ -45,7 +46,8 @@ PA_MODULE_USAGE(
         "channels=<number of channels> "
         "channel_map=<channel map> "
         "resample_method=<resampler> "
-        "remix=<remix channels?>");
+        "remix=<remix channels?> "
+        "fused=<run as a stage of a filter graph?>");
 
 struct userdata {
     pa_module *module;
@@ -53,6 +55,10 @@ struct userdata {
     pa_sink *sink;
     pa_sink_input *sink_input;
 
+    /* Only if fused, instead of sink_input. sink is then the sink of
+     * the stage. */
+    pa_filter_stage *stage;
+
     bool auto_desc;
 };
 
@@ -67,6 +73,7 @@ static const char* const valid_modargs[] = {
     "channel_map",
     "resample_method",
     "remix",
+    "fused",
     NULL
 };
 
@@ -298,6 +305,22 @@ static void sink_input_kill_cb(pa_sink_input *i) {
     pa_module_unload_request(u->module, true);
 }
 
+/* Called from main context */
+static void update_description(struct userdata *u, pa_sink *dest) {
+    const char *k;
+    pa_proplist *pl;
+
+    if (!u->auto_desc)
+        return;
+
+    pl = pa_proplist_new();
+    k = pa_proplist_gets(dest->proplist, PA_PROP_DEVICE_DESCRIPTION);
+    pa_proplist_setf(pl, PA_PROP_DEVICE_DESCRIPTION, "Remapped %s", k ? k : dest->name);
+
+    pa_sink_update_proplist(u->sink, PA_UPDATE_REPLACE, pl);
+    pa_proplist_free(pl);
+}
+
 /* Called from main context */
 static void sink_input_moving_cb(pa_sink_input *i, pa_sink *dest) {
     struct userdata *u;
@@ -311,17 +334,19 @@ static void sink_input_moving_cb(pa_sink_input *i, pa_sink *dest) {
     } else
         pa_sink_set_asyncmsgq(u->sink, NULL);
 
-    if (u->auto_desc && dest) {
-        const char *k;
-        pa_proplist *pl;
+    if (dest)
+        update_description(u, dest);
+}
+
+/* Called from main context */
+static void stage_moving_cb(pa_filter_stage *s, pa_sink *dest) {
+    struct userdata *u;
 
-        pl = pa_proplist_new();
-        k = pa_proplist_gets(dest->proplist, PA_PROP_DEVICE_DESCRIPTION);
-        pa_proplist_setf(pl, PA_PROP_DEVICE_DESCRIPTION, "Remapped %s", k ? k : dest->name);
+    pa_assert(s);
+    pa_assert_se(u = s->userdata);
 
-        pa_sink_update_proplist(u->sink, PA_UPDATE_REPLACE, pl);
-        pa_proplist_free(pl);
-    }
+    if (dest)
+        update_description(u, dest);
 }
 
 int pa__init(pa_module*m) {
@@ -334,6 +359,7 @@ int pa__init(pa_module*m) {
     pa_sink_input_new_data sink_input_data;
     pa_sink_new_data sink_data;
     bool remix = true;
+    bool fused = false;
 
     pa_assert(m);
 
@@ -378,6 +404,11 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "fused", &fused) < 0) {
+        pa_log("fused= expects a boolean argument");
+        goto fail;
+    }
+
     u = pa_xnew0(struct userdata, 1);
     u->module = m;
     m->userdata = u;
@@ -406,6 +437,37 @@ int pa__init(pa_module*m) {
         pa_proplist_setf(sink_data.proplist, PA_PROP_DEVICE_DESCRIPTION, "Remapped %s", k ? k : master->name);
     }
 
+    if (fused) {
+        u->stage = pa_filter_stage_new(m, master, &sink_data);
+        pa_sink_new_data_done(&sink_data);
+
+        if (!u->stage) {
+            pa_log("Failed to create sink.");
+            goto fail;
+        }
+
+        u->sink = u->stage->sink;
+
+        /* Remapping is nothing but a different channel map, the
+         * conversion to the next stage or the master does the rest.
+         * If that only rearranges the channels, the graph does it in
+         * place and the master gets data it can play as is. */
+        u->stage->channel_map = stream_map;
+        u->stage->resample_method = resample_method;
+        u->stage->remix = remix;
+        u->stage->moving = stage_moving_cb;
+        u->stage->userdata = u;
+
+        if (pa_filter_stage_put(u->stage) < 0) {
+            pa_log("Failed to create filter graph.");
+            goto fail;
+        }
+
+        pa_modargs_free(ma);
+
+        return 0;
+    }
+
     u->sink = pa_sink_new(m->core, &sink_data, master->flags & (PA_SINK_LATENCY|PA_SINK_DYNAMIC_LATENCY));
     pa_sink_new_data_done(&sink_data);
 
@@ -493,6 +555,11 @@ void pa__done(pa_module*m) {
     if (!(u = m->userdata))
         return;
 
+    if (u->stage) {
+        pa_filter_stage_free(u->stage);
+        u->sink = NULL;
+    }
+
     /* See comments in sink_input_kill_cb() above regarding
      * destruction order! */
 
@@ -38,6 +38,7 @@
 #include <pulsecore/ltdl-helper.h>
 #include <pulsecore/sound-file.h>
 #include <pulsecore/resampler.h>
+#include <pulsecore/filter/convolver.h>
 
 #include <math.h>
 
@@ -63,6 +64,11 @@ PA_MODULE_USAGE(
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 #define DEFAULT_AUTOLOADED false
 
+/* The first CONVOLVER_BLOCK_SIZE taps of the hrir are applied in direct
+ * form, the rest with FFT convolution */
+#define CONVOLVER_BLOCK_SIZE 64
+#define HRIR_MAX_SAMPLES 8192
+
 struct userdata {
     pa_module *module;
 
@@ -86,8 +92,7 @@ struct userdata {
     unsigned hrir_samples;
     float *hrir_data;
 
-    float *input_buffer;
-    int input_buffer_offset;
+    pa_convolver *convolver;
 
     bool autoloaded;
 };
@@ -239,10 +244,7 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     float *src, *dst;
     unsigned n;
     pa_memchunk tchunk;
-
-    unsigned j, k, l;
-    float sum_right, sum_left;
-    float current_sample;
+    unsigned l;
 
     pa_sink_input_assert_ref(i);
     pa_assert(chunk);
@@ -278,29 +280,11 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk
     src = pa_memblock_acquire_chunk(&tchunk);
     dst = pa_memblock_acquire(chunk->memblock);
 
-    for (l = 0; l < n; l++) {
-        memcpy(((char*) u->input_buffer) + u->input_buffer_offset * u->sink_fs, ((char *) src) + l * u->sink_fs, u->sink_fs);
-
-        sum_right = 0;
-        sum_left = 0;
-
-        /* fold the input buffer with the impulse response */
-        for (j = 0; j < u->hrir_samples; j++) {
-            for (k = 0; k < u->channels; k++) {
-                current_sample = u->input_buffer[((u->input_buffer_offset + j) % u->hrir_samples) * u->channels + k];
-
-                sum_left += current_sample * u->hrir_data[j * u->hrir_channels + u->mapping_left[k]];
-                sum_right += current_sample * u->hrir_data[j * u->hrir_channels + u->mapping_right[k]];
-            }
-        }
-
-        dst[2 * l] = PA_CLAMP_UNLIKELY(sum_left, -1.0f, 1.0f);
-        dst[2 * l + 1] = PA_CLAMP_UNLIKELY(sum_right, -1.0f, 1.0f);
+    /* fold the input with the impulse response */
+    pa_convolver_process(u->convolver, src, dst, n);
 
-        u->input_buffer_offset--;
-        if (u->input_buffer_offset < 0)
-            u->input_buffer_offset += u->hrir_samples;
-    }
+    for (l = 0; l < 2 * n; l++)
+        dst[l] = PA_CLAMP_UNLIKELY(dst[l], -1.0f, 1.0f);
 
     pa_memblock_release(tchunk.memblock);
     pa_memblock_release(chunk->memblock);
@@ -329,17 +313,15 @@ static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
         amount = PA_MIN(u->sink->thread_info.rewind_nbytes * u->sink_fs / u->fs, max_rewrite);
         u->sink->thread_info.rewind_nbytes = 0;
 
-        if (amount > 0) {
+        if (amount > 0)
             pa_memblockq_seek(u->memblockq, - (int64_t) amount, PA_SEEK_RELATIVE, true);
-
-            /* Reset the input buffer */
-            memset(u->input_buffer, 0, u->hrir_samples * u->sink_fs);
-            u->input_buffer_offset = 0;
-        }
     }
 
     pa_sink_process_rewind(u->sink, amount);
     pa_memblockq_rewind(u->memblockq, nbytes * u->sink_fs / u->fs);
+
+    /* The frames read again from the memblockq will be folded again */
+    pa_convolver_rewind(u->convolver, nbytes / u->fs);
 }
 
 /* Called from I/O thread context */
@@ -353,6 +335,7 @@ static void sink_input_update_max_rewind_cb(pa_sink_input *i, size_t nbytes) {
      * https://bugs.freedesktop.org/show_bug.cgi?id=53709 */
     pa_memblockq_set_maxrewind(u->memblockq, nbytes * u->sink_fs / u->fs);
     pa_sink_set_max_rewind_within_thread(u->sink, nbytes * u->sink_fs / u->fs);
+    pa_convolver_set_max_rewind(u->convolver, nbytes / u->fs);
 }
 
 /* Called from I/O thread context */
@@ -415,6 +398,7 @@ static void sink_input_attach_cb(pa_sink_input *i) {
     /* FIXME: Too small max_rewind:
      * https://bugs.freedesktop.org/show_bug.cgi?id=53709 */
     pa_sink_set_max_rewind_within_thread(u->sink, pa_sink_input_get_max_rewind(i) * u->sink_fs / u->fs);
+    pa_convolver_set_max_rewind(u->convolver, pa_sink_input_get_max_rewind(i) / u->fs);
 
     if (PA_SINK_IS_LINKED(u->sink->thread_info.state))
         pa_sink_attach_within_thread(u->sink);
@@ -585,6 +569,33 @@ static void normalize_hrir(struct userdata *u) {
     }
 }
 
+static pa_convolver *create_convolver(struct userdata *u) {
+    float **responses;
+    pa_convolver *convolver;
+    unsigned i, j;
+
+    /* Left output first, then the right one */
+    responses = pa_xnew(float*, 2 * u->channels);
+
+    for (i = 0; i < 2 * u->channels; i++) {
+        unsigned c = i < u->channels ? u->mapping_left[i] : u->mapping_right[i - u->channels];
+
+        responses[i] = pa_xnew(float, u->hrir_samples);
+
+        for (j = 0; j < u->hrir_samples; j++)
+            responses[i][j] = u->hrir_data[j * u->hrir_channels + c];
+    }
+
+    convolver = pa_convolver_new(u->channels, 2, CONVOLVER_BLOCK_SIZE, (const float * const *) responses, u->hrir_samples);
+
+    for (i = 0; i < 2 * u->channels; i++)
+        pa_xfree(responses[i]);
+
+    pa_xfree(responses);
+
+    return convolver;
+}
+
 int pa__init(pa_module*m) {
     struct userdata *u;
     pa_sample_spec ss, sink_input_ss;
@@ -794,9 +805,10 @@ int pa__init(pa_module*m) {
                                  PA_RESAMPLER_SRC_SINC_BEST_QUALITY, PA_RESAMPLER_NO_REMAP);
 
     u->hrir_samples = hrir_temp_chunk.length / pa_frame_size(&hrir_temp_ss) * hrir_ss.rate / hrir_temp_ss.rate;
-    if (u->hrir_samples > 64) {
-        u->hrir_samples = 64;
-        pa_log("The (resampled) hrir contains more than 64 samples. Only the first 64 samples will be used to limit processor usage.");
+    if (u->hrir_samples > HRIR_MAX_SAMPLES) {
+        u->hrir_samples = HRIR_MAX_SAMPLES;
+        pa_log("The (resampled) hrir contains more than %u samples. Only the first %u samples will be used to limit processor usage.",
+               HRIR_MAX_SAMPLES, HRIR_MAX_SAMPLES);
     }
 
     hrir_total_length = u->hrir_samples * pa_frame_size(&hrir_ss);
@@ -872,8 +884,7 @@ int pa__init(pa_module*m) {
         }
     }
 
-    u->input_buffer = pa_xmalloc0(u->hrir_samples * u->sink_fs);
-    u->input_buffer_offset = 0;
+    u->convolver = create_convolver(u);
 
     /* The order here is important. The input must be put first,
      * otherwise streams might attach to the sink before the sink
@@ -940,8 +951,8 @@ void pa__done(pa_module*m) {
     if (u->hrir_data)
         pa_xfree(u->hrir_data);
 
-    if (u->input_buffer)
-        pa_xfree(u->input_buffer);
+    if (u->convolver)
+        pa_convolver_free(u->convolver);
 
     if (u->mapping_left)
         pa_xfree(u->mapping_left);
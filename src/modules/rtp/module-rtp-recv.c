@@ -400,6 +400,7 @@ static void sink_input_attach(pa_sink_input *i) {
     p->revents = 0;
 
     pa_rtpoll_item_set_work_callback(s->rtpoll_item, rtpoll_work_cb);
+    pa_rtpoll_item_set_name(s->rtpoll_item, "rtp-recv");
     pa_rtpoll_item_set_userdata(s->rtpoll_item, s);
 }
 
@@ -386,6 +386,8 @@ static void handle_srbchannel_memblock(pa_context *c, pa_memblock *memblock) {
         return;
     }
 
+    pa_srbchannel_set_busy_poll(sr, c->conf->srbchannel_busy_poll_usec);
+
     /* Ack the enable command */
     t = pa_tagstruct_new();
     pa_tagstruct_putu32(t, PA_COMMAND_ENABLE_SRBCHANNEL);
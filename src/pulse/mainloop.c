@@ -32,6 +32,10 @@
 #include <pulsecore/pipe.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
 #include <pulse/xmalloc.h>
@@ -39,6 +43,7 @@
 #include <pulsecore/poll.h>
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/hashmap.h>
 #include <pulsecore/i18n.h>
 #include <pulsecore/llist.h>
 #include <pulsecore/log.h>
@@ -57,6 +62,13 @@ struct pa_io_event {
     pa_io_event_flags_t events;
     struct pollfd *pollfd;
 
+#ifdef HAVE_SYS_EPOLL_H
+    /* The epoll registration this event shares with the other events on
+     * the same fd, and the next event in its list */
+    struct io_fd *io_fd;
+    pa_io_event *fd_next;
+#endif
+
     pa_io_event_cb_t callback;
     void *userdata;
     pa_io_event_destroy_cb_t destroy_callback;
@@ -64,6 +76,18 @@ struct pa_io_event {
     PA_LLIST_FIELDS(pa_io_event);
 };
 
+#ifdef HAVE_SYS_EPOLL_H
+/* epoll only allows one registration per fd, but there may be several
+ * io events on the same fd */
+struct io_fd {
+    int fd;
+    bool registered:1;
+    uint32_t events;
+
+    pa_io_event *io_events;
+};
+#endif
+
 struct pa_time_event {
     pa_mainloop *mainloop;
     bool dead:1;
@@ -72,6 +96,14 @@ struct pa_time_event {
     bool use_rtclock:1;
     pa_usec_t time;
 
+    /* Position in the time heap, valid while enabled */
+    unsigned heap_idx;
+
+    /* Set while taken from the heap by dispatch_timeout() and not yet
+     * dispatched, cleared if restarted or freed in the meantime */
+    bool expired:1;
+    pa_time_event *next_expired;
+
     pa_time_event_cb_t callback;
     void *userdata;
     pa_time_event_destroy_cb_t destroy_callback;
@@ -104,8 +136,25 @@ struct pa_mainloop {
     struct pollfd *pollfds;
     unsigned max_pollfds, n_pollfds;
 
+#ifdef HAVE_SYS_EPOLL_H
+    /* If epoll_fd is valid the io events are watched with epoll and the
+     * pollfd array only contains epoll_fd, so that poll functions set with
+     * pa_mainloop_set_poll_func() keep working. If an fd can't be added to
+     * epoll, epoll_failed is set and we go back to plain poll() in the next
+     * pa_mainloop_prepare(). */
+    int epoll_fd;
+    bool epoll_failed:1;
+    pa_hashmap *io_fds;
+    struct epoll_event *epoll_events;
+    unsigned max_epoll_events;
+    int n_epoll_events;
+#endif
+
     pa_usec_t prepared_timeout;
-    pa_time_event *cached_next_time_event;
+
+    /* Binary min-heap of the enabled time events, ordered by time */
+    pa_time_event **time_heap;
+    unsigned max_time_heap;
 
     pa_mainloop_api api;
 
@@ -144,6 +193,258 @@ static pa_io_event_flags_t map_flags_from_libc(short flags) {
         (flags & POLLHUP ? PA_IO_EVENT_HANGUP : 0);
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+static uint32_t map_flags_to_epoll(pa_io_event_flags_t flags) {
+    return
+        (flags & PA_IO_EVENT_INPUT ? EPOLLIN : 0) |
+        (flags & PA_IO_EVENT_OUTPUT ? EPOLLOUT : 0) |
+        (flags & PA_IO_EVENT_ERROR ? EPOLLERR : 0) |
+        (flags & PA_IO_EVENT_HANGUP ? EPOLLHUP : 0);
+}
+
+static pa_io_event_flags_t map_flags_from_epoll(uint32_t flags) {
+    return
+        (flags & EPOLLIN ? PA_IO_EVENT_INPUT : 0) |
+        (flags & EPOLLOUT ? PA_IO_EVENT_OUTPUT : 0) |
+        (flags & EPOLLERR ? PA_IO_EVENT_ERROR : 0) |
+        (flags & EPOLLHUP ? PA_IO_EVENT_HANGUP : 0);
+}
+
+static bool use_epoll(pa_mainloop *m) {
+    return m->epoll_fd >= 0 && !m->epoll_failed;
+}
+
+static int epoll_ctl_io_fd(pa_mainloop *m, int op, struct io_fd *f) {
+    struct epoll_event ev;
+
+    pa_zero(ev);
+    ev.events = f->events;
+    ev.data.ptr = f;
+
+    return epoll_ctl(m->epoll_fd, op, f->fd, &ev);
+}
+
+/* Brings the epoll registration of f in line with the io events on it */
+static void io_fd_update(pa_mainloop *m, struct io_fd *f) {
+    pa_io_event *e;
+    uint32_t events = 0;
+    bool live = false;
+    int r;
+
+    if (!use_epoll(m))
+        return;
+
+    for (e = f->io_events; e; e = e->fd_next)
+        if (!e->dead) {
+            events |= map_flags_to_epoll(e->events);
+            live = true;
+        }
+
+    if (!live) {
+        /* Drop the registration right away, the fd is probably closed
+         * next and its number reused */
+        if (f->registered)
+            epoll_ctl(m->epoll_fd, EPOLL_CTL_DEL, f->fd, NULL);
+
+        f->registered = false;
+        return;
+    }
+
+    if (f->registered && f->events == events)
+        return;
+
+    f->events = events;
+
+    /* The kernel drops registrations of closed fds behind our back, and a
+     * new fd with the same number may already be registered, so retry
+     * with the other operation. */
+    if (f->registered) {
+        if ((r = epoll_ctl_io_fd(m, EPOLL_CTL_MOD, f)) < 0 && errno == ENOENT)
+            r = epoll_ctl_io_fd(m, EPOLL_CTL_ADD, f);
+    } else {
+        if ((r = epoll_ctl_io_fd(m, EPOLL_CTL_ADD, f)) < 0 && errno == EEXIST)
+            r = epoll_ctl_io_fd(m, EPOLL_CTL_MOD, f);
+    }
+
+    if (r < 0) {
+        /* E.g. regular files can't be watched with epoll */
+        pa_log_debug("Can't watch fd %i with epoll, falling back to poll(): %s", f->fd, pa_cstrerror(errno));
+        m->epoll_failed = true;
+        m->rebuild_pollfds = true;
+        return;
+    }
+
+    f->registered = true;
+}
+
+static void io_fd_add(pa_mainloop *m, pa_io_event *e) {
+    struct io_fd *f;
+
+    if (!use_epoll(m))
+        return;
+
+    if (!(f = pa_hashmap_get(m->io_fds, PA_INT_TO_PTR(e->fd)))) {
+        f = pa_xnew0(struct io_fd, 1);
+        f->fd = e->fd;
+        pa_hashmap_put(m->io_fds, PA_INT_TO_PTR(f->fd), f);
+    }
+
+    e->io_fd = f;
+    e->fd_next = f->io_events;
+    f->io_events = e;
+
+    io_fd_update(m, f);
+}
+
+/* Called when e is actually freed */
+static void io_fd_remove(pa_mainloop *m, pa_io_event *e) {
+    struct io_fd *f = e->io_fd;
+    pa_io_event **p;
+
+    if (!f)
+        return;
+
+    for (p = &f->io_events; *p != e; p = &(*p)->fd_next)
+        pa_assert(*p);
+
+    *p = e->fd_next;
+    e->io_fd = NULL;
+
+    if (f->io_events)
+        return;
+
+    if (f->registered && m->epoll_fd >= 0)
+        epoll_ctl(m->epoll_fd, EPOLL_CTL_DEL, f->fd, NULL);
+
+    pa_hashmap_remove(m->io_fds, PA_INT_TO_PTR(f->fd));
+    pa_xfree(f);
+}
+
+static void epoll_init(pa_mainloop *m) {
+    struct epoll_event ev;
+
+    m->epoll_fd = -1;
+
+    if (getenv("PULSE_NO_EPOLL"))
+        return;
+
+    if ((m->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        pa_log_debug("epoll_create1() failed: %s", pa_cstrerror(errno));
+        return;
+    }
+
+    /* The wakeup pipe is the only registration with a NULL pointer */
+    pa_zero(ev);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+
+    if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, m->wakeup_pipe[0], &ev) < 0) {
+        pa_log_debug("Can't watch the wakeup pipe with epoll: %s", pa_cstrerror(errno));
+        pa_close(m->epoll_fd);
+        m->epoll_fd = -1;
+        return;
+    }
+
+    m->io_fds = pa_hashmap_new_full(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func, NULL, pa_xfree);
+}
+
+static void epoll_done(pa_mainloop *m) {
+    pa_io_event *e;
+
+    if (m->epoll_fd < 0)
+        return;
+
+    PA_LLIST_FOREACH(e, m->io_events) {
+        e->io_fd = NULL;
+        e->fd_next = NULL;
+    }
+
+    pa_hashmap_free(m->io_fds);
+    m->io_fds = NULL;
+
+    pa_xfree(m->epoll_events);
+    m->epoll_events = NULL;
+    m->max_epoll_events = 0;
+    m->n_epoll_events = 0;
+
+    pa_close(m->epoll_fd);
+    m->epoll_fd = -1;
+    m->epoll_failed = false;
+    m->rebuild_pollfds = true;
+}
+
+/* Called after poll() reported epoll_fd as readable. Returns the number of
+ * ready fds, not counting the wakeup pipe. */
+static int epoll_collect(pa_mainloop *m) {
+    unsigned l;
+    int n, i, r;
+
+    l = pa_hashmap_size(m->io_fds) + 1;
+    if (m->max_epoll_events < l) {
+        l *= 2;
+        m->epoll_events = pa_xrenew(struct epoll_event, m->epoll_events, l);
+        m->max_epoll_events = l;
+    }
+
+    if ((n = epoll_wait(m->epoll_fd, m->epoll_events, (int) m->max_epoll_events, 0)) < 0) {
+        if (errno != EINTR)
+            pa_log("epoll_wait(): %s", pa_cstrerror(errno));
+
+        n = 0;
+    }
+
+    m->n_epoll_events = n;
+
+    for (i = 0, r = 0; i < n; i++)
+        if (m->epoll_events[i].data.ptr)
+            r++;
+
+    return r;
+}
+
+static unsigned dispatch_epoll(pa_mainloop *m) {
+    unsigned r = 0;
+    int i;
+
+    /* The io_fd structures are only freed in pa_mainloop_prepare(), so they
+     * stay valid even if the callbacks free io events */
+    for (i = 0; i < m->n_epoll_events; i++) {
+        struct io_fd *f = m->epoll_events[i].data.ptr;
+        pa_io_event_flags_t revents;
+        pa_io_event *e;
+
+        if (!f)
+            continue;
+
+        revents = map_flags_from_epoll(m->epoll_events[i].events);
+
+        for (e = f->io_events; e; e = e->fd_next) {
+            pa_io_event_flags_t flags;
+
+            if (m->quit)
+                return r;
+
+            if (e->dead)
+                continue;
+
+            /* Like poll(), only report what this event asked for, plus
+             * errors and hangups */
+            if (!(flags = revents & (e->events | PA_IO_EVENT_ERROR | PA_IO_EVENT_HANGUP)))
+                continue;
+
+            pa_assert(e->callback);
+
+            e->callback(&m->api, e, e->fd, flags, e->userdata);
+            r++;
+        }
+    }
+
+    m->n_epoll_events = 0;
+
+    return r;
+}
+#endif
+
 /* IO events */
 static pa_io_event* mainloop_io_new(
         pa_mainloop_api *a,
@@ -173,9 +474,15 @@ static pa_io_event* mainloop_io_new(
     e->userdata = userdata;
 
     PA_LLIST_PREPEND(pa_io_event, m->io_events, e);
-    m->rebuild_pollfds = true;
     m->n_io_events ++;
 
+#ifdef HAVE_SYS_EPOLL_H
+    if (use_epoll(m))
+        io_fd_add(m, e);
+    else
+#endif
+        m->rebuild_pollfds = true;
+
     pa_mainloop_wakeup(m);
 
     return e;
@@ -190,6 +497,11 @@ static void mainloop_io_enable(pa_io_event *e, pa_io_event_flags_t events) {
 
     e->events = events;
 
+#ifdef HAVE_SYS_EPOLL_H
+    if (e->io_fd)
+        io_fd_update(e->mainloop, e->io_fd);
+    else
+#endif
     if (e->pollfd)
         e->pollfd->events = map_flags_to_libc(events);
     else
@@ -206,7 +518,13 @@ static void mainloop_io_free(pa_io_event *e) {
     e->mainloop->io_events_please_scan ++;
 
     e->mainloop->n_io_events --;
-    e->mainloop->rebuild_pollfds = true;
+
+#ifdef HAVE_SYS_EPOLL_H
+    if (e->io_fd)
+        io_fd_update(e->mainloop, e->io_fd);
+    else
+#endif
+        e->mainloop->rebuild_pollfds = true;
 
     pa_mainloop_wakeup(e->mainloop);
 }
@@ -305,6 +623,112 @@ static pa_usec_t make_rt(const struct timeval *tv, bool *use_rtclock) {
     return pa_timeval_load(&ttv);
 }
 
+static void time_heap_set(pa_mainloop *m, unsigned idx, pa_time_event *e) {
+    m->time_heap[idx] = e;
+    e->heap_idx = idx;
+}
+
+static void time_heap_sift_up(pa_mainloop *m, unsigned idx) {
+    pa_time_event *e = m->time_heap[idx];
+
+    while (idx > 0) {
+        unsigned parent = (idx - 1) / 2;
+
+        if (m->time_heap[parent]->time <= e->time)
+            break;
+
+        time_heap_set(m, idx, m->time_heap[parent]);
+        idx = parent;
+    }
+
+    time_heap_set(m, idx, e);
+}
+
+static void time_heap_sift_down(pa_mainloop *m, unsigned idx) {
+    pa_time_event *e = m->time_heap[idx];
+    unsigned n = m->n_enabled_time_events;
+
+    for (;;) {
+        unsigned child = 2 * idx + 1;
+
+        if (child >= n)
+            break;
+
+        if (child + 1 < n && m->time_heap[child + 1]->time < m->time_heap[child]->time)
+            child++;
+
+        if (e->time <= m->time_heap[child]->time)
+            break;
+
+        time_heap_set(m, idx, m->time_heap[child]);
+        idx = child;
+    }
+
+    time_heap_set(m, idx, e);
+}
+
+/* Adds e to the heap and marks it enabled. The heap size is
+ * n_enabled_time_events. */
+static void time_heap_insert(pa_mainloop *m, pa_time_event *e) {
+    pa_assert(!e->enabled);
+
+    if (m->n_enabled_time_events >= m->max_time_heap) {
+        m->max_time_heap = PA_MAX(m->max_time_heap * 2, 16U);
+        m->time_heap = pa_xrenew(pa_time_event*, m->time_heap, m->max_time_heap);
+    }
+
+    e->enabled = true;
+    time_heap_set(m, m->n_enabled_time_events++, e);
+    time_heap_sift_up(m, e->heap_idx);
+}
+
+/* Removes e from the heap and marks it disabled */
+static void time_heap_remove(pa_mainloop *m, pa_time_event *e) {
+    unsigned idx = e->heap_idx;
+    pa_time_event *last;
+
+    pa_assert(e->enabled);
+    pa_assert(m->n_enabled_time_events > 0);
+    pa_assert(m->time_heap[idx] == e);
+
+    e->enabled = false;
+    last = m->time_heap[--m->n_enabled_time_events];
+
+    if (last == e)
+        return;
+
+    time_heap_set(m, idx, last);
+
+    if (idx > 0 && m->time_heap[(idx - 1) / 2]->time > last->time)
+        time_heap_sift_up(m, idx);
+    else
+        time_heap_sift_down(m, idx);
+}
+
+/* Changes the time of an enabled event and restores the heap order */
+static void time_heap_update(pa_mainloop *m, pa_time_event *e, pa_usec_t t) {
+    pa_usec_t old = e->time;
+
+    pa_assert(e->enabled);
+
+    e->time = t;
+
+    if (t < old)
+        time_heap_sift_up(m, e->heap_idx);
+    else if (t > old)
+        time_heap_sift_down(m, e->heap_idx);
+}
+
+/* The timeout is calculated in pa_mainloop_prepare(), which also clears
+ * pending wakeups, so a wakeup is only needed if the loop has already been
+ * prepared and e is now the first event to elapse. */
+static void time_event_wakeup(pa_time_event *e) {
+    pa_mainloop *m = e->mainloop;
+
+    if ((m->state == STATE_PREPARED || m->state == STATE_POLLING) && e->enabled && e->heap_idx == 0)
+        pa_mainloop_wakeup(m);
+}
+
 static pa_time_event* mainloop_time_new(
         pa_mainloop_api *a,
         const struct timeval *tv,
@@ -328,18 +752,10 @@ static pa_time_event* mainloop_time_new(
     e = pa_xnew0(pa_time_event, 1);
     e->mainloop = m;
 
-    if ((e->enabled = (t != PA_USEC_INVALID))) {
+    if (t != PA_USEC_INVALID) {
         e->time = t;
         e->use_rtclock = use_rtclock;
-
-        m->n_enabled_time_events++;
-
-        if (m->cached_next_time_event) {
-            pa_assert(m->cached_next_time_event->enabled);
-
-            if (t < m->cached_next_time_event->time)
-                m->cached_next_time_event = e;
-        }
+        time_heap_insert(m, e);
     }
 
     e->callback = callback;
@@ -347,14 +763,12 @@ static pa_time_event* mainloop_time_new(
 
     PA_LLIST_PREPEND(pa_time_event, m->time_events, e);
 
-    if (e->enabled)
-        pa_mainloop_wakeup(m);
+    time_event_wakeup(e);
 
     return e;
 }
 
 static void mainloop_time_restart(pa_time_event *e, const struct timeval *tv) {
-    bool valid;
     pa_usec_t t;
     bool use_rtclock = false;
 
@@ -363,28 +777,25 @@ static void mainloop_time_restart(pa_time_event *e, const struct timeval *tv) {
 
     t = make_rt(tv, &use_rtclock);
 
-    valid = (t != PA_USEC_INVALID);
-    if (e->enabled && !valid) {
-        pa_assert(e->mainloop->n_enabled_time_events > 0);
-        e->mainloop->n_enabled_time_events--;
-    } else if (!e->enabled && valid)
-        e->mainloop->n_enabled_time_events++;
+    e->expired = false;
 
-    if ((e->enabled = valid)) {
-        e->time = t;
-        e->use_rtclock = use_rtclock;
-        pa_mainloop_wakeup(e->mainloop);
-    }
+    if (t == PA_USEC_INVALID) {
+        if (e->enabled)
+            time_heap_remove(e->mainloop, e);
 
-    if (e->mainloop->cached_next_time_event == e)
-        e->mainloop->cached_next_time_event = NULL;
+        return;
+    }
 
-    if (e->mainloop->cached_next_time_event && e->enabled) {
-        pa_assert(e->mainloop->cached_next_time_event->enabled);
+    e->use_rtclock = use_rtclock;
 
-        if (t < e->mainloop->cached_next_time_event->time)
-            e->mainloop->cached_next_time_event = e;
+    if (e->enabled)
+        time_heap_update(e->mainloop, e, t);
+    else {
+        e->time = t;
+        time_heap_insert(e->mainloop, e);
     }
+
+    time_event_wakeup(e);
 }
 
 static void mainloop_time_free(pa_time_event *e) {
@@ -393,15 +804,10 @@ static void mainloop_time_free(pa_time_event *e) {
 
     e->dead = true;
     e->mainloop->time_events_please_scan ++;
+    e->expired = false;
 
-    if (e->enabled) {
-        pa_assert(e->mainloop->n_enabled_time_events > 0);
-        e->mainloop->n_enabled_time_events--;
-        e->enabled = false;
-    }
-
-    if (e->mainloop->cached_next_time_event == e)
-        e->mainloop->cached_next_time_event = NULL;
+    if (e->enabled)
+        time_heap_remove(e->mainloop, e);
 
     /* no wakeup needed here. Think about it! */
 }
@@ -463,6 +869,10 @@ pa_mainloop *pa_mainloop_new(void) {
     pa_make_fd_nonblock(m->wakeup_pipe[0]);
     pa_make_fd_nonblock(m->wakeup_pipe[1]);
 
+#ifdef HAVE_SYS_EPOLL_H
+    epoll_init(m);
+#endif
+
     m->rebuild_pollfds = true;
 
     m->api = vtable;
@@ -494,6 +904,9 @@ static void cleanup_io_events(pa_mainloop *m, bool force) {
             if (e->destroy_callback)
                 e->destroy_callback(&m->api, e, e->userdata);
 
+#ifdef HAVE_SYS_EPOLL_H
+            io_fd_remove(m, e);
+#endif
             pa_xfree(e);
 
             m->rebuild_pollfds = true;
@@ -519,11 +932,8 @@ static void cleanup_time_events(pa_mainloop *m, bool force) {
                 m->time_events_please_scan--;
             }
 
-            if (!e->dead && e->enabled) {
-                pa_assert(m->n_enabled_time_events > 0);
-                m->n_enabled_time_events--;
-                e->enabled = false;
-            }
+            if (!e->dead && e->enabled)
+                time_heap_remove(m, e);
 
             if (e->destroy_callback)
                 e->destroy_callback(&m->api, e, e->userdata);
@@ -574,7 +984,12 @@ void pa_mainloop_free(pa_mainloop *m) {
     cleanup_defer_events(m, true);
     cleanup_time_events(m, true);
 
+#ifdef HAVE_SYS_EPOLL_H
+    epoll_done(m);
+#endif
+
     pa_xfree(m->pollfds);
+    pa_xfree(m->time_heap);
 
     pa_close_pipe(m->wakeup_pipe);
 
@@ -609,6 +1024,22 @@ static void rebuild_pollfds(pa_mainloop *m) {
     m->n_pollfds = 0;
     p = m->pollfds;
 
+#ifdef HAVE_SYS_EPOLL_H
+    if (m->epoll_fd >= 0) {
+        /* The wakeup pipe and the io events are all behind this */
+        m->pollfds[0].fd = m->epoll_fd;
+        m->pollfds[0].events = POLLIN;
+        m->pollfds[0].revents = 0;
+        m->n_pollfds = 1;
+
+        PA_LLIST_FOREACH(e, m->io_events)
+            e->pollfd = NULL;
+
+        m->rebuild_pollfds = false;
+        return;
+    }
+#endif
+
     m->pollfds[0].fd = m->wakeup_pipe[0];
     m->pollfds[0].events = POLLIN;
     m->pollfds[0].revents = 0;
@@ -639,6 +1070,11 @@ static unsigned dispatch_pollfds(pa_mainloop *m) {
 
     pa_assert(m->poll_func_ret > 0);
 
+#ifdef HAVE_SYS_EPOLL_H
+    if (m->epoll_fd >= 0)
+        return dispatch_epoll(m);
+#endif
+
     k = m->poll_func_ret;
 
     PA_LLIST_FOREACH(e, m->io_events) {
@@ -685,28 +1121,12 @@ static unsigned dispatch_defer(pa_mainloop *m) {
 }
 
 static pa_time_event* find_next_time_event(pa_mainloop *m) {
-    pa_time_event *t, *n = NULL;
     pa_assert(m);
 
-    if (m->cached_next_time_event)
-        return m->cached_next_time_event;
-
-    PA_LLIST_FOREACH(t, m->time_events) {
-
-        if (t->dead || !t->enabled)
-            continue;
-
-        if (!n || t->time < n->time) {
-            n = t;
-
-            /* Shortcut for time == 0 */
-            if (n->time == 0)
-                break;
-        }
-    }
+    if (m->n_enabled_time_events <= 0)
+        return NULL;
 
-    m->cached_next_time_event = n;
-    return n;
+    return m->time_heap[0];
 }
 
 static pa_usec_t calc_next_timeout(pa_mainloop *m) {
@@ -730,7 +1150,7 @@ static pa_usec_t calc_next_timeout(pa_mainloop *m) {
 }
 
 static unsigned dispatch_timeout(pa_mainloop *m) {
-    pa_time_event *e;
+    pa_time_event *e, *expired = NULL, *tail = NULL;
     pa_usec_t now;
     unsigned r = 0;
     pa_assert(m);
@@ -740,25 +1160,44 @@ static unsigned dispatch_timeout(pa_mainloop *m) {
 
     now = pa_rtclock_now();
 
-    PA_LLIST_FOREACH(e, m->time_events) {
+    /* First take all events that are due from the heap, so that events
+     * that are restarted from a callback with a time in the past are not
+     * dispatched again in this iteration. */
+    while (m->n_enabled_time_events > 0 && (e = m->time_heap[0])->time <= now) {
+        time_heap_remove(m, e);
 
-        if (m->quit)
-            break;
+        e->expired = true;
+        e->next_expired = NULL;
 
-        if (e->dead || !e->enabled)
-            continue;
+        if (tail)
+            tail->next_expired = e;
+        else
+            expired = e;
 
-        if (e->time <= now) {
-            struct timeval tv;
-            pa_assert(e->callback);
+        tail = e;
+    }
 
-            /* Disable time event */
-            mainloop_time_restart(e, NULL);
+    while ((e = expired)) {
+        struct timeval tv;
 
-            e->callback(&m->api, e, pa_timeval_rtstore(&tv, e->time, e->use_rtclock), e->userdata);
+        expired = e->next_expired;
 
-            r++;
+        /* Restarted or freed by an earlier callback */
+        if (!e->expired)
+            continue;
+
+        e->expired = false;
+
+        if (m->quit) {
+            /* Leave it for the next iteration */
+            time_heap_insert(m, e);
+            continue;
         }
+
+        pa_assert(e->callback);
+        e->callback(&m->api, e, pa_timeval_rtstore(&tv, e->time, e->use_rtclock), e->userdata);
+
+        r++;
     }
 
     return r;
@@ -789,6 +1228,11 @@ int pa_mainloop_prepare(pa_mainloop *m, int timeout) {
     clear_wakeup(m);
     scan_dead(m);
 
+#ifdef HAVE_SYS_EPOLL_H
+    if (m->epoll_failed)
+        epoll_done(m);
+#endif
+
     if (m->quit)
         goto quit;
 
@@ -866,6 +1310,12 @@ int pa_mainloop_poll(pa_mainloop *m) {
             else
                 pa_log("poll(): %s", pa_cstrerror(errno));
         }
+
+#ifdef HAVE_SYS_EPOLL_H
+        /* Only the epoll fd was polled, now find out what is ready */
+        if (m->poll_func_ret > 0 && m->epoll_fd >= 0)
+            m->poll_func_ret = epoll_collect(m);
+#endif
     }
 
     m->state = m->poll_func_ret < 0 ? STATE_PASSIVE : STATE_POLLED;
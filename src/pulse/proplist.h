@@ -267,6 +267,54 @@ PA_C_DECL_BEGIN
 /** For PCM formats: the channel map of the stream as returned by pa_channel_map_snprint() \since 1.0 */
 #define PA_PROP_FORMAT_CHANNEL_MAP             "format.channel_map"
 
+/** For streams: how often the server was woken up through the shared ringbuffer channel's semaphore. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_SRBCHANNEL_WAKEUPS             "srbchannel.wakeups"
+
+/** For streams: how often the server found new data on the shared ringbuffer channel while busy polling. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_SRBCHANNEL_SPIN_HITS           "srbchannel.spin_hits"
+
+/** For streams: how often busy polling on the shared ringbuffer channel timed out without new data. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_SRBCHANNEL_SPIN_MISSES         "srbchannel.spin_misses"
+
+/** For devices: how often the I/O thread of the device went to sleep. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_RTPOLL_ITERATIONS              "rtpoll.iterations"
+
+/** For devices: average time in usec the I/O thread of the device was busy between two sleeps. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_RTPOLL_AWAKE_AVG_USEC          "rtpoll.awake.avg_usec"
+
+/** For devices: maximum time in usec the I/O thread of the device was busy between two sleeps. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_RTPOLL_AWAKE_MAX_USEC          "rtpoll.awake.max_usec"
+
+/** For devices: comma separated histogram of the busy times of the I/O thread of the device. Bucket 0 counts times below 1 usec, bucket n times below 2^n usec. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_RTPOLL_AWAKE_HISTOGRAM         "rtpoll.awake.histogram"
+
+/** For devices: average time in usec the I/O thread of the device slept. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_RTPOLL_SLEEP_AVG_USEC          "rtpoll.sleep.avg_usec"
+
+/** For devices: maximum time in usec the I/O thread of the device slept. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_RTPOLL_SLEEP_MAX_USEC          "rtpoll.sleep.max_usec"
+
+/** For devices: comma separated histogram of the sleep times of the I/O thread of the device, with buckets as in PA_PROP_RTPOLL_AWAKE_HISTOGRAM. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_RTPOLL_SLEEP_HISTOGRAM         "rtpoll.sleep.histogram"
+
+/** For devices: how often the I/O thread of the device was woken up by its timer. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_RTPOLL_TIMER_WAKEUPS           "rtpoll.timer.wakeups"
+
+/** For devices: average time in usec the I/O thread of the device woke up later than its timer was set to. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_RTPOLL_TIMER_OVERSHOOT_AVG_USEC "rtpoll.timer.overshoot.avg_usec"
+
+/** For devices: maximum time in usec the I/O thread of the device woke up later than its timer was set to. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_RTPOLL_TIMER_OVERSHOOT_MAX_USEC "rtpoll.timer.overshoot.max_usec"
+
+/** For devices: comma separated histogram of the timer overshoot of the I/O thread of the device, with buckets as in PA_PROP_RTPOLL_AWAKE_HISTOGRAM. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_RTPOLL_TIMER_OVERSHOOT_HISTOGRAM "rtpoll.timer.overshoot.histogram"
+
+/** For devices: comma separated list of the work callbacks run by the I/O thread of the device, each formatted as name:calls:avg_usec:max_usec. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_RTPOLL_ITEMS                   "rtpoll.items"
+
+/** For playback streams: the quality level the resample quality governor of the sink currently imposes on the resampler of the stream, 0 meaning the quality the stream was set up with and higher values cheaper ones. Only set if the governor is enabled. Read-only, filled in on introspection. \since 13.0 */
+#define PA_PROP_RESAMPLER_QUALITY_LEVEL        "resampler.quality_level"
+
 /** A property list object. Basically a dictionary with ASCII strings
  * as keys and arbitrary data as values. \since 0.9.11 */
 typedef struct pa_proplist pa_proplist;
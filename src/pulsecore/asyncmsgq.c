@@ -29,8 +29,8 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/log.h>
 #include <pulsecore/semaphore.h>
-#include <pulsecore/macro.h>
-#include <pulsecore/mutex.h>
+#include <pulsecore/mpscq.h>
+#include <pulsecore/fdsem.h>
 #include <pulsecore/flist.h>
 
 #include "asyncmsgq.h"
@@ -39,6 +39,8 @@ PA_STATIC_FLIST_DECLARE(asyncmsgq, 0, pa_xfree);
 PA_STATIC_FLIST_DECLARE(semaphores, 0, (void(*)(void*)) pa_semaphore_free);
 
 struct asyncmsgq_item {
+    pa_mpscq_node node; /* must be first */
+
     int code;
     pa_msgobject *object;
     void *userdata;
@@ -47,57 +49,130 @@ struct asyncmsgq_item {
     pa_memchunk memchunk;
     pa_semaphore *semaphore;
     int ret;
+
+    bool idempotent:1;
+    bool superseded:1;
+
+    /* Only used on the reading side, for items that have been taken
+     * from the queue but not processed yet */
+    struct asyncmsgq_item *pending_next;
 };
 
 struct pa_asyncmsgq {
     PA_REFCNT_DECLARE;
-    pa_asyncq *asyncq;
-    pa_mutex *mutex; /* only for the writer side */
+    pa_mpscq *mpscq;
+
+    /* Never signalled. Writers never need to wait since the queue is
+     * unbounded; this only exists to keep the write side fd
+     * interface working. */
+    pa_fdsem *write_fdsem;
 
+    /* Reader side only */
+    struct asyncmsgq_item *pending_head, *pending_tail;
     struct asyncmsgq_item *current;
 };
 
 pa_asyncmsgq *pa_asyncmsgq_new(unsigned size) {
-    pa_asyncq *asyncq;
     pa_asyncmsgq *a;
 
-    asyncq = pa_asyncq_new(size);
-    if (!asyncq)
-        return NULL;
-
-    a = pa_xnew(pa_asyncmsgq, 1);
+    a = pa_xnew0(pa_asyncmsgq, 1);
 
     PA_REFCNT_INIT(a);
-    a->asyncq = asyncq;
-    pa_assert_se(a->mutex = pa_mutex_new(false, true));
-    a->current = NULL;
+
+    if (!(a->mpscq = pa_mpscq_new())) {
+        pa_xfree(a);
+        return NULL;
+    }
+
+    if (!(a->write_fdsem = pa_fdsem_new())) {
+        pa_mpscq_free(a->mpscq);
+        pa_xfree(a);
+        return NULL;
+    }
 
     return a;
 }
 
-static void asyncmsgq_free(pa_asyncmsgq *a) {
+static void item_free(struct asyncmsgq_item *i) {
+    pa_assert(i);
+    pa_assert(!i->semaphore);
+
+    if (i->free_cb)
+        i->free_cb(i->userdata);
+
+    if (i->object)
+        pa_msgobject_unref(i->object);
+
+    if (i->memchunk.memblock)
+        pa_memblock_unref(i->memchunk.memblock);
+
+    if (pa_flist_push(PA_STATIC_FLIST_GET(asyncmsgq), i) < 0)
+        pa_xfree(i);
+}
+
+/* Returns the next item that is to be processed, without taking it. If
+ * there is nothing pending locally, take one item from the queue. */
+static struct asyncmsgq_item *pending_peek(pa_asyncmsgq *a, bool wait_op) {
     struct asyncmsgq_item *i;
-    pa_assert(a);
 
-    while ((i = pa_asyncq_pop(a->asyncq, false))) {
+    for (;;) {
+        while ((i = a->pending_head) && i->superseded) {
+            if (!(a->pending_head = i->pending_next))
+                a->pending_tail = NULL;
+
+            item_free(i);
+        }
+
+        if (i)
+            return i;
+
+        if (!(i = (struct asyncmsgq_item*) pa_mpscq_pop(a->mpscq, wait_op)))
+            return NULL;
+
+        i->pending_next = NULL;
+        a->pending_head = a->pending_tail = i;
+    }
+}
+
+/* Moves up to max items from the queue to the local pending list. A
+ * newer idempotent message replaces an older pending one for the same
+ * object and code. */
+static void pending_fill(pa_asyncmsgq *a, unsigned max) {
+    struct asyncmsgq_item *i, *j;
 
-        pa_assert(!i->semaphore);
+    for (; max > 0; max--) {
+        if (!(i = (struct asyncmsgq_item*) pa_mpscq_pop(a->mpscq, false)))
+            break;
 
-        if (i->object)
-            pa_msgobject_unref(i->object);
+        i->pending_next = NULL;
 
-        if (i->memchunk.memblock)
-            pa_memblock_unref(i->memchunk.memblock);
+        if (i->idempotent)
+            for (j = a->pending_head; j; j = j->pending_next)
+                if (j->idempotent && !j->superseded && j->object == i->object && j->code == i->code)
+                    j->superseded = true;
 
-        if (i->free_cb)
-            i->free_cb(i->userdata);
+        if (a->pending_tail)
+            a->pending_tail->pending_next = i;
+        else
+            a->pending_head = i;
 
-        if (pa_flist_push(PA_STATIC_FLIST_GET(asyncmsgq), i) < 0)
-            pa_xfree(i);
+        a->pending_tail = i;
     }
+}
+
+static void asyncmsgq_free(pa_asyncmsgq *a) {
+    struct asyncmsgq_item *i;
+    pa_assert(a);
 
-    pa_asyncq_free(a->asyncq, NULL);
-    pa_mutex_free(a->mutex);
+    while ((i = pending_peek(a, false))) {
+        if (!(a->pending_head = i->pending_next))
+            a->pending_tail = NULL;
+
+        item_free(i);
+    }
+
+    pa_mpscq_free(a->mpscq);
+    pa_fdsem_free(a->write_fdsem);
     pa_xfree(a);
 }
 
@@ -115,7 +190,7 @@ void pa_asyncmsgq_unref(pa_asyncmsgq* q) {
         asyncmsgq_free(q);
 }
 
-void pa_asyncmsgq_post(pa_asyncmsgq *a, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *chunk, pa_free_cb_t free_cb) {
+static void post_item(pa_asyncmsgq *a, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *chunk, pa_free_cb_t free_cb, bool idempotent) {
     struct asyncmsgq_item *i;
     pa_assert(PA_REFCNT_VALUE(a) > 0);
 
@@ -134,11 +209,18 @@ void pa_asyncmsgq_post(pa_asyncmsgq *a, pa_msgobject *object, int code, const vo
     } else
         pa_memchunk_reset(&i->memchunk);
     i->semaphore = NULL;
+    i->idempotent = idempotent;
+    i->superseded = false;
 
-    /* This mutex makes the queue multiple-writer safe. This lock is only used on the writing side */
-    pa_mutex_lock(a->mutex);
-    pa_asyncq_post(a->asyncq, i);
-    pa_mutex_unlock(a->mutex);
+    pa_mpscq_push(a->mpscq, &i->node);
+}
+
+void pa_asyncmsgq_post(pa_asyncmsgq *a, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *chunk, pa_free_cb_t free_cb) {
+    post_item(a, object, code, userdata, offset, chunk, free_cb, false);
+}
+
+void pa_asyncmsgq_post_idempotent(pa_asyncmsgq *a, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *chunk, pa_free_cb_t free_cb) {
+    post_item(a, object, code, userdata, offset, chunk, free_cb, true);
 }
 
 int pa_asyncmsgq_send(pa_asyncmsgq *a, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *chunk) {
@@ -151,6 +233,8 @@ int pa_asyncmsgq_send(pa_asyncmsgq *a, pa_msgobject *object, int code, const voi
     i.free_cb = NULL;
     i.ret = -1;
     i.offset = offset;
+    i.idempotent = false;
+    i.superseded = false;
     if (chunk) {
         pa_assert(chunk->memblock);
         i.memchunk = *chunk;
@@ -160,10 +244,7 @@ int pa_asyncmsgq_send(pa_asyncmsgq *a, pa_msgobject *object, int code, const voi
     if (!(i.semaphore = pa_flist_pop(PA_STATIC_FLIST_GET(semaphores))))
         i.semaphore = pa_semaphore_new(0);
 
-    /* This mutex makes the queue multiple-writer safe. This lock is only used on the writing side */
-    pa_mutex_lock(a->mutex);
-    pa_assert_se(pa_asyncq_push(a->asyncq, &i, true) == 0);
-    pa_mutex_unlock(a->mutex);
+    pa_mpscq_push(a->mpscq, &i.node);
 
     pa_semaphore_wait(i.semaphore);
 
@@ -177,11 +258,14 @@ int pa_asyncmsgq_get(pa_asyncmsgq *a, pa_msgobject **object, int *code, void **u
     pa_assert(PA_REFCNT_VALUE(a) > 0);
     pa_assert(!a->current);
 
-    if (!(a->current = pa_asyncq_pop(a->asyncq, wait_op))) {
+    if (!(a->current = pending_peek(a, wait_op))) {
 /*         pa_log("failure"); */
         return -1;
     }
 
+    if (!(a->pending_head = a->current->pending_next))
+        a->pending_tail = NULL;
+
 /*     pa_log("success"); */
 
     if (code)
@@ -216,20 +300,8 @@ void pa_asyncmsgq_done(pa_asyncmsgq *a, int ret) {
     if (a->current->semaphore) {
         a->current->ret = ret;
         pa_semaphore_post(a->current->semaphore);
-    } else {
-
-        if (a->current->free_cb)
-            a->current->free_cb(a->current->userdata);
-
-        if (a->current->object)
-            pa_msgobject_unref(a->current->object);
-
-        if (a->current->memchunk.memblock)
-            pa_memblock_unref(a->current->memchunk.memblock);
-
-        if (pa_flist_push(PA_STATIC_FLIST_GET(asyncmsgq), a->current) < 0)
-            pa_xfree(a->current);
-    }
+    } else
+        item_free(a->current);
 
     a->current = NULL;
 }
@@ -281,40 +353,76 @@ int pa_asyncmsgq_process_one(pa_asyncmsgq *a) {
     return 1;
 }
 
+int pa_asyncmsgq_process_batch(pa_asyncmsgq *a, unsigned max) {
+    int n = 0;
+
+    pa_assert(PA_REFCNT_VALUE(a) > 0);
+    pa_assert(max > 0);
+
+    pa_asyncmsgq_ref(a);
+
+    pending_fill(a, max);
+
+    for (; max > 0; max--) {
+        pa_msgobject *object;
+        int code;
+        void *data;
+        pa_memchunk chunk;
+        int64_t offset;
+        int ret;
+
+        if (pa_asyncmsgq_get(a, &object, &code, &data, &offset, &chunk, false) < 0)
+            break;
+
+        if (!object && code == PA_MESSAGE_SHUTDOWN) {
+            pa_asyncmsgq_done(a, 0);
+            n = -1;
+            break;
+        }
+
+        ret = pa_asyncmsgq_dispatch(object, code, data, offset, &chunk);
+        pa_asyncmsgq_done(a, ret);
+        n++;
+    }
+
+    pa_asyncmsgq_unref(a);
+
+    return n;
+}
+
 int pa_asyncmsgq_read_fd(pa_asyncmsgq *a) {
     pa_assert(PA_REFCNT_VALUE(a) > 0);
 
-    return pa_asyncq_read_fd(a->asyncq);
+    return pa_mpscq_read_fd(a->mpscq);
 }
 
 int pa_asyncmsgq_read_before_poll(pa_asyncmsgq *a) {
     pa_assert(PA_REFCNT_VALUE(a) > 0);
 
-    return pa_asyncq_read_before_poll(a->asyncq);
+    if (a->pending_head)
+        return -1;
+
+    return pa_mpscq_read_before_poll(a->mpscq);
 }
 
 void pa_asyncmsgq_read_after_poll(pa_asyncmsgq *a) {
     pa_assert(PA_REFCNT_VALUE(a) > 0);
 
-    pa_asyncq_read_after_poll(a->asyncq);
+    pa_mpscq_read_after_poll(a->mpscq);
 }
 
 int pa_asyncmsgq_write_fd(pa_asyncmsgq *a) {
     pa_assert(PA_REFCNT_VALUE(a) > 0);
 
-    return pa_asyncq_write_fd(a->asyncq);
+    return pa_fdsem_get(a->write_fdsem);
 }
 
 void pa_asyncmsgq_write_before_poll(pa_asyncmsgq *a) {
     pa_assert(PA_REFCNT_VALUE(a) > 0);
-
-    pa_asyncq_write_before_poll(a->asyncq);
 }
 
 void pa_asyncmsgq_write_after_poll(pa_asyncmsgq *a) {
     pa_assert(PA_REFCNT_VALUE(a) > 0);
-
-    pa_asyncq_write_after_poll(a->asyncq);
 }
 
 int pa_asyncmsgq_dispatch(pa_msgobject *object, int code, void *userdata, int64_t offset, pa_memchunk *memchunk) {
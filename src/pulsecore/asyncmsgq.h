@@ -22,17 +22,16 @@
 
 #include <sys/types.h>
 
-#include <pulsecore/asyncq.h>
 #include <pulsecore/memchunk.h>
 #include <pulsecore/msgobject.h>
 
-/* A simple asynchronous message queue, based on pa_asyncq. In
- * contrast to pa_asyncq this one is multiple-writer safe, though
- * still not multiple-reader safe. This queue is intended to be used
- * for controlling real-time threads from normal-priority
- * threads. Multiple-writer-safety is accomplished by using a mutex on
- * the writer side. This queue is thus not useful for communication
- * between several real-time threads.
+/* A simple asynchronous message queue, based on pa_mpscq. It is
+ * multiple-writer safe, though still not multiple-reader safe. This
+ * queue is intended to be used for controlling real-time threads from
+ * normal-priority threads. Since the underlying queue is lock-free and
+ * unbounded, writers never take a lock and never have to wait for the
+ * reader, so bursts of messages from the main thread don't stall the
+ * real-time side.
  *
  * The queue takes messages consisting of:
  *    "Object" for which this messages is intended (may be NULL)
@@ -42,7 +41,12 @@
  *
  * There are two functions for submitting messages: _post and
  * _send. The former just enqueues the message asynchronously, the
- * latter waits for completion, synchronously. */
+ * latter waits for completion, synchronously.
+ *
+ * Messages submitted with _post_idempotent only carry state that a
+ * newer message with the same object and code completely replaces
+ * (e.g. "set the volume to x"). When the reader picks up several of
+ * them in one batch only the newest one is dispatched. */
 
 enum {
     PA_MESSAGE_SHUTDOWN = -1/* A generic message to inform the handler of this queue to quit */
@@ -50,12 +54,14 @@ enum {
 
 typedef struct pa_asyncmsgq pa_asyncmsgq;
 
+/* The size argument is ignored, the queue grows as needed */
 pa_asyncmsgq* pa_asyncmsgq_new(unsigned size);
 pa_asyncmsgq* pa_asyncmsgq_ref(pa_asyncmsgq *q);
 
 void pa_asyncmsgq_unref(pa_asyncmsgq* q);
 
 void pa_asyncmsgq_post(pa_asyncmsgq *q, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *memchunk, pa_free_cb_t userdata_free_cb);
+void pa_asyncmsgq_post_idempotent(pa_asyncmsgq *q, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *memchunk, pa_free_cb_t userdata_free_cb);
 int pa_asyncmsgq_send(pa_asyncmsgq *q, pa_msgobject *object, int code, const void *userdata, int64_t offset, const pa_memchunk *memchunk);
 
 int pa_asyncmsgq_get(pa_asyncmsgq *q, pa_msgobject **object, int *code, void **userdata, int64_t *offset, pa_memchunk *memchunk, bool wait);
@@ -64,6 +70,12 @@ void pa_asyncmsgq_done(pa_asyncmsgq *q, int ret);
 int pa_asyncmsgq_wait_for(pa_asyncmsgq *a, int code);
 int pa_asyncmsgq_process_one(pa_asyncmsgq *a);
 
+/* Dispatches up to max messages that are currently queued, coalescing
+ * idempotent ones. Returns the number of messages dispatched, or a
+ * negative value if a PA_MESSAGE_SHUTDOWN message was received, which
+ * is acknowledged but not dispatched and ends the batch. */
+int pa_asyncmsgq_process_batch(pa_asyncmsgq *a, unsigned max);
+
 void pa_asyncmsgq_flush(pa_asyncmsgq *a, bool run);
 
 /* For the reading side */
@@ -71,7 +83,8 @@ int pa_asyncmsgq_read_fd(pa_asyncmsgq *q);
 int pa_asyncmsgq_read_before_poll(pa_asyncmsgq *a);
 void pa_asyncmsgq_read_after_poll(pa_asyncmsgq *a);
 
-/* For the write side */
+/* For the write side. Writers never need to wait, so the fd never
+ * becomes ready; these are kept for compatibility only. */
 int pa_asyncmsgq_write_fd(pa_asyncmsgq *q);
 void pa_asyncmsgq_write_before_poll(pa_asyncmsgq *a);
 void pa_asyncmsgq_write_after_poll(pa_asyncmsgq *a);
@@ -21,6 +21,12 @@
 #include <config.h>
 #endif
 
+#ifdef __linux__
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#endif
+
 #include <pulse/volume.h>
 #include <pulse/xmalloc.h>
 #include <pulse/timeval.h>
@@ -35,6 +41,7 @@
 #include <pulsecore/core-scache.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/core-error.h>
 #include <pulsecore/namereg.h>
 
 #include "cli-text.h"
@@ -134,6 +141,20 @@ static void append_port_list(pa_strbuf *s, pa_hashmap *ports) {
     }
 }
 
+static void append_rtpoll_stats(pa_strbuf *s, const pa_rtpoll_stats *stats) {
+    pa_proplist *pl;
+    char *t;
+
+    pa_assert(stats);
+
+    pl = pa_proplist_new();
+    pa_rtpoll_stats_to_proplist(stats, pl);
+    t = pa_proplist_to_string_sep(pl, "\n\t\t");
+    pa_strbuf_printf(s, "\tI/O thread timing:\n\t\t%s\n", t);
+    pa_xfree(t);
+    pa_proplist_free(pl);
+}
+
 char *pa_card_list_to_string(pa_core *c) {
     pa_strbuf *s;
     pa_card *card;
@@ -213,6 +234,7 @@ char *pa_sink_list_to_string(pa_core *c) {
             cm[PA_CHANNEL_MAP_SNPRINT_MAX], *t;
         const char *cmn;
         char suspend_cause_buf[PA_SUSPEND_CAUSE_TO_STRING_BUF_SIZE];
+        pa_rtpoll_stats stats;
 
         cmn = pa_channel_map_to_pretty_name(&sink->channel_map);
 
@@ -298,6 +320,9 @@ char *pa_sink_list_to_string(pa_core *c) {
         pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
         pa_xfree(t);
 
+        if (pa_sink_get_rtpoll_stats(sink, &stats) >= 0)
+            append_rtpoll_stats(s, &stats);
+
         append_port_list(s, sink->ports);
 
         if (sink->active_port)
@@ -327,6 +352,7 @@ char *pa_source_list_to_string(pa_core *c) {
             cm[PA_CHANNEL_MAP_SNPRINT_MAX], *t;
         const char *cmn;
         char suspend_cause_buf[PA_SUSPEND_CAUSE_TO_STRING_BUF_SIZE];
+        pa_rtpoll_stats stats;
 
         cmn = pa_channel_map_to_pretty_name(&source->channel_map);
 
@@ -409,6 +435,9 @@ char *pa_source_list_to_string(pa_core *c) {
         pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
         pa_xfree(t);
 
+        if (pa_source_get_rtpoll_stats(source, &stats) >= 0)
+            append_rtpoll_stats(s, &stats);
+
         append_port_list(s, source->ports);
 
         if (source->active_port)
@@ -571,7 +600,8 @@ char *pa_sink_input_list_to_string(pa_core *c) {
             "\trequested latency: %s\n"
             "\tsample spec: %s\n"
             "\tchannel map: %s%s%s\n"
-            "\tresample method: %s\n",
+            "\tresample method: %s\n"
+            "\tsilent blocks skipped: %u of %u\n",
             i->index,
             i->driver,
             i->flags & PA_SINK_INPUT_VARIABLE_RATE ? "VARIABLE_RATE " : "",
@@ -596,7 +626,9 @@ char *pa_sink_input_list_to_string(pa_core *c) {
             pa_channel_map_snprint(cm, sizeof(cm), &i->channel_map),
             cmn ? "\n\t             " : "",
             cmn ? cmn : "",
-            pa_resample_method_to_string(pa_sink_input_get_resample_method(i)));
+            pa_resample_method_to_string(pa_sink_input_get_resample_method(i)),
+            (unsigned) pa_atomic_load(&i->n_silent_blocks),
+            (unsigned) pa_atomic_load(&i->n_render_blocks));
 
         pa_xfree(volume_str);
 
@@ -672,6 +704,122 @@ char *pa_scache_list_to_string(pa_core *c) {
     return pa_strbuf_to_string_free(s);
 }
 
+#ifdef __linux__
+static const char *sched_policy_to_string(int policy) {
+    switch (policy) {
+        case SCHED_OTHER:
+            return "SCHED_OTHER";
+        case SCHED_FIFO:
+            return "SCHED_FIFO";
+        case SCHED_RR:
+            return "SCHED_RR";
+#ifdef SCHED_BATCH
+        case SCHED_BATCH:
+            return "SCHED_BATCH";
+#endif
+#ifdef SCHED_IDLE
+        case SCHED_IDLE:
+            return "SCHED_IDLE";
+#endif
+        default:
+            return "unknown";
+    }
+}
+
+/* Print the CPUs in the mask as a list of ranges, like "0-3,6" */
+static void append_cpu_list(pa_strbuf *s, const cpu_set_t *mask) {
+    bool first = true;
+    int k = 0;
+
+    while (k < CPU_SETSIZE) {
+        int last;
+
+        if (!CPU_ISSET(k, mask)) {
+            k++;
+            continue;
+        }
+
+        for (last = k; last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, mask); last++)
+            ;
+
+        if (last > k)
+            pa_strbuf_printf(s, "%s%i-%i", first ? "" : ",", k, last);
+        else
+            pa_strbuf_printf(s, "%s%i", first ? "" : ",", k);
+
+        first = false;
+        k = last + 1;
+    }
+}
+#endif
+
+char *pa_thread_list_to_string(pa_core *c) {
+    pa_strbuf *s;
+#ifdef __linux__
+    pa_strbuf *threads;
+    unsigned n = 0;
+    DIR *d;
+    struct dirent *de;
+    char *t;
+#endif
+
+    pa_assert(c);
+
+    s = pa_strbuf_new();
+
+#ifdef __linux__
+    if (!(d = opendir("/proc/self/task"))) {
+        pa_strbuf_printf(s, "Failed to list threads: %s\n", pa_cstrerror(errno));
+        return pa_strbuf_to_string_free(s);
+    }
+
+    threads = pa_strbuf_new();
+
+    while ((de = readdir(d))) {
+        uint32_t tid;
+        struct sched_param param;
+        cpu_set_t mask;
+        char *fn, *name;
+        int policy;
+
+        if (pa_atou(de->d_name, &tid) < 0)
+            continue;
+
+        fn = pa_sprintf_malloc("/proc/self/task/%s/comm", de->d_name);
+        name = pa_read_line_from_file(fn);
+        pa_xfree(fn);
+
+        pa_strbuf_printf(threads, "    tid: %u\n\tname: <%s>\n", tid, pa_strnull(name));
+        pa_xfree(name);
+
+        if ((policy = sched_getscheduler((pid_t) tid)) >= 0 && sched_getparam((pid_t) tid, &param) >= 0) {
+#ifdef SCHED_RESET_ON_FORK
+            policy &= ~SCHED_RESET_ON_FORK;
+#endif
+            pa_strbuf_printf(threads, "\tscheduling: %s, priority %i\n", sched_policy_to_string(policy), param.sched_priority);
+        }
+
+        if (sched_getaffinity((pid_t) tid, sizeof(mask), &mask) >= 0) {
+            pa_strbuf_puts(threads, "\tcpu affinity: ");
+            append_cpu_list(threads, &mask);
+            pa_strbuf_puts(threads, "\n");
+        }
+
+        n++;
+    }
+
+    closedir(d);
+
+    t = pa_strbuf_to_string_free(threads);
+    pa_strbuf_printf(s, "%u thread(s).\n%s", n, t);
+    pa_xfree(t);
+#else
+    pa_strbuf_puts(s, "Listing threads is not supported on this platform.\n");
+#endif
+
+    return pa_strbuf_to_string_free(s);
+}
+
 char *pa_full_status_string(pa_core *c) {
     pa_strbuf *s;
     int i;
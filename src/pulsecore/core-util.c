@@ -3062,6 +3062,45 @@ unsigned pa_ncpus(void) {
     return ncpus <= 0 ? 1 : (unsigned) ncpus;
 }
 
+/* Arbitrary limit for syntax checks without a target array */
+#define MAX_CPU_NUMBER 4096
+
+int pa_parse_cpu_list(const char *s, bool *cpus, unsigned n) {
+    const char *state = NULL;
+    char *range;
+    int count = 0;
+
+    pa_assert(s);
+
+    if (!cpus)
+        n = MAX_CPU_NUMBER;
+
+    while ((range = pa_split(s, ",", &state))) {
+        uint32_t first, last;
+        char *dash;
+
+        if ((dash = strchr(range, '-')))
+            *(dash++) = 0;
+
+        if (pa_atou(range, &first) < 0 ||
+            (dash ? pa_atou(dash, &last) : pa_atou(range, &last)) < 0 ||
+            last < first || last >= n) {
+            pa_xfree(range);
+            return -1;
+        }
+
+        pa_xfree(range);
+
+        for (; first <= last; first++) {
+            if (cpus)
+                cpus[first] = true;
+            count++;
+        }
+    }
+
+    return count > 0 ? count : -1;
+}
+
 char *pa_replace(const char*s, const char*a, const char *b) {
     pa_strbuf *sb;
     size_t an;
@@ -3566,6 +3605,105 @@ bool pa_running_in_vm(void) {
     return false;
 }
 
+bool pa_running_on_battery(void) {
+#ifdef __linux__
+    DIR *d;
+    struct dirent *de;
+    bool on_battery = false;
+
+    if (!(d = opendir("/sys/class/power_supply")))
+        return false;
+
+    while ((de = readdir(d))) {
+        char *fn, *type, *value;
+
+        if (de->d_name[0] == '.')
+            continue;
+
+        fn = pa_sprintf_malloc("/sys/class/power_supply/%s/type", de->d_name);
+        type = pa_read_line_from_file(fn);
+        pa_xfree(fn);
+
+        if (!type)
+            continue;
+
+        if (pa_streq(type, "Mains")) {
+            fn = pa_sprintf_malloc("/sys/class/power_supply/%s/online", de->d_name);
+            value = pa_read_line_from_file(fn);
+            pa_xfree(fn);
+
+            /* Being plugged in always wins over any battery state */
+            if (value && pa_streq(value, "1")) {
+                pa_xfree(value);
+                pa_xfree(type);
+                on_battery = false;
+                break;
+            }
+
+            pa_xfree(value);
+        } else if (pa_streq(type, "Battery")) {
+            fn = pa_sprintf_malloc("/sys/class/power_supply/%s/status", de->d_name);
+            value = pa_read_line_from_file(fn);
+            pa_xfree(fn);
+
+            if (value && pa_streq(value, "Discharging"))
+                on_battery = true;
+
+            pa_xfree(value);
+        }
+
+        pa_xfree(type);
+    }
+
+    closedir(d);
+    return on_battery;
+#else
+    return false;
+#endif
+}
+
+int pa_get_cpu_pressure(double *ret_percent) {
+#ifdef __linux__
+    char *ln, *p;
+    double v;
+
+    pa_assert(ret_percent);
+
+    /* Prefer the pressure stall information of the kernel, it tells us
+     * directly how much runnable tasks had to wait for a CPU. */
+    if ((ln = pa_read_line_from_file("/proc/pressure/cpu"))) {
+        if ((p = strstr(ln, "avg10="))) {
+            p += 6;
+            p[strcspn(p, " ")] = 0;
+
+            if (pa_atod(p, &v) >= 0) {
+                pa_xfree(ln);
+                *ret_percent = v;
+                return 0;
+            }
+        }
+
+        pa_xfree(ln);
+    }
+
+    /* Fall back to the one-minute load average relative to the number
+     * of CPUs */
+    if ((ln = pa_read_line_from_file("/proc/loadavg"))) {
+        ln[strcspn(ln, " ")] = 0;
+
+        if (pa_atod(ln, &v) >= 0) {
+            pa_xfree(ln);
+            *ret_percent = PA_CLAMP_UNLIKELY(v * 100.0 / pa_ncpus(), 0.0, 100.0);
+            return 0;
+        }
+
+        pa_xfree(ln);
+    }
+#endif
+
+    return -1;
+}
+
 size_t pa_page_size(void) {
 #if defined(PAGE_SIZE)
     return PAGE_SIZE;
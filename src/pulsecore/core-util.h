@@ -251,6 +251,12 @@ void pa_reduce(unsigned *num, unsigned *den);
 
 unsigned pa_ncpus(void);
 
+/* Parses a list of CPU numbers and ranges like "0,2-5". If cpus is
+ * not NULL, the listed CPUs are set to true in it, which has room for
+ * n entries. Returns the number of listed CPUs, or negative on a
+ * syntax error or when a CPU doesn't fit into cpus. */
+int pa_parse_cpu_list(const char *s, bool *cpus, unsigned n);
+
 /* Replaces all occurrences of `a' in `s' with `b'. The caller has to free the
  * returned string. All parameters must be non-NULL and additionally `a' must
  * not be a zero-length string.
@@ -300,6 +306,13 @@ void pa_nullify_stdfds(void);
 char *pa_read_line_from_file(const char *fn);
 bool pa_running_in_vm(void);
 
+/* Returns true if the system is known to run from a discharging battery */
+bool pa_running_on_battery(void);
+
+/* Returns the share of time (in percent) runnable tasks recently had to
+ * wait for a CPU, or a negative value if that's not known */
+int pa_get_cpu_pressure(double *ret_percent);
+
 #ifdef OS_IS_WIN32
 char *pa_win32_get_toplevel(HANDLE handle);
 #endif
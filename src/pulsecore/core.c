@@ -25,19 +25,23 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <signal.h>
+#include <errno.h>
 
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
+#include <pulse/util.h>
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/module.h>
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/core-error.h>
 #include <pulsecore/core-scache.h>
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/random.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/thread.h>
 
 #include "core.h"
 
@@ -146,6 +150,8 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
     c->disable_lfe_remixing = true;
     c->lfe_crossover_freq = 0;
     c->deferred_volume = true;
+    c->incremental_rewind = false;
+    c->resample_quality_governor = false;
     c->resample_method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 1;
 
     for (j = 0; j < PA_CORE_HOOK_MAX; j++)
@@ -216,6 +222,7 @@ static void core_free(pa_object *o) {
     pa_assert(!c->default_sink);
     pa_xfree(c->configured_default_source);
     pa_xfree(c->configured_default_sink);
+    pa_xfree(c->realtime_cpu_affinity);
 
     pa_silence_cache_done(&c->silence_cache);
     pa_mempool_unref(c->mempool);
@@ -226,6 +233,32 @@ static void core_free(pa_object *o) {
     pa_xfree(c);
 }
 
+void pa_io_thread_config_done(pa_io_thread_config *cfg) {
+    pa_assert(cfg);
+
+    pa_xfree(cfg->cpu_affinity);
+    cfg->cpu_affinity = NULL;
+}
+
+void pa_core_setup_io_thread(pa_core *c, const pa_io_thread_config *cfg) {
+    const char *cpus;
+
+    pa_assert(c);
+
+    if (c->realtime_scheduling)
+        pa_thread_make_realtime(PA_MAX(c->realtime_priority + (cfg ? cfg->priority_offset : 0), 1));
+
+    cpus = cfg && cfg->cpu_affinity ? cfg->cpu_affinity : c->realtime_cpu_affinity;
+
+    if (!cpus)
+        return;
+
+    if (pa_thread_set_cpu_affinity(cpus) < 0)
+        pa_log_warn("Failed to restrict I/O thread to CPUs %s: %s", cpus, pa_cstrerror(errno));
+    else
+        pa_log_info("Restricted I/O thread to CPUs %s.", cpus);
+}
+
 void pa_core_set_configured_default_sink(pa_core *core, const char *sink) {
     char *old_sink;
 
@@ -218,14 +218,19 @@ struct pa_core {
     bool running_as_daemon:1;
     bool realtime_scheduling:1;
     bool avoid_resampling:1;
+    bool resample_quality_governor:1;
     bool disable_remixing:1;
     bool remixing_use_all_sink_channels:1;
     bool disable_lfe_remixing:1;
     bool deferred_volume:1;
+    bool incremental_rewind:1;
 
     pa_resample_method_t resample_method;
     int realtime_priority;
 
+    /* CPUs the I/O threads are restricted to, NULL for no restriction */
+    char *realtime_cpu_affinity;
+
     pa_server_type_t server_type;
     pa_cpu_info cpu_info;
 
@@ -243,6 +248,19 @@ enum {
 
 pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t shm_size);
 
+/* Per device overrides of how an I/O thread is scheduled */
+typedef struct pa_io_thread_config {
+    char *cpu_affinity;     /* NULL for the core's realtime_cpu_affinity */
+    int priority_offset;    /* Relative to the core's realtime_priority */
+} pa_io_thread_config;
+
+void pa_io_thread_config_done(pa_io_thread_config *cfg);
+
+/* Called from the I/O thread itself, before it starts processing. Enables
+ * realtime scheduling if configured and applies the CPU affinity. cfg
+ * may be NULL to use the core defaults. */
+void pa_core_setup_io_thread(pa_core *c, const pa_io_thread_config *cfg);
+
 void pa_core_set_configured_default_sink(pa_core *core, const char *sink);
 void pa_core_set_configured_default_source(pa_core *core, const char *source);
 
@@ -155,6 +155,11 @@ bool pa_cpu_init_arm(pa_cpu_arm_flag_t *flags) {
         pa_convert_func_init_neon(*flags);
         pa_mix_func_init_neon(*flags);
         pa_remap_func_init_neon(*flags);
+        pa_polyphase_func_init_neon(*flags);
+        pa_silence_func_init_neon(*flags);
+        pa_convolver_func_init_neon(*flags);
+        pa_crossover_func_init_neon(*flags);
+        pa_interleave_func_init_neon(*flags);
     }
 #endif
 
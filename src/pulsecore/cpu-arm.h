@@ -48,6 +48,11 @@ void pa_volume_func_init_arm(pa_cpu_arm_flag_t flags);
 void pa_convert_func_init_neon(pa_cpu_arm_flag_t flags);
 void pa_mix_func_init_neon(pa_cpu_arm_flag_t flags);
 void pa_remap_func_init_neon(pa_cpu_arm_flag_t flags);
+void pa_polyphase_func_init_neon(pa_cpu_arm_flag_t flags);
+void pa_silence_func_init_neon(pa_cpu_arm_flag_t flags);
+void pa_convolver_func_init_neon(pa_cpu_arm_flag_t flags);
+void pa_crossover_func_init_neon(pa_cpu_arm_flag_t flags);
+void pa_interleave_func_init_neon(pa_cpu_arm_flag_t flags);
 #endif
 
 #endif /* foocpuarmhfoo */
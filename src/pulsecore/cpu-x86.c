@@ -123,6 +123,11 @@ bool pa_cpu_init_x86(pa_cpu_x86_flag_t *flags) {
         pa_volume_func_init_sse(*flags);
         pa_remap_func_init_sse(*flags);
         pa_convert_func_init_sse(*flags);
+        pa_polyphase_func_init_sse(*flags);
+        pa_silence_func_init_sse(*flags);
+        pa_convolver_func_init_sse(*flags);
+        pa_crossover_func_init_sse(*flags);
+        pa_interleave_func_init_sse(*flags);
     }
 
     return true;
@@ -0,0 +1,962 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/mix.h>
+#include <pulsecore/sample-util.h>
+#include <pulsecore/shared.h>
+#include <pulsecore/sink-input.h>
+
+#include "filter-graph.h"
+
+#define N_BUFFERS 2
+
+struct pa_filter_graph {
+    pa_core *core;
+    pa_sink_input *input;
+
+    /* Once the sink input is linked, this is only changed from the I/O
+     * thread, while the main thread waits for it */
+    PA_LLIST_HEAD(pa_filter_stage, stages);
+    unsigned max_block_frames;
+
+    /* Reused for the data between the stages, only accessed from the
+     * I/O thread */
+    pa_memblock *buffers[N_BUFFERS];
+    unsigned next_buffer;
+};
+
+enum {
+    GRAPH_INPUT_MESSAGE_ADD_STAGE = PA_SINK_INPUT_MESSAGE_MAX,
+    GRAPH_INPUT_MESSAGE_REMOVE_STAGE,
+};
+
+struct stage_removal {
+    pa_filter_stage *stage;
+
+    /* The new converter of the stage before, the old one on return */
+    pa_resampler *convert;
+};
+
+static pa_hashmap *get_stages(pa_core *c, bool create) {
+    pa_hashmap *stages;
+
+    if (!(stages = pa_shared_get(c, "filter-stages")) && create) {
+        stages = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+        pa_assert_se(pa_shared_set(c, "filter-stages", stages) >= 0);
+    }
+
+    return stages;
+}
+
+/* Converts a length in the format of the graph's sink input to the
+ * format of a stage sink */
+static size_t to_stage_bytes(pa_filter_graph *g, pa_filter_stage *s, size_t nbytes) {
+    return nbytes / pa_frame_size(&g->input->sample_spec) * pa_frame_size(&s->sink->sample_spec);
+}
+
+static int converter_new(pa_filter_stage *s, const pa_sample_spec *ss, const pa_channel_map *map, pa_resampler **r) {
+    pa_core *c = s->sink->core;
+    pa_resample_method_t method;
+
+    *r = NULL;
+
+    if (pa_sample_spec_equal(&s->sample_spec, ss) && pa_channel_map_equal(&s->channel_map, map))
+        return 0;
+
+    method = s->resample_method == PA_RESAMPLER_INVALID ? c->resample_method : s->resample_method;
+
+    if (!(*r = pa_resampler_new(c->mempool,
+                                &s->sample_spec, &s->channel_map,
+                                ss, map,
+                                c->lfe_crossover_freq,
+                                method,
+                                (c->disable_remixing || !s->remix ? PA_RESAMPLER_NO_REMIX : 0) |
+                                (c->remixing_use_all_sink_channels ? 0 : PA_RESAMPLER_NO_FILL_SINK) |
+                                (c->disable_lfe_remixing ? PA_RESAMPLER_NO_LFE : 0)))) {
+        pa_log_warn("Unsupported conversion after filter stage %s.", s->sink->name);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Called from main or I/O thread context. Checks whether the converter
+ * of s does nothing but copy channels around. */
+static void setup_arrange(pa_filter_stage *s) {
+    pa_resampler *r = s->convert;
+
+    s->arrange_only = r &&
+        pa_resampler_input_sample_spec(r)->format == pa_resampler_output_sample_spec(r)->format &&
+        r->map_required && !r->lfe_filter &&
+        pa_setup_remap_arrange(&r->remap, s->arrange);
+}
+
+/* The converter that s needs if next follows it, next may be NULL for
+ * the end of the graph */
+static int converter_to(pa_filter_graph *g, pa_filter_stage *s, pa_filter_stage *next, pa_resampler **r) {
+    if (next)
+        return converter_new(s, &next->sink->sample_spec, &next->sink->channel_map, r);
+
+    return converter_new(s, &g->input->sample_spec, &g->input->channel_map, r);
+}
+
+static void update_max_block_frames(pa_filter_graph *g) {
+    pa_filter_stage *s;
+
+    g->max_block_frames = 0;
+
+    PA_LLIST_FOREACH(s, g->stages)
+        if (s->max_block_frames > 0 && (g->max_block_frames == 0 || s->max_block_frames < g->max_block_frames))
+            g->max_block_frames = s->max_block_frames;
+}
+
+/* Called from main context. Corks the sink input if nothing but
+ * suspended stages are left, changed is about to enter state. */
+static void update_cork(pa_filter_graph *g, pa_filter_stage *changed, pa_sink_state_t state) {
+    pa_filter_stage *s;
+    bool suspended = true;
+
+    if (!PA_SINK_INPUT_IS_LINKED(g->input->state))
+        return;
+
+    PA_LLIST_FOREACH(s, g->stages) {
+        pa_sink_state_t t = s == changed ? state : s->sink->state;
+
+        if (PA_SINK_IS_LINKED(t) && t != PA_SINK_SUSPENDED) {
+            suspended = false;
+            break;
+        }
+    }
+
+    pa_sink_input_cork(g->input, suspended);
+}
+
+/* Called from I/O thread context */
+int pa_filter_stage_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    pa_filter_stage *s = PA_SINK(o)->userdata;
+
+    switch (code) {
+
+        case PA_SINK_MESSAGE_GET_LATENCY: {
+            pa_sink_input *i = s->graph->input;
+
+            /* The sink is _put() before the sink input is, so let's
+             * make sure we don't access it in that time. Also, the
+             * sink input is first shut down, the sink second. */
+            if (!PA_SINK_IS_LINKED(s->sink->thread_info.state) ||
+                !PA_SINK_INPUT_IS_LINKED(i->thread_info.state)) {
+                *((int64_t*) data) = 0;
+                return 0;
+            }
+
+            *((int64_t*) data) =
+
+                /* Get the latency of the master sink */
+                pa_sink_get_latency_within_thread(i->sink, true) +
+
+                /* Add the latency internal to the sink input on top */
+                pa_bytes_to_usec(pa_memblockq_get_length(i->thread_info.render_memblockq), &i->sink->sample_spec);
+
+            return 0;
+        }
+    }
+
+    return pa_sink_process_msg(o, code, data, offset, chunk);
+}
+
+/* Called from main context */
+static int stage_sink_set_state_in_main_thread_cb(pa_sink *sink, pa_sink_state_t state, pa_suspend_cause_t suspend_cause) {
+    pa_filter_stage *s;
+
+    pa_sink_assert_ref(sink);
+    pa_assert_se(s = sink->userdata);
+
+    if (!PA_SINK_IS_LINKED(state))
+        return 0;
+
+    update_cork(s->graph, s, state);
+    return 0;
+}
+
+/* Called from the IO thread. */
+static int stage_sink_set_state_in_io_thread_cb(pa_sink *sink, pa_sink_state_t new_state, pa_suspend_cause_t new_suspend_cause) {
+    pa_filter_stage *s;
+
+    pa_assert(sink);
+    pa_assert_se(s = sink->userdata);
+
+    /* When set to running or idle for the first time, request a rewind
+     * of the master sink to make sure we are heard immediately */
+    if (PA_SINK_IS_OPENED(new_state) && sink->thread_info.state == PA_SINK_INIT) {
+        pa_log_debug("Requesting rewind due to state change.");
+        pa_sink_input_request_rewind(s->graph->input, 0, false, true, true);
+    }
+
+    return 0;
+}
+
+/* Called from I/O thread context */
+static void stage_sink_request_rewind_cb(pa_sink *sink) {
+    pa_filter_stage *s;
+    pa_sink_input *i;
+
+    pa_sink_assert_ref(sink);
+    pa_assert_se(s = sink->userdata);
+
+    i = s->graph->input;
+
+    if (!PA_SINK_IS_LINKED(sink->thread_info.state) ||
+        !PA_SINK_INPUT_IS_LINKED(i->thread_info.state))
+        return;
+
+    /* Nothing is buffered between the stages, the whole graph is
+     * rewound */
+    pa_sink_input_request_rewind(i,
+                                 sink->thread_info.rewind_nbytes / pa_frame_size(&sink->sample_spec) * pa_frame_size(&i->sample_spec),
+                                 true, false, false);
+}
+
+/* Called from I/O thread context */
+static void stage_sink_update_requested_latency_cb(pa_sink *sink) {
+    pa_filter_stage *s, *t;
+    pa_usec_t latency = (pa_usec_t) -1;
+
+    pa_sink_assert_ref(sink);
+    pa_assert_se(s = sink->userdata);
+
+    if (!PA_SINK_IS_LINKED(sink->thread_info.state) ||
+        !PA_SINK_INPUT_IS_LINKED(s->graph->input->thread_info.state))
+        return;
+
+    /* The stages share the sink input, which has to satisfy the
+     * strictest of them */
+    PA_LLIST_FOREACH(t, s->graph->stages)
+        if (PA_SINK_IS_LINKED(t->sink->thread_info.state))
+            latency = PA_MIN(latency, pa_sink_get_requested_latency_within_thread(t->sink));
+
+    pa_sink_input_set_requested_latency_within_thread(s->graph->input, latency);
+}
+
+/* Called from I/O thread context */
+static pa_memblock *get_buffer(pa_filter_graph *g, size_t length) {
+    unsigned k;
+
+    for (k = 0; k < N_BUFFERS; k++) {
+        pa_memblock *b = g->buffers[k];
+
+        if (b && pa_memblock_ref_is_one(b) && pa_memblock_get_length(b) >= length)
+            return pa_memblock_ref(b);
+    }
+
+    /* All of them are too small or still in use, for example queued up
+     * for playback. Replace one, whoever uses it keeps it alive. */
+    k = g->next_buffer++ % N_BUFFERS;
+
+    if (g->buffers[k])
+        pa_memblock_unref(g->buffers[k]);
+
+    g->buffers[k] = pa_memblock_new(g->core->mempool, length);
+
+    return pa_memblock_ref(g->buffers[k]);
+}
+
+/* Called from I/O thread context. Mixes what is played to the stage
+ * sink directly into what the stages before it produced. */
+static void stage_mix(pa_filter_graph *g, pa_filter_stage *s, pa_memchunk *chunk) {
+    pa_sink *sink = s->sink;
+    pa_mix_info info[2];
+    pa_cvolume volume;
+    pa_memchunk result;
+    void *dst;
+
+    if (!PA_SINK_IS_LINKED(sink->thread_info.state))
+        return;
+
+    /* The data from the stages before would have been an input of this
+     * sink, so it gets the volume of the sink */
+    if (sink->thread_info.soft_muted)
+        pa_cvolume_mute(&volume, sink->sample_spec.channels);
+    else
+        volume = sink->thread_info.soft_volume;
+
+    if (pa_hashmap_isempty(sink->thread_info.inputs)) {
+
+        if (sink->thread_info.soft_muted) {
+            pa_memchunk_make_writable(chunk, 0);
+            pa_silence_memchunk(chunk, &sink->sample_spec);
+        } else if (!pa_cvolume_is_norm(&volume)) {
+            pa_memchunk_make_writable(chunk, 0);
+            pa_volume_memchunk(chunk, &sink->sample_spec, &volume);
+        }
+
+        return;
+    }
+
+    info[0].chunk = *chunk;
+    info[0].volume = volume;
+    info[0].userdata = NULL;
+
+    pa_sink_render_full(sink, chunk->length, &info[1].chunk);
+    pa_cvolume_reset(&info[1].volume, sink->sample_spec.channels);
+    info[1].userdata = NULL;
+
+    result.index = 0;
+    result.length = chunk->length;
+    result.memblock = get_buffer(g, result.length);
+
+    pa_cvolume_reset(&volume, sink->sample_spec.channels);
+
+    dst = pa_memblock_acquire(result.memblock);
+    pa_mix(info, 2, dst, result.length, &sink->sample_spec, &volume, false);
+    pa_memblock_release(result.memblock);
+
+    pa_memblock_unref(info[1].chunk.memblock);
+    pa_memblock_unref(chunk->memblock);
+
+    *chunk = result;
+}
+
+/* Called from I/O thread context */
+static void stage_process(pa_filter_graph *g, pa_filter_stage *s, pa_memchunk *chunk, unsigned n) {
+    pa_memchunk result;
+    const void *src;
+    void *dst;
+
+    result.index = 0;
+    result.length = n * pa_frame_size(&s->sample_spec);
+    result.memblock = get_buffer(g, result.length);
+
+    src = pa_memblock_acquire_chunk(chunk);
+    dst = pa_memblock_acquire(result.memblock);
+
+    s->process(s, src, dst, n);
+
+    pa_memblock_release(result.memblock);
+    pa_memblock_release(chunk->memblock);
+
+    pa_memblock_unref(chunk->memblock);
+
+    *chunk = result;
+}
+
+/* Called from I/O thread context */
+static void stage_convert(pa_filter_stage *s, pa_memchunk *chunk) {
+    pa_memchunk result;
+
+    /* The rate doesn't change, so everything comes out right away */
+    pa_resampler_run(s->convert, chunk, &result);
+    pa_assert(result.memblock);
+
+    pa_memblock_unref(chunk->memblock);
+
+    *chunk = result;
+}
+
+/* Called from I/O thread context. A block that was made for the graph
+ * and isn't passed on yet can be changed in place. */
+static bool chunk_is_private(pa_filter_graph *g, pa_memchunk *chunk) {
+    unsigned k;
+
+    for (k = 0; k < N_BUFFERS; k++)
+        if (chunk->memblock == g->buffers[k])
+            return true;
+
+    return pa_memblock_ref_is_one(chunk->memblock) && !pa_memblock_is_read_only(chunk->memblock);
+}
+
+#define ARRANGE(type)                                                   \
+    do {                                                                \
+        const type *sp = src;                                           \
+        type *dp = dst;                                                 \
+        type frame[PA_CHANNELS_MAX];                                    \
+                                                                        \
+        for (j = 0; j < n; j++, sp += i_channels, dp += o_channels) {   \
+            memcpy(frame, sp, i_channels * sizeof(type));               \
+                                                                        \
+            for (c = 0; c < o_channels; c++)                            \
+                dp[c] = arrange[c] >= 0 ? frame[arrange[c]] : 0;        \
+        }                                                               \
+    } while (0)
+
+/* Called from I/O thread context. Does what the converter of s would
+ * do, in place if the frames don't grow. Every frame is read before it
+ * is written, and no frame is written before it was read. */
+static void stage_arrange(pa_filter_graph *g, pa_filter_stage *s, pa_memchunk *chunk, unsigned n) {
+    const pa_sample_spec *o = pa_resampler_output_sample_spec(s->convert);
+    const int8_t *arrange = s->arrange;
+    unsigned i_channels = s->sample_spec.channels, o_channels = o->channels, j, c;
+    size_t ss = pa_sample_size(o);
+    pa_memchunk result;
+    const void *src;
+    void *dst;
+
+    src = pa_memblock_acquire_chunk(chunk);
+
+    if (o_channels <= i_channels && chunk_is_private(g, chunk)) {
+        result = *chunk;
+        dst = (void*) src;
+    } else {
+        result.index = 0;
+        result.memblock = get_buffer(g, n * ss * o_channels);
+        dst = pa_memblock_acquire(result.memblock);
+    }
+
+    result.length = n * ss * o_channels;
+
+    /* The silence of all formats of these sizes is zero */
+    if (ss == 4)
+        ARRANGE(uint32_t);
+    else if (ss == 2)
+        ARRANGE(uint16_t);
+    else {
+        const uint8_t *sp = src;
+        uint8_t *dp = dst;
+        uint8_t frame[PA_CHANNELS_MAX * 3];
+
+        for (j = 0; j < n; j++, sp += i_channels * ss, dp += o_channels * ss) {
+            memcpy(frame, sp, i_channels * ss);
+
+            for (c = 0; c < o_channels; c++)
+                if (arrange[c] >= 0)
+                    memcpy(dp + c * ss, frame + arrange[c] * ss, ss);
+                else
+                    pa_silence_memory(dp + c * ss, ss, o);
+        }
+    }
+
+    if (result.memblock != chunk->memblock) {
+        pa_memblock_release(result.memblock);
+        pa_memblock_release(chunk->memblock);
+        pa_memblock_unref(chunk->memblock);
+    } else
+        pa_memblock_release(chunk->memblock);
+
+    *chunk = result;
+}
+
+/* Called from I/O thread context */
+static int graph_input_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    pa_filter_graph *g;
+    pa_filter_stage *s, *top;
+    size_t fs;
+    unsigned n;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert(chunk);
+    pa_assert_se(g = i->userdata);
+
+    /* A stage that is just joining isn't linked yet */
+    for (top = g->stages; top; top = top->next)
+        if (PA_SINK_IS_LINKED(top->sink->thread_info.state))
+            break;
+
+    if (!top)
+        return -1;
+
+    /* Hmm, process any rewind request that might be queued up */
+    for (s = top; s; s = s->next)
+        if (PA_SINK_IS_LINKED(s->sink->thread_info.state))
+            pa_sink_process_rewind(s->sink, 0);
+
+    n = (unsigned) (nbytes / pa_frame_size(&i->sample_spec));
+    if (g->max_block_frames > 0)
+        n = PA_MIN(n, g->max_block_frames);
+    n = PA_MAX(n, 1U);
+
+    fs = pa_frame_size(&top->sink->sample_spec);
+    pa_sink_render(top->sink, n * fs, chunk);
+
+    n = (unsigned) (chunk->length / fs);
+    pa_assert(n > 0);
+
+    for (s = top; s; s = s->next) {
+        if (s != top)
+            stage_mix(g, s, chunk);
+
+        if (s->process)
+            stage_process(g, s, chunk, n);
+
+        if (s->arrange_only)
+            stage_arrange(g, s, chunk, n);
+        else if (s->convert)
+            stage_convert(s, chunk);
+    }
+
+    return 0;
+}
+
+/* Called from I/O thread context */
+static void graph_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
+    pa_filter_graph *g;
+    pa_filter_stage *s;
+    size_t n;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert_se(g = i->userdata);
+
+    n = nbytes / pa_frame_size(&i->sample_spec);
+
+    /* Nothing is buffered between the stages, so every stage sink has
+     * to render all of it again */
+    PA_LLIST_FOREACH(s, g->stages) {
+        if (!PA_SINK_IS_LINKED(s->sink->thread_info.state))
+            continue;
+
+        pa_sink_process_rewind(s->sink, to_stage_bytes(g, s, nbytes));
+
+        if (n > 0 && s->rewind)
+            s->rewind(s, n);
+    }
+}
+
+/* Called from I/O thread context */
+static void graph_input_update_max_rewind_cb(pa_sink_input *i, size_t nbytes) {
+    pa_filter_graph *g;
+    pa_filter_stage *s;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert_se(g = i->userdata);
+
+    PA_LLIST_FOREACH(s, g->stages) {
+        /* FIXME: Too small max_rewind:
+         * https://bugs.freedesktop.org/show_bug.cgi?id=53709 */
+        pa_sink_set_max_rewind_within_thread(s->sink, to_stage_bytes(g, s, nbytes));
+
+        if (s->update_max_rewind)
+            s->update_max_rewind(s, nbytes / pa_frame_size(&i->sample_spec));
+    }
+}
+
+/* Called from I/O thread context */
+static void graph_input_update_max_request_cb(pa_sink_input *i, size_t nbytes) {
+    pa_filter_graph *g;
+    pa_filter_stage *s;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert_se(g = i->userdata);
+
+    PA_LLIST_FOREACH(s, g->stages)
+        pa_sink_set_max_request_within_thread(s->sink, to_stage_bytes(g, s, nbytes));
+}
+
+/* Called from I/O thread context */
+static void graph_input_update_sink_latency_range_cb(pa_sink_input *i) {
+    pa_filter_graph *g;
+    pa_filter_stage *s;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert_se(g = i->userdata);
+
+    PA_LLIST_FOREACH(s, g->stages)
+        pa_sink_set_latency_range_within_thread(s->sink, i->sink->thread_info.min_latency, i->sink->thread_info.max_latency);
+}
+
+/* Called from I/O thread context */
+static void graph_input_update_sink_fixed_latency_cb(pa_sink_input *i) {
+    pa_filter_graph *g;
+    pa_filter_stage *s;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert_se(g = i->userdata);
+
+    PA_LLIST_FOREACH(s, g->stages)
+        pa_sink_set_fixed_latency_within_thread(s->sink, i->sink->thread_info.fixed_latency);
+}
+
+/* Called from I/O thread context */
+static void stage_detach(pa_filter_stage *s) {
+    if (PA_SINK_IS_LINKED(s->sink->thread_info.state))
+        pa_sink_detach_within_thread(s->sink);
+
+    pa_sink_set_rtpoll(s->sink, NULL);
+}
+
+/* Called from I/O thread context */
+static void stage_attach(pa_filter_graph *g, pa_filter_stage *s) {
+    pa_sink_input *i = g->input;
+
+    pa_sink_set_rtpoll(s->sink, i->sink->thread_info.rtpoll);
+    pa_sink_set_latency_range_within_thread(s->sink, i->sink->thread_info.min_latency, i->sink->thread_info.max_latency);
+    pa_sink_set_fixed_latency_within_thread(s->sink, i->sink->thread_info.fixed_latency);
+    pa_sink_set_max_request_within_thread(s->sink, to_stage_bytes(g, s, pa_sink_input_get_max_request(i)));
+
+    /* FIXME: Too small max_rewind:
+     * https://bugs.freedesktop.org/show_bug.cgi?id=53709 */
+    pa_sink_set_max_rewind_within_thread(s->sink, to_stage_bytes(g, s, pa_sink_input_get_max_rewind(i)));
+
+    if (s->update_max_rewind)
+        s->update_max_rewind(s, pa_sink_input_get_max_rewind(i) / pa_frame_size(&i->sample_spec));
+
+    if (PA_SINK_IS_LINKED(s->sink->thread_info.state))
+        pa_sink_attach_within_thread(s->sink);
+}
+
+/* Called from I/O thread context */
+static void graph_input_detach_cb(pa_sink_input *i) {
+    pa_filter_graph *g;
+    pa_filter_stage *s;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert_se(g = i->userdata);
+
+    PA_LLIST_FOREACH(s, g->stages)
+        stage_detach(s);
+}
+
+/* Called from I/O thread context */
+static void graph_input_attach_cb(pa_sink_input *i) {
+    pa_filter_graph *g;
+    pa_filter_stage *s;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert_se(g = i->userdata);
+
+    PA_LLIST_FOREACH(s, g->stages)
+        stage_attach(g, s);
+}
+
+/* Called from main context */
+static void graph_input_kill_cb(pa_sink_input *i) {
+    pa_filter_graph *g;
+    pa_filter_stage *s;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert_se(g = i->userdata);
+
+    /* The order here matters! We first kill the sinks so that streams
+     * can properly be moved away while the sink input is still connected
+     * to the master. The stages are freed when their modules are
+     * unloaded. */
+    pa_sink_input_cork(i, true);
+
+    PA_LLIST_FOREACH(s, g->stages)
+        pa_sink_unlink(s->sink);
+
+    pa_sink_input_unlink(i);
+
+    PA_LLIST_FOREACH(s, g->stages)
+        pa_module_unload_request(s->module, true);
+}
+
+/* Called from main context */
+static void graph_input_moving_cb(pa_sink_input *i, pa_sink *dest) {
+    pa_filter_graph *g;
+    pa_filter_stage *s;
+
+    pa_sink_input_assert_ref(i);
+    pa_assert_se(g = i->userdata);
+
+    PA_LLIST_FOREACH(s, g->stages) {
+        if (dest) {
+            pa_sink_set_asyncmsgq(s->sink, dest->asyncmsgq);
+            pa_sink_update_flags(s->sink, PA_SINK_LATENCY|PA_SINK_DYNAMIC_LATENCY, dest->flags);
+        } else
+            pa_sink_set_asyncmsgq(s->sink, NULL);
+
+        if (s->moving)
+            s->moving(s, dest);
+    }
+}
+
+/* Called from main or I/O thread context */
+static void remove_stage(pa_filter_graph *g, struct stage_removal *r) {
+    pa_filter_stage *s = r->stage;
+    pa_resampler *old = NULL;
+
+    if (s->prev) {
+        old = s->prev->convert;
+        s->prev->convert = r->convert;
+        setup_arrange(s->prev);
+    }
+
+    PA_LLIST_REMOVE(pa_filter_stage, g->stages, s);
+    update_max_block_frames(g);
+
+    r->convert = old;
+}
+
+/* Called from I/O thread context */
+static int graph_input_process_msg_cb(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    pa_filter_graph *g = PA_SINK_INPUT(o)->userdata;
+
+    switch (code) {
+
+        case GRAPH_INPUT_MESSAGE_ADD_STAGE: {
+            pa_filter_stage *s = data;
+
+            PA_LLIST_PREPEND(pa_filter_stage, g->stages, s);
+            update_max_block_frames(g);
+            stage_attach(g, s);
+
+            return 0;
+        }
+
+        case GRAPH_INPUT_MESSAGE_REMOVE_STAGE: {
+            struct stage_removal *r = data;
+
+            stage_detach(r->stage);
+            remove_stage(g, r);
+
+            return 0;
+        }
+    }
+
+    return pa_sink_input_process_msg(o, code, data, offset, chunk);
+}
+
+static pa_filter_graph *graph_new(pa_filter_stage *s) {
+    pa_filter_graph *g;
+    pa_sink_input_new_data data;
+    pa_sample_spec ss;
+    pa_channel_map map;
+
+    /* If the stage only rearranges its channels for the master, the
+     * graph does that itself and hands the master data it can take as
+     * is, instead of having the master's resampler copy it */
+    ss = s->sample_spec;
+    ss.channels = s->master->channel_map.channels;
+
+    if (converter_new(s, &ss, &s->master->channel_map, &s->convert) >= 0)
+        setup_arrange(s);
+
+    if (s->arrange_only)
+        map = s->master->channel_map;
+    else {
+        if (s->convert) {
+            pa_resampler_free(s->convert);
+            s->convert = NULL;
+        }
+
+        ss = s->sample_spec;
+        map = s->channel_map;
+    }
+
+    g = pa_xnew0(pa_filter_graph, 1);
+    g->core = s->sink->core;
+
+    /* The sink input belongs to the graph, which outlives any single
+     * module of it, so it isn't associated with one */
+    pa_sink_input_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_input_new_data_set_sink(&data, s->master, false, true);
+    pa_proplist_setf(data.proplist, PA_PROP_MEDIA_NAME, "Filter Graph Stream from %s", pa_proplist_gets(s->sink->proplist, PA_PROP_DEVICE_DESCRIPTION));
+    pa_proplist_sets(data.proplist, PA_PROP_MEDIA_ROLE, "filter");
+    pa_sink_input_new_data_set_sample_spec(&data, &ss);
+    pa_sink_input_new_data_set_channel_map(&data, &map);
+    data.flags = (s->remix ? 0 : PA_SINK_INPUT_NO_REMIX) | PA_SINK_INPUT_START_CORKED;
+    data.resample_method = s->resample_method;
+
+    pa_sink_input_new(&g->input, g->core, &data);
+    pa_sink_input_new_data_done(&data);
+
+    if (!g->input) {
+        pa_xfree(g);
+        return NULL;
+    }
+
+    g->input->parent.process_msg = graph_input_process_msg_cb;
+    g->input->pop = graph_input_pop_cb;
+    g->input->process_rewind = graph_input_process_rewind_cb;
+    g->input->update_max_rewind = graph_input_update_max_rewind_cb;
+    g->input->update_max_request = graph_input_update_max_request_cb;
+    g->input->update_sink_latency_range = graph_input_update_sink_latency_range_cb;
+    g->input->update_sink_fixed_latency = graph_input_update_sink_fixed_latency_cb;
+    g->input->kill = graph_input_kill_cb;
+    g->input->attach = graph_input_attach_cb;
+    g->input->detach = graph_input_detach_cb;
+    g->input->moving = graph_input_moving_cb;
+    g->input->userdata = g;
+
+    return g;
+}
+
+static void graph_free(pa_filter_graph *g) {
+    unsigned k;
+
+    pa_assert(!g->stages);
+
+    if (PA_SINK_INPUT_IS_LINKED(g->input->state)) {
+        pa_sink_input_cork(g->input, true);
+        pa_sink_input_unlink(g->input);
+    }
+
+    pa_sink_input_unref(g->input);
+
+    for (k = 0; k < N_BUFFERS; k++)
+        if (g->buffers[k])
+            pa_memblock_unref(g->buffers[k]);
+
+    pa_xfree(g);
+}
+
+pa_filter_stage *pa_filter_stage_new(pa_module *m, pa_sink *master, pa_sink_new_data *data) {
+    pa_filter_stage *s;
+
+    pa_assert(m);
+    pa_assert(master);
+    pa_assert(data);
+
+    s = pa_xnew0(pa_filter_stage, 1);
+    s->module = m;
+    s->master = master;
+
+    if (!(s->sink = pa_sink_new(m->core, data, master->flags & (PA_SINK_LATENCY|PA_SINK_DYNAMIC_LATENCY)))) {
+        pa_xfree(s);
+        return NULL;
+    }
+
+    s->sink->parent.process_msg = pa_filter_stage_process_msg;
+    s->sink->set_state_in_main_thread = stage_sink_set_state_in_main_thread_cb;
+    s->sink->set_state_in_io_thread = stage_sink_set_state_in_io_thread_cb;
+    s->sink->update_requested_latency = stage_sink_update_requested_latency_cb;
+    s->sink->request_rewind = stage_sink_request_rewind_cb;
+    s->sink->userdata = s;
+
+    s->sample_spec = s->sink->sample_spec;
+    s->channel_map = s->sink->channel_map;
+    s->resample_method = PA_RESAMPLER_INVALID;
+    s->remix = true;
+
+    pa_assert_se(pa_hashmap_put(get_stages(m->core, true), s->sink, s) >= 0);
+
+    return s;
+}
+
+/* Returns the graph s can join, if any */
+static pa_filter_graph *find_graph(pa_filter_stage *s) {
+    pa_hashmap *stages;
+    pa_filter_stage *top;
+    pa_filter_graph *g;
+
+    if (!(stages = get_stages(s->sink->core, false)) || !(top = pa_hashmap_get(stages, s->master)))
+        return NULL;
+
+    /* Only the topmost stage can take another stage on top of it,
+     * anything else branches off */
+    if (!(g = top->graph) || g->stages != top || !PA_SINK_INPUT_IS_LINKED(g->input->state))
+        return NULL;
+
+    if (s->sink->sample_spec.rate != g->input->sample_spec.rate)
+        return NULL;
+
+    return g;
+}
+
+int pa_filter_stage_put(pa_filter_stage *s) {
+    pa_filter_graph *g;
+
+    pa_assert(s);
+    pa_assert(!s->graph);
+    pa_assert(s->sample_spec.rate == s->sink->sample_spec.rate);
+    pa_assert(s->process || pa_sample_spec_equal(&s->sample_spec, &s->sink->sample_spec));
+
+    if ((g = find_graph(s)) && converter_to(g, s, g->stages, &s->convert) >= 0) {
+        setup_arrange(s);
+
+        s->graph = g;
+        s->sink->input_to_master = g->input;
+        pa_sink_set_asyncmsgq(s->sink, g->input->sink->asyncmsgq);
+
+        pa_assert_se(pa_asyncmsgq_send(g->input->sink->asyncmsgq, PA_MSGOBJECT(g->input), GRAPH_INPUT_MESSAGE_ADD_STAGE, s, 0, NULL) == 0);
+
+        pa_sink_put(s->sink);
+        update_cork(g, NULL, PA_SINK_INIT);
+
+        pa_log_info("Filter sink %s joined the filter graph on %s.", s->sink->name, g->input->sink->name);
+        return 0;
+    }
+
+    if (!(g = graph_new(s)))
+        return -1;
+
+    s->graph = g;
+    s->sink->input_to_master = g->input;
+    pa_sink_set_asyncmsgq(s->sink, g->input->sink->asyncmsgq);
+    PA_LLIST_PREPEND(pa_filter_stage, g->stages, s);
+    update_max_block_frames(g);
+
+    /* The order here is important. The input must be put first,
+     * otherwise streams might attach to the sink before the sink
+     * input is attached to the master. */
+    pa_sink_input_put(g->input);
+    pa_sink_put(s->sink);
+    update_cork(g, NULL, PA_SINK_INIT);
+
+    pa_log_info("Filter sink %s started a filter graph on %s.", s->sink->name, g->input->sink->name);
+    return 0;
+}
+
+void pa_filter_stage_free(pa_filter_stage *s) {
+    pa_filter_graph *g;
+    pa_hashmap *stages;
+
+    pa_assert(s);
+
+    /* Streams are moved away while the graph still plays */
+    pa_sink_unlink(s->sink);
+
+    if ((g = s->graph)) {
+        struct stage_removal r;
+
+        r.stage = s;
+        r.convert = NULL;
+
+        /* Connect the stages around s */
+        if (s->prev && converter_to(g, s->prev, s->next, &r.convert) < 0) {
+            pa_log("Failed to connect the filter stages around %s, unloading them.", s->sink->name);
+            pa_sink_input_kill(g->input);
+        }
+
+        if (PA_SINK_INPUT_IS_LINKED(g->input->state))
+            pa_assert_se(pa_asyncmsgq_send(g->input->sink->asyncmsgq, PA_MSGOBJECT(g->input), GRAPH_INPUT_MESSAGE_REMOVE_STAGE, &r, 0, NULL) == 0);
+        else
+            remove_stage(g, &r);
+
+        if (r.convert)
+            pa_resampler_free(r.convert);
+
+        if (g->stages)
+            update_cork(g, NULL, PA_SINK_INIT);
+        else
+            graph_free(g);
+    }
+
+    if ((stages = get_stages(s->sink->core, false))) {
+        pa_hashmap_remove(stages, s->sink);
+
+        if (pa_hashmap_isempty(stages)) {
+            pa_assert_se(pa_shared_remove(s->sink->core, "filter-stages") >= 0);
+            pa_hashmap_free(stages);
+        }
+    }
+
+    if (s->convert)
+        pa_resampler_free(s->convert);
+
+    pa_sink_unref(s->sink);
+    pa_xfree(s);
+}
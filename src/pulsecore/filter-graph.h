@@ -0,0 +1,128 @@
+#ifndef foopulsefiltergraphhfoo
+#define foopulsefiltergraphhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <pulse/sample.h>
+#include <pulse/channelmap.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/module.h>
+#include <pulsecore/resampler.h>
+#include <pulsecore/sink.h>
+
+/* Filter sinks that are stacked on top of each other, say a LADSPA
+ * sink on an equalizer on a remapping sink, each need a sink input on
+ * the sink below, with its own render queue, rewind handling and format
+ * conversion. A filter graph runs such a chain as stages of a single
+ * sink input on the real master instead: the topmost sink is rendered,
+ * its data is handed from stage to stage in reused buffers and only
+ * converted where the next stage takes a different format.
+ *
+ * Every stage still has a sink of its own, so streams can be played to
+ * any of them. A stage sink applies its volume in software, like a
+ * filter sink that doesn't share the volume of its master.
+ *
+ * A stage whose master is the topmost stage of a graph joins that
+ * graph, any other stage starts a new graph on its master. All stages
+ * of a graph run at the same rate.
+ *
+ * Conversions that only rearrange channels, as for a remapping stage,
+ * are done on the block in place. If the stage that starts a graph only
+ * rearranges its channels for the master, the graph's sink input takes
+ * the channel map of the master, so its data is played as is. After a
+ * move to another master, that map is converted like any other. */
+
+typedef struct pa_filter_graph pa_filter_graph;
+typedef struct pa_filter_stage pa_filter_stage;
+
+/* Called from the I/O thread. Turns n_frames of input (in the format of
+ * the stage sink) into n_frames of output (in the output format of the
+ * stage). src and dst don't overlap. */
+typedef void (*pa_filter_stage_process_cb_t)(pa_filter_stage *s, const void *src, void *dst, unsigned n_frames);
+
+struct pa_filter_stage {
+    pa_filter_graph *graph;
+    pa_module *module;
+    pa_sink *sink;
+
+    /* The sink the stage was created on */
+    pa_sink *master;
+
+    /* The format the stage produces. Defaults to the format of the
+     * sink. If process is NULL, the data is passed on unchanged, so the
+     * sample spec must stay that of the sink, but the channel map may
+     * differ. */
+    pa_sample_spec sample_spec;
+    pa_channel_map channel_map;
+
+    /* Used to convert the output to what follows, if necessary */
+    pa_resample_method_t resample_method;
+    bool remix;
+
+    /* Upper limit for the frames processed at once, 0 for no limit */
+    unsigned max_block_frames;
+
+    /* Called from the I/O thread */
+    pa_filter_stage_process_cb_t process;
+
+    /* Called from the I/O thread. The graph was rewound by n_frames,
+     * the stage should bring back its state or reset it. */
+    void (*rewind)(pa_filter_stage *s, size_t n_frames);
+
+    /* Called from the I/O thread, the graph may be rewound by up to
+     * n_frames from now on */
+    void (*update_max_rewind)(pa_filter_stage *s, size_t n_frames);
+
+    /* Called from the main thread when the graph is moved to another
+     * master, dest is NULL while the move is in progress */
+    void (*moving)(pa_filter_stage *s, pa_sink *dest);
+
+    void *userdata;
+
+    /* Converts the output to the format of the next stage or of the
+     * graph's sink input, NULL if the formats are the same */
+    pa_resampler *convert;
+
+    /* If convert does nothing but copy channels around, the graph does
+     * that itself instead, in place where possible: channel c of what
+     * follows is channel arrange[c] of the output, or silence for -1 */
+    bool arrange_only;
+    int8_t arrange[PA_CHANNELS_MAX];
+
+    /* Topmost stage first */
+    PA_LLIST_FIELDS(pa_filter_stage);
+};
+
+/* Creates the stage and its sink, but doesn't link either of them. The
+ * flags of the sink are chosen here. */
+pa_filter_stage *pa_filter_stage_new(pa_module *m, pa_sink *master, pa_sink_new_data *data);
+
+/* Joins or starts a graph and puts the stage sink */
+int pa_filter_stage_put(pa_filter_stage *s);
+
+/* The process_msg() of stage sinks. Modules that handle messages of
+ * their own on the stage sink pass everything else on to this one. */
+int pa_filter_stage_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk);
+
+/* Takes the stage out of its graph and unlinks its sink. Any remaining
+ * stages are connected to each other. */
+void pa_filter_stage_free(pa_filter_stage *s);
+
+#endif
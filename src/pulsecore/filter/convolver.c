@@ -0,0 +1,593 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+
+#include "convolver.h"
+
+/* With a block size of B, every FFT partition is B taps long and is
+ * applied with a real FFT of 2B points, which is computed as a complex
+ * FFT of B points. Spectra have B + 1 bins; they are stored as their
+ * real parts followed by their imaginary parts, each padded to a
+ * multiple of 4 bins for the SIMD functions. */
+
+struct pa_convolver {
+    unsigned n_inputs, n_outputs;
+    unsigned block_size;
+
+    /* [output][input], whether there is a response from that input to
+     * that output */
+    bool *paths;
+
+    /* Taps of the responses, the ones applied in direct form, padded
+     * to a multiple of 4, and the number of FFT partitions that follow
+     * them */
+    unsigned taps;
+    unsigned head;
+    unsigned n_partitions;
+
+    /* Frames of the current block seen so far, and of the whole
+     * stream */
+    unsigned pos;
+    int64_t index;
+
+    /* [output][input][head], the taps in reverse order, preceded by
+     * zeros for the padding */
+    float *head_taps;
+
+    /* [input][2 * block_size], the previous block followed by the
+     * current one */
+    float *history;
+
+    /* [output][block_size], what the FFT partitions add to the
+     * current block */
+    float *tail;
+
+    /* Twiddle factors for the complex FFT and for the split into the
+     * real FFT, and the bit reversal permutation */
+    float *twiddle_re, *twiddle_im;
+    float *split_re, *split_im;
+    unsigned *bitrev;
+
+    /* The padded number of bins */
+    unsigned bins;
+
+    float *work_re, *work_im;
+    float *acc;
+    float *time;
+
+    /* Frequency domain delay line, [input][partition][2 * bins], and
+     * the slot of the latest input block */
+    float *fdl;
+    unsigned fdl_pos;
+
+    /* [output][input][partition][2 * bins] */
+    float *filter;
+
+    /* The last ring_filled input frames, for rewinding */
+    size_t max_rewind;
+    float *ring;
+    size_t ring_frames, ring_filled;
+};
+
+static float dot_c(const float *a, const float *b, unsigned n) {
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    unsigned i;
+
+    /* Four partial sums, added up in the same order as the SIMD
+     * versions do */
+    for (i = 0; i < n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i+1] * b[i+1];
+        s2 += a[i+2] * b[i+2];
+        s3 += a[i+3] * b[i+3];
+    }
+
+    return (s0 + s2) + (s1 + s3);
+}
+
+static void cmac_c(float *acc, const float *x, const float *h, unsigned bins) {
+    const float *x_im = x + bins, *h_im = h + bins;
+    float *acc_im = acc + bins;
+    unsigned k;
+
+    for (k = 0; k < bins; k++) {
+        acc[k] += x[k] * h[k] - x_im[k] * h_im[k];
+        acc_im[k] += x[k] * h_im[k] + x_im[k] * h[k];
+    }
+}
+
+static pa_convolver_dot_func_t dot_func = dot_c;
+static pa_convolver_cmac_func_t cmac_func = cmac_c;
+
+pa_convolver_dot_func_t pa_get_convolver_dot_func(void) {
+    return dot_func;
+}
+
+void pa_set_convolver_dot_func(pa_convolver_dot_func_t func) {
+    pa_assert(func);
+
+    dot_func = func;
+}
+
+pa_convolver_cmac_func_t pa_get_convolver_cmac_func(void) {
+    return cmac_func;
+}
+
+void pa_set_convolver_cmac_func(pa_convolver_cmac_func_t func) {
+    pa_assert(func);
+
+    cmac_func = func;
+}
+
+static void fft(pa_convolver *c, float *re, float *im, bool inverse) {
+    unsigned n = c->block_size, len, i, j;
+
+    for (i = 0; i < n; i++) {
+        j = c->bitrev[i];
+
+        if (i < j) {
+            float t;
+
+            t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    for (len = 2; len <= n; len <<= 1) {
+        unsigned half = len / 2, step = n / len;
+
+        for (i = 0; i < n; i += len)
+            for (j = 0; j < half; j++) {
+                unsigned a = i + j, b = a + half;
+                float wr, wi, tr, ti;
+
+                wr = c->twiddle_re[j * step];
+                wi = inverse ? -c->twiddle_im[j * step] : c->twiddle_im[j * step];
+
+                tr = re[b] * wr - im[b] * wi;
+                ti = re[b] * wi + im[b] * wr;
+
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+    }
+}
+
+/* Transforms the 2 * block_size real samples in x into twice their
+ * spectrum */
+static void real_forward(pa_convolver *c, const float *x, float *out) {
+    unsigned n = c->block_size, k;
+    float *out_im = out + c->bins;
+
+    for (k = 0; k < n; k++) {
+        c->work_re[k] = x[2 * k];
+        c->work_im[k] = x[2 * k + 1];
+    }
+
+    fft(c, c->work_re, c->work_im, false);
+
+    for (k = 0; k <= n; k++) {
+        unsigned a = k % n, b = (n - k) % n;
+        float e_re, e_im, o_re, o_im;
+
+        /* Even and odd samples, twice */
+        e_re = c->work_re[a] + c->work_re[b];
+        e_im = c->work_im[a] - c->work_im[b];
+        o_re = c->work_im[a] + c->work_im[b];
+        o_im = c->work_re[b] - c->work_re[a];
+
+        out[k] = e_re + o_re * c->split_re[k] - o_im * c->split_im[k];
+        out_im[k] = e_im + o_re * c->split_im[k] + o_im * c->split_re[k];
+    }
+}
+
+/* Transforms a spectrum back into 2 * block_size real samples, scaled
+ * by 2 * block_size */
+static void real_inverse(pa_convolver *c, const float *in, float *x) {
+    unsigned n = c->block_size, k;
+    const float *in_im = in + c->bins;
+
+    for (k = 0; k < n; k++) {
+        float e_re, e_im, d_re, d_im, o_re, o_im;
+
+        e_re = in[k] + in[n - k];
+        e_im = in_im[k] - in_im[n - k];
+        d_re = in[k] - in[n - k];
+        d_im = in_im[k] + in_im[n - k];
+
+        /* Multiplied by the conjugated twiddle factor */
+        o_re = d_re * c->split_re[k] + d_im * c->split_im[k];
+        o_im = d_im * c->split_re[k] - d_re * c->split_im[k];
+
+        c->work_re[k] = e_re - o_im;
+        c->work_im[k] = e_im + o_re;
+    }
+
+    fft(c, c->work_re, c->work_im, true);
+
+    for (k = 0; k < n; k++) {
+        x[2 * k] = c->work_re[k];
+        x[2 * k + 1] = c->work_im[k];
+    }
+}
+
+static void init_fft(pa_convolver *c) {
+    unsigned n = c->block_size, bits = 0, i, j;
+
+    while ((1U << bits) < n)
+        bits++;
+
+    c->bitrev = pa_xnew(unsigned, n);
+
+    for (i = 0; i < n; i++) {
+        unsigned r = 0;
+
+        for (j = 0; j < bits; j++)
+            if (i & (1U << j))
+                r |= 1U << (bits - 1 - j);
+
+        c->bitrev[i] = r;
+    }
+
+    c->twiddle_re = pa_xnew(float, n / 2);
+    c->twiddle_im = pa_xnew(float, n / 2);
+
+    for (i = 0; i < n / 2; i++) {
+        c->twiddle_re[i] = (float) cos(2 * M_PI * i / n);
+        c->twiddle_im[i] = (float) -sin(2 * M_PI * i / n);
+    }
+
+    c->split_re = pa_xnew(float, n + 1);
+    c->split_im = pa_xnew(float, n + 1);
+
+    for (i = 0; i <= n; i++) {
+        c->split_re[i] = (float) cos(M_PI * i / n);
+        c->split_im[i] = (float) -sin(M_PI * i / n);
+    }
+
+    c->bins = PA_ROUND_UP(n + 1, 4);
+
+    c->work_re = pa_xnew(float, n);
+    c->work_im = pa_xnew(float, n);
+    c->acc = pa_xnew(float, 2 * c->bins);
+    c->time = pa_xnew(float, 2 * n);
+}
+
+/* Sets the taps of the response from input i to output o */
+static void set_path(pa_convolver *c, unsigned o, unsigned i, const float *r) {
+    unsigned head = PA_MIN(c->taps, c->block_size), path = o * c->n_inputs + i, p, j;
+    float *h = c->head_taps + path * c->head;
+
+    /* Reversed, preceded by the padding */
+    memset(h, 0, (c->head - head) * sizeof(float));
+    h += c->head - head;
+
+    for (j = 0; j < head; j++)
+        h[j] = r[head - 1 - j];
+
+    for (p = 0; p < c->n_partitions; p++) {
+        unsigned n = PA_MIN(c->block_size, c->taps - (p + 1) * c->block_size);
+
+        h = c->filter + (path * c->n_partitions + p) * 2 * c->bins;
+
+        /* The partition, zero padded to the FFT size */
+        memset(c->time, 0, 2 * c->block_size * sizeof(float));
+        memcpy(c->time, r + (p + 1) * c->block_size, n * sizeof(float));
+
+        real_forward(c, c->time, h);
+
+        /* The forward transforms of both the input and the filter
+         * yield twice the spectrum, and the inverse one scales by
+         * 2 * block_size, undo all that here */
+        for (j = 0; j < 2 * c->bins; j++)
+            h[j] /= 8 * c->block_size;
+    }
+}
+
+pa_convolver *pa_convolver_new(unsigned n_inputs, unsigned n_outputs, unsigned block_size, const float * const *responses, unsigned taps) {
+    pa_convolver *c;
+    unsigned o, i;
+
+    pa_assert(n_inputs > 0);
+    pa_assert(n_outputs > 0);
+    pa_assert(block_size >= 4);
+    pa_assert((block_size & (block_size - 1)) == 0);
+    pa_assert(responses);
+    pa_assert(taps > 0);
+
+    c = pa_xnew0(pa_convolver, 1);
+    c->n_inputs = n_inputs;
+    c->n_outputs = n_outputs;
+    c->block_size = block_size;
+    c->taps = taps;
+    c->paths = pa_xnew(bool, n_outputs * n_inputs);
+
+    c->head = PA_ROUND_UP(PA_MIN(taps, block_size), 4);
+    c->n_partitions = taps > block_size ? (taps - 1) / block_size : 0;
+
+    c->head_taps = pa_xnew0(float, n_outputs * n_inputs * c->head);
+    c->history = pa_xnew0(float, n_inputs * 2 * block_size);
+    c->tail = pa_xnew0(float, n_outputs * block_size);
+
+    if (c->n_partitions > 0) {
+        init_fft(c);
+
+        c->fdl = pa_xnew0(float, n_inputs * c->n_partitions * 2 * c->bins);
+        c->filter = pa_xnew0(float, n_outputs * n_inputs * c->n_partitions * 2 * c->bins);
+    }
+
+    for (o = 0; o < n_outputs; o++)
+        for (i = 0; i < n_inputs; i++)
+            if ((c->paths[o * n_inputs + i] = !!responses[o * n_inputs + i]))
+                set_path(c, o, i, responses[o * n_inputs + i]);
+
+    return c;
+}
+
+pa_convolver *pa_fir_new(unsigned channels, unsigned block_size, const float * const *responses, unsigned taps) {
+    const float **matrix;
+    pa_convolver *c;
+    unsigned i;
+
+    pa_assert(channels > 0);
+    pa_assert(responses);
+
+    matrix = pa_xnew0(const float*, channels * channels);
+
+    for (i = 0; i < channels; i++) {
+        pa_assert(responses[i]);
+        matrix[i * channels + i] = responses[i];
+    }
+
+    c = pa_convolver_new(channels, channels, block_size, matrix, taps);
+
+    pa_xfree(matrix);
+
+    return c;
+}
+
+void pa_convolver_set_response(pa_convolver *c, unsigned output, unsigned input, const float *response) {
+    pa_assert(c);
+    pa_assert(output < c->n_outputs);
+    pa_assert(input < c->n_inputs);
+    pa_assert(response);
+    pa_assert(c->paths[output * c->n_inputs + input]);
+
+    set_path(c, output, input, response);
+}
+
+void pa_convolver_free(pa_convolver *c) {
+    pa_assert(c);
+
+    pa_xfree(c->paths);
+    pa_xfree(c->head_taps);
+    pa_xfree(c->history);
+    pa_xfree(c->tail);
+    pa_xfree(c->twiddle_re);
+    pa_xfree(c->twiddle_im);
+    pa_xfree(c->split_re);
+    pa_xfree(c->split_im);
+    pa_xfree(c->bitrev);
+    pa_xfree(c->work_re);
+    pa_xfree(c->work_im);
+    pa_xfree(c->acc);
+    pa_xfree(c->time);
+    pa_xfree(c->fdl);
+    pa_xfree(c->filter);
+    pa_xfree(c->ring);
+    pa_xfree(c);
+}
+
+/* Clears the filter state, but not the input kept for rewinding */
+static void clear_state(pa_convolver *c) {
+    c->pos = 0;
+    c->fdl_pos = 0;
+
+    memset(c->history, 0, c->n_inputs * 2 * c->block_size * sizeof(float));
+    memset(c->tail, 0, c->n_outputs * c->block_size * sizeof(float));
+
+    if (c->n_partitions > 0)
+        memset(c->fdl, 0, c->n_inputs * c->n_partitions * 2 * c->bins * sizeof(float));
+}
+
+void pa_convolver_reset(pa_convolver *c) {
+    pa_assert(c);
+
+    clear_state(c);
+
+    c->index = 0;
+    c->ring_filled = 0;
+}
+
+/* Runs the FFT partitions once a block of input is complete. Their
+ * output is the part of the next block that depends on input from this
+ * block and earlier ones. */
+static void finish_block(pa_convolver *c) {
+    unsigned spectrum = 2 * c->bins, o, i, p;
+
+    if (c->n_partitions > 0) {
+        c->fdl_pos = (c->fdl_pos + 1) % c->n_partitions;
+
+        for (i = 0; i < c->n_inputs; i++)
+            real_forward(c, c->history + i * 2 * c->block_size, c->fdl + (i * c->n_partitions + c->fdl_pos) * spectrum);
+
+        for (o = 0; o < c->n_outputs; o++) {
+            memset(c->acc, 0, spectrum * sizeof(float));
+
+            for (i = 0; i < c->n_inputs; i++) {
+                if (!c->paths[o * c->n_inputs + i])
+                    continue;
+
+                for (p = 0; p < c->n_partitions; p++) {
+                    unsigned slot = (c->fdl_pos + c->n_partitions - p) % c->n_partitions;
+
+                    cmac_func(c->acc,
+                              c->fdl + (i * c->n_partitions + slot) * spectrum,
+                              c->filter + ((o * c->n_inputs + i) * c->n_partitions + p) * spectrum,
+                              c->bins);
+                }
+            }
+
+            real_inverse(c, c->acc, c->time);
+
+            /* Overlap-save: only the second half is free of wrap around */
+            memcpy(c->tail + o * c->block_size, c->time + c->block_size, c->block_size * sizeof(float));
+        }
+    }
+
+    for (i = 0; i < c->n_inputs; i++) {
+        float *h = c->history + i * 2 * c->block_size;
+
+        memcpy(h, h + c->block_size, c->block_size * sizeof(float));
+    }
+
+    c->pos = 0;
+}
+
+/* Without dst only the state is updated */
+static void process(pa_convolver *c, const float *src, float *dst, unsigned n_frames) {
+    unsigned f, o, i;
+
+    for (f = 0; f < n_frames; f++) {
+        for (i = 0; i < c->n_inputs; i++)
+            c->history[i * 2 * c->block_size + c->block_size + c->pos] = *(src++);
+
+        if (dst)
+            for (o = 0; o < c->n_outputs; o++) {
+                float sum = c->tail[o * c->block_size + c->pos];
+
+                for (i = 0; i < c->n_inputs; i++) {
+                    if (!c->paths[o * c->n_inputs + i])
+                        continue;
+
+                    sum += dot_func(c->head_taps + (o * c->n_inputs + i) * c->head,
+                                    c->history + i * 2 * c->block_size + c->block_size + c->pos + 1 - c->head,
+                                    c->head);
+                }
+
+                *(dst++) = sum;
+            }
+
+        if (++c->pos >= c->block_size)
+            finish_block(c);
+    }
+
+    c->index += n_frames;
+}
+
+static void ring_append(pa_convolver *c, const float *src, unsigned n_frames) {
+    size_t frame_size = c->n_inputs * sizeof(float);
+
+    /* Only the last ring_frames frames matter */
+    if (n_frames > c->ring_frames) {
+        src += (n_frames - c->ring_frames) * c->n_inputs;
+        n_frames = c->ring_frames;
+    }
+
+    while (n_frames > 0) {
+        size_t at = (size_t) ((c->index - n_frames) % (int64_t) c->ring_frames);
+        size_t n = PA_MIN(n_frames, c->ring_frames - at);
+
+        memcpy(c->ring + at * c->n_inputs, src, n * frame_size);
+
+        src += n * c->n_inputs;
+        n_frames -= n;
+    }
+}
+
+void pa_convolver_process(pa_convolver *c, const float *src, float *dst, unsigned n_frames) {
+    pa_assert(c);
+    pa_assert(src);
+    pa_assert(dst);
+
+    process(c, src, dst, n_frames);
+
+    if (c->ring) {
+        ring_append(c, src, n_frames);
+        c->ring_filled = PA_MIN(c->ring_filled + n_frames, c->ring_frames);
+    }
+}
+
+void pa_convolver_set_max_rewind(pa_convolver *c, size_t n_frames) {
+    pa_assert(c);
+
+    if (n_frames == c->max_rewind)
+        return;
+
+    c->max_rewind = n_frames;
+
+    pa_xfree(c->ring);
+    c->ring = NULL;
+    c->ring_frames = c->ring_filled = 0;
+
+    if (n_frames == 0)
+        return;
+
+    /* Rewinding replays the input from the start of the block before
+     * the oldest one in the delay line on */
+    c->ring_frames = n_frames + (c->n_partitions + 2) * c->block_size;
+    c->ring = pa_xnew(float, c->ring_frames * c->n_inputs);
+}
+
+void pa_convolver_rewind(pa_convolver *c, size_t n_frames) {
+    int64_t target, start;
+
+    pa_assert(c);
+
+    if (n_frames == 0)
+        return;
+
+    target = PA_MAX(c->index - (int64_t) n_frames, 0);
+
+    /* The state at target depends on the input since the block that
+     * ends up as the oldest one in the delay line, and the one before
+     * it. Earlier input doesn't matter. */
+    start = (target / c->block_size - 1 - (int64_t) c->n_partitions) * c->block_size;
+    start = PA_MAX(start, 0);
+
+    if ((int64_t) c->ring_filled < c->index - start) {
+        pa_log_debug("Rewinding convolver %zu frames, not enough input kept, starting over.", n_frames);
+
+        pa_convolver_reset(c);
+        return;
+    }
+
+    c->ring_filled -= (size_t) (c->index - target);
+
+    clear_state(c);
+    c->index = start;
+
+    /* Replay the input up to the new position */
+    while (c->index < target) {
+        size_t at = (size_t) (c->index % (int64_t) c->ring_frames);
+        size_t n = (size_t) PA_MIN(target - c->index, (int64_t) (c->ring_frames - at));
+
+        process(c, c->ring + at * c->n_inputs, NULL, (unsigned) n);
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef fooconvolverhfoo
+#define fooconvolverhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <stddef.h>
+
+/* Convolves n_inputs channels with a matrix of impulse responses into
+ * n_outputs channels, every output being the sum of all inputs each
+ * convolved with its own response.
+ *
+ * The first block_size taps of every response are applied in direct
+ * form, the rest with uniformly partitioned overlap-save FFT
+ * convolution in partitions of block_size taps. The output doesn't lag
+ * behind the input, and filters no longer than block_size are plain
+ * direct form convolution. block_size must be a power of two, at least 4.
+ *
+ * The direct form dot products and the spectrum products of the FFT
+ * partitions are done by replaceable (SIMD) functions. */
+
+typedef struct pa_convolver pa_convolver;
+
+/* Returns the sum of a[i] * b[i], n is a multiple of 4 */
+typedef float (*pa_convolver_dot_func_t) (const float *a, const float *b, unsigned n);
+
+/* Adds the product of the spectra x and h to acc. Each spectrum is bins
+ * real parts followed by bins imaginary parts, bins is a multiple of
+ * 4. */
+typedef void (*pa_convolver_cmac_func_t) (float *acc, const float *x, const float *h, unsigned bins);
+
+pa_convolver_dot_func_t pa_get_convolver_dot_func(void);
+void pa_set_convolver_dot_func(pa_convolver_dot_func_t func);
+
+pa_convolver_cmac_func_t pa_get_convolver_cmac_func(void);
+void pa_set_convolver_cmac_func(pa_convolver_cmac_func_t func);
+
+/* responses[o * n_inputs + i] holds the taps of the response from input
+ * i to output o, or NULL if input i doesn't go to output o at all. The
+ * responses are copied. */
+pa_convolver *pa_convolver_new(unsigned n_inputs, unsigned n_outputs, unsigned block_size, const float * const *responses, unsigned taps);
+
+/* A convolver that filters each of the channels on its own, with
+ * responses[c] for channel c */
+pa_convolver *pa_fir_new(unsigned channels, unsigned block_size, const float * const *responses, unsigned taps);
+
+void pa_convolver_free(pa_convolver *c);
+
+/* Replaces the taps of the response from input to output, which must not
+ * have been NULL. The input seen so far is kept, so the new response
+ * applies to it from the next frame on. For a convolver from
+ * pa_fir_new() output and input are both the channel. */
+void pa_convolver_set_response(pa_convolver *c, unsigned output, unsigned input, const float *response);
+
+/* Forget all input seen so far */
+void pa_convolver_reset(pa_convolver *c);
+
+/* Keep enough input around to rewind by up to n_frames. This drops the
+ * input kept so far. */
+void pa_convolver_set_max_rewind(pa_convolver *c, size_t n_frames);
+
+/* Bring the state back to what it was n_frames ago, as if the last
+ * n_frames had never been processed. If more than the max_rewind frames
+ * are rewound, the state is reset. */
+void pa_convolver_rewind(pa_convolver *c, size_t n_frames);
+
+/* src holds n_frames interleaved frames of n_inputs floats, dst
+ * receives n_frames interleaved frames of n_outputs floats */
+void pa_convolver_process(pa_convolver *c, const float *src, float *dst, unsigned n_frames);
+
+#endif
@@ -0,0 +1,67 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/cpu-arm.h>
+
+#include "convolver.h"
+
+#include <arm_neon.h>
+
+static float dot_neon(const float *a, const float *b, unsigned n) {
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    float32x2_t half;
+    unsigned i;
+
+    for (i = 0; i < n; i += 4)
+        sum = vmlaq_f32(sum, vld1q_f32(a + i), vld1q_f32(b + i));
+
+    /* (s0 + s2) + (s1 + s3), like the generic version */
+    half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+
+    return vget_lane_f32(half, 0) + vget_lane_f32(half, 1);
+}
+
+static void cmac_neon(float *acc, const float *x, const float *h, unsigned bins) {
+    unsigned k;
+
+    for (k = 0; k < bins; k += 4) {
+        float32x4_t x_re = vld1q_f32(x + k), x_im = vld1q_f32(x + bins + k);
+        float32x4_t h_re = vld1q_f32(h + k), h_im = vld1q_f32(h + bins + k);
+        float32x4_t re, im;
+
+        re = vmlaq_f32(vld1q_f32(acc + k), x_re, h_re);
+        re = vmlsq_f32(re, x_im, h_im);
+        im = vmlaq_f32(vld1q_f32(acc + bins + k), x_re, h_im);
+        im = vmlaq_f32(im, x_im, h_re);
+
+        vst1q_f32(acc + k, re);
+        vst1q_f32(acc + bins + k, im);
+    }
+}
+
+void pa_convolver_func_init_neon(pa_cpu_arm_flag_t flags) {
+    pa_log_info("Initialising ARM NEON optimized convolver.");
+
+    pa_set_convolver_dot_func(dot_neon);
+    pa_set_convolver_cmac_func(cmac_neon);
+}
@@ -0,0 +1,120 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/cpu-x86.h>
+
+#include "convolver.h"
+
+#if defined (__i386__) || defined (__amd64__)
+
+static float dot_sse(const float *a, const float *b, unsigned n) {
+    pa_reg_x86 i = 0, count = n / 4;
+    float sum;
+
+    /* xmm0 holds four partial sums, which are added up as
+     * (s0 + s2) + (s1 + s3) at the end */
+    __asm__ __volatile__ (
+        " xorps %%xmm0, %%xmm0          \n\t"
+        " test %1, %1                   \n\t"
+        " je 2f                         \n\t"
+
+        "1:                             \n\t"
+        " movups (%q3, %0), %%xmm1      \n\t"
+        " movups (%q4, %0), %%xmm2      \n\t"
+        " mulps %%xmm2, %%xmm1          \n\t"
+        " addps %%xmm1, %%xmm0          \n\t"
+        " add $16, %0                   \n\t"
+        " dec %1                        \n\t"
+        " jne 1b                        \n\t"
+
+        "2:                             \n\t"
+        " movhlps %%xmm0, %%xmm1        \n\t"
+        " addps %%xmm1, %%xmm0          \n\t"
+        " movaps %%xmm0, %%xmm1         \n\t"
+        " shufps $0x55, %%xmm1, %%xmm1  \n\t"
+        " addss %%xmm1, %%xmm0          \n\t"
+        " movss %%xmm0, %2              \n\t"
+
+        : "+r" (i), "+r" (count), "=m" (sum)
+        : "r" (a), "r" (b)
+        : "cc", "memory", "xmm0", "xmm1", "xmm2"
+    );
+
+    return sum;
+}
+
+static void cmac_sse(float *acc, const float *x, const float *h, unsigned bins) {
+    pa_reg_x86 count = bins / 4, im = bins * sizeof(float);
+
+    /* Four bins at a time, the imaginary parts are im bytes after the
+     * real ones */
+    __asm__ __volatile__ (
+        " test %3, %3                   \n\t"
+        " je 2f                         \n\t"
+
+        "1:                             \n\t"
+        " movups (%q1), %%xmm0          \n\t" /* x re */
+        " movups (%q1, %q4), %%xmm1     \n\t" /* x im */
+        " movups (%q2), %%xmm2          \n\t" /* h re */
+        " movups (%q2, %q4), %%xmm3     \n\t" /* h im */
+        " movaps %%xmm0, %%xmm4         \n\t"
+        " mulps %%xmm2, %%xmm4          \n\t"
+        " movaps %%xmm1, %%xmm5         \n\t"
+        " mulps %%xmm3, %%xmm5          \n\t"
+        " subps %%xmm5, %%xmm4          \n\t" /* x re * h re - x im * h im */
+        " mulps %%xmm3, %%xmm0          \n\t"
+        " mulps %%xmm2, %%xmm1          \n\t"
+        " addps %%xmm1, %%xmm0          \n\t" /* x re * h im + x im * h re */
+        " movups (%q0), %%xmm6          \n\t"
+        " addps %%xmm4, %%xmm6          \n\t"
+        " movups %%xmm6, (%q0)          \n\t"
+        " movups (%q0, %q4), %%xmm7     \n\t"
+        " addps %%xmm0, %%xmm7          \n\t"
+        " movups %%xmm7, (%q0, %q4)     \n\t"
+        " add $16, %0                   \n\t"
+        " add $16, %1                   \n\t"
+        " add $16, %2                   \n\t"
+        " dec %3                        \n\t"
+        " jne 1b                        \n\t"
+
+        "2:                             \n\t"
+
+        : "+r" (acc), "+r" (x), "+r" (h), "+r" (count)
+        : "r" (im)
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+    );
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_convolver_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+
+    if (flags & PA_CPU_X86_SSE) {
+        pa_log_info("Initialising SSE optimized convolver.");
+        pa_set_convolver_dot_func(dot_sse);
+        pa_set_convolver_cmac_func(cmac_sse);
+    }
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
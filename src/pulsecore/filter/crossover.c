@@ -7,91 +7,127 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <pulsecore/macro.h>
 
 #include "crossover.h"
 
-void lr4_set(struct lr4 *lr4, enum biquad_type type, float freq)
+/* Filters the first lanes channels of a group. The operations are done in
+ * the same order as in the SIMD versions, so that the results are the same. */
+static void process_lanes_float32(struct lr4_group *g, int lanes, int samples, int channels, const float *src, float *dest)
 {
-	biquad_set(&lr4->bq, type, freq);
-	lr4->x1 = 0;
-	lr4->x2 = 0;
-	lr4->y1 = 0;
-	lr4->y2 = 0;
-	lr4->z1 = 0;
-	lr4->z2 = 0;
+	int i, l;
+
+	for (i = 0; i < samples * channels; i += channels) {
+		for (l = 0; l < lanes; l++) {
+			float x, y, z;
+			x = src[i + l];
+			y = g->b0[l]*x + g->b1[l]*g->x1[l] + g->b2[l]*g->x2[l] - g->a1[l]*g->y1[l] - g->a2[l]*g->y2[l];
+			z = g->b0[l]*y + g->b1[l]*g->y1[l] + g->b2[l]*g->y2[l] - g->a1[l]*g->z1[l] - g->a2[l]*g->z2[l];
+			g->x2[l] = g->x1[l];
+			g->x1[l] = x;
+			g->y2[l] = g->y1[l];
+			g->y1[l] = y;
+			g->z2[l] = g->z1[l];
+			g->z1[l] = z;
+			dest[i + l] = z;
+		}
+	}
 }
 
-void lr4_process_float32(struct lr4 *lr4, int samples, int channels, float *src, float *dest)
+static void process_lanes_s16(struct lr4_group *g, int lanes, int samples, int channels, const short *src, short *dest)
 {
-	float lx1 = lr4->x1;
-	float lx2 = lr4->x2;
-	float ly1 = lr4->y1;
-	float ly2 = lr4->y2;
-	float lz1 = lr4->z1;
-	float lz2 = lr4->z2;
-	float lb0 = lr4->bq.b0;
-	float lb1 = lr4->bq.b1;
-	float lb2 = lr4->bq.b2;
-	float la1 = lr4->bq.a1;
-	float la2 = lr4->bq.a2;
+	int i, l;
 
-	int i;
 	for (i = 0; i < samples * channels; i += channels) {
-		float x, y, z;
-		x = src[i];
-		y = lb0*x + lb1*lx1 + lb2*lx2 - la1*ly1 - la2*ly2;
-		z = lb0*y + lb1*ly1 + lb2*ly2 - la1*lz1 - la2*lz2;
-		lx2 = lx1;
-		lx1 = x;
-		ly2 = ly1;
-		ly1 = y;
-		lz2 = lz1;
-		lz1 = z;
-		dest[i] = z;
+		for (l = 0; l < lanes; l++) {
+			float x, y, z;
+			x = src[i + l];
+			y = g->b0[l]*x + g->b1[l]*g->x1[l] + g->b2[l]*g->x2[l] - g->a1[l]*g->y1[l] - g->a2[l]*g->y2[l];
+			z = g->b0[l]*y + g->b1[l]*g->y1[l] + g->b2[l]*g->y2[l] - g->a1[l]*g->z1[l] - g->a2[l]*g->z2[l];
+			g->x2[l] = g->x1[l];
+			g->x1[l] = x;
+			g->y2[l] = g->y1[l];
+			g->y1[l] = y;
+			g->z2[l] = g->z1[l];
+			g->z1[l] = z;
+			dest[i + l] = PA_CLAMP_UNLIKELY((int) z, -0x8000, 0x7fff);
+		}
 	}
+}
+
+static void group_process_c(struct lr4_group *g, int samples, int channels, const float *src, float *dest)
+{
+	process_lanes_float32(g, 4, samples, channels, src, dest);
+}
+
+static lr4_group_process_func_t group_process_func = group_process_c;
 
-	lr4->x1 = lx1;
-	lr4->x2 = lx2;
-	lr4->y1 = ly1;
-	lr4->y2 = ly2;
-	lr4->z1 = lz1;
-	lr4->z2 = lz2;
+lr4_group_process_func_t pa_get_lr4_group_process_func(void)
+{
+	return group_process_func;
 }
 
-void lr4_process_s16(struct lr4 *lr4, int samples, int channels, short *src, short *dest)
+void pa_set_lr4_group_process_func(lr4_group_process_func_t func)
 {
-	float lx1 = lr4->x1;
-	float lx2 = lr4->x2;
-	float ly1 = lr4->y1;
-	float ly2 = lr4->y2;
-	float lz1 = lr4->z1;
-	float lz2 = lr4->z2;
-	float lb0 = lr4->bq.b0;
-	float lb1 = lr4->bq.b1;
-	float lb2 = lr4->bq.b2;
-	float la1 = lr4->bq.a1;
-	float la2 = lr4->bq.a2;
+	pa_assert(func);
+
+	group_process_func = func;
+}
 
+void lr4_bank_init(struct lr4_bank *bank, int channels)
+{
 	int i;
-	for (i = 0; i < samples * channels; i += channels) {
-		float x, y, z;
-		x = src[i];
-		y = lb0*x + lb1*lx1 + lb2*lx2 - la1*ly1 - la2*ly2;
-		z = lb0*y + lb1*ly1 + lb2*ly2 - la1*lz1 - la2*lz2;
-		lx2 = lx1;
-		lx1 = x;
-		ly2 = ly1;
-		ly1 = y;
-		lz2 = lz1;
-		lz1 = z;
-		dest[i] = PA_CLAMP_UNLIKELY((int) z, -0x8000, 0x7fff);
-	}
 
-	lr4->x1 = lx1;
-	lr4->x2 = lx2;
-	lr4->y1 = ly1;
-	lr4->y2 = ly2;
-	lr4->z1 = lz1;
-	lr4->z2 = lz2;
+	pa_assert(channels > 0 && channels <= LR4_BANK_MAX_CHANNELS);
+
+	memset(bank, 0, sizeof(*bank));
+	bank->channels = channels;
+
+	for (i = 0; i < LR4_BANK_MAX_CHANNELS; i++)
+		bank->group[i / 4].b0[i % 4] = 1;
+}
+
+void lr4_bank_set(struct lr4_bank *bank, int channel, enum biquad_type type, float freq)
+{
+	struct lr4_group *g = &bank->group[channel / 4];
+	struct biquad bq;
+	int l = channel % 4;
+
+	pa_assert(channel >= 0 && channel < bank->channels);
+
+	biquad_set(&bq, type, freq);
+	g->b0[l] = bq.b0;
+	g->b1[l] = bq.b1;
+	g->b2[l] = bq.b2;
+	g->a1[l] = bq.a1;
+	g->a2[l] = bq.a2;
+	g->x1[l] = 0;
+	g->x2[l] = 0;
+	g->y1[l] = 0;
+	g->y2[l] = 0;
+	g->z1[l] = 0;
+	g->z2[l] = 0;
+}
+
+void lr4_bank_process_float32(struct lr4_bank *bank, int samples, const float *src, float *dest)
+{
+	int c;
+
+	/* Whole groups go to the (SIMD) group function, the channels left
+	 * over are done here */
+	for (c = 0; c + 4 <= bank->channels; c += 4)
+		group_process_func(&bank->group[c / 4], samples, bank->channels, src + c, dest + c);
+
+	if (c < bank->channels)
+		process_lanes_float32(&bank->group[c / 4], bank->channels - c, samples, bank->channels, src + c, dest + c);
+}
+
+void lr4_bank_process_s16(struct lr4_bank *bank, int samples, const short *src, short *dest)
+{
+	int c;
+
+	for (c = 0; c < bank->channels; c += 4)
+		process_lanes_s16(&bank->group[c / 4], PA_MIN(4, bank->channels - c), samples, bank->channels, src + c, dest + c);
 }
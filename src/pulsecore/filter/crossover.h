@@ -13,17 +13,41 @@
  *
  * Both biquad filter has the same parameter b[012] and a[12],
  * The variable [xyz][12] keep the history values.
+ *
+ * The filters of four channels are kept together in a group, every array
+ * holding one value per channel, so that the four channels can be
+ * processed at once in SIMD registers.
  */
-struct lr4 {
-	struct biquad bq;
-	float x1, x2;
-	float y1, y2;
-	float z1, z2;
+struct lr4_group {
+	float b0[4], b1[4], b2[4];
+	float a1[4], a2[4];
+	float x1[4], x2[4];
+	float y1[4], y2[4];
+	float z1[4], z2[4];
+};
+
+#define LR4_BANK_MAX_CHANNELS 32
+
+/* The LR4 filters of all channels of an interleaved stream */
+struct lr4_bank {
+	int channels;
+	struct lr4_group group[LR4_BANK_MAX_CHANNELS / 4];
 };
 
-void lr4_set(struct lr4 *lr4, enum biquad_type type, float freq);
+/* Filters the channels of a group over samples frames, which are
+ * channels floats apart. */
+typedef void (*lr4_group_process_func_t)(struct lr4_group *g, int samples, int channels, const float *src, float *dest);
+
+lr4_group_process_func_t pa_get_lr4_group_process_func(void);
+void pa_set_lr4_group_process_func(lr4_group_process_func_t func);
+
+/* Sets up the bank with all filters passing everything through */
+void lr4_bank_init(struct lr4_bank *bank, int channels);
+
+/* Sets the filter of one channel and clears its history */
+void lr4_bank_set(struct lr4_bank *bank, int channel, enum biquad_type type, float freq);
 
-void lr4_process_float32(struct lr4 *lr4, int samples, int channels, float *src, float *dest);
-void lr4_process_s16(struct lr4 *lr4, int samples, int channels, short *src, short *dest);
+void lr4_bank_process_float32(struct lr4_bank *bank, int samples, const float *src, float *dest);
+void lr4_bank_process_s16(struct lr4_bank *bank, int samples, const short *src, short *dest);
 
 #endif /* CROSSOVER_H_ */
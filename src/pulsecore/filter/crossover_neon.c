@@ -0,0 +1,78 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/cpu-arm.h>
+
+#include "crossover.h"
+
+#include <arm_neon.h>
+
+/* Multiplies and adds separately, in the same order as the generic
+ * version */
+static void group_process_neon(struct lr4_group *g, int samples, int channels, const float *src, float *dest) {
+    float32x4_t b0 = vld1q_f32(g->b0), b1 = vld1q_f32(g->b1), b2 = vld1q_f32(g->b2);
+    float32x4_t a1 = vld1q_f32(g->a1), a2 = vld1q_f32(g->a2);
+    float32x4_t x1 = vld1q_f32(g->x1), x2 = vld1q_f32(g->x2);
+    float32x4_t y1 = vld1q_f32(g->y1), y2 = vld1q_f32(g->y2);
+    float32x4_t z1 = vld1q_f32(g->z1), z2 = vld1q_f32(g->z2);
+    int i;
+
+    for (i = 0; i < samples; i++, src += channels, dest += channels) {
+        float32x4_t x, y, z;
+
+        x = vld1q_f32(src);
+        y = vmulq_f32(b0, x);
+        y = vaddq_f32(y, vmulq_f32(b1, x1));
+        y = vaddq_f32(y, vmulq_f32(b2, x2));
+        y = vsubq_f32(y, vmulq_f32(a1, y1));
+        y = vsubq_f32(y, vmulq_f32(a2, y2));
+
+        z = vmulq_f32(b0, y);
+        z = vaddq_f32(z, vmulq_f32(b1, y1));
+        z = vaddq_f32(z, vmulq_f32(b2, y2));
+        z = vsubq_f32(z, vmulq_f32(a1, z1));
+        z = vsubq_f32(z, vmulq_f32(a2, z2));
+
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        z2 = z1;
+        z1 = z;
+
+        vst1q_f32(dest, z);
+    }
+
+    vst1q_f32(g->x1, x1);
+    vst1q_f32(g->x2, x2);
+    vst1q_f32(g->y1, y1);
+    vst1q_f32(g->y2, y2);
+    vst1q_f32(g->z1, z1);
+    vst1q_f32(g->z2, z2);
+}
+
+void pa_crossover_func_init_neon(pa_cpu_arm_flag_t flags) {
+    pa_log_info("Initialising ARM NEON optimized crossover filters.");
+
+    pa_set_lr4_group_process_func(group_process_neon);
+}
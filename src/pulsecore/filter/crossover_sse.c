@@ -0,0 +1,127 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/cpu-x86.h>
+
+#include "crossover.h"
+
+#if defined (__i386__) || defined (__amd64__)
+
+/* The four channels of a group in one register each for the history
+ * (xmm0-xmm5) and two registers to compute with, which is all i386 has.
+ * The coefficients are loaded from the group as needed, and the stage 1
+ * output is parked in dest while stage 2 runs. */
+static void group_process_sse(struct lr4_group *g, int samples, int channels, const float *src, float *dest) {
+    pa_reg_x86 count = samples, stride = channels * sizeof(float);
+
+    __asm__ __volatile__ (
+        " test %2, %2                   \n\t"
+        " je 2f                         \n\t"
+
+        " movups %c[x1](%q4), %%xmm0    \n\t"
+        " movups %c[x2](%q4), %%xmm1    \n\t"
+        " movups %c[y1](%q4), %%xmm2    \n\t"
+        " movups %c[y2](%q4), %%xmm3    \n\t"
+        " movups %c[z1](%q4), %%xmm4    \n\t"
+        " movups %c[z2](%q4), %%xmm5    \n\t"
+
+        "1:                             \n\t"
+        " movups %c[b0](%q4), %%xmm6    \n\t"
+        " movups (%q0), %%xmm7          \n\t"
+        " mulps %%xmm7, %%xmm6          \n\t" /* b0 * x */
+        " movups %c[b1](%q4), %%xmm7    \n\t"
+        " mulps %%xmm0, %%xmm7          \n\t"
+        " addps %%xmm7, %%xmm6          \n\t" /* + b1 * x1 */
+        " movups %c[b2](%q4), %%xmm7    \n\t"
+        " mulps %%xmm7, %%xmm1          \n\t"
+        " addps %%xmm1, %%xmm6          \n\t" /* + b2 * x2 */
+        " movups %c[a1](%q4), %%xmm7    \n\t"
+        " mulps %%xmm2, %%xmm7          \n\t"
+        " subps %%xmm7, %%xmm6          \n\t" /* - a1 * y1 */
+        " movups %c[a2](%q4), %%xmm7    \n\t"
+        " mulps %%xmm3, %%xmm7          \n\t"
+        " subps %%xmm7, %%xmm6          \n\t" /* - a2 * y2 = y */
+        " movaps %%xmm0, %%xmm1         \n\t"
+        " movups (%q0), %%xmm0          \n\t"
+        " movups %%xmm6, (%q1)          \n\t"
+
+        " movups %c[b0](%q4), %%xmm7    \n\t"
+        " mulps %%xmm7, %%xmm6          \n\t" /* b0 * y */
+        " movups %c[b1](%q4), %%xmm7    \n\t"
+        " mulps %%xmm2, %%xmm7          \n\t"
+        " addps %%xmm7, %%xmm6          \n\t" /* + b1 * y1 */
+        " movups %c[b2](%q4), %%xmm7    \n\t"
+        " mulps %%xmm7, %%xmm3          \n\t"
+        " addps %%xmm3, %%xmm6          \n\t" /* + b2 * y2 */
+        " movups %c[a1](%q4), %%xmm7    \n\t"
+        " mulps %%xmm4, %%xmm7          \n\t"
+        " subps %%xmm7, %%xmm6          \n\t" /* - a1 * z1 */
+        " movups %c[a2](%q4), %%xmm7    \n\t"
+        " mulps %%xmm5, %%xmm7          \n\t"
+        " subps %%xmm7, %%xmm6          \n\t" /* - a2 * z2 = z */
+        " movaps %%xmm2, %%xmm3         \n\t"
+        " movups (%q1), %%xmm2          \n\t"
+        " movaps %%xmm4, %%xmm5         \n\t"
+        " movaps %%xmm6, %%xmm4         \n\t"
+        " movups %%xmm6, (%q1)          \n\t"
+
+        " add %3, %0                    \n\t"
+        " add %3, %1                    \n\t"
+        " dec %2                        \n\t"
+        " jne 1b                        \n\t"
+
+        " movups %%xmm0, %c[x1](%q4)    \n\t"
+        " movups %%xmm1, %c[x2](%q4)    \n\t"
+        " movups %%xmm2, %c[y1](%q4)    \n\t"
+        " movups %%xmm3, %c[y2](%q4)    \n\t"
+        " movups %%xmm4, %c[z1](%q4)    \n\t"
+        " movups %%xmm5, %c[z2](%q4)    \n\t"
+
+        "2:                             \n\t"
+
+        : "+r" (src), "+r" (dest), "+r" (count)
+        : "r" (stride), "r" (g),
+          [b0] "i" (offsetof(struct lr4_group, b0)), [b1] "i" (offsetof(struct lr4_group, b1)),
+          [b2] "i" (offsetof(struct lr4_group, b2)), [a1] "i" (offsetof(struct lr4_group, a1)),
+          [a2] "i" (offsetof(struct lr4_group, a2)), [x1] "i" (offsetof(struct lr4_group, x1)),
+          [x2] "i" (offsetof(struct lr4_group, x2)), [y1] "i" (offsetof(struct lr4_group, y1)),
+          [y2] "i" (offsetof(struct lr4_group, y2)), [z1] "i" (offsetof(struct lr4_group, z1)),
+          [z2] "i" (offsetof(struct lr4_group, z2))
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+    );
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_crossover_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+
+    if (flags & PA_CPU_X86_SSE) {
+        pa_log_info("Initialising SSE optimized crossover filters.");
+        pa_set_lr4_group_process_func(group_process_sse);
+    }
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
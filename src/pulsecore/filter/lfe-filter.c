@@ -32,7 +32,7 @@ struct saved_state {
     PA_LLIST_FIELDS(struct saved_state);
     pa_memchunk chunk;
     int64_t index;
-    struct lr4 lr4[PA_CHANNELS_MAX];
+    struct lr4_bank bank;
 };
 
 PA_STATIC_FLIST_DECLARE(lfe_state, 0, pa_xfree);
@@ -53,7 +53,7 @@ struct pa_lfe_filter {
     pa_sample_spec ss;
     size_t maxrewind;
     bool active;
-    struct lr4 lr4[PA_CHANNELS_MAX];
+    struct lr4_bank bank;
 };
 
 static void remove_state(pa_lfe_filter_t *f, struct saved_state *s) {
@@ -64,7 +64,11 @@ static void remove_state(pa_lfe_filter_t *f, struct saved_state *s) {
 
 pa_lfe_filter_t * pa_lfe_filter_new(const pa_sample_spec* ss, const pa_channel_map* cm, float crossover_freq, size_t maxrewind) {
 
-    pa_lfe_filter_t *f = pa_xnew0(struct pa_lfe_filter, 1);
+    pa_lfe_filter_t *f;
+
+    pa_assert_cc(LR4_BANK_MAX_CHANNELS >= PA_CHANNELS_MAX);
+
+    f = pa_xnew0(struct pa_lfe_filter, 1);
     f->crossover = crossover_freq;
     f->cm = *cm;
     f->ss = *ss;
@@ -89,18 +93,15 @@ static void process_block(pa_lfe_filter_t *f, pa_memchunk *buf, bool store_resul
 
     void *garbage = store_result ? NULL : pa_xmalloc(buf->length);
 
+    /* All channels at once, so that they can share SIMD registers */
     if (f->ss.format == PA_SAMPLE_FLOAT32NE) {
-        int i;
         float *data = pa_memblock_acquire_chunk(buf);
-        for (i = 0; i < f->cm.channels; i++)
-            lr4_process_float32(&f->lr4[i], samples, f->cm.channels, &data[i], garbage ? garbage : &data[i]);
+        lr4_bank_process_float32(&f->bank, samples, data, garbage ? garbage : data);
         pa_memblock_release(buf->memblock);
     }
     else if (f->ss.format == PA_SAMPLE_S16NE) {
-        int i;
         short *data = pa_memblock_acquire_chunk(buf);
-        for (i = 0; i < f->cm.channels; i++)
-            lr4_process_s16(&f->lr4[i], samples, f->cm.channels, &data[i], garbage ? garbage : &data[i]);
+        lr4_bank_process_s16(&f->bank, samples, data, garbage ? garbage : data);
         pa_memblock_release(buf->memblock);
     }
     else pa_assert_not_reached();
@@ -138,7 +139,7 @@ pa_memchunk * pa_lfe_filter_process(pa_lfe_filter_t *f, pa_memchunk *buf) {
     pa_mempool_unref(pool), pool = NULL;
 
     s->index = f->index;
-    memcpy(s->lr4, f->lr4, sizeof(struct lr4) * f->cm.channels);
+    s->bank = f->bank;
     PA_LLIST_PREPEND(struct saved_state, f->saved, s);
 
     process_block(f, buf, true);
@@ -160,8 +161,10 @@ void pa_lfe_filter_update_rate(pa_lfe_filter_t *f, uint32_t new_rate) {
         return;
     }
 
+    lr4_bank_init(&f->bank, f->cm.channels);
+
     for (i = 0; i < f->cm.channels; i++)
-        lr4_set(&f->lr4[i], f->cm.map[i] == PA_CHANNEL_POSITION_LFE ? BQ_LOWPASS : BQ_HIGHPASS, biquad_freq);
+        lr4_bank_set(&f->bank, i, f->cm.map[i] == PA_CHANNEL_POSITION_LFE ? BQ_LOWPASS : BQ_HIGHPASS, biquad_freq);
 
     f->active = true;
 }
@@ -185,7 +188,7 @@ void pa_lfe_filter_rewind(pa_lfe_filter_t *f, size_t amount) {
     }
     pa_log_debug("Rewinding LFE filter %zu samples to position %lli. Found saved state at position %lli",
         samples, (long long) f->index, (long long) s->index);
-    memcpy(f->lr4, s->lr4, sizeof(struct lr4) * f->cm.channels);
+    f->bank = s->bank;
 
     /* now fast forward to the actual position */
     if (f->index > s->index) {
@@ -0,0 +1,176 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+#include <pulsecore/cpu-arm.h>
+
+#include <arm_neon.h>
+
+/* Everything the kernels don't cover, and the remainder */
+static pa_interleave_func_t interleave_fallback;
+static pa_deinterleave_func_t deinterleave_fallback;
+
+/* The structured loads and stores (de)interleave two or four channels
+ * of 16 or 32 bit samples by themselves. Returns the number of frames
+ * done. */
+static unsigned interleave_kernel(const void *src[], unsigned channels, void *dst, size_t ss, unsigned n) {
+    unsigned j = 0;
+
+    if (ss == 4 && channels == 2) {
+        uint32_t *d = dst;
+
+        for (; j + 4 <= n; j += 4, d += 8) {
+            uint32x4x2_t v;
+
+            v.val[0] = vld1q_u32((const uint32_t*) src[0] + j);
+            v.val[1] = vld1q_u32((const uint32_t*) src[1] + j);
+            vst2q_u32(d, v);
+        }
+    } else if (ss == 4 && channels == 4) {
+        uint32_t *d = dst;
+
+        for (; j + 4 <= n; j += 4, d += 16) {
+            uint32x4x4_t v;
+
+            v.val[0] = vld1q_u32((const uint32_t*) src[0] + j);
+            v.val[1] = vld1q_u32((const uint32_t*) src[1] + j);
+            v.val[2] = vld1q_u32((const uint32_t*) src[2] + j);
+            v.val[3] = vld1q_u32((const uint32_t*) src[3] + j);
+            vst4q_u32(d, v);
+        }
+    } else if (ss == 2 && channels == 2) {
+        uint16_t *d = dst;
+
+        for (; j + 8 <= n; j += 8, d += 16) {
+            uint16x8x2_t v;
+
+            v.val[0] = vld1q_u16((const uint16_t*) src[0] + j);
+            v.val[1] = vld1q_u16((const uint16_t*) src[1] + j);
+            vst2q_u16(d, v);
+        }
+    } else if (ss == 2 && channels == 4) {
+        uint16_t *d = dst;
+
+        for (; j + 8 <= n; j += 8, d += 32) {
+            uint16x8x4_t v;
+
+            v.val[0] = vld1q_u16((const uint16_t*) src[0] + j);
+            v.val[1] = vld1q_u16((const uint16_t*) src[1] + j);
+            v.val[2] = vld1q_u16((const uint16_t*) src[2] + j);
+            v.val[3] = vld1q_u16((const uint16_t*) src[3] + j);
+            vst4q_u16(d, v);
+        }
+    }
+
+    return j;
+}
+
+static unsigned deinterleave_kernel(const void *src, void *dst[], unsigned channels, size_t ss, unsigned n) {
+    unsigned j = 0;
+
+    if (ss == 4 && channels == 2) {
+        const uint32_t *s = src;
+
+        for (; j + 4 <= n; j += 4, s += 8) {
+            uint32x4x2_t v = vld2q_u32(s);
+
+            vst1q_u32((uint32_t*) dst[0] + j, v.val[0]);
+            vst1q_u32((uint32_t*) dst[1] + j, v.val[1]);
+        }
+    } else if (ss == 4 && channels == 4) {
+        const uint32_t *s = src;
+
+        for (; j + 4 <= n; j += 4, s += 16) {
+            uint32x4x4_t v = vld4q_u32(s);
+
+            vst1q_u32((uint32_t*) dst[0] + j, v.val[0]);
+            vst1q_u32((uint32_t*) dst[1] + j, v.val[1]);
+            vst1q_u32((uint32_t*) dst[2] + j, v.val[2]);
+            vst1q_u32((uint32_t*) dst[3] + j, v.val[3]);
+        }
+    } else if (ss == 2 && channels == 2) {
+        const uint16_t *s = src;
+
+        for (; j + 8 <= n; j += 8, s += 16) {
+            uint16x8x2_t v = vld2q_u16(s);
+
+            vst1q_u16((uint16_t*) dst[0] + j, v.val[0]);
+            vst1q_u16((uint16_t*) dst[1] + j, v.val[1]);
+        }
+    } else if (ss == 2 && channels == 4) {
+        const uint16_t *s = src;
+
+        for (; j + 8 <= n; j += 8, s += 32) {
+            uint16x8x4_t v = vld4q_u16(s);
+
+            vst1q_u16((uint16_t*) dst[0] + j, v.val[0]);
+            vst1q_u16((uint16_t*) dst[1] + j, v.val[1]);
+            vst1q_u16((uint16_t*) dst[2] + j, v.val[2]);
+            vst1q_u16((uint16_t*) dst[3] + j, v.val[3]);
+        }
+    }
+
+    return j;
+}
+
+static void interleave_neon(const void *src[], unsigned channels, void *dst, size_t ss, unsigned n) {
+    const void *s[4];
+    unsigned j, c;
+
+    j = interleave_kernel(src, channels, dst, ss, n);
+
+    if (j == 0)
+        interleave_fallback(src, channels, dst, ss, n);
+    else if (j < n) {
+        for (c = 0; c < channels; c++)
+            s[c] = (const uint8_t*) src[c] + j * ss;
+
+        interleave_fallback(s, channels, (uint8_t*) dst + j * ss * channels, ss, n - j);
+    }
+}
+
+static void deinterleave_neon(const void *src, void *dst[], unsigned channels, size_t ss, unsigned n) {
+    void *d[4];
+    unsigned j, c;
+
+    j = deinterleave_kernel(src, dst, channels, ss, n);
+
+    if (j == 0)
+        deinterleave_fallback(src, dst, channels, ss, n);
+    else if (j < n) {
+        for (c = 0; c < channels; c++)
+            d[c] = (uint8_t*) dst[c] + j * ss;
+
+        deinterleave_fallback((const uint8_t*) src + j * ss * channels, d, channels, ss, n - j);
+    }
+}
+
+void pa_interleave_func_init_neon(pa_cpu_arm_flag_t flags) {
+    pa_log_info("Initialising ARM NEON optimized (de)interleaving.");
+
+    interleave_fallback = pa_get_interleave_func();
+    deinterleave_fallback = pa_get_deinterleave_func();
+
+    pa_set_interleave_func(interleave_neon);
+    pa_set_deinterleave_func(deinterleave_neon);
+}
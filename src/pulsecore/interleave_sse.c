@@ -0,0 +1,275 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/sample.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+#include <pulsecore/cpu-x86.h>
+
+#if defined (__i386__) || defined (__amd64__)
+
+/* The samples are only moved around, never used in arithmetic, so the
+ * float shuffles work for 32 bit samples of any format. In all of the
+ * kernels below f points to the interleaved frames, fs is the frame
+ * size, p to the plane pointers of the first channel handled and o is
+ * the offset into the planes. */
+
+/* Transposes rows xmm0 to xmm3 into columns xmm0, xmm2, xmm4 and xmm5 */
+#define TRANSPOSE_4X4                                   \
+        " movaps %%xmm0, %%xmm4             \n\t"       \
+        " unpcklps %%xmm1, %%xmm0           \n\t"       \
+        " unpckhps %%xmm1, %%xmm4           \n\t"       \
+        " movaps %%xmm2, %%xmm5             \n\t"       \
+        " unpcklps %%xmm3, %%xmm2           \n\t"       \
+        " unpckhps %%xmm3, %%xmm5           \n\t"       \
+        " movaps %%xmm0, %%xmm1             \n\t"       \
+        " movlhps %%xmm2, %%xmm0            \n\t"       \
+        " movhlps %%xmm1, %%xmm2            \n\t"       \
+        " movaps %%xmm4, %%xmm3             \n\t"       \
+        " movlhps %%xmm5, %%xmm4            \n\t"       \
+        " movhlps %%xmm3, %%xmm5            \n\t"
+
+/* Four channels of four frames of 32 bit samples */
+static inline void deinterleave_4x4(const uint8_t *f, pa_reg_x86 fs, void * const *p, pa_reg_x86 o) {
+    pa_reg_x86 t;
+
+    __asm__ __volatile__ (
+        " movups (%1), %%xmm0               \n\t"
+        " movups (%1,%2), %%xmm1            \n\t"
+        " lea (%1,%2,2), %0                 \n\t"
+        " movups (%0), %%xmm2               \n\t"
+        " movups (%0,%2), %%xmm3            \n\t"
+        TRANSPOSE_4X4
+        " mov (%3), %0                      \n\t"
+        " movups %%xmm0, (%0,%4)            \n\t"
+        " mov %c5(%3), %0                   \n\t"
+        " movups %%xmm2, (%0,%4)            \n\t"
+        " mov %c6(%3), %0                   \n\t"
+        " movups %%xmm4, (%0,%4)            \n\t"
+        " mov %c7(%3), %0                   \n\t"
+        " movups %%xmm5, (%0,%4)            \n\t"
+        : "=&r" (t)
+        : "r" (f), "r" (fs), "r" (p), "r" (o),
+          "i" (sizeof(void*)), "i" (2 * sizeof(void*)), "i" (3 * sizeof(void*))
+        : "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5"
+    );
+}
+
+static inline void interleave_4x4(uint8_t *f, pa_reg_x86 fs, const void * const *p, pa_reg_x86 o) {
+    pa_reg_x86 t;
+
+    __asm__ __volatile__ (
+        " mov (%3), %0                      \n\t"
+        " movups (%0,%4), %%xmm0            \n\t"
+        " mov %c5(%3), %0                   \n\t"
+        " movups (%0,%4), %%xmm1            \n\t"
+        " mov %c6(%3), %0                   \n\t"
+        " movups (%0,%4), %%xmm2            \n\t"
+        " mov %c7(%3), %0                   \n\t"
+        " movups (%0,%4), %%xmm3            \n\t"
+        TRANSPOSE_4X4
+        " movups %%xmm0, (%1)               \n\t"
+        " movups %%xmm2, (%1,%2)            \n\t"
+        " lea (%1,%2,2), %0                 \n\t"
+        " movups %%xmm4, (%0)               \n\t"
+        " movups %%xmm5, (%0,%2)            \n\t"
+        : "=&r" (t)
+        : "r" (f), "r" (fs), "r" (p), "r" (o),
+          "i" (sizeof(void*)), "i" (2 * sizeof(void*)), "i" (3 * sizeof(void*))
+        : "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5"
+    );
+}
+
+/* Two channels of four frames of 32 bit samples */
+static inline void deinterleave_2x4(const uint8_t *f, pa_reg_x86 fs, void * const *p, pa_reg_x86 o) {
+    pa_reg_x86 t;
+
+    __asm__ __volatile__ (
+        " movlps (%1), %%xmm0               \n\t"
+        " movhps (%1,%2), %%xmm0            \n\t"
+        " lea (%1,%2,2), %0                 \n\t"
+        " movlps (%0), %%xmm1               \n\t"
+        " movhps (%0,%2), %%xmm1            \n\t"
+        " movaps %%xmm0, %%xmm2             \n\t"
+        " shufps $0x88, %%xmm1, %%xmm0      \n\t" /* a0 a1 a2 a3 */
+        " shufps $0xdd, %%xmm1, %%xmm2      \n\t" /* b0 b1 b2 b3 */
+        " mov (%3), %0                      \n\t"
+        " movups %%xmm0, (%0,%4)            \n\t"
+        " mov %c5(%3), %0                   \n\t"
+        " movups %%xmm2, (%0,%4)            \n\t"
+        : "=&r" (t)
+        : "r" (f), "r" (fs), "r" (p), "r" (o), "i" (sizeof(void*))
+        : "memory", "xmm0", "xmm1", "xmm2"
+    );
+}
+
+static inline void interleave_2x4(uint8_t *f, pa_reg_x86 fs, const void * const *p, pa_reg_x86 o) {
+    pa_reg_x86 t;
+
+    __asm__ __volatile__ (
+        " mov (%3), %0                      \n\t"
+        " movups (%0,%4), %%xmm0            \n\t"
+        " mov %c5(%3), %0                   \n\t"
+        " movups (%0,%4), %%xmm1            \n\t"
+        " movaps %%xmm0, %%xmm2             \n\t"
+        " unpcklps %%xmm1, %%xmm0           \n\t" /* a0 b0 a1 b1 */
+        " unpckhps %%xmm1, %%xmm2           \n\t" /* a2 b2 a3 b3 */
+        " movlps %%xmm0, (%1)               \n\t"
+        " movhps %%xmm0, (%1,%2)            \n\t"
+        " lea (%1,%2,2), %0                 \n\t"
+        " movlps %%xmm2, (%0)               \n\t"
+        " movhps %%xmm2, (%0,%2)            \n\t"
+        : "=&r" (t)
+        : "r" (f), "r" (fs), "r" (p), "r" (o), "i" (sizeof(void*))
+        : "memory", "xmm0", "xmm1", "xmm2"
+    );
+}
+
+/* Two channels of eight frames of 16 bit samples. The samples of the
+ * first channel are sign extended in their 32 bit frames, those of the
+ * second channel shifted down, which lets the saturating pack put them
+ * back together unchanged. */
+static inline void deinterleave_s16_2x8(const uint8_t *f, void * const *p, pa_reg_x86 o) {
+    pa_reg_x86 t;
+
+    __asm__ __volatile__ (
+        " movdqu (%1), %%xmm0               \n\t"
+        " movdqu 16(%1), %%xmm1             \n\t"
+        " movdqa %%xmm0, %%xmm2             \n\t"
+        " movdqa %%xmm1, %%xmm3             \n\t"
+        " pslld $16, %%xmm2                 \n\t"
+        " pslld $16, %%xmm3                 \n\t"
+        " psrad $16, %%xmm2                 \n\t"
+        " psrad $16, %%xmm3                 \n\t"
+        " psrad $16, %%xmm0                 \n\t"
+        " psrad $16, %%xmm1                 \n\t"
+        " packssdw %%xmm3, %%xmm2           \n\t"
+        " packssdw %%xmm1, %%xmm0           \n\t"
+        " mov (%2), %0                      \n\t"
+        " movdqu %%xmm2, (%0,%3)            \n\t"
+        " mov %c4(%2), %0                   \n\t"
+        " movdqu %%xmm0, (%0,%3)            \n\t"
+        : "=&r" (t)
+        : "r" (f), "r" (p), "r" (o), "i" (sizeof(void*))
+        : "memory", "xmm0", "xmm1", "xmm2", "xmm3"
+    );
+}
+
+static inline void interleave_s16_2x8(uint8_t *f, const void * const *p, pa_reg_x86 o) {
+    pa_reg_x86 t;
+
+    __asm__ __volatile__ (
+        " mov (%2), %0                      \n\t"
+        " movdqu (%0,%3), %%xmm0            \n\t"
+        " mov %c4(%2), %0                   \n\t"
+        " movdqu (%0,%3), %%xmm1            \n\t"
+        " movdqa %%xmm0, %%xmm2             \n\t"
+        " punpcklwd %%xmm1, %%xmm0          \n\t"
+        " punpckhwd %%xmm1, %%xmm2          \n\t"
+        " movdqu %%xmm0, (%1)               \n\t"
+        " movdqu %%xmm2, 16(%1)             \n\t"
+        : "=&r" (t)
+        : "r" (f), "r" (p), "r" (o), "i" (sizeof(void*))
+        : "memory", "xmm0", "xmm1", "xmm2"
+    );
+}
+
+/* Everything the kernels don't cover, and the remainder */
+static pa_interleave_func_t interleave_fallback;
+static pa_deinterleave_func_t deinterleave_fallback;
+
+static void interleave_sse2(const void *src[], unsigned channels, void *dst, size_t ss, unsigned n) {
+    const void *s[PA_CHANNELS_MAX];
+    uint8_t *d = dst;
+    pa_reg_x86 fs = ss * channels, o = 0;
+    unsigned j = 0, c;
+
+    if (ss == 4 && channels <= 8 && channels % 2 == 0) {
+        for (; j + 4 <= n; j += 4, d += 4 * fs, o += 16) {
+            for (c = 0; c + 4 <= channels; c += 4)
+                interleave_4x4(d + c * 4, fs, src + c, o);
+
+            if (c < channels)
+                interleave_2x4(d + c * 4, fs, src + c, o);
+        }
+    } else if (ss == 2 && channels == 2) {
+        for (; j + 8 <= n; j += 8, d += 8 * fs, o += 16)
+            interleave_s16_2x8(d, src, o);
+    }
+
+    if (j == 0)
+        interleave_fallback(src, channels, dst, ss, n);
+    else if (j < n) {
+        for (c = 0; c < channels; c++)
+            s[c] = (const uint8_t*) src[c] + o;
+
+        interleave_fallback(s, channels, d, ss, n - j);
+    }
+}
+
+static void deinterleave_sse2(const void *src, void *dst[], unsigned channels, size_t ss, unsigned n) {
+    void *d[PA_CHANNELS_MAX];
+    const uint8_t *s = src;
+    pa_reg_x86 fs = ss * channels, o = 0;
+    unsigned j = 0, c;
+
+    if (ss == 4 && channels <= 8 && channels % 2 == 0) {
+        for (; j + 4 <= n; j += 4, s += 4 * fs, o += 16) {
+            for (c = 0; c + 4 <= channels; c += 4)
+                deinterleave_4x4(s + c * 4, fs, dst + c, o);
+
+            if (c < channels)
+                deinterleave_2x4(s + c * 4, fs, dst + c, o);
+        }
+    } else if (ss == 2 && channels == 2) {
+        for (; j + 8 <= n; j += 8, s += 8 * fs, o += 16)
+            deinterleave_s16_2x8(s, dst, o);
+    }
+
+    if (j == 0)
+        deinterleave_fallback(src, dst, channels, ss, n);
+    else if (j < n) {
+        for (c = 0; c < channels; c++)
+            d[c] = (uint8_t*) dst[c] + o;
+
+        deinterleave_fallback(s, d, channels, ss, n - j);
+    }
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_interleave_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+
+    if (flags & PA_CPU_X86_SSE2) {
+        pa_log_info("Initialising SSE2 optimized (de)interleaving.");
+
+        interleave_fallback = pa_get_interleave_func();
+        deinterleave_fallback = pa_get_deinterleave_func();
+
+        pa_set_interleave_func(interleave_sse2);
+        pa_set_deinterleave_func(deinterleave_sse2);
+    }
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
@@ -0,0 +1,520 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/msgobject.h>
+#include <pulsecore/refcnt.h>
+#include <pulsecore/shared.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+
+#include "io-executor.h"
+
+#define MAX_THREADS 4
+
+typedef struct pa_io_executor pa_io_executor;
+typedef struct io_thread io_thread;
+
+struct pa_io_executor_slot {
+    io_thread *thread;
+    pa_module *module;
+    char *name;
+
+    pa_io_executor_cb_t cb;
+    void *userdata;
+
+    bool started;
+
+    /* Only accessed from the I/O thread */
+    PA_LLIST_FIELDS(pa_io_executor_slot);
+    bool attached;
+
+    /* Set while the callback runs, and if the slot was woken up in the
+     * meantime */
+    bool running, woken;
+
+    /* When the callback is due, and the position in the heap of the
+     * thread, valid while scheduled */
+    pa_usec_t deadline;
+    unsigned heap_idx;
+    bool scheduled;
+
+    /* Links the due slots of one iteration of the thread loop */
+    pa_io_executor_slot *run_next;
+};
+
+struct io_thread {
+    pa_msgobject parent;
+
+    pa_io_executor *executor;
+    unsigned index;
+
+    pa_thread *thread;
+    pa_thread_mq thread_mq;
+    pa_rtpoll *rtpoll;
+
+    /* Number of slots assigned to this thread, only accessed from the
+     * main thread */
+    unsigned n_slots;
+
+    /* The started slots, only accessed from the I/O thread */
+    PA_LLIST_HEAD(pa_io_executor_slot, slots);
+
+    /* Binary min-heap of the scheduled slots, ordered by deadline, only
+     * accessed from the I/O thread */
+    pa_io_executor_slot **heap;
+    unsigned n_heap, max_heap;
+
+    /* Set when the loop failed, only accessed from the I/O thread */
+    bool failed;
+};
+
+PA_DEFINE_PRIVATE_CLASS(io_thread, pa_msgobject);
+#define IO_THREAD(o) (io_thread_cast(o))
+
+enum {
+    IO_THREAD_MESSAGE_ADD_SLOT,
+    IO_THREAD_MESSAGE_REMOVE_SLOT,
+};
+
+struct pa_io_executor {
+    PA_REFCNT_DECLARE;
+
+    pa_core *core;
+
+    io_thread *threads[MAX_THREADS];
+    unsigned n_threads, max_threads;
+};
+
+/* Called from I/O thread context. The device of s isn't clocked anymore,
+ * so its module has to go. */
+static void slot_unload_module(io_thread *t, pa_io_executor_slot *s) {
+    if (!s->module)
+        return;
+
+    pa_asyncmsgq_post(t->thread_mq.outq, PA_MSGOBJECT(t->executor->core), PA_CORE_MESSAGE_UNLOAD_MODULE, s->module, 0, NULL, NULL);
+}
+
+static void heap_set(io_thread *t, unsigned idx, pa_io_executor_slot *s) {
+    t->heap[idx] = s;
+    s->heap_idx = idx;
+}
+
+static void heap_sift_up(io_thread *t, unsigned idx) {
+    pa_io_executor_slot *s = t->heap[idx];
+
+    while (idx > 0) {
+        unsigned parent = (idx - 1) / 2;
+
+        if (t->heap[parent]->deadline <= s->deadline)
+            break;
+
+        heap_set(t, idx, t->heap[parent]);
+        idx = parent;
+    }
+
+    heap_set(t, idx, s);
+}
+
+static void heap_sift_down(io_thread *t, unsigned idx) {
+    pa_io_executor_slot *s = t->heap[idx];
+
+    for (;;) {
+        unsigned child = 2 * idx + 1;
+
+        if (child >= t->n_heap)
+            break;
+
+        if (child + 1 < t->n_heap && t->heap[child + 1]->deadline < t->heap[child]->deadline)
+            child++;
+
+        if (s->deadline <= t->heap[child]->deadline)
+            break;
+
+        heap_set(t, idx, t->heap[child]);
+        idx = child;
+    }
+
+    heap_set(t, idx, s);
+}
+
+/* Called from I/O thread context. Makes s due at the given time, or
+ * moves it there if it is already scheduled. */
+static void slot_schedule(io_thread *t, pa_io_executor_slot *s, pa_usec_t deadline) {
+    if (s->scheduled) {
+        pa_usec_t old = s->deadline;
+
+        s->deadline = deadline;
+
+        if (deadline < old)
+            heap_sift_up(t, s->heap_idx);
+        else
+            heap_sift_down(t, s->heap_idx);
+
+        return;
+    }
+
+    if (t->n_heap >= t->max_heap) {
+        t->max_heap = PA_MAX(t->max_heap * 2, 8U);
+        t->heap = pa_xrenew(pa_io_executor_slot*, t->heap, t->max_heap);
+    }
+
+    s->deadline = deadline;
+    s->scheduled = true;
+    heap_set(t, t->n_heap++, s);
+    heap_sift_up(t, s->heap_idx);
+}
+
+/* Called from I/O thread context */
+static void slot_unschedule(io_thread *t, pa_io_executor_slot *s) {
+    pa_io_executor_slot *last;
+    unsigned idx = s->heap_idx;
+
+    if (!s->scheduled)
+        return;
+
+    pa_assert(t->heap[idx] == s);
+    s->scheduled = false;
+
+    last = t->heap[--t->n_heap];
+
+    if (last == s)
+        return;
+
+    heap_set(t, idx, last);
+
+    if (idx > 0 && t->heap[(idx - 1) / 2]->deadline > last->deadline)
+        heap_sift_up(t, idx);
+    else
+        heap_sift_down(t, idx);
+}
+
+/* Called from I/O thread context */
+static int io_thread_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    io_thread *t = IO_THREAD(o);
+    pa_io_executor_slot *s = data;
+
+    io_thread_assert_ref(t);
+
+    switch (code) {
+        case IO_THREAD_MESSAGE_ADD_SLOT:
+            PA_LLIST_PREPEND(pa_io_executor_slot, t->slots, s);
+            s->attached = true;
+
+            if (t->failed)
+                slot_unload_module(t, s);
+            else
+                slot_schedule(t, s, pa_rtclock_now());
+
+            return 0;
+
+        case IO_THREAD_MESSAGE_REMOVE_SLOT:
+            slot_unschedule(t, s);
+            s->attached = false;
+            PA_LLIST_REMOVE(pa_io_executor_slot, t->slots, s);
+            return 0;
+    }
+
+    return 0;
+}
+
+static void thread_func(void *userdata) {
+    io_thread *t = userdata;
+    pa_io_executor_slot *s;
+
+    pa_assert(t);
+
+    pa_log_debug("Thread starting up");
+
+    pa_core_setup_io_thread(t->executor->core, NULL);
+
+    pa_thread_mq_install(&t->thread_mq);
+
+    for (;;) {
+        pa_io_executor_slot *run = NULL;
+        int ret;
+
+        /* Only the slots that are due are run, each of them once. Take
+         * them all out first, so that a slot that is already late again
+         * can't keep the others waiting. */
+        if (t->n_heap > 0) {
+            pa_usec_t now = pa_rtclock_now();
+
+            while (t->n_heap > 0 && t->heap[0]->deadline <= now) {
+                s = t->heap[0];
+                slot_unschedule(t, s);
+
+                s->run_next = run;
+                run = s;
+            }
+        }
+
+        while ((s = run)) {
+            pa_usec_t next;
+
+            run = s->run_next;
+
+            s->running = true;
+            s->woken = false;
+            next = s->cb(s, s->userdata);
+            s->running = false;
+
+            if (s->woken)
+                slot_schedule(t, s, pa_rtclock_now());
+            else if (next > 0)
+                slot_schedule(t, s, next);
+        }
+
+        if (t->n_heap > 0)
+            pa_rtpoll_set_timer_absolute(t->rtpoll, t->heap[0]->deadline);
+        else
+            pa_rtpoll_set_timer_disabled(t->rtpoll);
+
+        if ((ret = pa_rtpoll_run(t->rtpoll)) < 0)
+            goto fail;
+
+        if (ret == 0)
+            goto finish;
+    }
+
+fail:
+    /* If this was no regular exit from the loop we have to continue
+     * processing messages until we received PA_MESSAGE_SHUTDOWN. The
+     * attached devices will not be clocked anymore, so their modules are
+     * unloaded, and so are those of devices that are started later. */
+    pa_log_error("I/O thread %u failed.", t->index);
+    t->failed = true;
+
+    PA_LLIST_FOREACH(s, t->slots)
+        slot_unload_module(t, s);
+
+    pa_asyncmsgq_wait_for(t->thread_mq.inq, PA_MESSAGE_SHUTDOWN);
+
+finish:
+    pa_log_debug("Thread shutting down");
+}
+
+static void io_thread_free(io_thread *t) {
+    pa_assert(t);
+    pa_assert(t->n_slots == 0);
+
+    if (t->thread) {
+        pa_asyncmsgq_send(t->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+        pa_thread_free(t->thread);
+    }
+
+    pa_thread_mq_done(&t->thread_mq);
+    pa_rtpoll_free(t->rtpoll);
+
+    pa_xfree(t->heap);
+    io_thread_unref(t);
+}
+
+static io_thread *io_thread_new(pa_io_executor *e, unsigned index) {
+    io_thread *t;
+    char name[16];
+
+    t = pa_msgobject_new(io_thread);
+    t->parent.process_msg = io_thread_process_msg;
+    t->executor = e;
+    t->index = index;
+    t->thread = NULL;
+    t->n_slots = 0;
+    PA_LLIST_HEAD_INIT(pa_io_executor_slot, t->slots);
+    t->heap = NULL;
+    t->n_heap = t->max_heap = 0;
+    t->failed = false;
+
+    t->rtpoll = pa_rtpoll_new();
+
+    if (pa_thread_mq_init(&t->thread_mq, e->core->mainloop, t->rtpoll) < 0) {
+        pa_log("pa_thread_mq_init() failed.");
+        pa_rtpoll_free(t->rtpoll);
+        io_thread_unref(t);
+        return NULL;
+    }
+
+    pa_snprintf(name, sizeof(name), "io-executor-%u", index);
+
+    if (!(t->thread = pa_thread_new(name, thread_func, t))) {
+        pa_log("Failed to create thread.");
+        io_thread_free(t);
+        return NULL;
+    }
+
+    return t;
+}
+
+static pa_io_executor *io_executor_new(pa_core *c) {
+    pa_io_executor *e;
+
+    pa_assert(c);
+
+    e = pa_xnew0(pa_io_executor, 1);
+    PA_REFCNT_INIT(e);
+    e->core = c;
+    e->max_threads = PA_CLAMP(pa_ncpus(), 1U, MAX_THREADS);
+
+    pa_assert_se(pa_shared_set(c, "io-executor", e) >= 0);
+
+    return e;
+}
+
+static pa_io_executor *io_executor_get(pa_core *c) {
+    pa_io_executor *e;
+
+    if ((e = pa_shared_get(c, "io-executor"))) {
+        PA_REFCNT_INC(e);
+        return e;
+    }
+
+    return io_executor_new(c);
+}
+
+static void io_executor_unref(pa_io_executor *e) {
+    unsigned k;
+
+    pa_assert(e);
+    pa_assert(PA_REFCNT_VALUE(e) >= 1);
+
+    if (PA_REFCNT_DEC(e) > 0)
+        return;
+
+    for (k = 0; k < e->n_threads; k++)
+        io_thread_free(e->threads[k]);
+
+    pa_assert_se(pa_shared_remove(e->core, "io-executor") >= 0);
+    pa_xfree(e);
+}
+
+/* Spread the slots evenly over the threads, and start a new thread
+ * only when every running thread is already in use */
+static io_thread *io_executor_pick_thread(pa_io_executor *e) {
+    io_thread *best = NULL;
+    unsigned k;
+
+    for (k = 0; k < e->n_threads; k++)
+        if (!best || e->threads[k]->n_slots < best->n_slots)
+            best = e->threads[k];
+
+    if ((!best || best->n_slots > 0) && e->n_threads < e->max_threads) {
+        io_thread *t;
+
+        if ((t = io_thread_new(e, e->n_threads))) {
+            e->threads[e->n_threads++] = t;
+            return t;
+        }
+    }
+
+    return best;
+}
+
+pa_io_executor_slot *pa_io_executor_slot_new(pa_core *c, pa_module *m, const char *name, pa_io_executor_cb_t cb, void *userdata) {
+    pa_io_executor *e;
+    pa_io_executor_slot *s;
+    io_thread *t;
+
+    pa_assert(c);
+    pa_assert(name);
+    pa_assert(cb);
+    pa_assert_ctl_context();
+
+    e = io_executor_get(c);
+
+    if (!(t = io_executor_pick_thread(e))) {
+        io_executor_unref(e);
+        return NULL;
+    }
+
+    s = pa_xnew0(pa_io_executor_slot, 1);
+    s->thread = t;
+    s->module = m;
+    s->name = pa_xstrdup(name);
+    s->cb = cb;
+    s->userdata = userdata;
+
+    t->n_slots++;
+
+    pa_log_debug("Attached %s to I/O thread %u, which now has %u slots.", name, t->index, t->n_slots);
+
+    return s;
+}
+
+void pa_io_executor_slot_start(pa_io_executor_slot *s) {
+    pa_assert(s);
+    pa_assert(!s->started);
+    pa_assert_ctl_context();
+
+    pa_assert_se(pa_asyncmsgq_send(s->thread->thread_mq.inq, PA_MSGOBJECT(s->thread), IO_THREAD_MESSAGE_ADD_SLOT, s, 0, NULL) == 0);
+    s->started = true;
+}
+
+void pa_io_executor_slot_free(pa_io_executor_slot *s) {
+    io_thread *t;
+
+    pa_assert(s);
+    pa_assert_ctl_context();
+
+    t = s->thread;
+
+    if (s->started)
+        pa_assert_se(pa_asyncmsgq_send(t->thread_mq.inq, PA_MSGOBJECT(t), IO_THREAD_MESSAGE_REMOVE_SLOT, s, 0, NULL) == 0);
+
+    pa_assert(t->n_slots > 0);
+    t->n_slots--;
+
+    io_executor_unref(t->executor);
+
+    pa_xfree(s->name);
+    pa_xfree(s);
+}
+
+void pa_io_executor_slot_wakeup(pa_io_executor_slot *s) {
+    pa_assert(s);
+
+    /* Not started yet, or stopped: the callback is run once the slot
+     * is started anyway */
+    if (!s->attached || s->thread->failed)
+        return;
+
+    if (s->running)
+        s->woken = true;
+    else
+        slot_schedule(s->thread, s, pa_rtclock_now());
+}
+
+pa_asyncmsgq *pa_io_executor_slot_get_asyncmsgq(pa_io_executor_slot *s) {
+    pa_assert(s);
+
+    return s->thread->thread_mq.inq;
+}
+
+pa_rtpoll *pa_io_executor_slot_get_rtpoll(pa_io_executor_slot *s) {
+    pa_assert(s);
+
+    return s->thread->rtpoll;
+}
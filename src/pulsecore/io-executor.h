@@ -0,0 +1,61 @@
+#ifndef foopulseioexecutorhfoo
+#define foopulseioexecutorhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <pulse/sample.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/asyncmsgq.h>
+#include <pulsecore/module.h>
+#include <pulsecore/rtpoll.h>
+
+/* A small pool of I/O threads that are shared by lightweight,
+ * timer driven devices, so that each of them doesn't need a thread of
+ * its own. Every thread runs a single rtpoll and a thread_mq; devices
+ * attached to a thread use these as their asyncmsgq and rtpoll. */
+
+typedef struct pa_io_executor_slot pa_io_executor_slot;
+
+/* Called from the I/O thread once the slot was started, whenever the
+ * time it asked for has come, and after pa_io_executor_slot_wakeup().
+ * Returns the absolute time (in pa_rtclock_now() terms) at which the
+ * slot needs to be called again, or 0 if no timer is needed. Other
+ * slots on the same thread are not called along with it. */
+typedef pa_usec_t (*pa_io_executor_cb_t)(pa_io_executor_slot *s, void *userdata);
+
+/* Create a slot on one of the shared threads. The callback is not run
+ * before pa_io_executor_slot_start() is called, which should happen
+ * after the device was put. If the thread fails, m is unloaded, unless
+ * it is NULL. */
+pa_io_executor_slot *pa_io_executor_slot_new(pa_core *c, pa_module *m, const char *name, pa_io_executor_cb_t cb, void *userdata);
+
+/* Should be called after the device was unlinked */
+void pa_io_executor_slot_free(pa_io_executor_slot *s);
+
+void pa_io_executor_slot_start(pa_io_executor_slot *s);
+
+/* Called from the I/O thread. Makes the callback of s run on the next
+ * iteration of the loop, for example after a message for the device
+ * changed its state or a rewind was requested. */
+void pa_io_executor_slot_wakeup(pa_io_executor_slot *s);
+
+pa_asyncmsgq *pa_io_executor_slot_get_asyncmsgq(pa_io_executor_slot *s);
+pa_rtpoll *pa_io_executor_slot_get_rtpoll(pa_io_executor_slot *s);
+
+#endif
@@ -476,6 +476,30 @@ int pa_modargs_get_resample_method(pa_modargs *ma, pa_resample_method_t *rmethod
     return 0;
 }
 
+int pa_modargs_get_io_thread_config(pa_modargs *ma, pa_io_thread_config *cfg) {
+    const char *cpus;
+    int32_t offset;
+
+    pa_assert(ma);
+    pa_assert(cfg);
+
+    if ((cpus = pa_modargs_get_value(ma, "thread_cpu_affinity", NULL))) {
+        if (!pa_streq(cpus, "isolated") && pa_parse_cpu_list(cpus, NULL, 0) < 0)
+            return -1;
+
+        pa_xfree(cfg->cpu_affinity);
+        cfg->cpu_affinity = pa_xstrdup(cpus);
+    }
+
+    offset = cfg->priority_offset;
+    if (pa_modargs_get_value_s32(ma, "thread_priority_offset", &offset) < 0)
+        return -1;
+
+    cfg->priority_offset = offset;
+
+    return 0;
+}
+
 int pa_modargs_get_sample_spec_and_channel_map(
         pa_modargs *ma,
         pa_sample_spec *rss,
@@ -27,6 +27,7 @@
 #include <pulse/volume.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/resampler.h>
+#include <pulsecore/core.h>
 
 typedef struct pa_modargs pa_modargs;
 
@@ -86,6 +87,11 @@ int pa_modargs_get_alternate_sample_rate(pa_modargs *ma, uint32_t *alternate_rat
 
 int pa_modargs_get_proplist(pa_modargs *ma, const char *name, pa_proplist *p, pa_update_mode_t m);
 
+/* Read the I/O thread configuration from the "thread_cpu_affinity" and
+ * "thread_priority_offset" arguments. Fields whose argument was not
+ * specified remain unchanged. */
+int pa_modargs_get_io_thread_config(pa_modargs *ma, pa_io_thread_config *cfg);
+
 /* Iterate through the module argument list. The user should allocate a
  * state variable of type void* and initialize it with NULL. A pointer
  * to this variable should then be passed to pa_modargs_iterate()
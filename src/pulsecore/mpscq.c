@@ -0,0 +1,178 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/fdsem.h>
+#include <pulsecore/macro.h>
+
+#include "mpscq.h"
+
+struct pa_mpscq {
+    /* Written by all producers */
+    pa_atomic_ptr_t head;
+
+    /* Only touched by the consumer */
+    pa_mpscq_node *tail;
+
+    pa_mpscq_node stub;
+    pa_fdsem *fdsem;
+};
+
+pa_mpscq* pa_mpscq_new(void) {
+    pa_mpscq *q;
+
+    q = pa_xnew0(pa_mpscq, 1);
+
+    if (!(q->fdsem = pa_fdsem_new())) {
+        pa_xfree(q);
+        return NULL;
+    }
+
+    pa_atomic_ptr_store(&q->stub.next, NULL);
+    pa_atomic_ptr_store(&q->head, &q->stub);
+    q->tail = &q->stub;
+
+    return q;
+}
+
+void pa_mpscq_free(pa_mpscq *q) {
+    pa_assert(q);
+    pa_assert(pa_mpscq_is_empty(q));
+
+    pa_fdsem_free(q->fdsem);
+    pa_xfree(q);
+}
+
+static void link_node(pa_mpscq *q, pa_mpscq_node *n) {
+    pa_mpscq_node *prev;
+
+    pa_atomic_ptr_store(&n->next, NULL);
+
+    /* Atomically swap ourselves in as the new head. Between this and
+     * linking the previous head to us the queue is briefly
+     * disconnected, which the consumer has to deal with. */
+    do {
+        prev = pa_atomic_ptr_load(&q->head);
+    } while (!pa_atomic_ptr_cmpxchg(&q->head, prev, n));
+
+    pa_atomic_ptr_store(&prev->next, n);
+}
+
+void pa_mpscq_push(pa_mpscq *q, pa_mpscq_node *n) {
+    pa_assert(q);
+    pa_assert(n);
+
+    link_node(q, n);
+    pa_fdsem_post(q->fdsem);
+}
+
+static pa_mpscq_node *try_pop(pa_mpscq *q) {
+    pa_mpscq_node *tail, *next;
+
+    tail = q->tail;
+    next = pa_atomic_ptr_load(&tail->next);
+
+    if (tail == &q->stub) {
+        if (!next)
+            return NULL;
+
+        q->tail = tail = next;
+        next = pa_atomic_ptr_load(&tail->next);
+    }
+
+    if (next) {
+        q->tail = next;
+        return tail;
+    }
+
+    /* A producer is between swapping the head and linking its node */
+    if (tail != pa_atomic_ptr_load(&q->head))
+        return NULL;
+
+    /* tail is the last node, put the stub behind it so that we can
+     * hand it out */
+    link_node(q, &q->stub);
+
+    if ((next = pa_atomic_ptr_load(&tail->next))) {
+        q->tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
+
+pa_mpscq_node* pa_mpscq_pop(pa_mpscq *q, bool wait_op) {
+    pa_mpscq_node *n;
+
+    pa_assert(q);
+
+    while (!(n = try_pop(q))) {
+        if (!wait_op)
+            return NULL;
+
+        pa_fdsem_wait(q->fdsem);
+    }
+
+    return n;
+}
+
+bool pa_mpscq_is_empty(pa_mpscq *q) {
+    pa_assert(q);
+
+    return q->tail == &q->stub && !pa_atomic_ptr_load(&q->stub.next);
+}
+
+int pa_mpscq_read_fd(pa_mpscq *q) {
+    pa_assert(q);
+
+    return pa_fdsem_get(q->fdsem);
+}
+
+/* Whether try_pop() would hand out a node. One that is still being
+ * pushed doesn't count: its producer posts the fdsem once it is linked,
+ * so the consumer can go to sleep until then instead of spinning. */
+static bool can_pop(pa_mpscq *q) {
+    pa_mpscq_node *tail = q->tail;
+
+    if (tail == &q->stub && !(tail = pa_atomic_ptr_load(&q->stub.next)))
+        return false;
+
+    return pa_atomic_ptr_load(&tail->next) || tail == pa_atomic_ptr_load(&q->head);
+}
+
+int pa_mpscq_read_before_poll(pa_mpscq *q) {
+    pa_assert(q);
+
+    for (;;) {
+        if (can_pop(q))
+            return -1;
+
+        if (pa_fdsem_before_poll(q->fdsem) >= 0)
+            return 0;
+    }
+}
+
+void pa_mpscq_read_after_poll(pa_mpscq *q) {
+    pa_assert(q);
+
+    pa_fdsem_after_poll(q->fdsem);
+}
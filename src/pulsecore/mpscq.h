@@ -0,0 +1,61 @@
+#ifndef foopulsempscqhfoo
+#define foopulsempscqhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/macro.h>
+
+/* An unbounded, intrusive, lock-free multiple-producer single-consumer
+ * queue (after Dmitry Vyukov's MPSC node-based queue). Pushing never
+ * fails and never blocks, since the queue links the nodes that are
+ * embedded in the queued objects instead of storing them in a fixed
+ * size ring. Any number of threads may push concurrently, but only a
+ * single thread may pop.
+ *
+ * The consumer can sleep on an fdsem (pa_mpscq_read_fd() and friends),
+ * which is signalled whenever something is pushed and the consumer
+ * is waiting. */
+
+typedef struct pa_mpscq_node {
+    pa_atomic_ptr_t next;
+} pa_mpscq_node;
+
+typedef struct pa_mpscq pa_mpscq;
+
+pa_mpscq* pa_mpscq_new(void);
+/* The queue must be empty when it is freed */
+void pa_mpscq_free(pa_mpscq *q);
+
+/* May be called from any thread */
+void pa_mpscq_push(pa_mpscq *q, pa_mpscq_node *n);
+
+/* Consumer side only. Returns NULL if the queue is empty, or if the
+ * producer of the next node is still in the middle of pushing it. In
+ * the latter case the consumer will be woken up once the push is
+ * complete. */
+pa_mpscq_node* pa_mpscq_pop(pa_mpscq *q, bool wait);
+bool pa_mpscq_is_empty(pa_mpscq *q);
+
+int pa_mpscq_read_fd(pa_mpscq *q);
+/* Returns -1 if a node can be popped right away, 0 once the fdsem is
+ * armed. A push that is still in progress arms it too. */
+int pa_mpscq_read_before_poll(pa_mpscq *q);
+void pa_mpscq_read_after_poll(pa_mpscq *q);
+
+#endif
@@ -2495,6 +2495,10 @@ static void setup_srbchannel(pa_native_connection *c, pa_mem_type_t shm_type) {
         goto fail;
     }
     pa_log_debug("Enabling srbchannel...");
+    /* Our end of the channel is served by the main loop, not by an I/O
+     * thread of its own. Any time spent spinning here is taken from all
+     * other clients and modules, hence this stays off unless asked for. */
+    pa_srbchannel_set_busy_poll(srb, c->options->srbchannel_busy_poll_usec);
     pa_srbchannel_export(srb, &srbt);
 
     /* Send enable command to client */
@@ -3135,6 +3139,21 @@ static void fixup_sample_spec(pa_native_connection *c, pa_sample_spec *fixed, co
     }
 }
 
+/* Put the device proplist, with the I/O thread timing statistics added */
+static void device_put_proplist(pa_tagstruct *t, pa_proplist *proplist, const pa_rtpoll_stats *stats) {
+    pa_proplist *pl;
+
+    if (!stats) {
+        pa_tagstruct_put_proplist(t, proplist);
+        return;
+    }
+
+    pl = pa_proplist_copy(proplist);
+    pa_rtpoll_stats_to_proplist(stats, pl);
+    pa_tagstruct_put_proplist(t, pl);
+    pa_proplist_free(pl);
+}
+
 static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink *sink) {
     pa_sample_spec fixed_ss;
 
@@ -3161,7 +3180,9 @@ static void sink_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sin
         PA_TAG_INVALID);
 
     if (c->version >= 13) {
-        pa_tagstruct_put_proplist(t, sink->proplist);
+        pa_rtpoll_stats stats;
+
+        device_put_proplist(t, sink->proplist, pa_sink_get_rtpoll_stats(sink, &stats) >= 0 ? &stats : NULL);
         pa_tagstruct_put_usec(t, pa_sink_get_requested_latency(sink));
     }
 
@@ -3231,7 +3252,9 @@ static void source_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_s
         PA_TAG_INVALID);
 
     if (c->version >= 13) {
-        pa_tagstruct_put_proplist(t, source->proplist);
+        pa_rtpoll_stats stats;
+
+        device_put_proplist(t, source->proplist, pa_source_get_rtpoll_stats(source, &stats) >= 0 ? &stats : NULL);
         pa_tagstruct_put_usec(t, pa_source_get_requested_latency(source));
     }
 
@@ -3358,6 +3381,42 @@ static void module_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_m
         pa_tagstruct_put_proplist(t, module->proplist);
 }
 
+/* Adds the transport statistics of the connection the stream belongs to */
+static void stream_add_srbchannel_stats(pa_native_protocol *p, pa_client *client, pa_proplist *pl) {
+    pa_native_connection *c;
+    pa_srbchannel *srb;
+    pa_srbchannel_stats stats;
+    uint32_t idx;
+
+    if (!client)
+        return;
+
+    PA_IDXSET_FOREACH(c, p->connections, idx)
+        if (c->client == client)
+            break;
+
+    if (!c || !(srb = pa_pstream_get_srbchannel(c->pstream)))
+        return;
+
+    pa_srbchannel_get_stats(srb, &stats);
+    pa_proplist_setf(pl, PA_PROP_SRBCHANNEL_WAKEUPS, "%llu", (unsigned long long) stats.wakeups);
+    pa_proplist_setf(pl, PA_PROP_SRBCHANNEL_SPIN_HITS, "%llu", (unsigned long long) stats.spin_hits);
+    pa_proplist_setf(pl, PA_PROP_SRBCHANNEL_SPIN_MISSES, "%llu", (unsigned long long) stats.spin_misses);
+}
+
+/* resampler_level is negative for streams that have no resample
+ * quality governor watching them */
+static void stream_put_proplist(pa_native_connection *c, pa_tagstruct *t, pa_client *client, pa_proplist *proplist, int resampler_level) {
+    pa_proplist *pl;
+
+    pl = pa_proplist_copy(proplist);
+    stream_add_srbchannel_stats(c->protocol, client, pl);
+    if (resampler_level >= 0)
+        pa_proplist_setf(pl, PA_PROP_RESAMPLER_QUALITY_LEVEL, "%i", resampler_level);
+    pa_tagstruct_put_proplist(t, pl);
+    pa_proplist_free(pl);
+}
+
 static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t, pa_sink_input *s) {
     pa_sample_spec fixed_ss;
     pa_usec_t sink_latency;
@@ -3390,7 +3449,8 @@ static void sink_input_fill_tagstruct(pa_native_connection *c, pa_tagstruct *t,
     if (c->version >= 11)
         pa_tagstruct_put_boolean(t, s->muted);
     if (c->version >= 13)
-        pa_tagstruct_put_proplist(t, s->proplist);
+        stream_put_proplist(c, t, s->client, s->proplist,
+                            c->protocol->core->resample_quality_governor ? (int) pa_sink_input_get_resampler_level(s) : -1);
     if (c->version >= 19)
         pa_tagstruct_put_boolean(t, s->state == PA_SINK_INPUT_CORKED);
     if (c->version >= 20) {
@@ -3430,7 +3490,7 @@ static void source_output_fill_tagstruct(pa_native_connection *c, pa_tagstruct *
     pa_tagstruct_puts(t, pa_resample_method_to_string(pa_source_output_get_resample_method(s)));
     pa_tagstruct_puts(t, s->driver);
     if (c->version >= 13)
-        pa_tagstruct_put_proplist(t, s->proplist);
+        stream_put_proplist(c, t, s->client, s->proplist, -1);
     if (c->version >= 19)
         pa_tagstruct_put_boolean(t, s->state == PA_SOURCE_OUTPUT_CORKED);
     if (c->version >= 22) {
@@ -5377,6 +5437,7 @@ void pa_native_options_unref(pa_native_options *o) {
 int pa_native_options_parse(pa_native_options *o, pa_core *c, pa_modargs *ma) {
     bool enabled;
     const char *acl;
+    uint32_t busy_poll_usec;
 
     pa_assert(o);
     pa_assert(PA_REFCNT_VALUE(o) >= 1);
@@ -5388,6 +5449,13 @@ int pa_native_options_parse(pa_native_options *o, pa_core *c, pa_modargs *ma) {
         return -1;
     }
 
+    busy_poll_usec = 0;
+    if (pa_modargs_get_value_u32(ma, "srbchannel-busy-poll-usec", &busy_poll_usec) < 0) {
+        pa_log("srbchannel-busy-poll-usec= expects an unsigned integer argument.");
+        return -1;
+    }
+    o->srbchannel_busy_poll_usec = busy_poll_usec;
+
     if (pa_modargs_get_value_boolean(ma, "auth-anonymous", &o->auth_anonymous) < 0) {
         pa_log("auth-anonymous= expects a boolean argument.");
         return -1;
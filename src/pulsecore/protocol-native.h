@@ -43,6 +43,7 @@ typedef struct pa_native_options {
 
     bool auth_anonymous;
     bool srbchannel;
+    pa_usec_t srbchannel_busy_poll_usec;
     char *auth_group;
     pa_ip_acl *auth_ip_acl;
     pa_auth_cookie *auth_cookie;
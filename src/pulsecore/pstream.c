@@ -1280,3 +1280,10 @@ void pa_pstream_set_srbchannel(pa_pstream *p, pa_srbchannel *srb) {
     else
         do_write(p);
 }
+
+pa_srbchannel *pa_pstream_get_srbchannel(pa_pstream *p) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    return p->srb;
+}
@@ -72,5 +72,7 @@ bool pa_pstream_get_memfd(pa_pstream *p);
 /* Enables shared ringbuffer channel. Note that the srbchannel is now owned by the pstream.
    Setting srb to NULL will free any existing srbchannel. */
 void pa_pstream_set_srbchannel(pa_pstream *p, pa_srbchannel *srb);
+/* Returns the srbchannel currently in use, or NULL */
+pa_srbchannel *pa_pstream_get_srbchannel(pa_pstream *p);
 
 #endif
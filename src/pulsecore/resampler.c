@@ -424,8 +424,14 @@ pa_resampler* pa_resampler_new(
         pa_log_debug("  lfe filter activated (LR4 type), the crossover_freq = %uHz", crossover_freq);
     }
 
-    /* initialize implementation */
-    if (init_table[method](r) < 0)
+    /* initialize implementation, integer ratios have a cheaper one
+     * than the generic speex float resampler */
+    if (method >= PA_RESAMPLER_SPEEX_FLOAT_BASE && method <= PA_RESAMPLER_SPEEX_FLOAT_MAX &&
+        !(flags & (PA_RESAMPLER_VARIABLE_RATE | PA_RESAMPLER_NO_FAST_PATH)) &&
+        pa_resampler_polyphase_usable(a->rate, b->rate)) {
+        if (pa_resampler_polyphase_init(r) < 0)
+            goto fail;
+    } else if (init_table[method](r) < 0)
         goto fail;
 
     return r;
@@ -476,6 +482,24 @@ void pa_resampler_set_input_rate(pa_resampler *r, uint32_t rate) {
     r->impl.update_rates(r);
 }
 
+int pa_resampler_set_method(pa_resampler *r, pa_resample_method_t method) {
+    pa_assert(r);
+    pa_assert(method >= 0 && method < PA_RESAMPLER_MAX);
+
+    if (r->method == method)
+        return 0;
+
+    if (!r->impl.change_method || r->impl.change_method(r, method) < 0)
+        return -1;
+
+    pa_log_debug("Switched resampler from %s to %s.",
+                 pa_resample_method_to_string(r->method), pa_resample_method_to_string(method));
+
+    r->method = method;
+
+    return 0;
+}
+
 void pa_resampler_set_output_rate(pa_resampler *r, uint32_t rate) {
     pa_assert(r);
     pa_assert(rate > 0);
@@ -31,17 +31,6 @@
 typedef struct pa_resampler pa_resampler;
 typedef struct pa_resampler_impl pa_resampler_impl;
 
-struct pa_resampler_impl {
-    void (*free)(pa_resampler *r);
-    void (*update_rates)(pa_resampler *r);
-
-    /* Returns the number of leftover frames in the input buffer. */
-    unsigned (*resample)(pa_resampler *r, const pa_memchunk *in, unsigned in_n_frames, pa_memchunk *out, unsigned *out_n_frames);
-
-    void (*reset)(pa_resampler *r);
-    void *data;
-};
-
 typedef enum pa_resample_method {
     PA_RESAMPLER_INVALID                 = -1,
     PA_RESAMPLER_SRC_SINC_BEST_QUALITY   = 0, /* = SRC_SINC_BEST_QUALITY */
@@ -64,12 +53,35 @@ typedef enum pa_resample_method {
     PA_RESAMPLER_MAX
 } pa_resample_method_t;
 
+struct pa_resampler_impl {
+    void (*free)(pa_resampler *r);
+
+    /* Called when the input or output rate changed. Implementations
+     * that support PA_RESAMPLER_VARIABLE_RATE must keep their filter
+     * history and the position between two input frames here, since
+     * the rate may be nudged many times per second. */
+    void (*update_rates)(pa_resampler *r);
+
+    /* Returns the number of leftover frames in the input buffer. */
+    unsigned (*resample)(pa_resampler *r, const pa_memchunk *in, unsigned in_n_frames, pa_memchunk *out, unsigned *out_n_frames);
+
+    void (*reset)(pa_resampler *r);
+
+    /* Switches to another method of the same implementation, keeping
+     * the filter state. Returns negative if that is not possible. May
+     * be NULL. */
+    int (*change_method)(pa_resampler *r, pa_resample_method_t method);
+
+    void *data;
+};
+
 typedef enum pa_resample_flags {
     PA_RESAMPLER_VARIABLE_RATE = 0x0001U,
     PA_RESAMPLER_NO_REMAP      = 0x0002U,  /* implies NO_REMIX */
     PA_RESAMPLER_NO_REMIX      = 0x0004U,
     PA_RESAMPLER_NO_LFE        = 0x0008U,
     PA_RESAMPLER_NO_FILL_SINK  = 0x0010U,
+    PA_RESAMPLER_NO_FAST_PATH  = 0x0020U,  /* always use the generic implementation of the method */
 } pa_resample_flags_t;
 
 struct pa_resampler {
@@ -137,10 +149,13 @@ size_t pa_resampler_max_block_size(pa_resampler *r);
 /* Pass the specified memory chunk to the resampler and return the newly resampled data */
 void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out);
 
-/* Change the input rate of the resampler object */
+/* Change the input rate of the resampler object. For resamplers
+ * created with PA_RESAMPLER_VARIABLE_RATE this is cheap and continues
+ * the stream seamlessly, so it may be called for every block. */
 void pa_resampler_set_input_rate(pa_resampler *r, uint32_t rate);
 
-/* Change the output rate of the resampler object */
+/* Change the output rate of the resampler object, see
+ * pa_resampler_set_input_rate() */
 void pa_resampler_set_output_rate(pa_resampler *r, uint32_t rate);
 
 /* Reinitialize state of the resampler, possibly due to seeking or other discontinuities */
@@ -152,6 +167,11 @@ void pa_resampler_rewind(pa_resampler *r, size_t out_frames);
 /* Return the resampling method of the resampler object */
 pa_resample_method_t pa_resampler_get_method(pa_resampler *r);
 
+/* Switch to another quality of the same resampler implementation
+ * without interrupting the stream. Returns negative if the
+ * implementation can't do that. */
+int pa_resampler_set_method(pa_resampler *r, pa_resample_method_t method);
+
 /* Try to parse the resampler method */
 pa_resample_method_t pa_parse_resample_method(const char *string);
 
@@ -173,6 +193,18 @@ int pa_resampler_peaks_init(pa_resampler *r);
 int pa_resampler_speex_init(pa_resampler *r);
 int pa_resampler_trivial_init(pa_resampler*r);
 int pa_resampler_soxr_init(pa_resampler *r);
+int pa_resampler_polyphase_init(pa_resampler *r);
+
+/* True if the polyphase resampler can convert between these rates,
+ * i.e. if their ratio is made of small integers */
+bool pa_resampler_polyphase_usable(uint32_t rate_a, uint32_t rate_b);
+
+/* The dot product at the heart of the polyphase resampler. n is a
+ * multiple of 4, a and b need not be aligned. */
+typedef float (*pa_polyphase_dot_func_t)(const float *a, const float *b, unsigned n);
+
+pa_polyphase_dot_func_t pa_get_polyphase_dot_func(void);
+void pa_set_polyphase_dot_func(pa_polyphase_dot_func_t func);
 
 /* Resampler-specific quirks */
 bool pa_speex_is_fixed_point(void);
@@ -57,11 +57,12 @@ static unsigned libsamplerate_resample(pa_resampler *r, const pa_memchunk *input
 }
 
 static void libsamplerate_update_rates(pa_resampler *r) {
-    SRC_STATE *state;
     pa_assert(r);
 
-    state = r->impl.data;
-    pa_assert_se(src_set_ratio(state, (double) r->o_ss.rate / r->i_ss.rate) == 0);
+    /* Nothing to do here: libsamplerate_resample() passes the new
+     * ratio to src_process(), which glides from the old ratio to the
+     * new one over the next block. src_set_ratio() would make it jump
+     * instead. */
 }
 
 static void libsamplerate_reset(pa_resampler *r) {
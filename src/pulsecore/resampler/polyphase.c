@@ -0,0 +1,294 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/resampler.h>
+
+/* A polyphase FIR resampler for ratios up/down with small up and down,
+ * such as 48 kHz <-> 96 kHz or 16 kHz -> 48 kHz. It stands in for the
+ * speex float resamplers when the rates allow it, so the filter is
+ * designed after the speex quality settings. Each output frame costs
+ * one dot product of 'taps' floats per channel, and those dot products
+ * are done by a replaceable (SIMD) function. */
+
+#define MAX_FACTOR 8
+
+struct quality {
+    unsigned base_length;
+    double downsample_bandwidth;
+    double upsample_bandwidth;
+    double beta; /* of the Kaiser window */
+};
+
+/* The same filter lengths and bandwidths as the speex qualities 0-10 */
+static const struct quality quality_map[] = {
+    {   8, 0.830, 0.860,  6.0 },
+    {  16, 0.850, 0.880,  6.0 },
+    {  32, 0.882, 0.910,  6.0 },
+    {  48, 0.895, 0.917,  8.0 },
+    {  64, 0.921, 0.940,  8.0 },
+    {  80, 0.922, 0.940, 10.0 },
+    {  96, 0.940, 0.945, 10.0 },
+    { 128, 0.950, 0.950, 10.0 },
+    { 160, 0.960, 0.960, 10.0 },
+    { 192, 0.968, 0.968, 12.0 },
+    { 256, 0.975, 0.975, 12.0 },
+};
+
+struct polyphase_data { /* data specific to the polyphase resampler */
+    unsigned up, down;
+
+    /* Filter taps per phase, a multiple of 4. The coefficients of each
+     * phase are stored in reverse order, so that they line up with the
+     * input frames they are applied to. */
+    unsigned taps;
+    float *kernel;
+
+    /* Phase and input frame (relative to the next block) of the next
+     * output frame */
+    unsigned phase;
+    unsigned index;
+
+    /* The last taps - 1 input frames of each channel */
+    float *history;
+
+    /* Deinterleaved history and input block */
+    float *buf;
+    size_t buf_size;
+};
+
+static float dot_c(const float *a, const float *b, unsigned n) {
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    unsigned i;
+
+    /* Four partial sums, added up in the same order as the SIMD
+     * versions do */
+    for (i = 0; i < n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i+1] * b[i+1];
+        s2 += a[i+2] * b[i+2];
+        s3 += a[i+3] * b[i+3];
+    }
+
+    return (s0 + s2) + (s1 + s3);
+}
+
+static pa_polyphase_dot_func_t dot_func = dot_c;
+
+pa_polyphase_dot_func_t pa_get_polyphase_dot_func(void) {
+    return dot_func;
+}
+
+void pa_set_polyphase_dot_func(pa_polyphase_dot_func_t func) {
+    pa_assert(func);
+
+    dot_func = func;
+}
+
+bool pa_resampler_polyphase_usable(uint32_t rate_a, uint32_t rate_b) {
+    unsigned g;
+
+    g = pa_gcd(rate_a, rate_b);
+
+    return rate_a != rate_b && rate_a / g <= MAX_FACTOR && rate_b / g <= MAX_FACTOR;
+}
+
+static double bessel_i0(double x) {
+    double sum = 1, term = 1;
+    unsigned k;
+
+    for (k = 1; k < 50; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+
+        if (term < sum * 1e-12)
+            break;
+    }
+
+    return sum;
+}
+
+static void build_kernel(struct polyphase_data *d, unsigned q) {
+    const struct quality *quality = &quality_map[q];
+    double cutoff, bandwidth, center;
+    unsigned length, p, j;
+
+    /* Like speex, make the filter longer when decimating so that the
+     * transition band keeps its width relative to the output rate */
+    d->taps = (quality->base_length * PA_MAX(d->up, d->down) + d->up - 1) / d->up;
+    d->taps = PA_ROUND_UP(d->taps, 4);
+
+    bandwidth = d->down > d->up ? quality->downsample_bandwidth : quality->upsample_bandwidth;
+
+    /* The prototype filter runs at up times the input rate, its cutoff
+     * is relative to the Nyquist frequency of that rate */
+    length = d->up * d->taps;
+    cutoff = bandwidth / PA_MAX(d->up, d->down);
+    center = (length - 1) / 2.0;
+
+    d->kernel = pa_xnew(float, length);
+
+    for (p = 0; p < d->up; p++)
+        for (j = 0; j < d->taps; j++) {
+            unsigned i = p + (d->taps - 1 - j) * d->up;
+            double x = i - center, w, h;
+
+            w = 2.0 * i / (length - 1) - 1.0;
+            w = bessel_i0(quality->beta * sqrt(PA_MAX(0.0, 1.0 - w * w))) / bessel_i0(quality->beta);
+
+            if (fabs(x) < 1e-9)
+                h = cutoff;
+            else
+                h = sin(M_PI * cutoff * x) / (M_PI * x);
+
+            d->kernel[p * d->taps + j] = (float) (d->up * h * w);
+        }
+}
+
+static unsigned polyphase_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
+    struct polyphase_data *d;
+    pa_polyphase_dot_func_t dot = dot_func;
+    unsigned c, i, o, hist, stride, channels;
+    const float *src;
+    float *dst;
+
+    pa_assert(r);
+    pa_assert(input);
+    pa_assert(output);
+    pa_assert(out_n_frames);
+
+    d = r->impl.data;
+    channels = r->work_channels;
+    hist = d->taps - 1;
+    stride = hist + in_n_frames;
+
+    if (d->buf_size < stride * channels * sizeof(float)) {
+        d->buf_size = stride * channels * sizeof(float);
+        pa_xfree(d->buf);
+        d->buf = pa_xmalloc(d->buf_size);
+    }
+
+    /* Lay out every channel as its history followed by the new block */
+    src = pa_memblock_acquire_chunk(input);
+
+    for (c = 0; c < channels; c++) {
+        float *b = d->buf + c * stride;
+
+        memcpy(b, d->history + c * hist, hist * sizeof(float));
+
+        for (i = 0; i < in_n_frames; i++)
+            b[hist + i] = src[i * channels + c];
+    }
+
+    pa_memblock_release(input->memblock);
+
+    dst = pa_memblock_acquire_chunk(output);
+
+    for (o = 0; d->index < in_n_frames; o++) {
+        const float *k = d->kernel + d->phase * d->taps;
+
+        pa_assert_fp(o < *out_n_frames);
+
+        for (c = 0; c < channels; c++)
+            dst[o * channels + c] = dot(k, d->buf + c * stride + d->index, d->taps);
+
+        d->phase += d->down;
+        d->index += d->phase / d->up;
+        d->phase %= d->up;
+    }
+
+    pa_memblock_release(output->memblock);
+
+    *out_n_frames = o;
+
+    d->index -= in_n_frames;
+
+    for (c = 0; c < channels; c++)
+        memcpy(d->history + c * hist, d->buf + c * stride + in_n_frames, hist * sizeof(float));
+
+    return 0;
+}
+
+static void polyphase_reset(pa_resampler *r) {
+    struct polyphase_data *d;
+
+    pa_assert(r);
+
+    d = r->impl.data;
+
+    d->phase = 0;
+    d->index = 0;
+    memset(d->history, 0, (d->taps - 1) * r->work_channels * sizeof(float));
+}
+
+static void polyphase_update_rates(pa_resampler *r) {
+    /* Only used for fixed rates */
+    pa_assert_not_reached();
+}
+
+static void polyphase_free(pa_resampler *r) {
+    struct polyphase_data *d;
+
+    pa_assert(r);
+
+    d = r->impl.data;
+
+    pa_xfree(d->kernel);
+    pa_xfree(d->history);
+    pa_xfree(d->buf);
+    pa_xfree(d);
+}
+
+int pa_resampler_polyphase_init(pa_resampler *r) {
+    struct polyphase_data *d;
+    unsigned g, q;
+
+    pa_assert(r);
+    pa_assert(r->work_format == PA_SAMPLE_FLOAT32NE);
+    pa_assert(!(r->flags & PA_RESAMPLER_VARIABLE_RATE));
+    pa_assert(pa_resampler_polyphase_usable(r->i_ss.rate, r->o_ss.rate));
+    pa_assert(r->method >= PA_RESAMPLER_SPEEX_FLOAT_BASE && r->method <= PA_RESAMPLER_SPEEX_FLOAT_MAX);
+
+    q = r->method - PA_RESAMPLER_SPEEX_FLOAT_BASE;
+    g = pa_gcd(r->i_ss.rate, r->o_ss.rate);
+
+    d = pa_xnew0(struct polyphase_data, 1);
+    d->up = r->o_ss.rate / g;
+    d->down = r->i_ss.rate / g;
+
+    build_kernel(d, q);
+
+    d->history = pa_xnew0(float, (d->taps - 1) * r->work_channels);
+
+    pa_log_info("Using polyphase resampler for ratio %u/%u with %u taps per phase.", d->up, d->down, d->taps);
+
+    r->impl.resample = polyphase_resample;
+    r->impl.reset = polyphase_reset;
+    r->impl.update_rates = polyphase_update_rates;
+    r->impl.free = polyphase_free;
+    r->impl.data = d;
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/resampler.h>
+#include <pulsecore/cpu-arm.h>
+
+#include <arm_neon.h>
+
+static float dot_neon(const float *a, const float *b, unsigned n) {
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    float32x2_t half;
+    unsigned i;
+
+    for (i = 0; i < n; i += 4)
+        sum = vmlaq_f32(sum, vld1q_f32(a + i), vld1q_f32(b + i));
+
+    /* (s0 + s2) + (s1 + s3), like the generic version */
+    half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+
+    return vget_lane_f32(half, 0) + vget_lane_f32(half, 1);
+}
+
+void pa_polyphase_func_init_neon(pa_cpu_arm_flag_t flags) {
+    pa_log_info("Initialising ARM NEON optimized polyphase resampler.");
+
+    pa_set_polyphase_dot_func(dot_neon);
+}
@@ -122,6 +122,8 @@ static void speex_update_rates(pa_resampler *r) {
 
     state = r->impl.data;
 
+    /* This keeps the filter memory and scales the position between
+     * two input frames to the new ratio */
     pa_assert_se(speex_resampler_set_rate(state, r->i_ss.rate, r->o_ss.rate) == 0);
 }
 
@@ -134,6 +136,33 @@ static void speex_reset(pa_resampler *r) {
     pa_assert_se(speex_resampler_reset_mem(state) == 0);
 }
 
+static int speex_change_method(pa_resampler *r, pa_resample_method_t method) {
+    SpeexResamplerState *state;
+    int q;
+
+    pa_assert(r);
+
+    state = r->impl.data;
+
+    /* The fixed point and float variants use different work formats */
+    if (r->method >= PA_RESAMPLER_SPEEX_FIXED_BASE && r->method <= PA_RESAMPLER_SPEEX_FIXED_MAX) {
+        if (method < PA_RESAMPLER_SPEEX_FIXED_BASE || method > PA_RESAMPLER_SPEEX_FIXED_MAX)
+            return -1;
+
+        q = method - PA_RESAMPLER_SPEEX_FIXED_BASE;
+    } else {
+        if (method < PA_RESAMPLER_SPEEX_FLOAT_BASE || method > PA_RESAMPLER_SPEEX_FLOAT_MAX)
+            return -1;
+
+        q = method - PA_RESAMPLER_SPEEX_FLOAT_BASE;
+    }
+
+    if (speex_resampler_set_quality(state, q) != 0)
+        return -1;
+
+    return 0;
+}
+
 static void speex_free(pa_resampler *r) {
     SpeexResamplerState *state;
     pa_assert(r);
@@ -154,6 +183,7 @@ int pa_resampler_speex_init(pa_resampler *r) {
     r->impl.free = speex_free;
     r->impl.update_rates = speex_update_rates;
     r->impl.reset = speex_reset;
+    r->impl.change_method = speex_change_method;
 
     if (r->method >= PA_RESAMPLER_SPEEX_FIXED_BASE && r->method <= PA_RESAMPLER_SPEEX_FIXED_MAX) {
 
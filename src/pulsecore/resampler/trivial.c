@@ -26,12 +26,15 @@
 #include <pulsecore/resampler.h>
 
 struct trivial_data { /* data specific to the trivial resampler */
-    unsigned o_counter;
-    unsigned i_counter;
+    /* Position of the next output frame, relative to the start of the
+     * next input block: i_index whole input frames plus frac/o_rate */
+    unsigned i_index;
+    unsigned frac;
+    uint32_t o_rate;
 };
 
 static unsigned trivial_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
-    unsigned i_index, o_index;
+    unsigned o_index;
     void *src, *dst;
     struct trivial_data *trivial_data;
 
@@ -45,16 +48,14 @@ static unsigned trivial_resample(pa_resampler *r, const pa_memchunk *input, unsi
     src = pa_memblock_acquire_chunk(input);
     dst = pa_memblock_acquire_chunk(output);
 
-    for (o_index = 0;; o_index++, trivial_data->o_counter++) {
-        i_index = ((uint64_t) trivial_data->o_counter * r->i_ss.rate) / r->o_ss.rate;
-        i_index = i_index > trivial_data->i_counter ? i_index - trivial_data->i_counter : 0;
-
-        if (i_index >= in_n_frames)
-            break;
-
+    for (o_index = 0; trivial_data->i_index < in_n_frames; o_index++) {
         pa_assert_fp(o_index * r->w_fz < pa_memblock_get_length(output->memblock));
 
-        memcpy((uint8_t*) dst + r->w_fz * o_index, (uint8_t*) src + r->w_fz * i_index, (int) r->w_fz);
+        memcpy((uint8_t*) dst + r->w_fz * o_index, (uint8_t*) src + r->w_fz * trivial_data->i_index, (int) r->w_fz);
+
+        trivial_data->frac += r->i_ss.rate;
+        trivial_data->i_index += trivial_data->frac / r->o_ss.rate;
+        trivial_data->frac %= r->o_ss.rate;
     }
 
     pa_memblock_release(input->memblock);
@@ -62,27 +63,31 @@ static unsigned trivial_resample(pa_resampler *r, const pa_memchunk *input, unsi
 
     *out_n_frames = o_index;
 
-    trivial_data->i_counter += in_n_frames;
+    trivial_data->i_index -= in_n_frames;
 
-    /* Normalize counters */
-    while (trivial_data->i_counter >= r->i_ss.rate) {
-        pa_assert(trivial_data->o_counter >= r->o_ss.rate);
+    return 0;
+}
 
-        trivial_data->i_counter -= r->i_ss.rate;
-        trivial_data->o_counter -= r->o_ss.rate;
-    }
+static void trivial_update_rates(pa_resampler *r) {
+    struct trivial_data *trivial_data;
+    pa_assert(r);
 
-    return 0;
+    trivial_data = r->impl.data;
+
+    /* Keep the position between two input frames, so that changing
+     * the rate does not make us skip or repeat anything */
+    trivial_data->frac = (unsigned) (((uint64_t) trivial_data->frac * r->o_ss.rate) / trivial_data->o_rate);
+    trivial_data->o_rate = r->o_ss.rate;
 }
 
-static void trivial_update_rates_or_reset(pa_resampler *r) {
+static void trivial_reset(pa_resampler *r) {
     struct trivial_data *trivial_data;
     pa_assert(r);
 
     trivial_data = r->impl.data;
 
-    trivial_data->i_counter = 0;
-    trivial_data->o_counter = 0;
+    trivial_data->i_index = 0;
+    trivial_data->frac = 0;
 }
 
 int pa_resampler_trivial_init(pa_resampler *r) {
@@ -90,10 +95,11 @@ int pa_resampler_trivial_init(pa_resampler *r) {
     pa_assert(r);
 
     trivial_data = pa_xnew0(struct trivial_data, 1);
+    trivial_data->o_rate = r->o_ss.rate;
 
     r->impl.resample = trivial_resample;
-    r->impl.update_rates = trivial_update_rates_or_reset;
-    r->impl.reset = trivial_update_rates_or_reset;
+    r->impl.update_rates = trivial_update_rates;
+    r->impl.reset = trivial_reset;
     r->impl.data = trivial_data;
 
     return 0;
@@ -24,9 +24,16 @@
 
 #include <sys/types.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_TIMERFD_H)
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#define USE_EPOLL 1
+#endif
+
 #include <pulse/xmalloc.h>
 #include <pulse/timeval.h>
 
@@ -37,13 +44,43 @@
 #include <pulsecore/llist.h>
 #include <pulsecore/flist.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/hashmap.h>
 #include <pulsecore/ratelimit.h>
+#include <pulsecore/strbuf.h>
 #include <pulse/rtclock.h>
 
 #include "rtpoll.h"
 
 /* #define DEBUG_TIMING */
 
+/* How many messages to handle per asyncmsgq item and loop iteration */
+#define ASYNCMSGQ_BATCH_MAX 64
+
+#ifdef USE_EPOLL
+/* One epoll registration, shared by all pollfds with the same fd */
+struct rtpoll_fd {
+    int fd;
+    unsigned n_ref;
+    bool registered:1;
+    bool dirty:1;
+    uint32_t events;
+
+    /* Valid if revents_serial matches the rtpoll's poll_serial */
+    short revents;
+    unsigned revents_serial;
+
+    struct rtpoll_fd *dirty_next;
+};
+
+/* What we last told epoll about a pollfd. Kept in an array parallel to
+ * the pollfd array. */
+struct rtpoll_shadow {
+    int fd;
+    short events;
+    struct rtpoll_fd *rfd;
+};
+#endif
+
 struct pa_rtpoll {
     struct pollfd *pollfd, *pollfd2;
     unsigned n_pollfd_alloc, n_pollfd_used;
@@ -57,11 +94,39 @@ struct pa_rtpoll {
     bool quit:1;
     bool timer_elapsed:1;
 
+    /* The items with a work, before and after callback, in priority
+     * order, so that each phase only visits the items that need it */
+    bool callbacks_changed:1;
+    pa_rtpoll_item **work_items, **before_items, **after_items;
+    unsigned n_work_items, n_before_items, n_after_items, n_callback_items_alloc;
+
+#ifdef USE_EPOLL
+    /* If epoll_fd is valid we sleep in epoll_wait() instead of ppoll().
+     * Interest in the pollfds is updated incrementally and the timer is a
+     * timerfd with an absolute expiration time. */
+    int epoll_fd, timer_fd;
+    bool timer_armed:1;
+    struct timeval timer_armed_elapse;
+
+    struct rtpoll_shadow *shadow, *shadow2;
+    pa_hashmap *fds;
+    struct rtpoll_fd *dirty_fds;
+
+    struct epoll_event *epoll_events;
+    unsigned n_epoll_events_alloc;
+    unsigned poll_serial;
+#endif
+
 #ifdef DEBUG_TIMING
     pa_usec_t timestamp;
     pa_usec_t slept, awake;
 #endif
 
+    /* Always collected, the per item counters live in the items. The
+     * wakeup time is 0 until the loop slept for the first time. */
+    pa_rtpoll_stats stats;
+    pa_usec_t wakeup_time;
+
     PA_LLIST_HEAD(pa_rtpoll_item, items);
 };
 
@@ -71,6 +136,9 @@ struct pa_rtpoll_item {
 
     pa_rtpoll_priority_t priority;
 
+    /* Position in the item list, set when the callback arrays are built */
+    unsigned position;
+
     struct pollfd *pollfd;
     unsigned n_pollfd;
 
@@ -79,11 +147,371 @@ struct pa_rtpoll_item {
     void (*after_cb)(pa_rtpoll_item *i);
     void *userdata;
 
+    const char *name;
+    uint64_t work_calls;
+    pa_usec_t work_total_usec, work_max_usec;
+
     PA_LLIST_FIELDS(pa_rtpoll_item);
 };
 
 PA_STATIC_FLIST_DECLARE(items, 0, pa_xfree);
 
+#ifdef USE_EPOLL
+
+static void epoll_init(pa_rtpoll *p) {
+    struct epoll_event ev;
+
+    p->epoll_fd = p->timer_fd = -1;
+
+    if (getenv("PULSE_NO_EPOLL"))
+        return;
+
+    if ((p->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        pa_log_debug("epoll_create1() failed: %s", pa_cstrerror(errno));
+        return;
+    }
+
+    if ((p->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC|TFD_NONBLOCK)) < 0) {
+        pa_log_debug("timerfd_create() failed: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    /* The timer is the only registration without a struct rtpoll_fd */
+    pa_zero(ev);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+
+    if (epoll_ctl(p->epoll_fd, EPOLL_CTL_ADD, p->timer_fd, &ev) < 0) {
+        pa_log_debug("Can't watch timerfd with epoll: %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    p->shadow = pa_xnew(struct rtpoll_shadow, p->n_pollfd_alloc);
+    p->shadow2 = pa_xnew(struct rtpoll_shadow, p->n_pollfd_alloc);
+    p->fds = pa_hashmap_new_full(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func, NULL, pa_xfree);
+
+    return;
+
+fail:
+    if (p->timer_fd >= 0)
+        pa_close(p->timer_fd);
+
+    pa_close(p->epoll_fd);
+    p->epoll_fd = p->timer_fd = -1;
+}
+
+/* Also used to fall back to ppoll() if an fd can't be watched with epoll */
+static void epoll_done(pa_rtpoll *p) {
+    if (p->epoll_fd < 0)
+        return;
+
+    pa_hashmap_free(p->fds);
+    p->fds = NULL;
+    p->dirty_fds = NULL;
+
+    pa_xfree(p->shadow);
+    pa_xfree(p->shadow2);
+    p->shadow = p->shadow2 = NULL;
+
+    pa_xfree(p->epoll_events);
+    p->epoll_events = NULL;
+    p->n_epoll_events_alloc = 0;
+
+    pa_close(p->timer_fd);
+    pa_close(p->epoll_fd);
+    p->epoll_fd = p->timer_fd = -1;
+    p->timer_armed = false;
+}
+
+static void shadow_reset(struct rtpoll_shadow *sh, unsigned n) {
+    for (; n > 0; n--, sh++) {
+        sh->fd = -1;
+        sh->events = 0;
+        sh->rfd = NULL;
+    }
+}
+
+static void rfd_mark_dirty(pa_rtpoll *p, struct rtpoll_fd *rfd) {
+    if (rfd->dirty)
+        return;
+
+    rfd->dirty = true;
+    rfd->dirty_next = p->dirty_fds;
+    p->dirty_fds = rfd;
+}
+
+/* Drops the references that the pollfds belonging to sh hold */
+static void shadow_release(pa_rtpoll *p, struct rtpoll_shadow *sh, unsigned n) {
+    for (; n > 0; n--, sh++) {
+        if (!sh->rfd)
+            continue;
+
+        pa_assert(sh->rfd->n_ref > 0);
+
+        /* Drop the registration right away, the fd is probably closed
+         * next and its number reused before the next epoll_sync(). A
+         * registration we still believed in would then never be
+         * renewed for the new fd. */
+        if (--sh->rfd->n_ref <= 0 && sh->rfd->registered) {
+            epoll_ctl(p->epoll_fd, EPOLL_CTL_DEL, sh->rfd->fd, NULL);
+            sh->rfd->registered = false;
+        }
+
+        rfd_mark_dirty(p, sh->rfd);
+
+        sh->fd = -1;
+        sh->rfd = NULL;
+    }
+}
+
+static uint32_t map_events_to_epoll(short events) {
+    return
+        (events & POLLIN ? EPOLLIN : 0) |
+        (events & POLLPRI ? EPOLLPRI : 0) |
+        (events & POLLOUT ? EPOLLOUT : 0);
+}
+
+static short map_events_from_epoll(uint32_t events) {
+    return (short)
+        ((events & EPOLLIN ? POLLIN : 0) |
+         (events & EPOLLPRI ? POLLPRI : 0) |
+         (events & EPOLLOUT ? POLLOUT : 0) |
+         (events & EPOLLERR ? POLLERR : 0) |
+         (events & EPOLLHUP ? POLLHUP : 0));
+}
+
+/* Brings the registration of a changed fd in line with the pollfds using
+ * it. Returns negative if epoll can't watch the fd. */
+static int rfd_flush(pa_rtpoll *p, struct rtpoll_fd *rfd) {
+    struct epoll_event ev;
+    uint32_t events = 0;
+    unsigned n;
+    int r;
+
+    if (rfd->n_ref <= 0) {
+        /* shadow_release() already dropped the registration */
+        pa_assert(!rfd->registered);
+
+        pa_hashmap_remove_and_free(p->fds, PA_INT_TO_PTR(rfd->fd));
+        return 0;
+    }
+
+    /* Changes are rare, so just look at all pollfds */
+    for (n = 0; n < p->n_pollfd_used; n++)
+        if (p->shadow[n].rfd == rfd)
+            events |= map_events_to_epoll(p->shadow[n].events);
+
+    if (rfd->registered && rfd->events == events)
+        return 0;
+
+    rfd->events = events;
+
+    pa_zero(ev);
+    ev.events = events;
+    ev.data.ptr = rfd;
+
+    /* The kernel drops registrations of closed fds behind our back, and a
+     * new fd with the same number may already be registered, so retry
+     * with the other operation. */
+    if (rfd->registered) {
+        if ((r = epoll_ctl(p->epoll_fd, EPOLL_CTL_MOD, rfd->fd, &ev)) < 0 && errno == ENOENT)
+            r = epoll_ctl(p->epoll_fd, EPOLL_CTL_ADD, rfd->fd, &ev);
+    } else {
+        if ((r = epoll_ctl(p->epoll_fd, EPOLL_CTL_ADD, rfd->fd, &ev)) < 0 && errno == EEXIST)
+            r = epoll_ctl(p->epoll_fd, EPOLL_CTL_MOD, rfd->fd, &ev);
+    }
+
+    if (r < 0) {
+        pa_log_debug("Can't watch fd %i with epoll, falling back to ppoll(): %s", rfd->fd, pa_cstrerror(errno));
+        return r;
+    }
+
+    rfd->registered = true;
+    return 0;
+}
+
+/* Compares the pollfds with what epoll knows about them and updates the
+ * registrations that changed. Returns negative if we have to fall back to
+ * ppoll(). */
+static int epoll_sync(pa_rtpoll *p) {
+    pa_rtpoll_item *i;
+    struct rtpoll_fd *rfd;
+    int r = 0;
+
+    for (i = p->items; i; i = i->next) {
+        struct rtpoll_shadow *sh;
+        unsigned n;
+
+        if (!i->pollfd)
+            continue;
+
+        sh = p->shadow + (i->pollfd - p->pollfd);
+
+        for (n = 0; n < i->n_pollfd; n++, sh++) {
+            int fd = i->dead ? -1 : i->pollfd[n].fd;
+            short events = i->pollfd[n].events;
+
+            if (sh->fd == fd && sh->events == events)
+                continue;
+
+            if (sh->fd == fd && sh->rfd) {
+                sh->events = events;
+                rfd_mark_dirty(p, sh->rfd);
+                continue;
+            }
+
+            shadow_release(p, sh, 1);
+
+            sh->events = events;
+
+            if (fd < 0)
+                continue;
+
+            if (!(rfd = pa_hashmap_get(p->fds, PA_INT_TO_PTR(fd)))) {
+                rfd = pa_xnew0(struct rtpoll_fd, 1);
+                rfd->fd = fd;
+                pa_hashmap_put(p->fds, PA_INT_TO_PTR(fd), rfd);
+            }
+
+            rfd->n_ref++;
+            rfd_mark_dirty(p, rfd);
+
+            sh->fd = fd;
+            sh->rfd = rfd;
+        }
+    }
+
+    while ((rfd = p->dirty_fds)) {
+        p->dirty_fds = rfd->dirty_next;
+        rfd->dirty = false;
+
+        if (r >= 0)
+            r = rfd_flush(p, rfd);
+    }
+
+    return r;
+}
+
+/* The rtclock is CLOCK_MONOTONIC, the clock of our timerfd */
+static void epoll_update_timer(pa_rtpoll *p) {
+    struct itimerspec its;
+
+    if (p->timer_enabled) {
+        if (p->timer_armed && pa_timeval_cmp(&p->timer_armed_elapse, &p->next_elapse) == 0)
+            return;
+
+        pa_zero(its);
+        its.it_value.tv_sec = p->next_elapse.tv_sec;
+        its.it_value.tv_nsec = p->next_elapse.tv_usec * PA_NSEC_PER_USEC;
+
+        /* An all zero it_value would disarm the timer */
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+            its.it_value.tv_nsec = 1;
+
+        p->timer_armed = true;
+        p->timer_armed_elapse = p->next_elapse;
+    } else {
+        if (!p->timer_armed)
+            return;
+
+        pa_zero(its);
+        p->timer_armed = false;
+    }
+
+    pa_assert_se(timerfd_settime(p->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) == 0);
+}
+
+/* Sleeps in epoll_wait() and fills in the revents of the pollfds. Returns
+ * the number of pollfds with revents, like poll(). */
+static int epoll_sleep(pa_rtpoll *p, bool no_wait) {
+    unsigned n_alloc;
+    int n, k, r = 0;
+    pa_rtpoll_item *i;
+
+    if (!no_wait)
+        epoll_update_timer(p);
+
+    n_alloc = pa_hashmap_size(p->fds) + 1;
+    if (p->n_epoll_events_alloc < n_alloc) {
+        p->n_epoll_events_alloc = n_alloc * 2;
+        p->epoll_events = pa_xrenew(struct epoll_event, p->epoll_events, p->n_epoll_events_alloc);
+    }
+
+    if ((n = epoll_wait(p->epoll_fd, p->epoll_events, (int) p->n_epoll_events_alloc, no_wait ? 0 : -1)) < 0)
+        return n;
+
+    p->poll_serial++;
+
+    for (k = 0; k < n; k++) {
+        struct rtpoll_fd *rfd = p->epoll_events[k].data.ptr;
+
+        if (!rfd) {
+            uint64_t expirations;
+
+            /* The timer elapsed. It is one-shot, so it is disarmed now. */
+            (void) pa_read(p->timer_fd, &expirations, sizeof(expirations), NULL);
+            p->timer_armed = false;
+            continue;
+        }
+
+        rfd->revents = map_events_from_epoll(p->epoll_events[k].events);
+        rfd->revents_serial = p->poll_serial;
+    }
+
+    /* Like poll(), report only what was asked for, plus errors and
+     * hangups, and clear everything else */
+    for (i = p->items; i; i = i->next) {
+        struct rtpoll_shadow *sh;
+        unsigned m;
+
+        if (!i->pollfd)
+            continue;
+
+        sh = p->shadow + (i->pollfd - p->pollfd);
+
+        for (m = 0; m < i->n_pollfd; m++, sh++) {
+            struct pollfd *f = i->pollfd + m;
+
+            if (sh->rfd && sh->rfd->revents_serial == p->poll_serial)
+                f->revents = sh->rfd->revents & (f->events | POLLERR | POLLHUP);
+            else
+                f->revents = 0;
+
+            if (f->revents)
+                r++;
+        }
+    }
+
+    return r;
+}
+
+#endif /* USE_EPOLL */
+
+static void account_duration(pa_usec_t d, uint64_t histogram[PA_RTPOLL_HISTOGRAM_BUCKETS], pa_usec_t *total, pa_usec_t *max) {
+    unsigned b;
+
+    if (d <= 0)
+        b = 0;
+    else if (d >= (1ULL << (PA_RTPOLL_HISTOGRAM_BUCKETS - 2)))
+        b = PA_RTPOLL_HISTOGRAM_BUCKETS - 1;
+    else
+        b = pa_ulog2((unsigned) d) + 1;
+
+    histogram[b]++;
+    *total += d;
+
+    if (d > *max)
+        *max = d;
+}
+
+static void account_work(pa_rtpoll_item *i, pa_usec_t d) {
+    i->work_calls++;
+    i->work_total_usec += d;
+
+    if (d > i->work_max_usec)
+        i->work_max_usec = d;
+}
+
 pa_rtpoll *pa_rtpoll_new(void) {
     pa_rtpoll *p;
 
@@ -93,6 +521,10 @@ pa_rtpoll *pa_rtpoll_new(void) {
     p->pollfd = pa_xnew(struct pollfd, p->n_pollfd_alloc);
     p->pollfd2 = pa_xnew(struct pollfd, p->n_pollfd_alloc);
 
+#ifdef USE_EPOLL
+    epoll_init(p);
+#endif
+
 #ifdef DEBUG_TIMING
     p->timestamp = pa_rtclock_now();
 #endif
@@ -100,6 +532,42 @@ pa_rtpoll *pa_rtpoll_new(void) {
     return p;
 }
 
+static void rebuild_callback_items(pa_rtpoll *p) {
+    pa_rtpoll_item *i;
+    unsigned n = 0;
+
+    p->callbacks_changed = false;
+
+    for (i = p->items; i; i = i->next)
+        n++;
+
+    if (p->n_callback_items_alloc < n) {
+        p->n_callback_items_alloc = n * 2;
+        p->work_items = pa_xrenew(pa_rtpoll_item*, p->work_items, p->n_callback_items_alloc);
+        p->before_items = pa_xrenew(pa_rtpoll_item*, p->before_items, p->n_callback_items_alloc);
+        p->after_items = pa_xrenew(pa_rtpoll_item*, p->after_items, p->n_callback_items_alloc);
+    }
+
+    p->n_work_items = p->n_before_items = p->n_after_items = 0;
+    n = 0;
+
+    for (i = p->items; i && i->priority < PA_RTPOLL_NEVER; i = i->next) {
+        i->position = n++;
+
+        if (i->dead)
+            continue;
+
+        if (i->work_cb)
+            p->work_items[p->n_work_items++] = i;
+
+        if (i->before_cb)
+            p->before_items[p->n_before_items++] = i;
+
+        if (i->after_cb)
+            p->after_items[p->n_after_items++] = i;
+    }
+}
+
 static void rtpoll_rebuild(pa_rtpoll *p) {
 
     struct pollfd *e, *t;
@@ -114,6 +582,10 @@ static void rtpoll_rebuild(pa_rtpoll *p) {
         /* Hmm, we have to allocate some more space */
         p->n_pollfd_alloc = p->n_pollfd_used * 2;
         p->pollfd2 = pa_xrealloc(p->pollfd2, p->n_pollfd_alloc * sizeof(struct pollfd));
+#ifdef USE_EPOLL
+        if (p->shadow2)
+            p->shadow2 = pa_xrenew(struct rtpoll_shadow, p->shadow2, p->n_pollfd_alloc);
+#endif
         ra = 1;
     }
 
@@ -129,6 +601,16 @@ static void rtpoll_rebuild(pa_rtpoll *p) {
             else
                 memset(e, 0, l);
 
+#ifdef USE_EPOLL
+            /* The epoll shadows move along with the pollfds */
+            if (p->shadow2) {
+                if (i->pollfd)
+                    memcpy(p->shadow2 + (e - p->pollfd2), p->shadow + (i->pollfd - p->pollfd), i->n_pollfd * sizeof(struct rtpoll_shadow));
+                else
+                    shadow_reset(p->shadow2 + (e - p->pollfd2), i->n_pollfd);
+            }
+#endif
+
             i->pollfd = e;
         } else
             i->pollfd = NULL;
@@ -141,6 +623,17 @@ static void rtpoll_rebuild(pa_rtpoll *p) {
     p->pollfd = p->pollfd2;
     p->pollfd2 = t;
 
+#ifdef USE_EPOLL
+    if (p->shadow2) {
+        struct rtpoll_shadow *ts = p->shadow;
+        p->shadow = p->shadow2;
+        p->shadow2 = ts;
+
+        if (ra)
+            p->shadow2 = pa_xrenew(struct rtpoll_shadow, p->shadow2, p->n_pollfd_alloc);
+    }
+#endif
+
     if (ra)
         p->pollfd2 = pa_xrealloc(p->pollfd2, p->n_pollfd_alloc * sizeof(struct pollfd));
 }
@@ -152,6 +645,11 @@ static void rtpoll_item_destroy(pa_rtpoll_item *i) {
 
     p = i->rtpoll;
 
+#ifdef USE_EPOLL
+    if (p->shadow && i->pollfd)
+        shadow_release(p, p->shadow + (i->pollfd - p->pollfd), i->n_pollfd);
+#endif
+
     PA_LLIST_REMOVE(pa_rtpoll_item, p->items, i);
 
     p->n_pollfd_used -= i->n_pollfd;
@@ -160,6 +658,7 @@ static void rtpoll_item_destroy(pa_rtpoll_item *i) {
         pa_xfree(i);
 
     p->rebuild_needed = true;
+    p->callbacks_changed = true;
 }
 
 void pa_rtpoll_free(pa_rtpoll *p) {
@@ -168,9 +667,17 @@ void pa_rtpoll_free(pa_rtpoll *p) {
     while (p->items)
         rtpoll_item_destroy(p->items);
 
+#ifdef USE_EPOLL
+    epoll_done(p);
+#endif
+
     pa_xfree(p->pollfd);
     pa_xfree(p->pollfd2);
 
+    pa_xfree(p->work_items);
+    pa_xfree(p->before_items);
+    pa_xfree(p->after_items);
+
     pa_xfree(p);
 }
 
@@ -203,8 +710,10 @@ static void reset_all_revents(pa_rtpoll *p) {
 
 int pa_rtpoll_run(pa_rtpoll *p) {
     pa_rtpoll_item *i;
+    unsigned n;
     int r = 0;
     struct timeval timeout;
+    pa_usec_t now, wakeup;
 
     pa_assert(p);
     pa_assert(!p->running);
@@ -216,14 +725,19 @@ int pa_rtpoll_run(pa_rtpoll *p) {
     p->running = true;
     p->timer_elapsed = false;
 
+    if (p->callbacks_changed)
+        rebuild_callback_items(p);
+
+    now = pa_rtclock_now();
+
     /* First, let's do some work */
-    for (i = p->items; i && i->priority < PA_RTPOLL_NEVER; i = i->next) {
+    for (n = 0; n < p->n_work_items; n++) {
+        pa_usec_t done;
         int k;
 
-        if (i->dead)
-            continue;
+        i = p->work_items[n];
 
-        if (!i->work_cb)
+        if (i->dead)
             continue;
 
         if (p->quit) {
@@ -233,7 +747,15 @@ int pa_rtpoll_run(pa_rtpoll *p) {
             goto finish;
         }
 
-        if ((k = i->work_cb(i)) != 0) {
+        k = i->work_cb(i);
+
+        /* The callback might have freed the item */
+        done = pa_rtclock_now();
+        if (!i->dead)
+            account_work(i, done - now);
+        now = done;
+
+        if (k != 0) {
             if (k < 0)
                 r = k;
 #ifdef DEBUG_TIMING
@@ -243,26 +765,31 @@ int pa_rtpoll_run(pa_rtpoll *p) {
         }
     }
 
+    /* Items may have been added by the work callbacks */
+    if (p->callbacks_changed)
+        rebuild_callback_items(p);
+
     /* Now let's prepare for entering the sleep */
-    for (i = p->items; i && i->priority < PA_RTPOLL_NEVER; i = i->next) {
+    for (n = 0; n < p->n_before_items; n++) {
         int k = 0;
 
-        if (i->dead)
-            continue;
+        i = p->before_items[n];
 
-        if (!i->before_cb)
+        if (i->dead)
             continue;
 
         if (p->quit || (k = i->before_cb(i)) != 0) {
+            unsigned position = i->position;
 
             /* Hmm, this one doesn't let us enter the poll, so rewind everything */
 
-            for (i = i->prev; i; i = i->prev) {
+            for (n = p->n_after_items; n > 0; n--) {
+                i = p->after_items[n-1];
 
-                if (i->dead)
+                if (i->position >= position)
                     continue;
 
-                if (!i->after_cb)
+                if (i->dead)
                     continue;
 
                 i->after_cb(i);
@@ -282,13 +809,17 @@ int pa_rtpoll_run(pa_rtpoll *p) {
 
     pa_zero(timeout);
 
+    now = pa_rtclock_now();
+
+    if (p->wakeup_time > 0)
+        account_duration(now - p->wakeup_time, p->stats.awake_histogram, &p->stats.awake_total_usec, &p->stats.awake_max_usec);
+
     /* Calculate timeout */
     if (!p->quit && p->timer_enabled) {
-        struct timeval now;
-        pa_rtclock_get(&now);
+        pa_usec_t elapse = pa_timeval_load(&p->next_elapse);
 
-        if (pa_timeval_cmp(&p->next_elapse, &now) > 0)
-            pa_timeval_add(&timeout, pa_timeval_diff(&p->next_elapse, &now));
+        if (elapse > now)
+            pa_timeval_store(&timeout, elapse - now);
     }
 
 #ifdef DEBUG_TIMING
@@ -306,19 +837,42 @@ int pa_rtpoll_run(pa_rtpoll *p) {
 #endif
 
     /* OK, now let's sleep */
-#ifdef HAVE_PPOLL
+#ifdef USE_EPOLL
+    if (p->epoll_fd >= 0 && epoll_sync(p) < 0)
+        epoll_done(p);
+
+    if (p->epoll_fd >= 0)
+        /* With a timer that is already due we must not block, otherwise
+         * the timerfd wakes us up at the absolute time */
+        r = epoll_sleep(p, p->quit || (p->timer_enabled && timeout.tv_sec == 0 && timeout.tv_usec == 0));
+    else
+#endif
     {
+#ifdef HAVE_PPOLL
         struct timespec ts;
         ts.tv_sec = timeout.tv_sec;
         ts.tv_nsec = timeout.tv_usec * 1000;
         r = ppoll(p->pollfd, p->n_pollfd_used, (p->quit || p->timer_enabled) ? &ts : NULL, NULL);
-    }
 #else
-    r = pa_poll(p->pollfd, p->n_pollfd_used, (p->quit || p->timer_enabled) ? (int) ((timeout.tv_sec*1000) + (timeout.tv_usec / 1000)) : -1);
+        r = pa_poll(p->pollfd, p->n_pollfd_used, (p->quit || p->timer_enabled) ? (int) ((timeout.tv_sec*1000) + (timeout.tv_usec / 1000)) : -1);
 #endif
+    }
 
     p->timer_elapsed = r == 0;
 
+    wakeup = pa_rtclock_now();
+    p->wakeup_time = wakeup;
+    p->stats.iterations++;
+    account_duration(wakeup - now, p->stats.sleep_histogram, &p->stats.sleep_total_usec, &p->stats.sleep_max_usec);
+
+    if (p->timer_elapsed && !p->quit && p->timer_enabled) {
+        pa_usec_t elapse = pa_timeval_load(&p->next_elapse);
+
+        p->stats.timer_wakeups++;
+        account_duration(wakeup > elapse ? wakeup - elapse : 0,
+                         p->stats.overshoot_histogram, &p->stats.overshoot_total_usec, &p->stats.overshoot_max_usec);
+    }
+
 #ifdef DEBUG_TIMING
     {
         pa_usec_t now = pa_rtclock_now();
@@ -341,14 +895,12 @@ int pa_rtpoll_run(pa_rtpoll *p) {
     }
 
     /* Let's tell everyone that we left the sleep */
-    for (i = p->items; i && i->priority < PA_RTPOLL_NEVER; i = i->next) {
+    for (n = 0; n < p->n_after_items; n++) {
+        i = p->after_items[n];
 
         if (i->dead)
             continue;
 
-        if (!i->after_cb)
-            continue;
-
         i->after_cb(i);
     }
 
@@ -416,6 +968,10 @@ pa_rtpoll_item *pa_rtpoll_item_new(pa_rtpoll *p, pa_rtpoll_priority_t prio, unsi
     i->after_cb = NULL;
     i->work_cb = NULL;
 
+    i->name = NULL;
+    i->work_calls = 0;
+    i->work_total_usec = i->work_max_usec = 0;
+
     for (j = p->items; j; j = j->next) {
         if (prio <= j->priority)
             break;
@@ -424,6 +980,7 @@ pa_rtpoll_item *pa_rtpoll_item_new(pa_rtpoll *p, pa_rtpoll_priority_t prio, unsi
     }
 
     PA_LLIST_INSERT_AFTER(pa_rtpoll_item, p->items, j ? j->prev : l, i);
+    p->callbacks_changed = true;
 
     if (n_fds > 0) {
         p->rebuild_needed = 1;
@@ -463,6 +1020,7 @@ void pa_rtpoll_item_set_before_callback(pa_rtpoll_item *i, int (*before_cb)(pa_r
     pa_assert(i->priority < PA_RTPOLL_NEVER);
 
     i->before_cb = before_cb;
+    i->rtpoll->callbacks_changed = true;
 }
 
 void pa_rtpoll_item_set_after_callback(pa_rtpoll_item *i, void (*after_cb)(pa_rtpoll_item *i)) {
@@ -470,6 +1028,7 @@ void pa_rtpoll_item_set_after_callback(pa_rtpoll_item *i, void (*after_cb)(pa_rt
     pa_assert(i->priority < PA_RTPOLL_NEVER);
 
     i->after_cb = after_cb;
+    i->rtpoll->callbacks_changed = true;
 }
 
 void pa_rtpoll_item_set_work_callback(pa_rtpoll_item *i, int (*work_cb)(pa_rtpoll_item *i)) {
@@ -477,6 +1036,7 @@ void pa_rtpoll_item_set_work_callback(pa_rtpoll_item *i, int (*work_cb)(pa_rtpol
     pa_assert(i->priority < PA_RTPOLL_NEVER);
 
     i->work_cb = work_cb;
+    i->rtpoll->callbacks_changed = true;
 }
 
 void pa_rtpoll_item_set_userdata(pa_rtpoll_item *i, void *userdata) {
@@ -491,6 +1051,103 @@ void* pa_rtpoll_item_get_userdata(pa_rtpoll_item *i) {
     return i->userdata;
 }
 
+void pa_rtpoll_item_set_name(pa_rtpoll_item *i, const char *name) {
+    pa_assert(i);
+
+    i->name = name;
+}
+
+void pa_rtpoll_get_stats(pa_rtpoll *p, pa_rtpoll_stats *ret) {
+    pa_rtpoll_item *i;
+
+    pa_assert(p);
+    pa_assert(ret);
+
+    *ret = p->stats;
+    ret->n_items = 0;
+
+    for (i = p->items; i && ret->n_items < PA_RTPOLL_STATS_MAX_ITEMS; i = i->next) {
+        pa_rtpoll_item_stats *s;
+
+        if (i->dead || !i->work_cb)
+            continue;
+
+        s = &ret->items[ret->n_items++];
+        s->name = i->name;
+        s->calls = i->work_calls;
+        s->total_usec = i->work_total_usec;
+        s->max_usec = i->work_max_usec;
+    }
+}
+
+char *pa_rtpoll_histogram_to_string(const uint64_t histogram[PA_RTPOLL_HISTOGRAM_BUCKETS]) {
+    pa_strbuf *buf;
+    unsigned n, k;
+
+    pa_assert(histogram);
+
+    for (n = PA_RTPOLL_HISTOGRAM_BUCKETS; n > 1; n--)
+        if (histogram[n-1] > 0)
+            break;
+
+    buf = pa_strbuf_new();
+
+    for (k = 0; k < n; k++)
+        pa_strbuf_printf(buf, "%s%llu", k > 0 ? "," : "", (unsigned long long) histogram[k]);
+
+    return pa_strbuf_to_string_free(buf);
+}
+
+static void put_durations(pa_proplist *p, const char *avg_key, const char *max_key, const char *histogram_key,
+                          uint64_t n, pa_usec_t total, pa_usec_t max, const uint64_t histogram[PA_RTPOLL_HISTOGRAM_BUCKETS]) {
+    char *t;
+
+    pa_proplist_setf(p, avg_key, "%llu", (unsigned long long) (n > 0 ? total / n : 0));
+    pa_proplist_setf(p, max_key, "%llu", (unsigned long long) max);
+
+    t = pa_rtpoll_histogram_to_string(histogram);
+    pa_proplist_sets(p, histogram_key, t);
+    pa_xfree(t);
+}
+
+void pa_rtpoll_stats_to_proplist(const pa_rtpoll_stats *s, pa_proplist *p) {
+    pa_strbuf *buf;
+    unsigned k;
+    char *t;
+
+    pa_assert(s);
+    pa_assert(p);
+
+    pa_proplist_setf(p, PA_PROP_RTPOLL_ITERATIONS, "%llu", (unsigned long long) s->iterations);
+
+    /* The first iteration has no awake time */
+    put_durations(p, PA_PROP_RTPOLL_AWAKE_AVG_USEC, PA_PROP_RTPOLL_AWAKE_MAX_USEC, PA_PROP_RTPOLL_AWAKE_HISTOGRAM,
+                  s->iterations > 0 ? s->iterations - 1 : 0, s->awake_total_usec, s->awake_max_usec, s->awake_histogram);
+    put_durations(p, PA_PROP_RTPOLL_SLEEP_AVG_USEC, PA_PROP_RTPOLL_SLEEP_MAX_USEC, PA_PROP_RTPOLL_SLEEP_HISTOGRAM,
+                  s->iterations, s->sleep_total_usec, s->sleep_max_usec, s->sleep_histogram);
+
+    pa_proplist_setf(p, PA_PROP_RTPOLL_TIMER_WAKEUPS, "%llu", (unsigned long long) s->timer_wakeups);
+    put_durations(p, PA_PROP_RTPOLL_TIMER_OVERSHOOT_AVG_USEC, PA_PROP_RTPOLL_TIMER_OVERSHOOT_MAX_USEC, PA_PROP_RTPOLL_TIMER_OVERSHOOT_HISTOGRAM,
+                  s->timer_wakeups, s->overshoot_total_usec, s->overshoot_max_usec, s->overshoot_histogram);
+
+    buf = pa_strbuf_new();
+
+    for (k = 0; k < s->n_items; k++) {
+        const pa_rtpoll_item_stats *i = &s->items[k];
+
+        pa_strbuf_printf(buf, "%s%s:%llu:%llu:%llu",
+                         k > 0 ? "," : "",
+                         i->name ? i->name : "unnamed",
+                         (unsigned long long) i->calls,
+                         (unsigned long long) (i->calls > 0 ? i->total_usec / i->calls : 0),
+                         (unsigned long long) i->max_usec);
+    }
+
+    t = pa_strbuf_to_string_free(buf);
+    pa_proplist_sets(p, PA_PROP_RTPOLL_ITEMS, t);
+    pa_xfree(t);
+}
+
 static int fdsem_before(pa_rtpoll_item *i) {
 
     if (pa_fdsem_before_poll(i->userdata) < 0)
@@ -523,6 +1180,7 @@ pa_rtpoll_item *pa_rtpoll_item_new_fdsem(pa_rtpoll *p, pa_rtpoll_priority_t prio
     i->before_cb = fdsem_before;
     i->after_cb = fdsem_after;
     i->userdata = f;
+    i->name = "fdsem";
 
     return i;
 }
@@ -544,31 +1202,20 @@ static void asyncmsgq_read_after(pa_rtpoll_item *i) {
 }
 
 static int asyncmsgq_read_work(pa_rtpoll_item *i) {
-    pa_msgobject *object;
-    int code;
-    void *data;
-    pa_memchunk chunk;
-    int64_t offset;
+    int n;
 
     pa_assert(i);
 
-    if (pa_asyncmsgq_get(i->userdata, &object, &code, &data, &offset, &chunk, 0) == 0) {
-        int ret;
-
-        if (!object && code == PA_MESSAGE_SHUTDOWN) {
-            pa_asyncmsgq_done(i->userdata, 0);
-            /* Requests the loop to exit. Will cause the next iteration of
-             * pa_rtpoll_run() to return 0 */
-            i->rtpoll->quit = true;
-            return 1;
-        }
-
-        ret = pa_asyncmsgq_dispatch(object, code, data, offset, &chunk);
-        pa_asyncmsgq_done(i->userdata, ret);
+    /* Handle messages in batches, so that a burst of messages doesn't
+     * restart the whole loop once per message */
+    if ((n = pa_asyncmsgq_process_batch(i->userdata, ASYNCMSGQ_BATCH_MAX)) < 0) {
+        /* Requests the loop to exit. Will cause the next iteration of
+         * pa_rtpoll_run() to return 0 */
+        i->rtpoll->quit = true;
         return 1;
     }
 
-    return 0;
+    return n > 0;
 }
 
 pa_rtpoll_item *pa_rtpoll_item_new_asyncmsgq_read(pa_rtpoll *p, pa_rtpoll_priority_t prio, pa_asyncmsgq *q) {
@@ -588,6 +1235,7 @@ pa_rtpoll_item *pa_rtpoll_item_new_asyncmsgq_read(pa_rtpoll *p, pa_rtpoll_priori
     i->after_cb = asyncmsgq_read_after;
     i->work_cb = asyncmsgq_read_work;
     i->userdata = q;
+    i->name = "asyncmsgq";
 
     return i;
 }
@@ -623,6 +1271,7 @@ pa_rtpoll_item *pa_rtpoll_item_new_asyncmsgq_write(pa_rtpoll *p, pa_rtpoll_prior
     i->after_cb = asyncmsgq_write_after;
     i->work_cb = NULL;
     i->userdata = q;
+    i->name = "asyncmsgq-write";
 
     return i;
 }
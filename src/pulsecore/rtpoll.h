@@ -24,6 +24,7 @@
 #include <limits.h>
 
 #include <pulse/sample.h>
+#include <pulse/proplist.h>
 #include <pulsecore/asyncmsgq.h>
 #include <pulsecore/fdsem.h>
 #include <pulsecore/macro.h>
@@ -94,8 +95,60 @@ void pa_rtpoll_item_set_after_callback(pa_rtpoll_item *i, void (*after_cb)(pa_rt
 void pa_rtpoll_item_set_userdata(pa_rtpoll_item *i, void *userdata);
 void* pa_rtpoll_item_get_userdata(pa_rtpoll_item *i);
 
+/* Set a name for the item that is used to identify it in the timing
+ * statistics. The string is not copied and needs to stay valid for
+ * the lifetime of the item, hence use a string literal. */
+void pa_rtpoll_item_set_name(pa_rtpoll_item *i, const char *name);
+
 pa_rtpoll_item *pa_rtpoll_item_new_fdsem(pa_rtpoll *p, pa_rtpoll_priority_t prio, pa_fdsem *s);
 pa_rtpoll_item *pa_rtpoll_item_new_asyncmsgq_read(pa_rtpoll *p, pa_rtpoll_priority_t prio, pa_asyncmsgq *q);
 pa_rtpoll_item *pa_rtpoll_item_new_asyncmsgq_write(pa_rtpoll *p, pa_rtpoll_priority_t prio, pa_asyncmsgq *q);
 
+/* Timing statistics that are always collected by pa_rtpoll_run().
+ * Histogram bucket 0 counts durations below 1 usec, bucket n > 0
+ * durations of at least 2^(n-1) and below 2^n usec. The last bucket
+ * counts everything that doesn't fit in the others. */
+#define PA_RTPOLL_HISTOGRAM_BUCKETS 24
+
+/* The maximum number of items with a work callback that are reported
+ * in pa_rtpoll_stats */
+#define PA_RTPOLL_STATS_MAX_ITEMS 16
+
+typedef struct pa_rtpoll_item_stats {
+    const char *name;                 /* As set with pa_rtpoll_item_set_name(), or NULL */
+    uint64_t calls;
+    pa_usec_t total_usec, max_usec;   /* Time spent in work_cb */
+} pa_rtpoll_item_stats;
+
+typedef struct pa_rtpoll_stats {
+    uint64_t iterations;              /* Number of times the loop went to sleep */
+
+    /* Time between waking up and going to sleep again */
+    pa_usec_t awake_total_usec, awake_max_usec;
+    uint64_t awake_histogram[PA_RTPOLL_HISTOGRAM_BUCKETS];
+
+    /* Time spent sleeping in poll */
+    pa_usec_t sleep_total_usec, sleep_max_usec;
+    uint64_t sleep_histogram[PA_RTPOLL_HISTOGRAM_BUCKETS];
+
+    /* How late we woke up compared to the configured timer */
+    uint64_t timer_wakeups;
+    pa_usec_t overshoot_total_usec, overshoot_max_usec;
+    uint64_t overshoot_histogram[PA_RTPOLL_HISTOGRAM_BUCKETS];
+
+    unsigned n_items;
+    pa_rtpoll_item_stats items[PA_RTPOLL_STATS_MAX_ITEMS];
+} pa_rtpoll_stats;
+
+/* Copy the current statistics. Needs to be called from the thread
+ * that runs the rtpoll, or when the loop is not running. */
+void pa_rtpoll_get_stats(pa_rtpoll *p, pa_rtpoll_stats *ret);
+
+/* Format a histogram as comma separated list of bucket counts, with
+ * trailing empty buckets omitted. Free the result with pa_xfree() */
+char *pa_rtpoll_histogram_to_string(const uint64_t histogram[PA_RTPOLL_HISTOGRAM_BUCKETS]);
+
+/* Store the statistics in the PA_PROP_RTPOLL_xxx properties */
+void pa_rtpoll_stats_to_proplist(const pa_rtpoll_stats *s, pa_proplist *p);
+
 #endif
@@ -101,6 +101,97 @@ void* pa_silence_memory(void *p, size_t length, const pa_sample_spec *spec) {
     return p;
 }
 
+static bool detect_silence_c(const void *p, size_t length, uint32_t pattern, uint32_t mask) {
+    const uint8_t *d = p;
+    uint64_t pattern2, mask2;
+
+    pattern2 = ((uint64_t) pattern << 32) | pattern;
+    mask2 = ((uint64_t) mask << 32) | mask;
+
+    /* Only look at the result after every 64 bytes, so that the inner
+     * loop has no branches and the compiler can vectorize it */
+    for (; length >= 64; length -= 64, d += 64) {
+        uint64_t acc = 0;
+        unsigned i;
+
+        for (i = 0; i < 64; i += 8) {
+            uint64_t w;
+
+            memcpy(&w, d + i, sizeof(w));
+            acc |= (w & mask2) ^ pattern2;
+        }
+
+        if (acc)
+            return false;
+    }
+
+    for (; length >= 4; length -= 4, d += 4) {
+        uint32_t w;
+
+        memcpy(&w, d, sizeof(w));
+
+        if ((w & mask) != pattern)
+            return false;
+    }
+
+    return true;
+}
+
+static pa_detect_silence_func_t detect_silence_func = detect_silence_c;
+
+pa_detect_silence_func_t pa_get_detect_silence_func(void) {
+    return detect_silence_func;
+}
+
+void pa_set_detect_silence_func(pa_detect_silence_func_t func) {
+    pa_assert(func);
+
+    detect_silence_func = func;
+}
+
+bool pa_memchunk_is_silence(const pa_memchunk *c, const pa_sample_spec *spec) {
+    uint8_t pattern[4], mask[4];
+    uint32_t p, m;
+    const uint8_t *d;
+    size_t n, i;
+    bool ret;
+
+    pa_assert(c);
+    pa_assert(c->memblock);
+    pa_assert(spec);
+
+    if (pa_memblock_is_silence(c->memblock))
+        return true;
+
+    memset(pattern, silence_byte(spec->format), sizeof(pattern));
+    memset(mask, 0xff, sizeof(mask));
+
+    /* Negative zero is silence too */
+    if (spec->format == PA_SAMPLE_FLOAT32LE)
+        mask[3] = 0x7f;
+    else if (spec->format == PA_SAMPLE_FLOAT32BE)
+        mask[0] = 0x7f;
+
+    memcpy(&p, pattern, sizeof(p));
+    memcpy(&m, mask, sizeof(m));
+
+    n = c->length & ~(size_t) 3;
+
+    d = pa_memblock_acquire_chunk(c);
+
+    ret = detect_silence_func(d, n, p, m);
+
+    /* The formats that leave a remainder have the same silence in
+     * every byte */
+    for (i = n; ret && i < c->length; i++)
+        if (d[i] != pattern[0])
+            ret = false;
+
+    pa_memblock_release(c->memblock);
+
+    return ret;
+}
+
 size_t pa_frame_align(size_t l, const pa_sample_spec *ss) {
     size_t fs;
 
@@ -121,15 +212,39 @@ bool pa_frame_aligned(size_t l, const pa_sample_spec *ss) {
     return l % fs == 0;
 }
 
-void pa_interleave(const void *src[], unsigned channels, void *dst, size_t ss, unsigned n) {
+/* Whole samples of the common sizes are copied as integers, not with a
+ * memcpy() each */
+#define INTERLEAVE(type)                                                \
+    for (c = 0; c < channels; c++) {                                    \
+        const type *s = src[c];                                         \
+        type *d = (type*) dst + c;                                      \
+        unsigned j;                                                     \
+                                                                        \
+        for (j = 0; j < n; j++, d += channels)                          \
+            *d = s[j];                                                  \
+    }
+
+#define DEINTERLEAVE(type)                                              \
+    for (c = 0; c < channels; c++) {                                    \
+        const type *s = (const type*) src + c;                          \
+        type *d = dst[c];                                               \
+        unsigned j;                                                     \
+                                                                        \
+        for (j = 0; j < n; j++, s += channels)                          \
+            d[j] = *s;                                                  \
+    }
+
+static void interleave_c(const void *src[], unsigned channels, void *dst, size_t ss, unsigned n) {
     unsigned c;
     size_t fs;
 
-    pa_assert(src);
-    pa_assert(channels > 0);
-    pa_assert(dst);
-    pa_assert(ss > 0);
-    pa_assert(n > 0);
+    if (ss == 4) {
+        INTERLEAVE(uint32_t);
+        return;
+    } else if (ss == 2) {
+        INTERLEAVE(uint16_t);
+        return;
+    }
 
     fs = ss * channels;
 
@@ -149,15 +264,17 @@ void pa_interleave(const void *src[], unsigned channels, void *dst, size_t ss, u
     }
 }
 
-void pa_deinterleave(const void *src, void *dst[], unsigned channels, size_t ss, unsigned n) {
+static void deinterleave_c(const void *src, void *dst[], unsigned channels, size_t ss, unsigned n) {
     size_t fs;
     unsigned c;
 
-    pa_assert(src);
-    pa_assert(dst);
-    pa_assert(channels > 0);
-    pa_assert(ss > 0);
-    pa_assert(n > 0);
+    if (ss == 4) {
+        DEINTERLEAVE(uint32_t);
+        return;
+    } else if (ss == 2) {
+        DEINTERLEAVE(uint16_t);
+        return;
+    }
 
     fs = ss * channels;
 
@@ -177,6 +294,49 @@ void pa_deinterleave(const void *src, void *dst[], unsigned channels, size_t ss,
     }
 }
 
+static pa_interleave_func_t interleave_func = interleave_c;
+static pa_deinterleave_func_t deinterleave_func = deinterleave_c;
+
+pa_interleave_func_t pa_get_interleave_func(void) {
+    return interleave_func;
+}
+
+void pa_set_interleave_func(pa_interleave_func_t func) {
+    pa_assert(func);
+
+    interleave_func = func;
+}
+
+pa_deinterleave_func_t pa_get_deinterleave_func(void) {
+    return deinterleave_func;
+}
+
+void pa_set_deinterleave_func(pa_deinterleave_func_t func) {
+    pa_assert(func);
+
+    deinterleave_func = func;
+}
+
+void pa_interleave(const void *src[], unsigned channels, void *dst, size_t ss, unsigned n) {
+    pa_assert(src);
+    pa_assert(channels > 0);
+    pa_assert(dst);
+    pa_assert(ss > 0);
+    pa_assert(n > 0);
+
+    interleave_func(src, channels, dst, ss, n);
+}
+
+void pa_deinterleave(const void *src, void *dst[], unsigned channels, size_t ss, unsigned n) {
+    pa_assert(src);
+    pa_assert(dst);
+    pa_assert(channels > 0);
+    pa_assert(ss > 0);
+    pa_assert(n > 0);
+
+    deinterleave_func(src, dst, channels, ss, n);
+}
+
 static pa_memblock *silence_memblock_new(pa_mempool *pool, uint8_t c) {
     pa_memblock *b;
     size_t length;
@@ -45,10 +45,32 @@ pa_memblock* pa_silence_memblock(pa_memblock *b, const pa_sample_spec *spec);
 
 pa_memchunk* pa_silence_memchunk_get(pa_silence_cache *cache, pa_mempool *pool, pa_memchunk* ret, const pa_sample_spec *spec, size_t length);
 
+/* Checks that every 32 bit word w of p satisfies (w & mask) ==
+ * pattern. length is a multiple of 4, p doesn't need to be aligned. */
+typedef bool (*pa_detect_silence_func_t) (const void *p, size_t length, uint32_t pattern, uint32_t mask);
+
+pa_detect_silence_func_t pa_get_detect_silence_func(void);
+void pa_set_detect_silence_func(pa_detect_silence_func_t func);
+
+/* Returns true if the chunk contains nothing but digital silence,
+ * regardless of whether its memblock is marked as silence */
+bool pa_memchunk_is_silence(const pa_memchunk *c, const pa_sample_spec *spec);
+
 size_t pa_frame_align(size_t l, const pa_sample_spec *ss) PA_GCC_PURE;
 
 bool pa_frame_aligned(size_t l, const pa_sample_spec *ss) PA_GCC_PURE;
 
+/* Interleave n frames from channels planes of samples of ss bytes each
+ * into dst, and back */
+typedef void (*pa_interleave_func_t) (const void *src[], unsigned channels, void *dst, size_t ss, unsigned n);
+typedef void (*pa_deinterleave_func_t) (const void *src, void *dst[], unsigned channels, size_t ss, unsigned n);
+
+pa_interleave_func_t pa_get_interleave_func(void);
+void pa_set_interleave_func(pa_interleave_func_t func);
+
+pa_deinterleave_func_t pa_get_deinterleave_func(void);
+void pa_set_deinterleave_func(pa_deinterleave_func_t func);
+
 void pa_interleave(const void *src[], unsigned channels, void *dst, size_t ss, unsigned n);
 void pa_deinterleave(const void *src, void *dst[], unsigned channels, size_t ss, unsigned n);
 
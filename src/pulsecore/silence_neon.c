@@ -0,0 +1,68 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+#include <pulsecore/cpu-arm.h>
+
+#include <arm_neon.h>
+
+static bool detect_silence_neon(const void *p, size_t length, uint32_t pattern, uint32_t mask) {
+    const uint8_t *d = p;
+    uint32x4_t vpattern = vdupq_n_u32(pattern), vmask = vdupq_n_u32(mask);
+
+    for (; length >= 32; length -= 32, d += 32) {
+        uint32x4_t a, b;
+        uint32x2_t t;
+
+        a = vreinterpretq_u32_u8(vld1q_u8(d));
+        b = vreinterpretq_u32_u8(vld1q_u8(d + 16));
+
+        a = veorq_u32(vandq_u32(a, vmask), vpattern);
+        b = veorq_u32(vandq_u32(b, vmask), vpattern);
+        a = vorrq_u32(a, b);
+
+        t = vorr_u32(vget_low_u32(a), vget_high_u32(a));
+
+        if (vget_lane_u32(t, 0) | vget_lane_u32(t, 1))
+            return false;
+    }
+
+    for (; length >= 4; length -= 4, d += 4) {
+        uint32_t w;
+
+        memcpy(&w, d, sizeof(w));
+
+        if ((w & mask) != pattern)
+            return false;
+    }
+
+    return true;
+}
+
+void pa_silence_func_init_neon(pa_cpu_arm_flag_t flags) {
+    pa_log_info("Initialising ARM NEON optimized silence detection.");
+
+    pa_set_detect_silence_func(detect_silence_neon);
+}
@@ -0,0 +1,94 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+#include <pulsecore/cpu-x86.h>
+
+#if defined (__i386__) || defined (__amd64__)
+
+static bool detect_silence_sse2(const void *p, size_t length, uint32_t pattern, uint32_t mask) {
+    const uint8_t *d = p;
+    pa_reg_x86 i = 0, count = length / 32;
+    unsigned bits;
+
+    if (count > 0) {
+        /* Compare 32 bytes per iteration, bail out on the first
+         * block that isn't silence */
+        __asm__ __volatile__ (
+            " movd %k4, %%xmm6              \n\t"
+            " pshufd $0, %%xmm6, %%xmm6     \n\t"
+            " movd %k5, %%xmm7              \n\t"
+            " pshufd $0, %%xmm7, %%xmm7     \n\t"
+
+            "1:                             \n\t"
+            " movdqu (%q3, %0), %%xmm0      \n\t"
+            " movdqu 16(%q3, %0), %%xmm1    \n\t"
+            " pand %%xmm7, %%xmm0           \n\t"
+            " pand %%xmm7, %%xmm1           \n\t"
+            " pcmpeqd %%xmm6, %%xmm0        \n\t"
+            " pcmpeqd %%xmm6, %%xmm1        \n\t"
+            " pand %%xmm1, %%xmm0           \n\t"
+            " pmovmskb %%xmm0, %k2          \n\t"
+            " cmp $0xffff, %k2              \n\t"
+            " jne 2f                        \n\t"
+            " add $32, %0                   \n\t"
+            " dec %1                        \n\t"
+            " jne 1b                        \n\t"
+            "2:                             \n\t"
+
+            : "+r" (i), "+r" (count), "=&r" (bits)
+            : "r" (d), "r" (pattern), "r" (mask)
+            : "cc", "memory", "xmm0", "xmm1", "xmm6", "xmm7"
+        );
+
+        /* We left the loop early */
+        if (count > 0)
+            return false;
+    }
+
+    for (d += i, length -= i; length >= 4; length -= 4, d += 4) {
+        uint32_t w;
+
+        memcpy(&w, d, sizeof(w));
+
+        if ((w & mask) != pattern)
+            return false;
+    }
+
+    return true;
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_silence_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if defined (__i386__) || defined (__amd64__)
+
+    if (flags & PA_CPU_X86_SSE2) {
+        pa_log_info("Initialising SSE2 optimized silence detection.");
+        pa_set_detect_silence_func(detect_silence_sse2);
+    }
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
@@ -491,6 +491,7 @@ int pa_sink_input_new(
 
     i->requested_resample_method = data->resample_method;
     i->actual_resample_method = resampler ? pa_resampler_get_method(resampler) : PA_RESAMPLER_INVALID;
+    i->resampler_level = 0;
     i->sample_spec = data->sample_spec;
     i->channel_map = data->channel_map;
     i->format = pa_format_info_copy(data->format);
@@ -543,12 +544,17 @@ int pa_sink_input_new(
     i->thread_info.attached = false;
     i->thread_info.sample_spec = i->sample_spec;
     i->thread_info.resampler = resampler;
+    i->thread_info.resampler_base_method = i->actual_resample_method;
+    i->thread_info.resampler_level = 0;
     i->thread_info.soft_volume = i->soft_volume;
     i->thread_info.muted = i->muted;
     i->thread_info.requested_sink_latency = (pa_usec_t) -1;
     i->thread_info.rewrite_nbytes = 0;
     i->thread_info.rewrite_flush = false;
     i->thread_info.dont_rewind_render = false;
+    i->thread_info.rewind_selected = false;
+    pa_cvolume_init(&i->thread_info.mix_volume);
+    i->thread_info.mix_volume_since = 0;
     i->thread_info.underrun_for = (uint64_t) -1;
     i->thread_info.underrun_for_sink = 0;
     i->thread_info.playing_for = 0;
@@ -854,6 +860,27 @@ pa_usec_t pa_sink_input_get_latency(pa_sink_input *i, pa_usec_t *sink_latency) {
     return r[0];
 }
 
+/* Called from thread context */
+static void push_render_chunk(pa_sink_input *i, pa_memchunk *chunk) {
+    pa_assert(i);
+    pa_assert(chunk);
+
+    pa_atomic_inc(&i->n_render_blocks);
+
+    /* Muted applications and idle VoIP clients tend to send digital
+     * silence. Leave a hole in the queue instead, reading it returns
+     * the sink's silence memblock, which the sink doesn't mix. */
+    if (!pa_memblock_is_silence(chunk->memblock) &&
+        pa_memchunk_is_silence(chunk, &i->sink->sample_spec)) {
+
+        pa_atomic_inc(&i->n_silent_blocks);
+        pa_memblockq_seek(i->thread_info.render_memblockq, (int64_t) chunk->length, PA_SEEK_RELATIVE, true);
+        return;
+    }
+
+    pa_memblockq_push_align(i->thread_info.render_memblockq, chunk);
+}
+
 /* Called from thread context */
 void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa_memchunk *chunk, pa_cvolume *volume) {
     bool do_volume_adj_here, need_volume_factor_sink;
@@ -976,7 +1003,7 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
                     pa_volume_memchunk(&wchunk, &i->sink->sample_spec, &i->volume_factor_sink);
                 }
 
-                pa_memblockq_push_align(i->thread_info.render_memblockq, &wchunk);
+                push_render_chunk(i, &wchunk);
             } else {
                 pa_memchunk rchunk;
                 pa_resampler_run(i->thread_info.resampler, &wchunk, &rchunk);
@@ -992,7 +1019,7 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
                         pa_volume_memchunk(&rchunk, &i->sink->sample_spec, &i->volume_factor_sink);
                     }
 
-                    pa_memblockq_push_align(i->thread_info.render_memblockq, &rchunk);
+                    push_render_chunk(i, &rchunk);
                     pa_memblock_unref(rchunk.memblock);
                 }
             }
@@ -1164,7 +1191,9 @@ void pa_sink_input_update_max_rewind(pa_sink_input *i, size_t nbytes  /* in the
     pa_assert(PA_SINK_INPUT_IS_LINKED(i->thread_info.state));
     pa_assert(pa_frame_aligned(nbytes, &i->sink->sample_spec));
 
-    pa_memblockq_set_maxrewind(i->thread_info.render_memblockq, nbytes);
+    /* If the sink mixed ahead in an incremental rewind we might have
+     * to go back up to twice as far in the next one */
+    pa_memblockq_set_maxrewind(i->thread_info.render_memblockq, i->sink->thread_info.mix_history ? 2 * nbytes : nbytes);
 
     if (i->update_max_rewind)
         i->update_max_rewind(i, i->thread_info.resampler ? pa_resampler_request(i->thread_info.resampler, nbytes) : nbytes);
@@ -1292,7 +1321,7 @@ void pa_sink_input_set_volume(pa_sink_input *i, const pa_cvolume *volume, bool s
         pa_sink_input_set_reference_ratio(i, &i->volume);
 
         /* Copy the new soft_volume to the thread_info struct */
-        pa_assert_se(pa_asyncmsgq_send(i->sink->asyncmsgq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME, NULL, 0, NULL) == 0);
+        pa_sink_input_post_soft_volume(i);
     }
 }
 
@@ -1320,7 +1349,7 @@ void pa_sink_input_add_volume_factor(pa_sink_input *i, const char *key, const pa
     pa_sw_cvolume_multiply(&i->soft_volume, &i->real_ratio, &i->volume_factor);
 
     /* Copy the new soft_volume to the thread_info struct */
-    pa_assert_se(pa_asyncmsgq_send(i->sink->asyncmsgq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME, NULL, 0, NULL) == 0);
+    pa_sink_input_post_soft_volume(i);
 }
 
 /* Returns 0 if an entry was removed and -1 if no entry for the given key was
@@ -1351,11 +1380,21 @@ int pa_sink_input_remove_volume_factor(pa_sink_input *i, const char *key) {
     pa_sw_cvolume_multiply(&i->soft_volume, &i->real_ratio, &i->volume_factor);
 
     /* Copy the new soft_volume to the thread_info struct */
-    pa_assert_se(pa_asyncmsgq_send(i->sink->asyncmsgq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME, NULL, 0, NULL) == 0);
+    pa_sink_input_post_soft_volume(i);
 
     return 0;
 }
 
+/* Called from main context */
+void pa_sink_input_post_soft_volume(pa_sink_input *i) {
+    pa_sink_input_assert_ref(i);
+    pa_assert_ctl_context();
+    pa_assert(PA_SINK_INPUT_IS_LINKED(i->state));
+
+    pa_asyncmsgq_post_idempotent(i->sink->asyncmsgq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME,
+                                 pa_xnewdup(pa_cvolume, &i->soft_volume, 1), 0, NULL, pa_xfree);
+}
+
 /* Called from main context */
 static void set_real_ratio(pa_sink_input *i, const pa_cvolume *v) {
     pa_sink_input_assert_ref(i);
@@ -1433,7 +1472,7 @@ void pa_sink_input_set_mute(pa_sink_input *i, bool mute, bool save) {
 
     i->save_muted = save;
 
-    pa_assert_se(pa_asyncmsgq_send(i->sink->asyncmsgq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_SET_SOFT_MUTE, NULL, 0, NULL) == 0);
+    pa_asyncmsgq_post_idempotent(i->sink->asyncmsgq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_SET_SOFT_MUTE, NULL, mute, NULL, NULL);
 
     /* The mute status changed, let's tell people so */
     if (i->mute_changed)
@@ -1599,6 +1638,14 @@ pa_resample_method_t pa_sink_input_get_resample_method(pa_sink_input *i) {
     return i->actual_resample_method;
 }
 
+/* Called from main context */
+unsigned pa_sink_input_get_resampler_level(pa_sink_input *i) {
+    pa_sink_input_assert_ref(i);
+    pa_assert_ctl_context();
+
+    return i->resampler_level;
+}
+
 /* Called from main context */
 bool pa_sink_input_may_move(pa_sink_input *i) {
     pa_sink_input_assert_ref(i);
@@ -2051,16 +2098,21 @@ int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t
 
     switch (code) {
 
-        case PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME:
-            if (!pa_cvolume_equal(&i->thread_info.soft_volume, &i->soft_volume)) {
-                i->thread_info.soft_volume = i->soft_volume;
+        case PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME: {
+            /* The message carries a snapshot of i->soft_volume, see
+             * pa_sink_input_post_soft_volume() */
+            const pa_cvolume *v = userdata;
+
+            if (!pa_cvolume_equal(&i->thread_info.soft_volume, v)) {
+                i->thread_info.soft_volume = *v;
                 pa_sink_input_request_rewind(i, 0, true, false, false);
             }
             return 0;
+        }
 
         case PA_SINK_INPUT_MESSAGE_SET_SOFT_MUTE:
-            if (i->thread_info.muted != i->muted) {
-                i->thread_info.muted = i->muted;
+            if (i->thread_info.muted != !!offset) {
+                i->thread_info.muted = !!offset;
                 pa_sink_input_request_rewind(i, 0, true, false, false);
             }
             return 0;
@@ -2108,11 +2160,69 @@ int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t
             *r = i->thread_info.requested_sink_latency;
             return 0;
         }
+
+        case PA_SINK_INPUT_MESSAGE_UPDATE_RESAMPLER_LEVEL:
+            /* This message is sent from IO-thread and handled in main thread. */
+            pa_assert_ctl_context();
+
+            /* The resampler is owned by the IO thread, so the level and
+             * method are passed by value, packed into offset. The
+             * resampler might have been replaced in the meantime. */
+            if (PA_PTR_TO_UINT(userdata) != i->resampler_serial)
+                return 0;
+
+            i->resampler_level = (unsigned) (offset & 0xff);
+            i->actual_resample_method = (pa_resample_method_t) (offset >> 8);
+
+            if (PA_SINK_INPUT_IS_LINKED(i->state))
+                pa_subscription_post(i->core, PA_SUBSCRIPTION_EVENT_SINK_INPUT|PA_SUBSCRIPTION_EVENT_CHANGE, i->index);
+
+            return 0;
     }
 
     return -PA_ERR_NOTIMPLEMENTED;
 }
 
+/* Called from IO context */
+static pa_resample_method_t resample_method_for_level(pa_resample_method_t method, unsigned level) {
+    static const int max_quality[PA_SINK_INPUT_RESAMPLER_LEVEL_MAX + 1] = { 10, 3, 1, 0 };
+    pa_resample_method_t base;
+
+    pa_assert(level <= PA_SINK_INPUT_RESAMPLER_LEVEL_MAX);
+
+    /* Only the speex resamplers can change their quality on the fly */
+    if (method >= PA_RESAMPLER_SPEEX_FLOAT_BASE && method <= PA_RESAMPLER_SPEEX_FLOAT_MAX)
+        base = PA_RESAMPLER_SPEEX_FLOAT_BASE;
+    else if (method >= PA_RESAMPLER_SPEEX_FIXED_BASE && method <= PA_RESAMPLER_SPEEX_FIXED_MAX)
+        base = PA_RESAMPLER_SPEEX_FIXED_BASE;
+    else
+        return method;
+
+    return base + PA_MIN((int) (method - base), max_quality[level]);
+}
+
+/* Called from IO context */
+void pa_sink_input_set_resampler_level_within_thread(pa_sink_input *i, unsigned level) {
+    pa_sink_input_assert_ref(i);
+    pa_sink_input_assert_io_context(i);
+    pa_assert(level <= PA_SINK_INPUT_RESAMPLER_LEVEL_MAX);
+
+    if (i->thread_info.resampler_level == level)
+        return;
+
+    i->thread_info.resampler_level = level;
+
+    if (!i->thread_info.resampler)
+        return;
+
+    if (pa_resampler_set_method(i->thread_info.resampler, resample_method_for_level(i->thread_info.resampler_base_method, level)) < 0)
+        return;
+
+    pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(i), PA_SINK_INPUT_MESSAGE_UPDATE_RESAMPLER_LEVEL,
+                      PA_UINT_TO_PTR(i->thread_info.resampler_serial),
+                      ((int64_t) pa_resampler_get_method(i->thread_info.resampler) << 8) | level, NULL, NULL);
+}
+
 /* Called from IO context */
 bool pa_sink_input_safe_to_remove(pa_sink_input *i) {
     pa_sink_input_assert_ref(i);
@@ -2208,10 +2318,10 @@ void pa_sink_input_request_rewind(
             nbytes = pa_resampler_result(i->thread_info.resampler, nbytes);
 
         if (nbytes > lbq)
-            pa_sink_request_rewind(i->sink, nbytes - lbq);
+            pa_sink_request_rewind_input(i->sink, i, nbytes - lbq);
         else
             /* This call will make sure process_rewind() is called later */
-            pa_sink_request_rewind(i->sink, 0);
+            pa_sink_request_rewind_input(i->sink, i, 0);
     }
 }
 
@@ -2310,6 +2420,7 @@ int pa_sink_input_update_rate(pa_sink_input *i) {
     i->thread_info.resampler = new_resampler;
 
     pa_memblockq_free(i->thread_info.render_memblockq);
+    pa_cvolume_init(&i->thread_info.mix_volume);
 
     memblockq_name = pa_sprintf_malloc("sink input render_memblockq [%u]", i->index);
     i->thread_info.render_memblockq = pa_memblockq_new(
@@ -2325,6 +2436,10 @@ int pa_sink_input_update_rate(pa_sink_input *i) {
     pa_xfree(memblockq_name);
 
     i->actual_resample_method = new_resampler ? pa_resampler_get_method(new_resampler) : PA_RESAMPLER_INVALID;
+    i->resampler_level = 0;
+    i->thread_info.resampler_base_method = i->actual_resample_method;
+    i->thread_info.resampler_level = 0;
+    i->thread_info.resampler_serial = ++i->resampler_serial;
 
     pa_log_debug("Updated resampler for sink input %d", i->index);
 
@@ -2338,6 +2453,9 @@ void pa_sink_input_attach(pa_sink_input *i) {
 
     i->thread_info.attached = true;
 
+    /* Nothing of ours is in the sink's mix history yet */
+    pa_cvolume_init(&i->thread_info.mix_volume);
+
     if (i->attach)
         i->attach(i);
 }
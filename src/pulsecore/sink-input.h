@@ -26,6 +26,7 @@
 #include <pulsecore/typedefs.h>
 #include <pulse/sample.h>
 #include <pulse/format.h>
+#include <pulsecore/atomic.h>
 #include <pulsecore/memblockq.h>
 #include <pulsecore/resampler.h>
 #include <pulsecore/module.h>
@@ -127,6 +128,19 @@ struct pa_sink_input {
 
     pa_resample_method_t requested_resample_method, actual_resample_method;
 
+    /* The quality level the sink's resample quality governor currently
+     * imposes on our resampler, 0 being the quality we were set up with */
+    unsigned resampler_level;
+
+    /* Counts the resamplers we had, so that updates of the level that
+     * are meant for an earlier one can be told apart */
+    unsigned resampler_serial;
+
+    /* How many blocks we queued for the sink, and how many of those
+     * turned out to be silence and are not going to be mixed. Written
+     * from IO thread context, may be read from anywhere. */
+    pa_atomic_t n_render_blocks, n_silent_blocks;
+
     /* Returns the chunk of audio data and drops it from the
      * queue. Returns -1 on failure. Called from IO thread context. If
      * data needs to be generated from scratch then please in the
@@ -236,6 +250,15 @@ struct pa_sink_input {
         /* rewrite_nbytes: 0: rewrite nothing, (size_t) -1: rewrite everything, otherwise how many bytes to rewrite */
         bool rewrite_flush:1, dont_rewind_render:1;
         size_t rewrite_nbytes;
+
+        /* True if we asked the sink for a rewind that it did not
+         * process yet */
+        bool rewind_selected:1;
+
+        /* The volume the sink mixed us with the last time, and the
+         * write index of the sink's mix history since when it does */
+        pa_cvolume mix_volume;
+        int64_t mix_volume_since;
         uint64_t underrun_for, playing_for;
         uint64_t underrun_for_sink; /* Like underrun_for, but in sink sample spec */
 
@@ -243,6 +266,12 @@ struct pa_sink_input {
 
         pa_resampler *resampler;                     /* may be NULL */
 
+        /* The method the resampler was created with, and the level the
+         * governor asked for last */
+        pa_resample_method_t resampler_base_method;
+        unsigned resampler_level;
+        unsigned resampler_serial;
+
         /* We maintain a history of resampled audio data here. */
         pa_memblockq *render_memblockq;
 
@@ -260,6 +289,8 @@ struct pa_sink_input {
 PA_DECLARE_PUBLIC_CLASS(pa_sink_input);
 #define PA_SINK_INPUT(o) pa_sink_input_cast(o)
 
+#define PA_SINK_INPUT_RESAMPLER_LEVEL_MAX 3
+
 enum {
     PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME,
     PA_SINK_INPUT_MESSAGE_SET_SOFT_MUTE,
@@ -268,6 +299,7 @@ enum {
     PA_SINK_INPUT_MESSAGE_SET_STATE,
     PA_SINK_INPUT_MESSAGE_SET_REQUESTED_LATENCY,
     PA_SINK_INPUT_MESSAGE_GET_REQUESTED_LATENCY,
+    PA_SINK_INPUT_MESSAGE_UPDATE_RESAMPLER_LEVEL,
     PA_SINK_INPUT_MESSAGE_MAX
 };
 
@@ -380,6 +412,7 @@ void pa_sink_input_set_property_arbitrary(pa_sink_input *i, const char *key, con
 void pa_sink_input_update_proplist(pa_sink_input *i, pa_update_mode_t mode, pa_proplist *p);
 
 pa_resample_method_t pa_sink_input_get_resample_method(pa_sink_input *i);
+unsigned pa_sink_input_get_resampler_level(pa_sink_input *i);
 
 void pa_sink_input_send_event(pa_sink_input *i, const char *name, pa_proplist *data);
 
@@ -410,6 +443,10 @@ int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t
 
 pa_usec_t pa_sink_input_set_requested_latency_within_thread(pa_sink_input *i, pa_usec_t usec);
 
+/* Cap the quality of our resampler, 0 lifts the cap again and
+ * PA_SINK_INPUT_RESAMPLER_LEVEL_MAX is the cheapest one */
+void pa_sink_input_set_resampler_level_within_thread(pa_sink_input *i, unsigned level);
+
 bool pa_sink_input_safe_to_remove(pa_sink_input *i);
 bool pa_sink_input_process_underrun(pa_sink_input *i);
 
@@ -453,6 +490,12 @@ void pa_sink_input_set_volume_direct(pa_sink_input *i, const pa_cvolume *volume)
  * i->reference_ratio and logs a message if the value changes. */
 void pa_sink_input_set_reference_ratio(pa_sink_input *i, const pa_cvolume *ratio);
 
+/* Called from the main thread. Copies i->soft_volume to the IO thread
+ * asynchronously. The message carries a snapshot of the volume and is
+ * idempotent, so if several of them are queued only the newest one is
+ * applied. */
+void pa_sink_input_post_soft_volume(pa_sink_input *i);
+
 #define pa_sink_input_assert_io_context(s) \
     pa_assert(pa_thread_mq_get() || !PA_SINK_INPUT_IS_LINKED((s)->state))
 
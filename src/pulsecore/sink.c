@@ -54,6 +54,11 @@
 #define ABSOLUTE_MIN_LATENCY (500)
 #define ABSOLUTE_MAX_LATENCY (10*PA_USEC_PER_SEC)
 #define DEFAULT_FIXED_LATENCY (250*PA_USEC_PER_MSEC)
+#define MIX_HISTORY_MAXLENGTH (32*1024*1024)
+#define GOVERNOR_WINDOW_USEC (500*PA_USEC_PER_MSEC)
+#define GOVERNOR_LOAD_HIGH 40 /* percent */
+#define GOVERNOR_LOAD_LOW 15 /* percent */
+#define GOVERNOR_CALM_WINDOWS 4
 
 PA_DEFINE_PUBLIC_CLASS(pa_sink, pa_msgobject);
 
@@ -74,6 +79,7 @@ static void sink_free(pa_object *s);
 static void pa_sink_volume_change_push(pa_sink *s);
 static void pa_sink_volume_change_flush(pa_sink *s);
 static void pa_sink_volume_change_rewind(pa_sink *s, size_t nbytes);
+static void update_mix_history(pa_sink *s);
 
 pa_sink_new_data* pa_sink_new_data_init(pa_sink_new_data *data) {
     pa_assert(data);
@@ -329,6 +335,7 @@ pa_sink* pa_sink_new(
     s->thread_info.state = s->state;
     s->thread_info.rewind_nbytes = 0;
     s->thread_info.rewind_requested = false;
+    s->thread_info.rewind_all = false;
     s->thread_info.max_rewind = 0;
     s->thread_info.max_request = 0;
     s->thread_info.requested_latency_valid = false;
@@ -344,6 +351,17 @@ pa_sink* pa_sink_new(
     s->thread_info.volume_change_extra_delay = core->deferred_volume_extra_delay_usec;
     s->thread_info.port_latency_offset = s->port_latency_offset;
 
+    s->thread_info.mix_history = NULL;
+    s->thread_info.mix_scratch = NULL;
+    s->thread_info.mix_scratch_size = 0;
+    update_mix_history(s);
+
+    s->thread_info.governor = core->resample_quality_governor;
+    s->thread_info.governor_busy = 0;
+    s->thread_info.governor_audio = 0;
+    s->thread_info.governor_level = 0;
+    s->thread_info.governor_calm_windows = 0;
+
     /* FIXME: This should probably be moved to pa_sink_put() */
     pa_assert_se(pa_idxset_put(core->sinks, s, &s->index) >= 0);
 
@@ -798,6 +816,11 @@ static void sink_free(pa_object *o) {
     pa_idxset_free(s->inputs, NULL);
     pa_hashmap_free(s->thread_info.inputs);
 
+    if (s->thread_info.mix_history)
+        pa_memblockq_free(s->thread_info.mix_history);
+
+    pa_xfree(s->thread_info.mix_scratch);
+
     if (s->silence.memblock)
         pa_memblock_unref(s->silence.memblock);
 
@@ -1020,10 +1043,289 @@ size_t pa_sink_process_input_underruns(pa_sink *s, size_t left_to_play) {
     return left_to_play - result;
 }
 
+/* Called from main context, while the IO thread is not running yet or
+ * the sink is suspended */
+static void update_mix_history(pa_sink *s) {
+    pa_sink_input *i;
+    uint32_t idx;
+    char *name;
+
+    pa_assert(s);
+
+    if (s->thread_info.mix_history) {
+        pa_memblockq_free(s->thread_info.mix_history);
+        s->thread_info.mix_history = NULL;
+    }
+
+    /* Taking the contribution of an input out of the mixed data again
+     * only works if mixing didn't clip, i.e. for float samples */
+    if (!s->core->incremental_rewind || s->sample_spec.format != PA_SAMPLE_FLOAT32NE)
+        return;
+
+    name = pa_sprintf_malloc("sink mix_history [%s]", s->name);
+    s->thread_info.mix_history = pa_memblockq_new(
+            name,
+            0,
+            MIX_HISTORY_MAXLENGTH,
+            0,
+            &s->sample_spec,
+            0,
+            1,
+            s->thread_info.max_rewind,
+            NULL);
+    pa_xfree(name);
+
+    pa_cvolume_init(&s->thread_info.mix_soft_volume);
+    s->thread_info.mix_soft_volume_since = 0;
+
+    PA_IDXSET_FOREACH(i, s->inputs, idx)
+        pa_cvolume_init(&i->thread_info.mix_volume);
+}
+
+/* Called from IO thread context */
+static void mix_history_push(pa_sink *s, pa_memchunk *chunk, bool copy) {
+    pa_memchunk c;
+
+    if (!s->thread_info.mix_history)
+        return;
+
+    pa_assert(!pa_memblockq_is_readable(s->thread_info.mix_history));
+
+    c = *chunk;
+
+    if (copy) {
+        /* The caller may be rendering into a buffer it will overwrite */
+        c.memblock = pa_memblock_new(s->core->mempool, c.length);
+        c.index = 0;
+        pa_memchunk_memcpy(&c, chunk);
+    } else
+        pa_memblock_ref(c.memblock);
+
+    pa_assert_se(pa_memblockq_push(s->thread_info.mix_history, &c) >= 0);
+    pa_memblockq_drop(s->thread_info.mix_history, c.length);
+
+    pa_memblock_unref(c.memblock);
+}
+
+/* Called from IO thread context. Hands out what an incremental rewind
+ * mixed ahead */
+static void mix_history_pop(pa_sink *s, size_t length, pa_memchunk *result) {
+    size_t l;
+
+    pa_assert_se(pa_memblockq_peek(s->thread_info.mix_history, result) >= 0);
+    pa_assert(result->memblock);
+
+    l = pa_memblockq_get_length(s->thread_info.mix_history);
+    if (result->length > l)
+        result->length = l;
+    if (result->length > length)
+        result->length = length;
+
+    pa_memblockq_drop(s->thread_info.mix_history, result->length);
+
+    if (s->monitor_source && pa_source_has_running_outputs(s->monitor_source))
+        pa_source_post(s->monitor_source, result);
+}
+
+/* Called from IO thread context. Adds the data in chunk, scaled by the
+ * given input volume and the sink soft volume, to dst. The volume is
+ * applied exactly like pa_mix() does it. */
+static void mix_history_accumulate(pa_sink *s, float *dst, const pa_memchunk *chunk, const pa_cvolume *volume, float sign) {
+    float linear[PA_CHANNELS_MAX];
+    const float *src;
+    unsigned channel, channels;
+    size_t n;
+
+    if (!chunk->memblock || pa_memblock_is_silence(chunk->memblock) || pa_cvolume_is_muted(volume))
+        return;
+
+    channels = s->sample_spec.channels;
+    pa_assert(volume->channels == channels);
+
+    for (channel = 0; channel < channels; channel++)
+        linear[channel] = sign * (float) (pa_sw_volume_to_linear(volume->values[channel]) *
+                                          pa_sw_volume_to_linear(s->thread_info.mix_soft_volume.values[channel]));
+
+    src = (const float*) ((uint8_t*) pa_memblock_acquire(chunk->memblock) + chunk->index);
+
+    for (n = chunk->length / pa_frame_size(&s->sample_spec); n > 0; n--)
+        for (channel = 0; channel < channels; channel++)
+            *(dst++) += *(src++) * linear[channel];
+
+    pa_memblock_release(chunk->memblock);
+}
+
+/* Called from IO thread context. Instead of rewinding and re-mixing
+ * all inputs this takes the old contribution of those inputs that
+ * asked for the rewind out of the mixed data we kept, and adds their
+ * new data. All other inputs are left alone. Returns false if this
+ * isn't possible, in which case everything needs to be re-rendered. */
+static bool process_rewind_incremental(pa_sink *s, size_t nbytes) {
+    pa_memblockq *history = s->thread_info.mix_history;
+    pa_sink_input *i;
+    void *state = NULL;
+    unsigned n_inputs, n_selected = 0;
+    int64_t start;
+    size_t done, block_size_max;
+
+    if (!history || nbytes <= 0)
+        return false;
+
+    /* The history has been rewound already, so its read index is where
+     * the data we have to replace begins */
+    start = pa_memblockq_get_read_index(history);
+    if (start < 0)
+        return false;
+
+    if (s->thread_info.soft_muted ||
+        !pa_cvolume_valid(&s->thread_info.mix_soft_volume) ||
+        !pa_cvolume_equal(&s->thread_info.mix_soft_volume, &s->thread_info.soft_volume) ||
+        s->thread_info.mix_soft_volume_since > start)
+        return false;
+
+    n_inputs = pa_hashmap_size(s->thread_info.inputs);
+    if (n_inputs > MAX_MIX_CHANNELS)
+        return false;
+
+    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
+        pa_sink_input_assert_ref(i);
+
+        /* Direct outputs on the monitor source get each input's data
+         * separately, which we cannot provide from the history */
+        if (pa_hashmap_size(i->thread_info.direct_outputs) > 0)
+            return false;
+
+        if (!i->thread_info.rewind_selected)
+            continue;
+
+        if (!pa_cvolume_valid(&i->thread_info.mix_volume) ||
+            i->thread_info.mix_volume_since > start)
+            return false;
+
+        n_selected++;
+    }
+
+    /* Taking an input out and adding it back costs about as much as
+     * mixing two inputs, so this only pays off if few inputs changed */
+    if (n_selected <= 0 || n_selected * 2 >= n_inputs)
+        return false;
+
+    pa_log_debug("Re-rendering %u of %u inputs for rewind.", n_selected, n_inputs);
+
+    if (s->thread_info.mix_scratch_size < nbytes) {
+        pa_xfree(s->thread_info.mix_scratch);
+        s->thread_info.mix_scratch = pa_xmalloc(nbytes);
+        s->thread_info.mix_scratch_size = nbytes;
+    }
+
+    /* Start with what we mixed the last time... */
+    for (done = 0; done < nbytes;) {
+        pa_memchunk chunk;
+
+        /* We might not have kept this much yet */
+        if (pa_memblockq_peek(history, &chunk) < 0 || !chunk.memblock) {
+            pa_memblockq_rewind(history, done);
+            return false;
+        }
+
+        if (chunk.length > nbytes - done)
+            chunk.length = nbytes - done;
+
+        memcpy((uint8_t*) s->thread_info.mix_scratch + done,
+               (uint8_t*) pa_memblock_acquire(chunk.memblock) + chunk.index,
+               chunk.length);
+        pa_memblock_release(chunk.memblock);
+        pa_memblock_unref(chunk.memblock);
+
+        pa_memblockq_drop(history, chunk.length);
+        done += chunk.length;
+    }
+
+    pa_memblockq_rewind(history, nbytes);
+    pa_memblockq_seek(history, - (int64_t) nbytes, PA_SEEK_RELATIVE, true);
+
+    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
+
+        if (!i->thread_info.rewind_selected) {
+            pa_sink_input_process_rewind(i, 0);
+            continue;
+        }
+
+        i->thread_info.rewind_selected = false;
+
+        /* ... take out what this input contributed to it... */
+        pa_memblockq_rewind(i->thread_info.render_memblockq, nbytes);
+
+        for (done = 0; done < nbytes;) {
+            pa_memchunk chunk;
+
+            pa_assert_se(pa_memblockq_peek(i->thread_info.render_memblockq, &chunk) >= 0);
+
+            if (chunk.length > nbytes - done)
+                chunk.length = nbytes - done;
+
+            mix_history_accumulate(s, (float*) ((uint8_t*) s->thread_info.mix_scratch + done), &chunk, &i->thread_info.mix_volume, -1.0f);
+
+            if (chunk.memblock)
+                pa_memblock_unref(chunk.memblock);
+
+            pa_memblockq_drop(i->thread_info.render_memblockq, chunk.length);
+            done += chunk.length;
+        }
+
+        /* ... and add what it has to say now. */
+        pa_sink_input_process_rewind(i, nbytes);
+
+        for (done = 0; done < nbytes;) {
+            pa_memchunk chunk;
+            pa_cvolume volume;
+
+            pa_sink_input_peek(i, nbytes - done, &chunk, &volume);
+
+            if (chunk.length > nbytes - done)
+                chunk.length = nbytes - done;
+
+            mix_history_accumulate(s, (float*) ((uint8_t*) s->thread_info.mix_scratch + done), &chunk, &volume, 1.0f);
+
+            pa_memblock_unref(chunk.memblock);
+
+            pa_sink_input_drop(i, chunk.length);
+            done += chunk.length;
+
+            if (!pa_cvolume_equal(&volume, &i->thread_info.mix_volume)) {
+                i->thread_info.mix_volume = volume;
+                i->thread_info.mix_volume_since = start;
+            }
+        }
+    }
+
+    block_size_max = pa_frame_align(pa_mempool_block_size_max(s->core->mempool), &s->sample_spec);
+
+    for (done = 0; done < nbytes;) {
+        pa_memchunk chunk;
+
+        chunk.index = 0;
+        chunk.length = PA_MIN(nbytes - done, block_size_max);
+        chunk.memblock = pa_memblock_new(s->core->mempool, chunk.length);
+
+        memcpy(pa_memblock_acquire(chunk.memblock), (uint8_t*) s->thread_info.mix_scratch + done, chunk.length);
+        pa_memblock_release(chunk.memblock);
+
+        pa_assert_se(pa_memblockq_push(history, &chunk) >= 0);
+        pa_memblock_unref(chunk.memblock);
+
+        done += chunk.length;
+    }
+
+    return true;
+}
+
 /* Called from IO thread context */
 void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
     pa_sink_input *i;
     void *state = NULL;
+    size_t rewrite = nbytes;
+    bool rewind_all;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1036,8 +1338,19 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
     if (!s->thread_info.rewind_requested && nbytes <= 0)
         return;
 
+    /* What an earlier incremental rewind mixed ahead and has not been
+     * handed out yet needs to be redone, too */
+    if (s->thread_info.mix_history) {
+        pa_memblockq_rewind(s->thread_info.mix_history, nbytes);
+        rewrite = pa_memblockq_get_length(s->thread_info.mix_history);
+    }
+
+    /* Rewinds the sink does on its own behalf concern all inputs */
+    rewind_all = s->thread_info.rewind_all || !s->thread_info.rewind_requested;
+
     s->thread_info.rewind_nbytes = 0;
     s->thread_info.rewind_requested = false;
+    s->thread_info.rewind_all = false;
 
     if (nbytes > 0) {
         pa_log_debug("Processing rewind...");
@@ -1045,9 +1358,22 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
             pa_sink_volume_change_rewind(s, nbytes);
     }
 
-    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
-        pa_sink_input_assert_ref(i);
-        pa_sink_input_process_rewind(i, nbytes);
+    if (rewind_all || !process_rewind_incremental(s, rewrite)) {
+
+        if (s->thread_info.mix_history)
+            pa_memblockq_seek(s->thread_info.mix_history, - (int64_t) rewrite, PA_SEEK_RELATIVE, true);
+
+        PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
+            pa_sink_input_assert_ref(i);
+
+            /* If the render queue is not rewound it doesn't line up
+             * with our mix history anymore */
+            if (i->thread_info.dont_rewind_render)
+                pa_cvolume_init(&i->thread_info.mix_volume);
+
+            i->thread_info.rewind_selected = false;
+            pa_sink_input_process_rewind(i, rewrite);
+        }
     }
 
     if (nbytes > 0) {
@@ -1067,11 +1393,33 @@ static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, uns
     pa_sink_assert_io_context(s);
     pa_assert(info);
 
+    if (s->thread_info.mix_history) {
+        pa_cvolume v = s->thread_info.soft_volume;
+
+        if (s->thread_info.soft_muted)
+            pa_cvolume_mute(&v, s->sample_spec.channels);
+
+        /* Remember since when we mix with this volume, an incremental
+         * rewind must not reach back before that */
+        if (!pa_cvolume_valid(&s->thread_info.mix_soft_volume) ||
+            !pa_cvolume_equal(&v, &s->thread_info.mix_soft_volume)) {
+            s->thread_info.mix_soft_volume = v;
+            s->thread_info.mix_soft_volume_since = pa_memblockq_get_write_index(s->thread_info.mix_history);
+        }
+    }
+
     while ((i = pa_hashmap_iterate(s->thread_info.inputs, &state, NULL)) && maxinfo > 0) {
         pa_sink_input_assert_ref(i);
 
         pa_sink_input_peek(i, *length, &info->chunk, &info->volume);
 
+        if (s->thread_info.mix_history &&
+            (!pa_cvolume_valid(&i->thread_info.mix_volume) ||
+             !pa_cvolume_equal(&info->volume, &i->thread_info.mix_volume))) {
+            i->thread_info.mix_volume = info->volume;
+            i->thread_info.mix_volume_since = pa_memblockq_get_write_index(s->thread_info.mix_history);
+        }
+
         if (mixlength == 0 || info->chunk.length < mixlength)
             mixlength = info->chunk.length;
 
@@ -1096,12 +1444,29 @@ static unsigned fill_mix_info(pa_sink *s, size_t *length, pa_mix_info *info, uns
     return n;
 }
 
+/* Called from IO thread context */
+static bool has_running_direct_outputs(pa_sink_input *i) {
+    pa_source_output *o;
+    void *state = NULL;
+
+    PA_HASHMAP_FOREACH(o, i->thread_info.direct_outputs, state) {
+        pa_source_output_assert_ref(o);
+        pa_assert(o->direct_on_input == i);
+
+        if (o->push && o->thread_info.state == PA_SOURCE_OUTPUT_RUNNING)
+            return true;
+    }
+
+    return false;
+}
+
 /* Called from IO thread context */
 static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *result) {
     pa_sink_input *i;
     void *state;
     unsigned p = 0;
     unsigned n_unreffed = 0;
+    bool monitor;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1109,6 +1474,10 @@ static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *
     pa_assert(result->memblock);
     pa_assert(result->length > 0);
 
+    monitor = s->monitor_source &&
+        PA_SOURCE_IS_LINKED(s->monitor_source->thread_info.state) &&
+        s->monitor_source->thread_info.state != PA_SOURCE_SUSPENDED;
+
     /* We optimize for the case where the order of the inputs has not changed */
 
     PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
@@ -1133,36 +1502,38 @@ static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *
         /* Drop read data */
         pa_sink_input_drop(i, result->length);
 
-        if (s->monitor_source && PA_SOURCE_IS_LINKED(s->monitor_source->thread_info.state)) {
-
-            if (pa_hashmap_size(i->thread_info.direct_outputs) > 0) {
-                void *ostate = NULL;
-                pa_source_output *o;
-                pa_memchunk c;
-
-                if (m && m->chunk.memblock) {
-                    c = m->chunk;
-                    pa_memblock_ref(c.memblock);
-                    pa_assert(result->length <= c.length);
-                    c.length = result->length;
-
+        /* Only prepare per-input data if one of the direct outputs is
+         * going to take it */
+        if (monitor && pa_hashmap_size(i->thread_info.direct_outputs) > 0 && has_running_direct_outputs(i)) {
+            void *ostate = NULL;
+            pa_source_output *o;
+            pa_memchunk c;
+
+            if (m && m->chunk.memblock && !pa_cvolume_is_muted(&m->volume)) {
+                c = m->chunk;
+                pa_memblock_ref(c.memblock);
+                pa_assert(result->length <= c.length);
+                c.length = result->length;
+
+                /* At unity volume the data can be shared as it is */
+                if (!pa_cvolume_is_norm(&m->volume)) {
                     pa_memchunk_make_writable(&c, 0);
                     pa_volume_memchunk(&c, &s->sample_spec, &m->volume);
-                } else {
-                    c = s->silence;
-                    pa_memblock_ref(c.memblock);
-                    pa_assert(result->length <= c.length);
-                    c.length = result->length;
-                }
-
-                while ((o = pa_hashmap_iterate(i->thread_info.direct_outputs, &ostate, NULL))) {
-                    pa_source_output_assert_ref(o);
-                    pa_assert(o->direct_on_input == i);
-                    pa_source_post_direct(s->monitor_source, o, &c);
                 }
+            } else {
+                c = s->silence;
+                pa_memblock_ref(c.memblock);
+                pa_assert(result->length <= c.length);
+                c.length = result->length;
+            }
 
-                pa_memblock_unref(c.memblock);
+            while ((o = pa_hashmap_iterate(i->thread_info.direct_outputs, &ostate, NULL))) {
+                pa_source_output_assert_ref(o);
+                pa_assert(o->direct_on_input == i);
+                pa_source_post_direct(s->monitor_source, o, &c);
             }
+
+            pa_memblock_unref(c.memblock);
         }
 
         if (m) {
@@ -1190,15 +1561,60 @@ static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *
         }
     }
 
-    if (s->monitor_source && PA_SOURCE_IS_LINKED(s->monitor_source->thread_info.state))
+    if (monitor && pa_source_has_running_outputs(s->monitor_source))
         pa_source_post(s->monitor_source, result);
 }
 
+/* Called from IO thread context */
+static void governor_account(pa_sink *s, pa_usec_t start, size_t length) {
+    pa_sink_input *i;
+    void *state = NULL;
+    unsigned load, level;
+
+    s->thread_info.governor_busy += pa_rtclock_now() - start;
+    s->thread_info.governor_audio += pa_bytes_to_usec(length, &s->sample_spec);
+
+    if (s->thread_info.governor_audio < GOVERNOR_WINDOW_USEC)
+        return;
+
+    load = (unsigned) (s->thread_info.governor_busy * 100 / s->thread_info.governor_audio);
+    s->thread_info.governor_busy = s->thread_info.governor_audio = 0;
+
+    level = s->thread_info.governor_level;
+
+    if (load > GOVERNOR_LOAD_HIGH) {
+        s->thread_info.governor_calm_windows = 0;
+
+        if (level < PA_SINK_INPUT_RESAMPLER_LEVEL_MAX)
+            level++;
+    } else if (load < GOVERNOR_LOAD_LOW && level > 0) {
+        /* Don't go back up before the load has been low for a while,
+         * so that we don't flip back and forth */
+        if (++s->thread_info.governor_calm_windows >= GOVERNOR_CALM_WINDOWS) {
+            s->thread_info.governor_calm_windows = 0;
+            level--;
+        }
+    } else
+        s->thread_info.governor_calm_windows = 0;
+
+    if (level != s->thread_info.governor_level)
+        pa_log_info("Rendering on sink %s takes %u%% of the time, switching resamplers to quality level %u.",
+                    s->name, load, level);
+
+    s->thread_info.governor_level = level;
+
+    /* This is also where inputs that joined since the last window get
+     * their level */
+    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state)
+        pa_sink_input_set_resampler_level_within_thread(i, level);
+}
+
 /* Called from IO thread context */
 void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
     pa_mix_info info[MAX_MIX_CHANNELS];
     unsigned n;
     size_t block_size_max;
+    pa_usec_t start = 0;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1227,6 +1643,15 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 
     pa_assert(length > 0);
 
+    if (s->thread_info.mix_history && pa_memblockq_is_readable(s->thread_info.mix_history)) {
+        mix_history_pop(s, length, result);
+        pa_sink_unref(s);
+        return;
+    }
+
+    if (s->thread_info.governor)
+        start = pa_rtclock_now();
+
     n = fill_mix_info(s, &length, info, MAX_MIX_CHANNELS);
 
     if (n == 0) {
@@ -1274,8 +1699,12 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
         result->index = 0;
     }
 
+    mix_history_push(s, result, false);
     inputs_drop(s, info, n, result);
 
+    if (s->thread_info.governor)
+        governor_account(s, start, result->length);
+
     pa_sink_unref(s);
 }
 
@@ -1284,6 +1713,7 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
     pa_mix_info info[MAX_MIX_CHANNELS];
     unsigned n;
     size_t length, block_size_max;
+    pa_usec_t start = 0;
 
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
@@ -1310,6 +1740,22 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 
     pa_assert(length > 0);
 
+    if (s->thread_info.mix_history && pa_memblockq_is_readable(s->thread_info.mix_history)) {
+        pa_memchunk chunk;
+
+        mix_history_pop(s, length, &chunk);
+
+        target->length = chunk.length;
+        pa_memchunk_memcpy(target, &chunk);
+        pa_memblock_unref(chunk.memblock);
+
+        pa_sink_unref(s);
+        return;
+    }
+
+    if (s->thread_info.governor)
+        start = pa_rtclock_now();
+
     n = fill_mix_info(s, &length, info, MAX_MIX_CHANNELS);
 
     if (n == 0) {
@@ -1359,8 +1805,12 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
         pa_memblock_release(target->memblock);
     }
 
+    mix_history_push(s, target, true);
     inputs_drop(s, info, n, target);
 
+    if (s->thread_info.governor)
+        governor_account(s, start, target->length);
+
     pa_sink_unref(s);
 }
 
@@ -1518,6 +1968,8 @@ int pa_sink_reconfigure(pa_sink *s, pa_sample_spec *spec, bool passthrough) {
     pa_sink_suspend(s, true, PA_SUSPEND_INTERNAL);
 
     if (s->reconfigure(s, &desired_spec, passthrough) >= 0) {
+        update_mix_history(s);
+
         /* update monitor source as well */
         if (s->monitor_source && !passthrough)
             pa_source_reconfigure(s->monitor_source, &desired_spec, false);
@@ -2055,6 +2507,38 @@ static bool update_reference_volume(pa_sink *s, const pa_cvolume *v, const pa_ch
     return true;
 }
 
+/* Called from main thread */
+static void post_soft_volume(pa_sink *s) {
+    pa_asyncmsgq_post_idempotent(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_SET_VOLUME,
+                                 pa_xnewdup(pa_cvolume, &s->soft_volume, 1), 0, NULL, pa_xfree);
+}
+
+/* Called from main thread. Only called for the root sink in volume sharing
+ * cases, except for internal recursive calls. This is the asynchronous
+ * counterpart of set_shared_volume_within_thread() for sinks without
+ * deferred volume. */
+static void post_shared_volume(pa_sink *s) {
+    pa_sink_input *i;
+    uint32_t idx;
+
+    pa_sink_assert_ref(s);
+
+    if (!PA_SINK_IS_LINKED(s->state) || !s->asyncmsgq)
+        return;
+
+    post_soft_volume(s);
+
+    PA_IDXSET_FOREACH(i, s->inputs, idx) {
+        if (!PA_SINK_INPUT_IS_LINKED(i->state))
+            continue;
+
+        pa_sink_input_post_soft_volume(i);
+
+        if (i->origin_sink && (i->origin_sink->flags & PA_SINK_SHARE_VOLUME_WITH_MASTER))
+            post_shared_volume(i->origin_sink);
+    }
+}
+
 /* Called from main thread */
 void pa_sink_set_volume(
         pa_sink *s,
@@ -2145,9 +2629,17 @@ void pa_sink_set_volume(
          * becomes the real volume */
         root_sink->soft_volume = root_sink->real_volume;
 
-    /* This tells the sink that soft volume and/or real volume changed */
-    if (send_msg)
-        pa_assert_se(pa_asyncmsgq_send(root_sink->asyncmsgq, PA_MSGOBJECT(root_sink), PA_SINK_MESSAGE_SET_SHARED_VOLUME, NULL, 0, NULL) == 0);
+    /* This tells the sink that soft volume and/or real volume changed. With
+     * deferred volume the IO thread needs to talk to the hardware with the
+     * main thread state, so we have to wait for it. Otherwise the new soft
+     * volumes are posted as snapshots, which lets the IO thread skip all but
+     * the latest one if the volume is changed faster than it catches up. */
+    if (send_msg) {
+        if (root_sink->flags & PA_SINK_DEFERRED_VOLUME)
+            pa_assert_se(pa_asyncmsgq_send(root_sink->asyncmsgq, PA_MSGOBJECT(root_sink), PA_SINK_MESSAGE_SET_SHARED_VOLUME, NULL, 0, NULL) == 0);
+        else
+            post_shared_volume(root_sink);
+    }
 }
 
 /* Called from the io thread if sync volume is used, otherwise from the main thread.
@@ -2168,7 +2660,7 @@ void pa_sink_set_soft_volume(pa_sink *s, const pa_cvolume *volume) {
         s->soft_volume = *volume;
 
     if (PA_SINK_IS_LINKED(s->state) && !(s->flags & PA_SINK_DEFERRED_VOLUME))
-        pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_SET_VOLUME, NULL, 0, NULL) == 0);
+        post_soft_volume(s);
     else
         s->thread_info.soft_volume = s->soft_volume;
 }
@@ -2309,7 +2801,14 @@ void pa_sink_set_mute(pa_sink *s, bool mute, bool save) {
         return;
 
     pa_log_debug("The mute of sink %s changed from %s to %s.", s->name, pa_yes_no(old_muted), pa_yes_no(mute));
-    pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_SET_MUTE, NULL, 0, NULL) == 0);
+
+    /* With deferred volume the IO thread calls set_mute(), which reads
+     * s->muted, so we have to wait for it */
+    if (s->flags & PA_SINK_DEFERRED_VOLUME)
+        pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_SET_MUTE, NULL, mute, NULL) == 0);
+    else
+        pa_asyncmsgq_post_idempotent(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_SET_MUTE, NULL, mute, NULL, NULL);
+
     pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SINK|PA_SUBSCRIPTION_EVENT_CHANGE, s->index);
     pa_hook_fire(&s->core->hooks[PA_CORE_HOOK_SINK_MUTE_CHANGED], s);
 }
@@ -2791,6 +3290,17 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
 
         case PA_SINK_MESSAGE_SET_VOLUME:
 
+            if (userdata) {
+                /* Posted by post_soft_volume() with a snapshot of
+                 * s->soft_volume. The inputs get their own messages. */
+                if (!pa_cvolume_equal(&s->thread_info.soft_volume, userdata)) {
+                    s->thread_info.soft_volume = *(pa_cvolume*) userdata;
+                    pa_sink_request_rewind(s, (size_t) -1);
+                }
+
+                return 0;
+            }
+
             if (!pa_cvolume_equal(&s->thread_info.soft_volume, &s->soft_volume)) {
                 s->thread_info.soft_volume = s->soft_volume;
                 pa_sink_request_rewind(s, (size_t) -1);
@@ -2820,8 +3330,8 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
 
         case PA_SINK_MESSAGE_SET_MUTE:
 
-            if (s->thread_info.soft_muted != s->muted) {
-                s->thread_info.soft_muted = s->muted;
+            if (s->thread_info.soft_muted != !!offset) {
+                s->thread_info.soft_muted = !!offset;
                 pa_sink_request_rewind(s, (size_t) -1);
             }
 
@@ -2946,6 +3456,14 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             s->thread_info.port_latency_offset = offset;
             return 0;
 
+        case PA_SINK_MESSAGE_GET_RTPOLL_STATS:
+
+            if (!s->thread_info.rtpoll)
+                return -1;
+
+            pa_rtpoll_get_stats(s->thread_info.rtpoll, userdata);
+            return 0;
+
         case PA_SINK_MESSAGE_GET_LATENCY:
         case PA_SINK_MESSAGE_MAX:
             ;
@@ -3007,11 +3525,7 @@ void pa_sink_attach_within_thread(pa_sink *s) {
 }
 
 /* Called from IO thread */
-void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
-    pa_sink_assert_ref(s);
-    pa_sink_assert_io_context(s);
-    pa_assert(PA_SINK_IS_LINKED(s->thread_info.state));
-
+static void request_rewind(pa_sink *s, size_t nbytes) {
     if (nbytes == (size_t) -1)
         nbytes = s->thread_info.max_rewind;
 
@@ -3028,6 +3542,27 @@ void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
         s->request_rewind(s);
 }
 
+/* Called from IO thread */
+void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
+    pa_sink_assert_ref(s);
+    pa_sink_assert_io_context(s);
+    pa_assert(PA_SINK_IS_LINKED(s->thread_info.state));
+
+    s->thread_info.rewind_all = true;
+    request_rewind(s, nbytes);
+}
+
+/* Called from IO thread */
+void pa_sink_request_rewind_input(pa_sink *s, pa_sink_input *i, size_t nbytes) {
+    pa_sink_assert_ref(s);
+    pa_sink_assert_io_context(s);
+    pa_assert(PA_SINK_IS_LINKED(s->thread_info.state));
+    pa_sink_input_assert_ref(i);
+
+    i->thread_info.rewind_selected = true;
+    request_rewind(s, nbytes);
+}
+
 /* Called from IO thread */
 pa_usec_t pa_sink_get_requested_latency_within_thread(pa_sink *s) {
     pa_usec_t result = (pa_usec_t) -1;
@@ -3096,6 +3631,9 @@ void pa_sink_set_max_rewind_within_thread(pa_sink *s, size_t max_rewind) {
 
     s->thread_info.max_rewind = max_rewind;
 
+    if (s->thread_info.mix_history)
+        pa_memblockq_set_maxrewind(s->thread_info.mix_history, s->thread_info.max_rewind);
+
     if (PA_SINK_IS_LINKED(s->thread_info.state))
         PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state)
             pa_sink_input_update_max_rewind(i, s->thread_info.max_rewind);
@@ -3367,6 +3905,18 @@ size_t pa_sink_get_max_rewind(pa_sink *s) {
     return r;
 }
 
+/* Called from main context */
+int pa_sink_get_rtpoll_stats(pa_sink *s, pa_rtpoll_stats *ret) {
+    pa_sink_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(ret);
+
+    if (!PA_SINK_IS_LINKED(s->state) || !s->asyncmsgq)
+        return -1;
+
+    return pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_GET_RTPOLL_STATS, ret, 0, NULL);
+}
+
 /* Called from main context */
 size_t pa_sink_get_max_request(pa_sink *s) {
     size_t r;
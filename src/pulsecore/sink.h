@@ -33,6 +33,7 @@
 #include <pulsecore/core.h>
 #include <pulsecore/idxset.h>
 #include <pulsecore/memchunk.h>
+#include <pulsecore/memblockq.h>
 #include <pulsecore/source.h>
 #include <pulsecore/module.h>
 #include <pulsecore/asyncmsgq.h>
@@ -297,6 +298,28 @@ struct pa_sink {
         /* Maximum of what clients requested to rewind in this cycle */
         size_t rewind_nbytes;
         bool rewind_requested;
+        /* Whether somebody asked for a rewind in this cycle that is not
+         * limited to the data of a few inputs */
+        bool rewind_all;
+
+        /* With incremental rewinding enabled we keep a copy of what we
+         * mixed here. Everything before the read index has been handed
+         * out already, everything after it has been re-mixed by an
+         * incremental rewind but has not been handed out yet. */
+        pa_memblockq *mix_history;
+        /* The soft volume the history has been mixed with, and the
+         * write index of the history since when that is the case */
+        pa_cvolume mix_soft_volume;
+        int64_t mix_soft_volume_since;
+        float *mix_scratch;
+        size_t mix_scratch_size;
+
+        /* The resample quality governor: time spent rendering and
+         * length of the audio rendered in the current window, and the
+         * quality level currently imposed on the inputs */
+        bool governor;
+        pa_usec_t governor_busy, governor_audio;
+        unsigned governor_level, governor_calm_windows;
 
         /* Both dynamic and fixed latencies will be clamped to this
          * range. */
@@ -358,6 +381,7 @@ typedef enum pa_sink_message {
     PA_SINK_MESSAGE_SET_MAX_REQUEST,
     PA_SINK_MESSAGE_UPDATE_VOLUME_AND_MUTE,
     PA_SINK_MESSAGE_SET_PORT_LATENCY_OFFSET,
+    PA_SINK_MESSAGE_GET_RTPOLL_STATS,
     PA_SINK_MESSAGE_MAX
 } pa_sink_message_t;
 
@@ -455,6 +479,9 @@ pa_usec_t pa_sink_get_fixed_latency(pa_sink *s);
 size_t pa_sink_get_max_rewind(pa_sink *s);
 size_t pa_sink_get_max_request(pa_sink *s);
 
+/* Returns -1 if the sink is not linked or has no rtpoll */
+int pa_sink_get_rtpoll_stats(pa_sink *s, pa_rtpoll_stats *ret);
+
 int pa_sink_update_status(pa_sink*s);
 int pa_sink_suspend(pa_sink *s, bool suspend, pa_suspend_cause_t cause);
 int pa_sink_suspend_all(pa_core *c, bool suspend, pa_suspend_cause_t cause);
@@ -544,6 +571,11 @@ size_t pa_sink_process_input_underruns(pa_sink *s, size_t left_to_play);
 
 void pa_sink_request_rewind(pa_sink*s, size_t nbytes);
 
+/* Like pa_sink_request_rewind(), but only the data of the given sink
+ * input needs to change. If the sink keeps a mix history it can then
+ * leave all other inputs alone. */
+void pa_sink_request_rewind_input(pa_sink *s, pa_sink_input *i, size_t nbytes);
+
 void pa_sink_invalidate_requested_latency(pa_sink *s, bool dynamic);
 
 int64_t pa_sink_get_latency_within_thread(pa_sink *s, bool allow_negative);
@@ -999,7 +999,7 @@ void pa_source_output_set_volume(pa_source_output *o, const pa_cvolume *volume,
         set_real_ratio(o, volume);
 
         /* Copy the new soft_volume to the thread_info struct */
-        pa_assert_se(pa_asyncmsgq_send(o->source->asyncmsgq, PA_MSGOBJECT(o), PA_SOURCE_OUTPUT_MESSAGE_SET_SOFT_VOLUME, NULL, 0, NULL) == 0);
+        pa_source_output_post_soft_volume(o);
     }
 
     /* The volume changed, let's tell people so */
@@ -1010,6 +1010,16 @@ void pa_source_output_set_volume(pa_source_output *o, const pa_cvolume *volume,
     pa_subscription_post(o->core, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT|PA_SUBSCRIPTION_EVENT_CHANGE, o->index);
 }
 
+/* Called from main context */
+void pa_source_output_post_soft_volume(pa_source_output *o) {
+    pa_source_output_assert_ref(o);
+    pa_assert_ctl_context();
+    pa_assert(PA_SOURCE_OUTPUT_IS_LINKED(o->state));
+
+    pa_asyncmsgq_post_idempotent(o->source->asyncmsgq, PA_MSGOBJECT(o), PA_SOURCE_OUTPUT_MESSAGE_SET_SOFT_VOLUME,
+                                 pa_xnewdup(pa_cvolume, &o->soft_volume, 1), 0, NULL, pa_xfree);
+}
+
 /* Called from main context */
 static void set_real_ratio(pa_source_output *o, const pa_cvolume *v) {
     pa_source_output_assert_ref(o);
@@ -1087,7 +1097,7 @@ void pa_source_output_set_mute(pa_source_output *o, bool mute, bool save) {
 
     o->save_muted = save;
 
-    pa_assert_se(pa_asyncmsgq_send(o->source->asyncmsgq, PA_MSGOBJECT(o), PA_SOURCE_OUTPUT_MESSAGE_SET_SOFT_MUTE, NULL, 0, NULL) == 0);
+    pa_asyncmsgq_post_idempotent(o->source->asyncmsgq, PA_MSGOBJECT(o), PA_SOURCE_OUTPUT_MESSAGE_SET_SOFT_MUTE, NULL, mute, NULL, NULL);
 
     /* The mute status changed, let's tell people so */
     if (o->mute_changed)
@@ -1683,15 +1693,13 @@ int pa_source_output_process_msg(pa_msgobject *mo, int code, void *userdata, int
         }
 
         case PA_SOURCE_OUTPUT_MESSAGE_SET_SOFT_VOLUME:
-            if (!pa_cvolume_equal(&o->thread_info.soft_volume, &o->soft_volume)) {
-                o->thread_info.soft_volume = o->soft_volume;
-            }
+            /* The message carries a snapshot of o->soft_volume, see
+             * pa_source_output_post_soft_volume() */
+            o->thread_info.soft_volume = *(pa_cvolume*) userdata;
             return 0;
 
         case PA_SOURCE_OUTPUT_MESSAGE_SET_SOFT_MUTE:
-            if (o->thread_info.muted != o->muted) {
-                o->thread_info.muted = o->muted;
-            }
+            o->thread_info.muted = !!offset;
             return 0;
     }
 
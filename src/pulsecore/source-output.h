@@ -396,6 +396,12 @@ void pa_source_output_set_volume_direct(pa_source_output *o, const pa_cvolume *v
  * o->reference_ratio and logs a message if the value changes. */
 void pa_source_output_set_reference_ratio(pa_source_output *o, const pa_cvolume *ratio);
 
+/* Called from the main thread. Copies o->soft_volume to the IO thread
+ * asynchronously. The message carries a snapshot of the volume and is
+ * idempotent, so if several of them are queued only the newest one is
+ * applied. */
+void pa_source_output_post_soft_volume(pa_source_output *o);
+
 #define pa_source_output_assert_io_context(s) \
     pa_assert(pa_thread_mq_get() || !PA_SOURCE_OUTPUT_IS_LINKED((s)->state))
 
@@ -1019,6 +1019,27 @@ void pa_source_post_direct(pa_source*s, pa_source_output *o, const pa_memchunk *
         pa_source_output_push(o, chunk);
 }
 
+/* Called from IO thread context */
+bool pa_source_has_running_outputs(pa_source *s) {
+    pa_source_output *o;
+    void *state = NULL;
+
+    pa_source_assert_ref(s);
+    pa_source_assert_io_context(s);
+
+    if (!PA_SOURCE_IS_LINKED(s->thread_info.state) || s->thread_info.state == PA_SOURCE_SUSPENDED)
+        return false;
+
+    PA_HASHMAP_FOREACH(o, s->thread_info.outputs, state) {
+        pa_source_output_assert_ref(o);
+
+        if (!o->thread_info.direct_on_input && o->push && o->thread_info.state == PA_SOURCE_OUTPUT_RUNNING)
+            return true;
+    }
+
+    return false;
+}
+
 /* Called from main thread */
 int pa_source_reconfigure(pa_source *s, pa_sample_spec *spec, bool passthrough) {
     int ret;
@@ -1635,6 +1656,38 @@ static bool update_reference_volume(pa_source *s, const pa_cvolume *v, const pa_
     return true;
 }
 
+/* Called from main thread */
+static void post_soft_volume(pa_source *s) {
+    pa_asyncmsgq_post_idempotent(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_SET_VOLUME,
+                                 pa_xnewdup(pa_cvolume, &s->soft_volume, 1), 0, NULL, pa_xfree);
+}
+
+/* Called from main thread. Only called for the root source in volume sharing
+ * cases, except for internal recursive calls. This is the asynchronous
+ * counterpart of set_shared_volume_within_thread() for sources without
+ * deferred volume. */
+static void post_shared_volume(pa_source *s) {
+    pa_source_output *o;
+    uint32_t idx;
+
+    pa_source_assert_ref(s);
+
+    if (!PA_SOURCE_IS_LINKED(s->state) || !s->asyncmsgq)
+        return;
+
+    post_soft_volume(s);
+
+    PA_IDXSET_FOREACH(o, s->outputs, idx) {
+        if (!PA_SOURCE_OUTPUT_IS_LINKED(o->state))
+            continue;
+
+        pa_source_output_post_soft_volume(o);
+
+        if (o->destination_source && (o->destination_source->flags & PA_SOURCE_SHARE_VOLUME_WITH_MASTER))
+            post_shared_volume(o->destination_source);
+    }
+}
+
 /* Called from main thread */
 void pa_source_set_volume(
         pa_source *s,
@@ -1735,9 +1788,15 @@ void pa_source_set_volume(
          * becomes the real volume */
         root_source->soft_volume = root_source->real_volume;
 
-    /* This tells the source that soft volume and/or real volume changed */
-    if (send_msg)
-        pa_assert_se(pa_asyncmsgq_send(root_source->asyncmsgq, PA_MSGOBJECT(root_source), PA_SOURCE_MESSAGE_SET_SHARED_VOLUME, NULL, 0, NULL) == 0);
+    /* This tells the source that soft volume and/or real volume changed. See
+     * pa_sink_set_volume() for why this is only synchronous with deferred
+     * volume. */
+    if (send_msg) {
+        if (root_source->flags & PA_SOURCE_DEFERRED_VOLUME)
+            pa_assert_se(pa_asyncmsgq_send(root_source->asyncmsgq, PA_MSGOBJECT(root_source), PA_SOURCE_MESSAGE_SET_SHARED_VOLUME, NULL, 0, NULL) == 0);
+        else
+            post_shared_volume(root_source);
+    }
 }
 
 /* Called from the io thread if sync volume is used, otherwise from the main thread.
@@ -1758,7 +1817,7 @@ void pa_source_set_soft_volume(pa_source *s, const pa_cvolume *volume) {
         s->soft_volume = *volume;
 
     if (PA_SOURCE_IS_LINKED(s->state) && !(s->flags & PA_SOURCE_DEFERRED_VOLUME))
-        pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_SET_VOLUME, NULL, 0, NULL) == 0);
+        post_soft_volume(s);
     else
         s->thread_info.soft_volume = s->soft_volume;
 }
@@ -1898,7 +1957,14 @@ void pa_source_set_mute(pa_source *s, bool mute, bool save) {
         return;
 
     pa_log_debug("The mute of source %s changed from %s to %s.", s->name, pa_yes_no(old_muted), pa_yes_no(mute));
-    pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_SET_MUTE, NULL, 0, NULL) == 0);
+
+    /* With deferred volume the IO thread calls set_mute(), which reads
+     * s->muted, so we have to wait for it */
+    if (s->flags & PA_SOURCE_DEFERRED_VOLUME)
+        pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_SET_MUTE, NULL, mute, NULL) == 0);
+    else
+        pa_asyncmsgq_post_idempotent(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_SET_MUTE, NULL, mute, NULL, NULL);
+
     pa_subscription_post(s->core, PA_SUBSCRIPTION_EVENT_SOURCE|PA_SUBSCRIPTION_EVENT_CHANGE, s->index);
     pa_hook_fire(&s->core->hooks[PA_CORE_HOOK_SOURCE_MUTE_CHANGED], s);
 }
@@ -2168,6 +2234,13 @@ int pa_source_process_msg(pa_msgobject *object, int code, void *userdata, int64_
 
         case PA_SOURCE_MESSAGE_SET_VOLUME:
 
+            if (userdata) {
+                /* Posted by post_soft_volume() with a snapshot of
+                 * s->soft_volume. The outputs get their own messages. */
+                s->thread_info.soft_volume = *(pa_cvolume*) userdata;
+                return 0;
+            }
+
             if (!pa_cvolume_equal(&s->thread_info.soft_volume, &s->soft_volume)) {
                 s->thread_info.soft_volume = s->soft_volume;
             }
@@ -2195,9 +2268,7 @@ int pa_source_process_msg(pa_msgobject *object, int code, void *userdata, int64_
 
         case PA_SOURCE_MESSAGE_SET_MUTE:
 
-            if (s->thread_info.soft_muted != s->muted) {
-                s->thread_info.soft_muted = s->muted;
-            }
+            s->thread_info.soft_muted = !!offset;
 
             if (s->flags & PA_SOURCE_DEFERRED_VOLUME && s->set_mute)
                 s->set_mute(s);
@@ -2315,6 +2386,14 @@ int pa_source_process_msg(pa_msgobject *object, int code, void *userdata, int64_
             s->thread_info.port_latency_offset = offset;
             return 0;
 
+        case PA_SOURCE_MESSAGE_GET_RTPOLL_STATS:
+
+            if (!s->thread_info.rtpoll)
+                return -1;
+
+            pa_rtpoll_get_stats(s->thread_info.rtpoll, userdata);
+            return 0;
+
         case PA_SOURCE_MESSAGE_MAX:
             ;
     }
@@ -2664,6 +2743,18 @@ size_t pa_source_get_max_rewind(pa_source *s) {
     return r;
 }
 
+/* Called from main context */
+int pa_source_get_rtpoll_stats(pa_source *s, pa_rtpoll_stats *ret) {
+    pa_source_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(ret);
+
+    if (!PA_SOURCE_IS_LINKED(s->state) || !s->asyncmsgq)
+        return -1;
+
+    return pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_GET_RTPOLL_STATS, ret, 0, NULL);
+}
+
 /* Called from main context */
 int pa_source_set_port(pa_source *s, const char *name, bool save) {
     pa_device_port *port;
@@ -296,6 +296,7 @@ typedef enum pa_source_message {
     PA_SOURCE_MESSAGE_SET_MAX_REWIND,
     PA_SOURCE_MESSAGE_UPDATE_VOLUME_AND_MUTE,
     PA_SOURCE_MESSAGE_SET_PORT_LATENCY_OFFSET,
+    PA_SOURCE_MESSAGE_GET_RTPOLL_STATS,
     PA_SOURCE_MESSAGE_MAX
 } pa_source_message_t;
 
@@ -387,6 +388,9 @@ pa_usec_t pa_source_get_fixed_latency(pa_source *s);
 
 size_t pa_source_get_max_rewind(pa_source *s);
 
+/* Returns -1 if the source is not linked or has no rtpoll */
+int pa_source_get_rtpoll_stats(pa_source *s, pa_rtpoll_stats *ret);
+
 int pa_source_update_status(pa_source*s);
 int pa_source_suspend(pa_source *s, bool suspend, pa_suspend_cause_t cause);
 int pa_source_suspend_all(pa_core *c, bool suspend, pa_suspend_cause_t cause);
@@ -448,6 +452,10 @@ void pa_source_post(pa_source*s, const pa_memchunk *chunk);
 void pa_source_post_direct(pa_source*s, pa_source_output *o, const pa_memchunk *chunk);
 void pa_source_process_rewind(pa_source *s, size_t nbytes);
 
+/* Returns true if pa_source_post() would actually hand data to one
+ * of the outputs right now, i.e. if it is worth preparing any */
+bool pa_source_has_running_outputs(pa_source *s);
+
 int pa_source_process_msg(pa_msgobject *o, int code, void *userdata, int64_t, pa_memchunk *chunk);
 
 void pa_source_attach_within_thread(pa_source *s);
@@ -23,11 +23,25 @@
 
 #include "srbchannel.h"
 
-#include <pulsecore/atomic.h>
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
 #include <pulse/xmalloc.h>
 
+#include <pulsecore/atomic.h>
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+
 /* #define DEBUG_SRBCHANNEL */
 
+/* Don't spin while the CPU is busier than this (in percent of stall time) */
+#define BUSY_POLL_MAX_CPU_PRESSURE 10.0
+/* How often we look at battery and CPU state again */
+#define BUSY_POLL_CHECK_INTERVAL_USEC (2 * PA_USEC_PER_SEC)
+/* After this many consecutive misses we stop spinning for a while */
+#define BUSY_POLL_MAX_MISSES 32
+#define BUSY_POLL_BACKOFF_USEC (1 * PA_USEC_PER_SEC)
+
 /* This ringbuffer might be useful in other contexts too, but
  * right now it's only used inside the srbchannel, so let's keep it here
  * for the time being. */
@@ -86,6 +100,14 @@ struct pa_srbchannel {
     pa_io_event *read_event;
     pa_defer_event *defer_event;
     pa_mainloop_api *mainloop;
+
+    pa_usec_t busy_poll_usec;
+    bool busy_poll_allowed;
+    pa_time_event *busy_poll_check_event;
+    pa_usec_t busy_poll_resume;
+    unsigned busy_poll_misses;
+
+    pa_srbchannel_stats stats;
 };
 
 /* We always listen to sem_read, and always signal on sem_write.
@@ -178,6 +200,74 @@ struct srbheader {
     /* TODO: Maybe a marker here to make sure we talk to a server with equally sized struct */
 };
 
+/* Looking at the battery and CPU state means reading files, so it is
+ * done from a timer of the mainloop and never on the way to spinning */
+static void busy_poll_update_allowed(pa_srbchannel *sr) {
+    double pressure;
+    bool allowed;
+
+    allowed = !pa_running_on_battery() &&
+        (pa_get_cpu_pressure(&pressure) < 0 || pressure < BUSY_POLL_MAX_CPU_PRESSURE);
+
+    if (allowed != sr->busy_poll_allowed)
+        pa_log_debug("%s srbchannel busy polling", allowed ? "Resuming" : "Suspending");
+
+    sr->busy_poll_allowed = allowed;
+}
+
+static void busy_poll_check_cb(pa_mainloop_api *m, pa_time_event *e, const struct timeval *t, void *userdata) {
+    pa_srbchannel *sr = userdata;
+    struct timeval tv;
+
+    busy_poll_update_allowed(sr);
+
+    m->time_restart(e, pa_timeval_rtstore(&tv, pa_rtclock_now() + BUSY_POLL_CHECK_INTERVAL_USEC, true));
+}
+
+static bool busy_poll_enabled(pa_srbchannel *sr, pa_usec_t now) {
+    if (sr->busy_poll_usec <= 0)
+        return false;
+
+    if (now < sr->busy_poll_resume)
+        return false;
+
+    return sr->busy_poll_allowed;
+}
+
+/* Returns true if data became available before the spin time ran out */
+static bool busy_poll(pa_srbchannel *sr) {
+    pa_usec_t now, deadline;
+    unsigned i = 0;
+
+    now = pa_rtclock_now();
+    if (!busy_poll_enabled(sr, now))
+        return false;
+
+    deadline = now + sr->busy_poll_usec;
+
+    for (;;) {
+        if (pa_atomic_load(sr->rb_read.count) > 0) {
+            sr->stats.spin_hits++;
+            sr->busy_poll_misses = 0;
+            return true;
+        }
+
+        /* Reading the clock is much more expensive than looking at
+         * the ringbuffer, so don't do it on every iteration */
+        if (++i % 64 == 0 && pa_rtclock_now() >= deadline)
+            break;
+    }
+
+    sr->stats.spin_misses++;
+
+    if (++sr->busy_poll_misses >= BUSY_POLL_MAX_MISSES) {
+        sr->busy_poll_misses = 0;
+        sr->busy_poll_resume = deadline + BUSY_POLL_BACKOFF_USEC;
+    }
+
+    return false;
+}
+
 static void srbchannel_rwloop(pa_srbchannel* sr) {
     do {
 #ifdef DEBUG_SRBCHANNEL
@@ -200,12 +290,14 @@ static void srbchannel_rwloop(pa_srbchannel* sr) {
         pa_log("In rw loop from srbchannel, after callback, count = %d", q);
 #endif
 
-    } while (pa_fdsem_before_poll(sr->sem_read) < 0);
+    } while (busy_poll(sr) || pa_fdsem_before_poll(sr->sem_read) < 0);
 }
 
 static void semread_cb(pa_mainloop_api *m, pa_io_event *e, int fd, pa_io_event_flags_t events, void *userdata) {
     pa_srbchannel* sr = userdata;
 
+    sr->stats.wakeups++;
+
     pa_fdsem_after_poll(sr->sem_read);
     srbchannel_rwloop(sr);
 }
@@ -353,6 +445,40 @@ void pa_srbchannel_set_callback(pa_srbchannel *sr, pa_srbchannel_cb_t callback,
     }
 }
 
+void pa_srbchannel_set_busy_poll(pa_srbchannel *sr, pa_usec_t spin_usec) {
+    struct timeval tv;
+
+    pa_assert(sr);
+
+    sr->busy_poll_usec = spin_usec;
+    sr->busy_poll_resume = 0;
+    sr->busy_poll_misses = 0;
+
+    if (spin_usec <= 0) {
+        if (sr->busy_poll_check_event) {
+            sr->mainloop->time_free(sr->busy_poll_check_event);
+            sr->busy_poll_check_event = NULL;
+        }
+
+        return;
+    }
+
+    busy_poll_update_allowed(sr);
+
+    if (!sr->busy_poll_check_event)
+        sr->busy_poll_check_event = sr->mainloop->time_new(sr->mainloop,
+                pa_timeval_rtstore(&tv, pa_rtclock_now() + BUSY_POLL_CHECK_INTERVAL_USEC, true),
+                busy_poll_check_cb, sr);
+}
+
+void pa_srbchannel_get_stats(pa_srbchannel *sr, pa_srbchannel_stats *stats) {
+    pa_assert(sr);
+    pa_assert(stats);
+
+    *stats = sr->stats;
+    stats->busy_poll_allowed = sr->busy_poll_allowed;
+}
+
 void pa_srbchannel_free(pa_srbchannel *sr)
 {
 #ifdef DEBUG_SRBCHANNEL
@@ -360,6 +486,8 @@ void pa_srbchannel_free(pa_srbchannel *sr)
 #endif
     pa_assert(sr);
 
+    if (sr->busy_poll_check_event)
+        sr->mainloop->time_free(sr->busy_poll_check_event);
     if (sr->defer_event)
         sr->mainloop->defer_free(sr->defer_event);
     if (sr->read_event)
@@ -21,6 +21,7 @@
 ***/
 
 #include <pulse/mainloop-api.h>
+#include <pulse/sample.h>
 #include <pulsecore/fdsem.h>
 #include <pulsecore/memblock.h>
 
@@ -54,4 +55,20 @@ size_t pa_srbchannel_read(pa_srbchannel *sr, void *data, size_t l);
 typedef bool (*pa_srbchannel_cb_t)(pa_srbchannel *sr, void *userdata);
 void pa_srbchannel_set_callback(pa_srbchannel *sr, pa_srbchannel_cb_t callback, void *userdata);
 
+/* Before going to sleep on the fdsem, spin on the read ringbuffer for at most
+ * the given time, so that data arriving shortly after we became idle can be
+ * picked up without a wake-up through the fdsem. 0 disables busy polling.
+ * Spinning is suspended automatically while the system runs on battery, while
+ * the CPU is under pressure and while the spinning doesn't pay off. */
+void pa_srbchannel_set_busy_poll(pa_srbchannel *sr, pa_usec_t spin_usec);
+
+typedef struct pa_srbchannel_stats {
+    uint64_t wakeups;     /* number of times we were woken up through the fdsem */
+    uint64_t spin_hits;   /* number of times data arrived while spinning */
+    uint64_t spin_misses; /* number of times spinning timed out */
+    bool busy_poll_allowed; /* false while the battery or CPU state suspends spinning */
+} pa_srbchannel_stats;
+
+void pa_srbchannel_get_stats(pa_srbchannel *sr, pa_srbchannel_stats *stats);
+
 #endif
@@ -34,6 +34,8 @@
 
 PA_STATIC_TLS_DECLARE_NO_FREE(thread_mq);
 
+#define ASYNCMSGQ_BATCH_MAX 64
+
 static void asyncmsgq_read_cb(pa_mainloop_api *api, pa_io_event *e, int fd, pa_io_event_flags_t events, void *userdata) {
     pa_thread_mq *q = userdata;
     pa_asyncmsgq *aq;
@@ -50,25 +52,14 @@ static void asyncmsgq_read_cb(pa_mainloop_api *api, pa_io_event *e, int fd, pa_i
     pa_asyncmsgq_read_after_poll(aq);
 
     for (;;) {
-        pa_msgobject *object;
-        int code;
-        void *data;
-        int64_t offset;
-        pa_memchunk chunk;
-
-        /* Check whether there is a message for us to process */
-        while (pa_asyncmsgq_get(aq, &object, &code, &data, &offset, &chunk, 0) >= 0) {
-            int ret;
-
-            if (!object && code == PA_MESSAGE_SHUTDOWN) {
-                pa_asyncmsgq_done(aq, 0);
-                api->quit(api, 0);
-                break;
-            }
-
-            ret = pa_asyncmsgq_dispatch(object, code, data, offset, &chunk);
-            pa_asyncmsgq_done(aq, ret);
-        }
+        int n;
+
+        /* Check whether there are messages for us to process */
+        while ((n = pa_asyncmsgq_process_batch(aq, ASYNCMSGQ_BATCH_MAX)) > 0)
+            ;
+
+        if (n < 0)
+            api->quit(api, 0);
 
         if (pa_asyncmsgq_read_before_poll(aq) == 0)
             break;
@@ -77,26 +68,6 @@ static void asyncmsgq_read_cb(pa_mainloop_api *api, pa_io_event *e, int fd, pa_i
     pa_asyncmsgq_unref(aq);
 }
 
-static void asyncmsgq_write_inq_cb(pa_mainloop_api *api, pa_io_event *e, int fd, pa_io_event_flags_t events, void *userdata) {
-    pa_thread_mq *q = userdata;
-
-    pa_assert(pa_asyncmsgq_write_fd(q->inq) == fd);
-    pa_assert(events == PA_IO_EVENT_INPUT);
-
-    pa_asyncmsgq_write_after_poll(q->inq);
-    pa_asyncmsgq_write_before_poll(q->inq);
-}
-
-static void asyncmsgq_write_outq_cb(pa_mainloop_api *api, pa_io_event *e, int fd, pa_io_event_flags_t events, void *userdata) {
-    pa_thread_mq *q = userdata;
-
-    pa_assert(pa_asyncmsgq_write_fd(q->outq) == fd);
-    pa_assert(events == PA_IO_EVENT_INPUT);
-
-    pa_asyncmsgq_write_after_poll(q->outq);
-    pa_asyncmsgq_write_before_poll(q->outq);
-}
-
 int pa_thread_mq_init_thread_mainloop(pa_thread_mq *q, pa_mainloop_api *main_mainloop, pa_mainloop_api *thread_mainloop) {
     pa_assert(q);
     pa_assert(main_mainloop);
@@ -115,15 +86,13 @@ int pa_thread_mq_init_thread_mainloop(pa_thread_mq *q, pa_mainloop_api *main_mai
     q->main_mainloop = main_mainloop;
     q->thread_mainloop = thread_mainloop;
 
+    /* The queues are unbounded, so writers never have to wait for the
+     * reader and we only need to watch the read side */
     pa_assert_se(pa_asyncmsgq_read_before_poll(q->outq) == 0);
-    pa_asyncmsgq_write_before_poll(q->outq);
     pa_assert_se(q->read_main_event = main_mainloop->io_new(main_mainloop, pa_asyncmsgq_read_fd(q->outq), PA_IO_EVENT_INPUT, asyncmsgq_read_cb, q));
-    pa_assert_se(q->write_thread_event = thread_mainloop->io_new(thread_mainloop, pa_asyncmsgq_write_fd(q->outq), PA_IO_EVENT_INPUT, asyncmsgq_write_outq_cb, q));
 
     pa_asyncmsgq_read_before_poll(q->inq);
-    pa_asyncmsgq_write_before_poll(q->inq);
     pa_assert_se(q->read_thread_event = thread_mainloop->io_new(thread_mainloop, pa_asyncmsgq_read_fd(q->inq), PA_IO_EVENT_INPUT, asyncmsgq_read_cb, q));
-    pa_assert_se(q->write_main_event = main_mainloop->io_new(main_mainloop, pa_asyncmsgq_write_fd(q->inq), PA_IO_EVENT_INPUT, asyncmsgq_write_inq_cb, q));
 
     return 0;
 
@@ -153,11 +122,7 @@ int pa_thread_mq_init(pa_thread_mq *q, pa_mainloop_api *mainloop, pa_rtpoll *rtp
     pa_assert_se(pa_asyncmsgq_read_before_poll(q->outq) == 0);
     pa_assert_se(q->read_main_event = mainloop->io_new(mainloop, pa_asyncmsgq_read_fd(q->outq), PA_IO_EVENT_INPUT, asyncmsgq_read_cb, q));
 
-    pa_asyncmsgq_write_before_poll(q->inq);
-    pa_assert_se(q->write_main_event = mainloop->io_new(mainloop, pa_asyncmsgq_write_fd(q->inq), PA_IO_EVENT_INPUT, asyncmsgq_write_inq_cb, q));
-
     pa_rtpoll_item_new_asyncmsgq_read(rtpoll, PA_RTPOLL_EARLY, q->inq);
-    pa_rtpoll_item_new_asyncmsgq_write(rtpoll, PA_RTPOLL_LATE, q->outq);
 
     return 0;
 
@@ -188,17 +153,13 @@ void pa_thread_mq_done(pa_thread_mq *q) {
     if (q->main_mainloop) {
         if (q->read_main_event)
             q->main_mainloop->io_free(q->read_main_event);
-        if (q->write_main_event)
-            q->main_mainloop->io_free(q->write_main_event);
-        q->read_main_event = q->write_main_event = NULL;
+        q->read_main_event = NULL;
     }
 
     if (q->thread_mainloop) {
         if (q->read_thread_event)
             q->thread_mainloop->io_free(q->read_thread_event);
-        if (q->write_thread_event)
-            q->thread_mainloop->io_free(q->write_thread_event);
-        q->read_thread_event = q->write_thread_event = NULL;
+        q->read_thread_event = NULL;
     }
 
     if (q->inq)
@@ -32,8 +32,8 @@ typedef struct pa_thread_mq {
     pa_mainloop_api *main_mainloop;
     pa_mainloop_api *thread_mainloop;
     pa_asyncmsgq *inq, *outq;
-    pa_io_event *read_main_event, *write_main_event;
-    pa_io_event *read_thread_event, *write_thread_event;
+    pa_io_event *read_main_event;
+    pa_io_event *read_thread_event;
 } pa_thread_mq;
 
 int pa_thread_mq_init(pa_thread_mq *q, pa_mainloop_api *mainloop, pa_rtpoll *rtpoll);
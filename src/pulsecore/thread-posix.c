@@ -211,6 +211,50 @@ const char *pa_thread_get_name(pa_thread *t) {
     return t->name;
 }
 
+int pa_thread_set_cpu_affinity(const char *cpus) {
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    bool set[CPU_SETSIZE] = { false };
+    char *isolated = NULL;
+    cpu_set_t mask;
+    unsigned k;
+    int r;
+
+    pa_assert(cpus);
+
+    if (pa_streq(cpus, "isolated")) {
+        if (!(isolated = pa_read_line_from_file("/sys/devices/system/cpu/isolated")))
+            return -1;
+
+        cpus = isolated;
+    }
+
+    r = pa_parse_cpu_list(cpus, set, CPU_SETSIZE);
+    pa_xfree(isolated);
+
+    if (r < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    CPU_ZERO(&mask);
+    for (k = 0; k < CPU_SETSIZE; k++)
+        if (set[k])
+            CPU_SET(k, &mask);
+
+    if ((r = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask)) != 0) {
+        errno = r;
+        return -1;
+    }
+
+    return 0;
+#else
+    pa_assert(cpus);
+
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
 void pa_thread_yield(void) {
 #ifdef HAVE_PTHREAD_YIELD
     pthread_yield();
@@ -22,6 +22,7 @@
 #endif
 
 #include <stdio.h>
+#include <errno.h>
 
 #include <windows.h>
 
@@ -149,6 +150,12 @@ const char *pa_thread_get_name(pa_thread *t) {
     return NULL;
 }
 
+int pa_thread_set_cpu_affinity(const char *cpus) {
+    /* Not implemented */
+    errno = ENOTSUP;
+    return -1;
+}
+
 void pa_thread_yield(void) {
     Sleep(0);
 }
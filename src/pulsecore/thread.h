@@ -49,6 +49,11 @@ void pa_thread_set_data(pa_thread *t, void *userdata);
 const char *pa_thread_get_name(pa_thread *t);
 void pa_thread_set_name(pa_thread *t, const char *name);
 
+/* Restrict the calling thread to the CPUs in the list, as parsed by
+ * pa_parse_cpu_list(), or to the CPUs isolated from the general
+ * scheduler if the list is "isolated". Returns negative on error. */
+int pa_thread_set_cpu_affinity(const char *cpus);
+
 typedef struct pa_tls pa_tls;
 
 pa_tls* pa_tls_new(pa_free_cb_t free_cb);
@@ -0,0 +1,177 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Measures how quickly bursts of messages posted from several threads
+ * get through a pa_asyncmsgq to a single reader, both one message at a
+ * time and in batches. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/asyncmsgq.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/poll.h>
+#include <pulsecore/thread.h>
+
+#define N_WRITERS 4
+#define N_MESSAGES 200000
+#define N_VOLUME_OBJECTS 16
+
+enum {
+    BENCH_MESSAGE_COUNT,
+    BENCH_MESSAGE_SET_VOLUME
+};
+
+typedef struct bench_msg {
+    pa_msgobject parent;
+    unsigned n_count, n_volume;
+} bench_msg;
+
+PA_DEFINE_PRIVATE_CLASS(bench_msg, pa_msgobject);
+#define BENCH_MSG(o) (bench_msg_cast(o))
+
+struct writer {
+    pa_asyncmsgq *q;
+    bench_msg *objects[N_VOLUME_OBJECTS];
+    bool idempotent;
+    pa_thread *thread;
+};
+
+static int bench_msg_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk) {
+    bench_msg *b = BENCH_MSG(o);
+
+    if (code == BENCH_MESSAGE_COUNT)
+        b->n_count++;
+    else
+        b->n_volume++;
+
+    return 0;
+}
+
+static void writer_thread(void *userdata) {
+    struct writer *w = userdata;
+    unsigned i;
+
+    for (i = 0; i < N_MESSAGES / N_WRITERS; i++) {
+        pa_msgobject *o = PA_MSGOBJECT(w->objects[i % N_VOLUME_OBJECTS]);
+
+        /* Half of the messages are volume updates, like a slider being dragged */
+        if (i % 2 == 0)
+            pa_asyncmsgq_post(w->q, o, BENCH_MESSAGE_COUNT, NULL, 0, NULL, NULL);
+        else if (w->idempotent)
+            pa_asyncmsgq_post_idempotent(w->q, o, BENCH_MESSAGE_SET_VOLUME, NULL, i, NULL, NULL);
+        else
+            pa_asyncmsgq_post(w->q, o, BENCH_MESSAGE_SET_VOLUME, NULL, i, NULL, NULL);
+    }
+}
+
+static void run(const char *label, unsigned batch, bool idempotent) {
+    pa_asyncmsgq *q;
+    struct writer w[N_WRITERS];
+    bench_msg *objects[N_VOLUME_OBJECTS];
+    unsigned i, n_count = 0, n_volume = 0, n_wakeups = 0;
+    pa_usec_t start, stop;
+
+    pa_assert_se(q = pa_asyncmsgq_new(0));
+
+    for (i = 0; i < N_VOLUME_OBJECTS; i++) {
+        objects[i] = pa_msgobject_new(bench_msg);
+        objects[i]->parent.process_msg = bench_msg_process_msg;
+        objects[i]->n_count = objects[i]->n_volume = 0;
+    }
+
+    start = pa_rtclock_now();
+
+    for (i = 0; i < N_WRITERS; i++) {
+        w[i].q = q;
+        w[i].idempotent = idempotent;
+        memcpy(w[i].objects, objects, sizeof(objects));
+        pa_assert_se(w[i].thread = pa_thread_new("writer", writer_thread, &w[i]));
+    }
+
+    for (;;) {
+        struct pollfd pollfd;
+
+        if (batch > 1)
+            while (pa_asyncmsgq_process_batch(q, batch) > 0)
+                ;
+        else
+            while (pa_asyncmsgq_process_one(q) > 0)
+                ;
+
+        n_count = 0;
+        for (i = 0; i < N_VOLUME_OBJECTS; i++)
+            n_count += objects[i]->n_count;
+
+        if (n_count >= N_MESSAGES / 2)
+            break;
+
+        if (pa_asyncmsgq_read_before_poll(q) < 0)
+            continue;
+
+        pa_zero(pollfd);
+        pollfd.fd = pa_asyncmsgq_read_fd(q);
+        pollfd.events = POLLIN;
+        pa_poll(&pollfd, 1, -1);
+        n_wakeups++;
+
+        pa_asyncmsgq_read_after_poll(q);
+    }
+
+    for (i = 0; i < N_WRITERS; i++)
+        pa_thread_free(w[i].thread);
+
+    /* Pick up whatever volume updates are still queued */
+    while (pa_asyncmsgq_process_batch(q, N_MESSAGES) > 0)
+        ;
+
+    stop = pa_rtclock_now();
+
+    for (i = 0; i < N_VOLUME_OBJECTS; i++) {
+        n_volume += objects[i]->n_volume;
+        pa_msgobject_unref(PA_MSGOBJECT(objects[i]));
+    }
+
+    pa_asyncmsgq_unref(q);
+
+    printf("%-28s %8llu usec, %5.1f ns/message, %u volume messages dispatched, %u wakeups\n",
+           label,
+           (unsigned long long) (stop - start),
+           (double) (stop - start) * 1000.0 / N_MESSAGES,
+           n_volume, n_wakeups);
+}
+
+int main(int argc, char *argv[]) {
+    pa_log_set_level(PA_LOG_WARN);
+
+    printf("%u writer threads, %u messages\n", N_WRITERS, N_MESSAGES);
+
+    run("one at a time", 1, false);
+    run("batches of 64", 64, false);
+    run("batches of 64, coalescing", 64, true);
+
+    return 0;
+}
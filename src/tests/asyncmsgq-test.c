@@ -37,6 +37,32 @@ enum {
     QUIT
 };
 
+typedef struct test_msg {
+    pa_msgobject parent;
+    unsigned n_a, n_b;
+    int last_a;
+} test_msg;
+
+PA_DEFINE_PRIVATE_CLASS(test_msg, pa_msgobject);
+#define TEST_MSG(o) (test_msg_cast(o))
+
+static int test_msg_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk) {
+    test_msg *t = TEST_MSG(o);
+
+    switch (code) {
+        case OPERATION_A:
+            t->n_a++;
+            t->last_a = PA_PTR_TO_INT(userdata);
+            break;
+
+        case OPERATION_B:
+            t->n_b++;
+            break;
+    }
+
+    return 0;
+}
+
 static void the_thread(void *_q) {
     pa_asyncmsgq *q = _q;
     int quit = 0;
@@ -105,6 +131,45 @@ START_TEST (asyncmsgq_test) {
 }
 END_TEST
 
+START_TEST (asyncmsgq_coalesce_test) {
+    pa_asyncmsgq *q;
+    test_msg *t;
+    int i;
+
+    q = pa_asyncmsgq_new(0);
+    fail_unless(q != NULL);
+
+    t = pa_msgobject_new(test_msg);
+    t->parent.process_msg = test_msg_process_msg;
+
+    /* Only the newest idempotent message per object and code is
+     * dispatched, all others go through */
+    for (i = 1; i <= 10; i++) {
+        pa_asyncmsgq_post_idempotent(q, PA_MSGOBJECT(t), OPERATION_A, PA_INT_TO_PTR(i), 0, NULL, NULL);
+        pa_asyncmsgq_post(q, PA_MSGOBJECT(t), OPERATION_B, NULL, 0, NULL, NULL);
+    }
+
+    fail_unless(pa_asyncmsgq_process_batch(q, 64) == 11);
+    fail_unless(t->n_a == 1);
+    fail_unless(t->last_a == 10);
+    fail_unless(t->n_b == 10);
+
+    /* A shutdown message ends the batch */
+    pa_asyncmsgq_post(q, PA_MSGOBJECT(t), OPERATION_B, NULL, 0, NULL, NULL);
+    pa_asyncmsgq_post(q, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL, NULL);
+    pa_asyncmsgq_post(q, PA_MSGOBJECT(t), OPERATION_B, NULL, 0, NULL, NULL);
+
+    fail_unless(pa_asyncmsgq_process_batch(q, 64) < 0);
+    fail_unless(t->n_b == 11);
+    fail_unless(pa_asyncmsgq_process_batch(q, 64) == 1);
+    fail_unless(t->n_b == 12);
+    fail_unless(pa_asyncmsgq_process_batch(q, 64) == 0);
+
+    pa_msgobject_unref(PA_MSGOBJECT(t));
+    pa_asyncmsgq_unref(q);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -114,6 +179,7 @@ int main(int argc, char *argv[]) {
     s = suite_create("Async Message Queue");
     tc = tcase_create("asyncmsgq");
     tcase_add_test(tc, asyncmsgq_test);
+    tcase_add_test(tc, asyncmsgq_coalesce_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
@@ -0,0 +1,384 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <math.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/filter/convolver.h>
+
+#include "runtime-test-util.h"
+
+#define N_FRAMES 4000
+#define BLOCK_SIZE 64
+#define MAX_REWIND 300
+
+/* Compares the convolver with a plain convolution, feeding it in
+ * chunks of odd sizes so that blocks are split up. With fir set the
+ * responses are only on the diagonal and the convolver is made with
+ * pa_fir_new() and then given its responses with
+ * pa_convolver_set_response(). */
+static void run_convolver_test(unsigned n_inputs, unsigned n_outputs, unsigned taps, bool fir) {
+    float **responses, **diagonal, *src, *dst, *ref;
+    pa_convolver *c;
+    unsigned o, i, f, j, done, chunk = 1, n_rewinds = 0, rewindable = 0;
+    double max_diff = 0;
+
+    pa_assert(!fir || n_inputs == n_outputs);
+
+    responses = pa_xnew0(float*, n_inputs * n_outputs);
+    diagonal = pa_xnew(float*, n_inputs);
+
+    for (j = 0; j < n_inputs * n_outputs; j++) {
+        unsigned t;
+
+        if (fir && j / n_inputs != j % n_inputs)
+            continue;
+
+        responses[j] = pa_xnew(float, taps);
+        diagonal[j % n_inputs] = responses[j];
+
+        for (t = 0; t < taps; t++)
+            responses[j][t] = (float) (exp(-3.0 * t / taps) * sin(0.37 * t + j)) / n_inputs;
+    }
+
+    src = pa_xnew(float, N_FRAMES * n_inputs);
+    dst = pa_xnew(float, N_FRAMES * n_outputs);
+    ref = pa_xnew0(float, N_FRAMES * n_outputs);
+
+    for (j = 0; j < N_FRAMES * n_inputs; j++)
+        src[j] = (float) sin(0.01 * j * j) * 0.5f;
+
+    for (f = 0; f < N_FRAMES; f++)
+        for (o = 0; o < n_outputs; o++) {
+            double sum = 0;
+
+            for (i = 0; i < n_inputs; i++)
+                for (j = 0; j < taps && j <= f && responses[o * n_inputs + i]; j++)
+                    sum += responses[o * n_inputs + i][j] * src[(f - j) * n_inputs + i];
+
+            ref[f * n_outputs + o] = (float) sum;
+        }
+
+    if (fir) {
+        float **silent;
+
+        /* Start with responses that mute everything, and replace them */
+        silent = pa_xnew(float*, n_inputs);
+        for (i = 0; i < n_inputs; i++)
+            silent[i] = pa_xnew0(float, taps);
+
+        c = pa_fir_new(n_inputs, BLOCK_SIZE, (const float * const *) silent, taps);
+
+        for (i = 0; i < n_inputs; i++) {
+            pa_convolver_set_response(c, i, i, diagonal[i]);
+            pa_xfree(silent[i]);
+        }
+
+        pa_xfree(silent);
+    } else
+        c = pa_convolver_new(n_inputs, n_outputs, BLOCK_SIZE, (const float * const *) responses, taps);
+
+    for (done = 0; done < N_FRAMES; done += chunk, chunk = chunk * 7 % 157 + 1) {
+        chunk = PA_MIN(chunk, N_FRAMES - done);
+        pa_convolver_process(c, src + done * n_inputs, dst + done * n_outputs, chunk);
+    }
+
+    for (j = 0; j < N_FRAMES * n_outputs; j++)
+        max_diff = PA_MAX(max_diff, fabs(dst[j] - ref[j]));
+
+    pa_log_debug("%u -> %u channels, %u taps%s: max difference %g", n_inputs, n_outputs, taps, fir ? " (FIR)" : "", max_diff);
+    fail_unless(max_diff < 1e-5);
+
+    /* After a reset the output must be the same again */
+    pa_convolver_reset(c);
+    pa_convolver_process(c, src, dst, N_FRAMES);
+
+    for (j = 0; j < N_FRAMES * n_outputs; j++)
+        fail_unless(fabs(dst[j] - ref[j]) < 1e-5);
+
+    /* Rewind now and then and process the rewound frames again, which
+     * must give the same output as if nothing had been rewound. Like
+     * with a memblockq, rewinding uses up what can be rewound until new
+     * frames come in. */
+    pa_convolver_reset(c);
+    pa_convolver_set_max_rewind(c, MAX_REWIND);
+    memset(dst, 0, N_FRAMES * n_outputs * sizeof(float));
+
+    for (done = 0; done < N_FRAMES; done += chunk, chunk = chunk * 7 % 157 + 1) {
+        chunk = PA_MIN(chunk, N_FRAMES - done);
+        pa_convolver_process(c, src + done * n_inputs, dst + done * n_outputs, chunk);
+        rewindable = PA_MIN(rewindable + chunk, MAX_REWIND);
+
+        if (chunk % 3 == 0) {
+            unsigned r = PA_MIN(rewindable, chunk * 13 % MAX_REWIND + 1);
+
+            pa_convolver_rewind(c, r);
+            done -= r;
+            rewindable -= r;
+            n_rewinds++;
+        }
+    }
+
+    max_diff = 0;
+    for (j = 0; j < N_FRAMES * n_outputs; j++)
+        max_diff = PA_MAX(max_diff, fabs(dst[j] - ref[j]));
+
+    pa_log_debug("%u rewinds: max difference %g", n_rewinds, max_diff);
+    fail_unless(n_rewinds > 0);
+    fail_unless(max_diff < 1e-5);
+
+    /* Rewinding further than max_rewind starts over */
+    pa_convolver_rewind(c, N_FRAMES);
+    pa_convolver_process(c, src, dst, N_FRAMES);
+
+    for (j = 0; j < N_FRAMES * n_outputs; j++)
+        fail_unless(fabs(dst[j] - ref[j]) < 1e-5);
+
+    pa_convolver_free(c);
+
+    for (j = 0; j < n_inputs * n_outputs; j++)
+        pa_xfree(responses[j]);
+
+    pa_xfree(responses);
+    pa_xfree(diagonal);
+    pa_xfree(src);
+    pa_xfree(dst);
+    pa_xfree(ref);
+}
+
+START_TEST (convolver_test) {
+    run_convolver_test(1, 1, 1, false);
+    run_convolver_test(2, 2, 3, false);
+    run_convolver_test(3, 2, BLOCK_SIZE, false);
+    run_convolver_test(3, 2, BLOCK_SIZE + 1, false);
+    run_convolver_test(2, 3, 5 * BLOCK_SIZE - 7, false);
+    run_convolver_test(8, 2, 1024, false);
+}
+END_TEST
+
+START_TEST (fir_test) {
+    run_convolver_test(1, 1, 7, true);
+    run_convolver_test(2, 2, BLOCK_SIZE - 1, true);
+    run_convolver_test(6, 6, 3 * BLOCK_SIZE + 5, true);
+}
+END_TEST
+
+#define DOT_LENGTH 1020
+#define BINS 516
+
+static void run_func_test(pa_convolver_dot_func_t dot, pa_convolver_dot_func_t orig_dot,
+                          pa_convolver_cmac_func_t cmac, pa_convolver_cmac_func_t orig_cmac) {
+    float *a, *b, *acc, *orig_acc;
+    unsigned j, n;
+
+    a = pa_xnew(float, 2 * BINS);
+    b = pa_xnew(float, 2 * BINS);
+    acc = pa_xnew(float, 2 * BINS);
+    orig_acc = pa_xnew(float, 2 * BINS);
+
+    for (j = 0; j < 2 * BINS; j++) {
+        a[j] = (float) sin(0.1 * j);
+        b[j] = (float) cos(0.03 * j * j);
+        acc[j] = orig_acc[j] = (float) sin(0.7 * j);
+    }
+
+    /* Both must sum up in the same order, so they must match exactly */
+    for (n = 0; n <= DOT_LENGTH; n += 4)
+        fail_unless(dot(a, b, n) == orig_dot(a, b, n));
+
+    for (n = 0; n <= BINS; n += 4) {
+        cmac(acc, a, b, n);
+        orig_cmac(orig_acc, a, b, n);
+    }
+
+    for (j = 0; j < 2 * BINS; j++)
+        fail_unless(fabsf(acc[j] - orig_acc[j]) <= 1e-6f * (1.0f + fabsf(orig_acc[j])));
+
+    PA_RUNTIME_TEST_RUN_START("func dot", 1000, 10) {
+        dot(a, b, DOT_LENGTH);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    PA_RUNTIME_TEST_RUN_START("orig dot", 1000, 10) {
+        orig_dot(a, b, DOT_LENGTH);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    PA_RUNTIME_TEST_RUN_START("func cmac", 1000, 10) {
+        cmac(acc, a, b, BINS);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    PA_RUNTIME_TEST_RUN_START("orig cmac", 1000, 10) {
+        orig_cmac(orig_acc, a, b, BINS);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    pa_xfree(a);
+    pa_xfree(b);
+    pa_xfree(acc);
+    pa_xfree(orig_acc);
+}
+
+#if defined (__i386__) || defined (__amd64__)
+START_TEST (convolver_sse_test) {
+    pa_convolver_dot_func_t orig_dot, sse_dot;
+    pa_convolver_cmac_func_t orig_cmac, sse_cmac;
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE)) {
+        pa_log_info("SSE not supported. Skipping");
+        return;
+    }
+
+    orig_dot = pa_get_convolver_dot_func();
+    orig_cmac = pa_get_convolver_cmac_func();
+    pa_convolver_func_init_sse(flags);
+    sse_dot = pa_get_convolver_dot_func();
+    sse_cmac = pa_get_convolver_cmac_func();
+
+    pa_log_debug("Checking SSE convolver functions");
+    run_func_test(sse_dot, orig_dot, sse_cmac, orig_cmac);
+
+    /* And the whole convolver on top of them */
+    run_convolver_test(3, 2, 5 * BLOCK_SIZE - 7, false);
+
+    pa_set_convolver_dot_func(orig_dot);
+    pa_set_convolver_cmac_func(orig_cmac);
+}
+END_TEST
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+#if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
+START_TEST (convolver_neon_test) {
+    pa_convolver_dot_func_t orig_dot, neon_dot;
+    pa_convolver_cmac_func_t orig_cmac, neon_cmac;
+    pa_cpu_arm_flag_t flags = 0;
+
+    pa_cpu_get_arm_flags(&flags);
+
+    if (!(flags & PA_CPU_ARM_NEON)) {
+        pa_log_info("NEON not supported. Skipping");
+        return;
+    }
+
+    orig_dot = pa_get_convolver_dot_func();
+    orig_cmac = pa_get_convolver_cmac_func();
+    pa_convolver_func_init_neon(flags);
+    neon_dot = pa_get_convolver_dot_func();
+    neon_cmac = pa_get_convolver_cmac_func();
+
+    pa_log_debug("Checking NEON convolver functions");
+    run_func_test(neon_dot, orig_dot, neon_cmac, orig_cmac);
+
+    run_convolver_test(3, 2, 5 * BLOCK_SIZE - 7, false);
+
+    pa_set_convolver_dot_func(orig_dot);
+    pa_set_convolver_cmac_func(orig_cmac);
+}
+END_TEST
+#endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
+
+/* 7.1 to stereo with a 1024 tap HRIR, once in direct form only and
+ * once partitioned */
+START_TEST (convolver_benchmark) {
+    const unsigned n_inputs = 8, n_outputs = 2, taps = 1024, frames = 1024;
+    float **responses, *src, *dst;
+    pa_convolver *direct, *partitioned;
+    unsigned j;
+
+    responses = pa_xnew(float*, n_inputs * n_outputs);
+
+    for (j = 0; j < n_inputs * n_outputs; j++) {
+        unsigned t;
+
+        responses[j] = pa_xnew(float, taps);
+
+        for (t = 0; t < taps; t++)
+            responses[j][t] = (float) (exp(-3.0 * t / taps) * sin(0.37 * t + j)) / n_inputs;
+    }
+
+    src = pa_xnew(float, frames * n_inputs);
+
+    for (j = 0; j < frames * n_inputs; j++)
+        src[j] = (float) sin(0.01 * j * j) * 0.5f;
+
+    dst = pa_xnew(float, frames * n_outputs);
+
+    direct = pa_convolver_new(n_inputs, n_outputs, taps, (const float * const *) responses, taps);
+    partitioned = pa_convolver_new(n_inputs, n_outputs, BLOCK_SIZE, (const float * const *) responses, taps);
+
+    pa_log_debug("Convolving %u frames, %u -> %u channels, %u taps", frames, n_inputs, n_outputs, taps);
+
+    PA_RUNTIME_TEST_RUN_START("direct", 10, 10) {
+        pa_convolver_process(direct, src, dst, frames);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    PA_RUNTIME_TEST_RUN_START("partitioned", 10, 10) {
+        pa_convolver_process(partitioned, src, dst, frames);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    pa_convolver_free(direct);
+    pa_convolver_free(partitioned);
+
+    for (j = 0; j < n_inputs * n_outputs; j++)
+        pa_xfree(responses[j]);
+
+    pa_xfree(responses);
+    pa_xfree(src);
+    pa_xfree(dst);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Convolver");
+    tc = tcase_create("convolver");
+    tcase_add_test(tc, convolver_test);
+    tcase_add_test(tc, fir_test);
+#if defined (__i386__) || defined (__amd64__)
+    tcase_add_test(tc, convolver_sse_test);
+#endif
+#if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
+    tcase_add_test(tc, convolver_neon_test);
+#endif
+    tcase_add_test(tc, convolver_benchmark);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
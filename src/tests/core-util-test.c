@@ -248,6 +248,26 @@ START_TEST (modargs_test_unescape) {
 }
 END_TEST
 
+START_TEST (modargs_test_parse_cpu_list) {
+    bool cpus[8] = { false };
+
+    ck_assert_int_eq(pa_parse_cpu_list("1,3-5", cpus, 8), 4);
+    ck_assert(!cpus[0] && cpus[1] && !cpus[2] && cpus[3] && cpus[4] && cpus[5] && !cpus[6] && !cpus[7]);
+
+    ck_assert_int_eq(pa_parse_cpu_list("7", NULL, 0), 1);
+    ck_assert_int_eq(pa_parse_cpu_list("0-3,8", NULL, 0), 5);
+
+    // invalid values
+    ck_assert_int_lt(pa_parse_cpu_list("", NULL, 0), 0);
+    ck_assert_int_lt(pa_parse_cpu_list("8", cpus, 8), 0);
+    ck_assert_int_lt(pa_parse_cpu_list("3-1", NULL, 0), 0);
+    ck_assert_int_lt(pa_parse_cpu_list("1-", NULL, 0), 0);
+    ck_assert_int_lt(pa_parse_cpu_list("-1", NULL, 0), 0);
+    ck_assert_int_lt(pa_parse_cpu_list("a", NULL, 0), 0);
+    ck_assert_int_lt(pa_parse_cpu_list("1, 2", NULL, 0), 0);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -274,6 +294,7 @@ int main(int argc, char *argv[]) {
     tcase_add_test_raise_signal(tc, modargs_test_replace_fail_4, SIGABRT);
     tcase_add_test(tc, modargs_test_escape);
     tcase_add_test(tc, modargs_test_unescape);
+    tcase_add_test(tc, modargs_test_parse_cpu_list);
 
     sr = srunner_create(s);
     srunner_run_all(sr, CK_NORMAL);
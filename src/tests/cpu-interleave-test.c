@@ -0,0 +1,256 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/random.h>
+#include <pulsecore/sample-util.h>
+
+#include "runtime-test-util.h"
+
+/* An odd number of frames, so that every kernel leaves a remainder */
+#define FRAMES 1021
+#define MAX_CHANNELS 8
+#define GUARD 0x5a
+#define TIMES 1000
+#define TIMES2 100
+
+static const size_t sample_sizes[] = { 2, 4, 3 };
+static const unsigned channel_counts[] = { 1, 2, 3, 4, 6, 8 };
+
+static void check_planes(void *planes[], void *orig_planes[], unsigned channels, size_t ss, unsigned n, int align) {
+    unsigned c;
+
+    for (c = 0; c < channels; c++) {
+        const uint8_t *p = planes[c];
+
+        if (memcmp(planes[c], orig_planes[c], n * ss) != 0) {
+            pa_log_debug("Deinterleaving failed: ss=%u, channels=%u, n=%u, align=%d, channel %u",
+                         (unsigned) ss, channels, n, align, c);
+            ck_abort();
+        }
+
+        fail_unless(p[n * ss] == GUARD);
+    }
+}
+
+static void run_interleave_test(
+        pa_interleave_func_t func,
+        pa_interleave_func_t orig_func,
+        pa_deinterleave_func_t de_func,
+        pa_deinterleave_func_t orig_de_func,
+        size_t ss,
+        unsigned channels,
+        int align,
+        bool correct,
+        bool perf) {
+
+    size_t fs = ss * channels, plane_size = FRAMES * ss + 16;
+    uint8_t *frames_buf, *out_buf, *orig_out_buf, *planes_buf, *orig_planes_buf;
+    uint8_t *frames, *out, *orig_out;
+    void *planes[MAX_CHANNELS], *orig_planes[MAX_CHANNELS];
+    unsigned c, n;
+
+    frames_buf = pa_xmalloc(FRAMES * fs + 16);
+    out_buf = pa_xmalloc(FRAMES * fs + 16);
+    orig_out_buf = pa_xmalloc(FRAMES * fs + 16);
+    planes_buf = pa_xmalloc(channels * plane_size);
+    orig_planes_buf = pa_xmalloc(channels * plane_size);
+
+    /* Misalign by whole samples, as the buffers passed around are only
+     * ever aligned to those */
+    frames = frames_buf + align * ss;
+    out = out_buf + align * ss;
+    orig_out = orig_out_buf + align * ss;
+
+    for (c = 0; c < channels; c++) {
+        planes[c] = planes_buf + c * plane_size + align * ss;
+        orig_planes[c] = orig_planes_buf + c * plane_size + align * ss;
+    }
+
+    pa_random(frames, FRAMES * fs);
+
+    if (correct) {
+        /* Every remainder after the kernels, and all frames */
+        for (n = 1; n <= FRAMES; n = (n < 33 ? n + 1 : FRAMES)) {
+            memset(planes_buf, GUARD, channels * plane_size);
+            memset(orig_planes_buf, GUARD, channels * plane_size);
+
+            orig_de_func(frames, orig_planes, channels, ss, n);
+            de_func(frames, planes, channels, ss, n);
+            check_planes(planes, orig_planes, channels, ss, n, align);
+
+            memset(out_buf, GUARD, FRAMES * fs + 16);
+            memset(orig_out_buf, GUARD, FRAMES * fs + 16);
+
+            orig_func((const void **) orig_planes, channels, orig_out, ss, n);
+            func((const void **) planes, channels, out, ss, n);
+
+            if (memcmp(out, orig_out, n * fs) != 0 || memcmp(out, frames, n * fs) != 0) {
+                pa_log_debug("Interleaving failed: ss=%u, channels=%u, n=%u, align=%d",
+                             (unsigned) ss, channels, n, align);
+                ck_abort();
+            }
+
+            fail_unless(out[n * fs] == GUARD);
+
+            if (n == FRAMES)
+                break;
+        }
+    }
+
+    if (perf) {
+        pa_log_debug("Testing %u channel %u byte (de)interleaving performance with %d sample alignment",
+                     channels, (unsigned) ss, align);
+
+        PA_RUNTIME_TEST_RUN_START("deinterleave func", TIMES, TIMES2) {
+            de_func(frames, planes, channels, ss, FRAMES);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("deinterleave orig", TIMES, TIMES2) {
+            orig_de_func(frames, orig_planes, channels, ss, FRAMES);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("interleave func", TIMES, TIMES2) {
+            func((const void **) planes, channels, out, ss, FRAMES);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("interleave orig", TIMES, TIMES2) {
+            orig_func((const void **) orig_planes, channels, orig_out, ss, FRAMES);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+
+    pa_xfree(frames_buf);
+    pa_xfree(out_buf);
+    pa_xfree(orig_out_buf);
+    pa_xfree(planes_buf);
+    pa_xfree(orig_planes_buf);
+}
+
+static void run_interleave_tests(
+        pa_interleave_func_t func,
+        pa_interleave_func_t orig_func,
+        pa_deinterleave_func_t de_func,
+        pa_deinterleave_func_t orig_de_func) {
+
+    unsigned i, k;
+
+    for (i = 0; i < PA_ELEMENTSOF(sample_sizes); i++)
+        for (k = 0; k < PA_ELEMENTSOF(channel_counts); k++) {
+            size_t ss = sample_sizes[i];
+            unsigned channels = channel_counts[k];
+
+            run_interleave_test(func, orig_func, de_func, orig_de_func, ss, channels, 0, true, false);
+            run_interleave_test(func, orig_func, de_func, orig_de_func, ss, channels, 1, true, false);
+            run_interleave_test(func, orig_func, de_func, orig_de_func, ss, channels, 3, true,
+                                ss != 3 && (channels == 2 || channels == 8));
+        }
+}
+
+#if defined (__i386__) || defined (__amd64__)
+START_TEST (interleave_sse2_test) {
+    pa_interleave_func_t orig_func, sse2_func;
+    pa_deinterleave_func_t orig_de_func, sse2_de_func;
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE2)) {
+        pa_log_info("SSE2 not supported. Skipping");
+        return;
+    }
+
+    orig_func = pa_get_interleave_func();
+    orig_de_func = pa_get_deinterleave_func();
+    pa_interleave_func_init_sse(flags);
+    sse2_func = pa_get_interleave_func();
+    sse2_de_func = pa_get_deinterleave_func();
+
+    pa_log_debug("Checking SSE2 (de)interleaving");
+    run_interleave_tests(sse2_func, orig_func, sse2_de_func, orig_de_func);
+
+    pa_set_interleave_func(orig_func);
+    pa_set_deinterleave_func(orig_de_func);
+}
+END_TEST
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+#if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
+START_TEST (interleave_neon_test) {
+    pa_interleave_func_t orig_func, neon_func;
+    pa_deinterleave_func_t orig_de_func, neon_de_func;
+    pa_cpu_arm_flag_t flags = 0;
+
+    pa_cpu_get_arm_flags(&flags);
+
+    if (!(flags & PA_CPU_ARM_NEON)) {
+        pa_log_info("NEON not supported. Skipping");
+        return;
+    }
+
+    orig_func = pa_get_interleave_func();
+    orig_de_func = pa_get_deinterleave_func();
+    pa_interleave_func_init_neon(flags);
+    neon_func = pa_get_interleave_func();
+    neon_de_func = pa_get_deinterleave_func();
+
+    pa_log_debug("Checking NEON (de)interleaving");
+    run_interleave_tests(neon_func, orig_func, neon_de_func, orig_de_func);
+
+    pa_set_interleave_func(orig_func);
+    pa_set_deinterleave_func(orig_de_func);
+}
+END_TEST
+#endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("CPU");
+
+    tc = tcase_create("interleave");
+#if defined (__i386__) || defined (__amd64__)
+    tcase_add_test(tc, interleave_sse2_test);
+#endif
+#if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
+    tcase_add_test(tc, interleave_neon_test);
+#endif
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,222 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/sample-util.h>
+
+#include "runtime-test-util.h"
+
+#define BYTES 4100
+#define TIMES 1000
+#define TIMES2 100
+
+static void run_silence_test(pa_detect_silence_func_t func, pa_detect_silence_func_t orig_func, int align, bool correct, bool perf) {
+    PA_DECLARE_ALIGNED(8, uint8_t, buf[BYTES + 16]);
+    uint8_t *d = buf + align;
+    size_t length = (BYTES - align) & ~3, i;
+    const uint32_t mask = 0xff7fffff;
+
+    if (correct) {
+        memset(d, 0, length);
+
+        fail_unless(orig_func(d, length, 0, mask));
+        fail_unless(func(d, length, 0, mask));
+
+        /* Every single bit that isn't masked out must be found, at every
+         * position, including those in the remainder */
+        for (i = 0; i < length; i++) {
+            unsigned bit;
+
+            for (bit = 0; bit < 8; bit++) {
+                bool ref, res;
+
+                d[i] = 1 << bit;
+
+                ref = orig_func(d, length, 0, mask);
+                res = func(d, length, 0, mask);
+
+                if (ref != res) {
+                    pa_log_debug("Correctness test failed: align=%d, byte %u, bit %u", align, (unsigned) i, bit);
+                    ck_abort();
+                }
+
+                fail_unless(ref == (i % 4 == 2 && bit == 7));
+            }
+
+            d[i] = 0;
+        }
+
+        /* A pattern other than 0 */
+        memset(d, 0x80, length);
+        fail_unless(func(d, length, 0x80808080, 0xffffffff));
+        d[length - 1] = 0x81;
+        fail_if(func(d, length, 0x80808080, 0xffffffff));
+    }
+
+    if (perf) {
+        pa_log_debug("Testing silence detection performance with %d byte alignment", align);
+
+        memset(d, 0, length);
+
+        PA_RUNTIME_TEST_RUN_START("func", TIMES, TIMES2) {
+            func(d, length, 0, mask);
+        } PA_RUNTIME_TEST_RUN_STOP
+
+        PA_RUNTIME_TEST_RUN_START("orig", TIMES, TIMES2) {
+            orig_func(d, length, 0, mask);
+        } PA_RUNTIME_TEST_RUN_STOP
+    }
+}
+
+START_TEST (silence_memchunk_test) {
+    pa_mempool *pool;
+    pa_sample_format_t f;
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++) {
+        pa_sample_spec ss;
+        pa_memchunk c;
+        uint8_t *d;
+        size_t length;
+
+        ss.format = f;
+        ss.rate = 44100;
+        ss.channels = 1;
+
+        /* An odd number of frames, so that there is a remainder */
+        length = 33 * pa_frame_size(&ss);
+
+        c.memblock = pa_memblock_new(pool, length + pa_frame_size(&ss));
+        c.index = pa_frame_size(&ss);
+        c.length = length;
+
+        pa_silence_memchunk(&c, &ss);
+        fail_unless(pa_memchunk_is_silence(&c, &ss));
+
+        d = pa_memblock_acquire_chunk(&c);
+
+        /* Negative zero */
+        if (f == PA_SAMPLE_FLOAT32LE || f == PA_SAMPLE_FLOAT32BE) {
+            d[f == PA_SAMPLE_FLOAT32LE ? 3 : 0] = 0x80;
+            pa_memblock_release(c.memblock);
+            fail_unless(pa_memchunk_is_silence(&c, &ss));
+            d = pa_memblock_acquire_chunk(&c);
+        }
+
+        d[length - 1] ^= 0x01;
+        pa_memblock_release(c.memblock);
+
+        fail_if(pa_memchunk_is_silence(&c, &ss));
+
+        pa_memblock_unref(c.memblock);
+    }
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+#if defined (__i386__) || defined (__amd64__)
+START_TEST (silence_sse2_test) {
+    pa_detect_silence_func_t orig_func, sse2_func;
+    pa_cpu_x86_flag_t flags = 0;
+
+    pa_cpu_get_x86_flags(&flags);
+
+    if (!(flags & PA_CPU_X86_SSE2)) {
+        pa_log_info("SSE2 not supported. Skipping");
+        return;
+    }
+
+    orig_func = pa_get_detect_silence_func();
+    pa_silence_func_init_sse(flags);
+    sse2_func = pa_get_detect_silence_func();
+
+    pa_log_debug("Checking SSE2 silence detection");
+    run_silence_test(sse2_func, orig_func, 0, true, false);
+    run_silence_test(sse2_func, orig_func, 1, true, false);
+    run_silence_test(sse2_func, orig_func, 3, true, true);
+
+    pa_set_detect_silence_func(orig_func);
+}
+END_TEST
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+#if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
+START_TEST (silence_neon_test) {
+    pa_detect_silence_func_t orig_func, neon_func;
+    pa_cpu_arm_flag_t flags = 0;
+
+    pa_cpu_get_arm_flags(&flags);
+
+    if (!(flags & PA_CPU_ARM_NEON)) {
+        pa_log_info("NEON not supported. Skipping");
+        return;
+    }
+
+    orig_func = pa_get_detect_silence_func();
+    pa_silence_func_init_neon(flags);
+    neon_func = pa_get_detect_silence_func();
+
+    pa_log_debug("Checking NEON silence detection");
+    run_silence_test(neon_func, orig_func, 0, true, false);
+    run_silence_test(neon_func, orig_func, 1, true, false);
+    run_silence_test(neon_func, orig_func, 3, true, true);
+
+    pa_set_detect_silence_func(orig_func);
+}
+END_TEST
+#endif /* defined (__arm__) && defined (__linux__) && defined (HAVE_NEON) */
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("CPU");
+
+    tc = tcase_create("silence");
+    tcase_add_test(tc, silence_memchunk_test);
+#if defined (__i386__) || defined (__amd64__)
+    tcase_add_test(tc, silence_sse2_test);
+#endif
+#if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
+    tcase_add_test(tc, silence_neon_test);
+#endif
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
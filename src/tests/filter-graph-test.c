@@ -0,0 +1,577 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/filter-graph.h>
+#include <pulsecore/io-executor.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/module.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+
+#define RATE 48000
+#define BLOCK_FRAMES 256
+#define MAX_REWIND_FRAMES 4096
+#define REWIND_FRAMES 100
+
+/* What the test streams play on channel c of frame k */
+#define VALUE(k, c) ((float) ((k) * 16 + (c)))
+
+/* A null sink like module-null-sink's, except that it only renders when
+ * it is told to, so the test knows exactly what was played */
+enum {
+    NULL_SINK_MESSAGE_RENDER = PA_SINK_MESSAGE_MAX,
+    NULL_SINK_MESSAGE_REWIND,
+};
+
+struct rewind_request {
+    /* The sink that requests the rewind, and how far */
+    pa_sink *sink;
+    size_t nbytes;
+
+    /* What the null sink rewound, in its own frames */
+    size_t rewound;
+};
+
+struct stage_data {
+    float gain, offset;
+    size_t rewound;
+};
+
+struct stream_data {
+    /* The next frame played, only accessed from the I/O thread */
+    int64_t frame;
+};
+
+static pa_mainloop *mainloop;
+static pa_core *core;
+static pa_module *module;
+static pa_io_executor_slot *slot;
+static pa_sink *null_sink;
+
+/* Called from the I/O thread */
+static pa_usec_t null_sink_process_cb(pa_io_executor_slot *s, void *userdata) {
+    return 0;
+}
+
+/* Called from the I/O thread */
+static int null_sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    pa_sink *s = PA_SINK(o);
+
+    switch (code) {
+        case NULL_SINK_MESSAGE_RENDER:
+            /* Requests that came in since are not rewound */
+            if (s->thread_info.rewind_requested)
+                pa_sink_process_rewind(s, 0);
+
+            pa_sink_render_full(s, (size_t) offset, data);
+            return 0;
+
+        case NULL_SINK_MESSAGE_REWIND: {
+            struct rewind_request *r = data;
+            size_t nbytes;
+
+            pa_sink_request_rewind(r->sink, r->nbytes);
+
+            /* Pretend that everything played is still in the buffer */
+            nbytes = s->thread_info.rewind_requested ? s->thread_info.rewind_nbytes : 0;
+            pa_sink_process_rewind(s, nbytes);
+            r->rewound = nbytes / pa_frame_size(&s->sample_spec);
+
+            return 0;
+        }
+    }
+
+    return pa_sink_process_msg(o, code, data, offset, chunk);
+}
+
+static pa_sink *null_sink_new(const char *name, const pa_sample_spec *ss, const pa_channel_map *map) {
+    pa_sink_new_data data;
+    pa_sink *s;
+
+    pa_sink_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_new_data_set_name(&data, name);
+    pa_sink_new_data_set_sample_spec(&data, ss);
+    pa_sink_new_data_set_channel_map(&data, map);
+
+    s = pa_sink_new(core, &data, PA_SINK_LATENCY|PA_SINK_DYNAMIC_LATENCY);
+    pa_sink_new_data_done(&data);
+    fail_unless(s != NULL);
+
+    s->parent.process_msg = null_sink_process_msg;
+
+    pa_sink_set_asyncmsgq(s, pa_io_executor_slot_get_asyncmsgq(slot));
+    pa_sink_set_rtpoll(s, pa_io_executor_slot_get_rtpoll(slot));
+    pa_sink_set_max_rewind(s, MAX_REWIND_FRAMES * pa_frame_size(ss));
+    pa_sink_set_max_request(s, BLOCK_FRAMES * pa_frame_size(ss));
+    pa_sink_set_latency_range(s, 0, pa_bytes_to_usec(BLOCK_FRAMES * pa_frame_size(ss), ss));
+
+    pa_sink_put(s);
+
+    return s;
+}
+
+static void setup(const pa_sample_spec *ss, const pa_channel_map *map) {
+    mainloop = pa_mainloop_new();
+    fail_unless(mainloop != NULL);
+
+    core = pa_core_new(pa_mainloop_get_api(mainloop), false, false, 0);
+    fail_unless(core != NULL);
+
+    /* The stages only need a module to unload if the graph is killed */
+    module = pa_xnew0(pa_module, 1);
+    module->core = core;
+    module->index = PA_IDXSET_INVALID;
+
+    slot = pa_io_executor_slot_new(core, NULL, "null-sink", null_sink_process_cb, NULL);
+    fail_unless(slot != NULL);
+
+    null_sink = null_sink_new("null", ss, map);
+    pa_io_executor_slot_start(slot);
+}
+
+static void teardown(void) {
+    pa_sink_unlink(null_sink);
+    pa_io_executor_slot_free(slot);
+    pa_sink_unref(null_sink);
+
+    pa_xfree(module);
+    pa_core_unref(core);
+    pa_mainloop_free(mainloop);
+}
+
+/* Called from the I/O thread */
+static void stage_process(pa_filter_stage *s, const void *src, void *dst, unsigned n_frames) {
+    struct stage_data *d = s->userdata;
+    const float *sp = src;
+    float *dp = dst;
+    unsigned k;
+
+    for (k = 0; k < n_frames * s->sample_spec.channels; k++)
+        dp[k] = sp[k] * d->gain + d->offset;
+}
+
+/* Called from the I/O thread */
+static void stage_rewind(pa_filter_stage *s, size_t n_frames) {
+    struct stage_data *d = s->userdata;
+
+    d->rewound += n_frames;
+}
+
+static pa_filter_stage *stage_new(const char *name, pa_sink *master, const pa_sample_spec *ss, const pa_channel_map *map,
+                                  bool remix, struct stage_data *d) {
+    pa_sink_new_data data;
+    pa_filter_stage *s;
+
+    pa_sink_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_new_data_set_name(&data, name);
+    pa_sink_new_data_set_sample_spec(&data, ss);
+    pa_sink_new_data_set_channel_map(&data, map);
+
+    s = pa_filter_stage_new(module, master, &data);
+    pa_sink_new_data_done(&data);
+    fail_unless(s != NULL);
+
+    s->remix = remix;
+
+    if (d) {
+        s->process = stage_process;
+        s->rewind = stage_rewind;
+        s->userdata = d;
+    }
+
+    fail_unless(pa_filter_stage_put(s) == 0);
+
+    return s;
+}
+
+/* Called from the I/O thread */
+static int stream_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    struct stream_data *d = i->userdata;
+    unsigned channels = i->sample_spec.channels, n, j, c;
+    float *p;
+
+    n = (unsigned) (nbytes / pa_frame_size(&i->sample_spec));
+
+    chunk->index = 0;
+    chunk->length = n * pa_frame_size(&i->sample_spec);
+    chunk->memblock = pa_memblock_new(i->core->mempool, chunk->length);
+
+    p = pa_memblock_acquire(chunk->memblock);
+
+    for (j = 0; j < n; j++, d->frame++)
+        for (c = 0; c < channels; c++)
+            *(p++) = VALUE(d->frame, c);
+
+    pa_memblock_release(chunk->memblock);
+
+    return 0;
+}
+
+/* Called from the I/O thread. The render queue of the stream keeps what
+ * was played, and only replays it. */
+static void stream_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
+    struct stream_data *d = i->userdata;
+
+    d->frame -= (int64_t) (nbytes / pa_frame_size(&i->sample_spec));
+}
+
+static void stream_kill_cb(pa_sink_input *i) {
+    ck_abort();
+}
+
+static pa_sink_input *stream_new(pa_sink *sink, struct stream_data *d) {
+    pa_sink_input_new_data data;
+    pa_sink_input *i = NULL;
+
+    pa_sink_input_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_input_new_data_set_sink(&data, sink, false, true);
+    pa_sink_input_new_data_set_sample_spec(&data, &sink->sample_spec);
+    pa_sink_input_new_data_set_channel_map(&data, &sink->channel_map);
+
+    pa_sink_input_new(&i, core, &data);
+    pa_sink_input_new_data_done(&data);
+    fail_unless(i != NULL);
+
+    i->pop = stream_pop_cb;
+    i->process_rewind = stream_process_rewind_cb;
+    i->kill = stream_kill_cb;
+    i->userdata = d;
+
+    pa_sink_input_put(i);
+
+    return i;
+}
+
+static void stream_free(pa_sink_input *i) {
+    pa_sink_input_unlink(i);
+    pa_sink_input_unref(i);
+}
+
+static void render(pa_sink *s, unsigned n_frames, pa_memchunk *chunk) {
+    size_t nbytes = n_frames * pa_frame_size(&s->sample_spec);
+
+    fail_unless(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), NULL_SINK_MESSAGE_RENDER, chunk, (int64_t) nbytes, NULL) == 0);
+    fail_unless(chunk->length == nbytes);
+}
+
+static size_t rewind_graph(pa_sink *sink, unsigned n_frames) {
+    struct rewind_request r;
+
+    r.sink = sink;
+    r.nbytes = n_frames * pa_frame_size(&sink->sample_spec);
+    r.rewound = 0;
+
+    fail_unless(pa_asyncmsgq_send(null_sink->asyncmsgq, PA_MSGOBJECT(null_sink), NULL_SINK_MESSAGE_REWIND, &r, 0, NULL) == 0);
+
+    return r.rewound;
+}
+
+/* Checks that channel c of what s played is channel arrange[c] of the
+ * stream, times gain plus offset. The stream starts at frame, or
+ * wherever the first sample says if that is negative. Returns the frame
+ * after the chunk. */
+static int64_t check_chunk(pa_sink *s, const pa_memchunk *chunk, int64_t frame, const int *arrange, float gain, float offset) {
+    unsigned channels = s->sample_spec.channels, n, j, c;
+    const float *p;
+
+    n = (unsigned) (chunk->length / pa_frame_size(&s->sample_spec));
+    p = pa_memblock_acquire_chunk(chunk);
+
+    if (frame < 0)
+        frame = ((int64_t) ((p[0] - offset) / gain) - arrange[0]) / 16;
+
+    for (j = 0; j < n; j++, frame++, p += channels)
+        for (c = 0; c < channels; c++)
+            if (p[c] != VALUE(frame, arrange[c]) * gain + offset) {
+                pa_log("Channel %u of frame %lli came out as %f", c, (long long) frame, p[c]);
+                ck_abort();
+            }
+
+    pa_memblock_release(chunk->memblock);
+
+    return frame;
+}
+
+static void check_silence(const pa_memchunk *chunk) {
+    const float *p;
+    size_t k;
+
+    p = pa_memblock_acquire_chunk(chunk);
+
+    for (k = 0; k < chunk->length / sizeof(float); k++)
+        fail_unless(p[k] == 0.0f);
+
+    pa_memblock_release(chunk->memblock);
+}
+
+START_TEST (filter_graph_render_test) {
+    pa_sample_spec ss = { PA_SAMPLE_FLOAT32NE, RATE, 2 };
+    pa_channel_map map;
+    const int same[] = { 0, 1 };
+    struct stage_data bottom_data = { 2.0f, 0.0f, 0 }, top_data = { 1.0f, 1.0f, 0 };
+    struct stream_data stream_data = { 0 };
+    pa_filter_stage *bottom, *top;
+    pa_sink_input *stream;
+    pa_memchunk chunk;
+    int64_t frame = 0;
+    size_t rewound;
+    unsigned k;
+
+    pa_channel_map_init_stereo(&map);
+    setup(&ss, &map);
+
+    /* The second stage joins the graph of the first one, so there is a
+     * single sink input on the null sink */
+    bottom = stage_new("bottom", null_sink, &ss, &map, true, &bottom_data);
+    top = stage_new("top", bottom->sink, &ss, &map, true, &top_data);
+
+    fail_unless(top->graph == bottom->graph);
+    fail_unless(pa_idxset_size(null_sink->inputs) == 1);
+    fail_unless(pa_idxset_size(bottom->sink->inputs) == 0);
+
+    stream = stream_new(top->sink, &stream_data);
+
+    /* Every stage runs in order, top first */
+    for (k = 0; k < 4; k++) {
+        render(null_sink, BLOCK_FRAMES, &chunk);
+        frame = check_chunk(null_sink, &chunk, frame, same, 2.0f, 2.0f);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    /* A rewind of a stage sink rewinds the whole graph. Each stage is
+     * told how far, and the graph plays from there on again. */
+    rewound = rewind_graph(top->sink, REWIND_FRAMES);
+    pa_log_debug("Rewound %lu frames, the stages %lu and %lu", (unsigned long) rewound,
+                 (unsigned long) top_data.rewound, (unsigned long) bottom_data.rewound);
+
+    fail_unless(rewound == REWIND_FRAMES);
+    fail_unless(top_data.rewound >= rewound);
+    fail_unless(bottom_data.rewound == top_data.rewound);
+
+    frame -= (int64_t) rewound;
+
+    for (k = 0; k < 2; k++) {
+        render(null_sink, BLOCK_FRAMES, &chunk);
+        frame = check_chunk(null_sink, &chunk, frame, same, 2.0f, 2.0f);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    stream_free(stream);
+    pa_filter_stage_free(top);
+
+    /* What is left of the graph still plays, silence by now */
+    fail_unless(!bottom->prev && pa_idxset_size(null_sink->inputs) == 1);
+    render(null_sink, BLOCK_FRAMES, &chunk);
+    check_silence(&chunk);
+    pa_memblock_unref(chunk.memblock);
+
+    pa_filter_stage_free(bottom);
+    teardown();
+}
+END_TEST
+
+/* A stage that only swaps the channels for the master. With process()
+ * the stage produces a block of the graph that is swapped in place,
+ * otherwise the block is the stream's and is swapped into a buffer of
+ * the graph, leaving the stream's data as it was. */
+static void run_swap_test(bool process) {
+    pa_sample_spec ss = { PA_SAMPLE_FLOAT32NE, RATE, 2 };
+    pa_channel_map map, swapped;
+    const int swap[] = { 1, 0 };
+    struct stage_data data = { 1.0f, 0.0f, 0 };
+    struct stream_data stream_data = { 0 };
+    pa_filter_stage *s;
+    pa_sink_input *stream, *i;
+    pa_memchunk chunk;
+    int64_t frame = 0;
+    unsigned k;
+
+    pa_channel_map_init_stereo(&map);
+    pa_assert_se(pa_channel_map_parse(&swapped, "front-right,front-left"));
+    setup(&ss, &map);
+
+    s = stage_new("swap", null_sink, &ss, &swapped, true, process ? &data : NULL);
+    stream = stream_new(s->sink, &stream_data);
+
+    /* The graph hands the master data in its own channel map */
+    fail_unless(s->arrange_only);
+    pa_assert_se(i = pa_idxset_first(null_sink->inputs, NULL));
+    fail_unless(pa_channel_map_equal(&i->channel_map, &null_sink->channel_map));
+
+    for (k = 0; k < 4; k++) {
+        render(null_sink, BLOCK_FRAMES, &chunk);
+        frame = check_chunk(null_sink, &chunk, frame, swap, 1.0f, 0.0f);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    /* What is played again comes from the render queue of the stream,
+     * which must not have been swapped as well */
+    frame -= (int64_t) rewind_graph(s->sink, REWIND_FRAMES);
+
+    for (k = 0; k < 2; k++) {
+        render(null_sink, BLOCK_FRAMES, &chunk);
+        frame = check_chunk(null_sink, &chunk, frame, swap, 1.0f, 0.0f);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    stream_free(stream);
+    pa_filter_stage_free(s);
+    teardown();
+}
+
+START_TEST (filter_graph_swap_in_place_test) {
+    run_swap_test(true);
+}
+END_TEST
+
+START_TEST (filter_graph_swap_test) {
+    run_swap_test(false);
+}
+END_TEST
+
+/* Four channels without remixing on a stereo master keep only the front
+ * channels, which shrinks the frames in place */
+START_TEST (filter_graph_narrow_test) {
+    pa_sample_spec ss = { PA_SAMPLE_FLOAT32NE, RATE, 2 }, ss4 = { PA_SAMPLE_FLOAT32NE, RATE, 4 };
+    pa_channel_map map, map4;
+    const int narrow[] = { 3, 1 };
+    struct stage_data data = { 1.0f, 0.5f, 0 };
+    struct stream_data stream_data = { 0 };
+    pa_filter_stage *s;
+    pa_sink_input *stream, *i;
+    pa_memchunk chunk;
+    int64_t frame = 0;
+    unsigned k;
+
+    pa_channel_map_init_stereo(&map);
+    pa_assert_se(pa_channel_map_parse(&map4, "rear-left,front-right,rear-right,front-left"));
+    setup(&ss, &map);
+
+    s = stage_new("narrow", null_sink, &ss4, &map4, false, &data);
+    stream = stream_new(s->sink, &stream_data);
+
+    fail_unless(s->arrange_only);
+    pa_assert_se(i = pa_idxset_first(null_sink->inputs, NULL));
+    fail_unless(pa_channel_map_equal(&i->channel_map, &null_sink->channel_map));
+
+    for (k = 0; k < 4; k++) {
+        render(null_sink, BLOCK_FRAMES, &chunk);
+        frame = check_chunk(null_sink, &chunk, frame, narrow, 1.0f, 0.5f);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    stream_free(stream);
+    pa_filter_stage_free(s);
+    teardown();
+}
+END_TEST
+
+/* The sink input of the graph keeps the channel map of the master it was
+ * started on. After a move, that map is converted for the new master
+ * like any other. */
+START_TEST (filter_graph_move_test) {
+    pa_sample_spec ss = { PA_SAMPLE_FLOAT32NE, RATE, 2 };
+    pa_channel_map map, swapped;
+    const int swap[] = { 1, 0 }, same[] = { 0, 1 };
+    struct stage_data data = { 1.0f, 0.0f, 0 };
+    struct stream_data stream_data = { 0 };
+    pa_filter_stage *s;
+    pa_sink_input *stream, *i;
+    pa_sink *other;
+    pa_memchunk chunk;
+    int64_t frame = 0;
+    unsigned k;
+
+    pa_channel_map_init_stereo(&map);
+    pa_assert_se(pa_channel_map_parse(&swapped, "front-right,front-left"));
+    setup(&ss, &map);
+    other = null_sink_new("other", &ss, &swapped);
+
+    s = stage_new("swap", null_sink, &ss, &swapped, true, &data);
+    stream = stream_new(s->sink, &stream_data);
+
+    pa_assert_se(i = pa_idxset_first(null_sink->inputs, NULL));
+    fail_unless(pa_channel_map_equal(&i->channel_map, &map));
+
+    for (k = 0; k < 2; k++) {
+        render(null_sink, BLOCK_FRAMES, &chunk);
+        frame = check_chunk(null_sink, &chunk, frame, swap, 1.0f, 0.0f);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    fail_unless(pa_sink_input_move_to(i, other, false) == 0);
+    fail_unless(pa_idxset_size(other->inputs) == 1);
+    fail_unless(pa_channel_map_equal(&i->channel_map, &map));
+
+    /* What was buffered for the old master is dropped, so the stream
+     * goes on from wherever it got to */
+    frame = -1;
+
+    for (k = 0; k < 4; k++) {
+        render(other, BLOCK_FRAMES, &chunk);
+        frame = check_chunk(other, &chunk, frame, same, 1.0f, 0.0f);
+        pa_memblock_unref(chunk.memblock);
+    }
+
+    stream_free(stream);
+    pa_filter_stage_free(s);
+
+    pa_sink_unlink(other);
+    pa_sink_unref(other);
+    teardown();
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Filter Graph");
+    tc = tcase_create("filter-graph");
+    tcase_add_test(tc, filter_graph_render_test);
+    tcase_add_test(tc, filter_graph_swap_in_place_test);
+    tcase_add_test(tc, filter_graph_swap_test);
+    tcase_add_test(tc, filter_graph_narrow_test);
+    tcase_add_test(tc, filter_graph_move_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
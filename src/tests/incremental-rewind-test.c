@@ -0,0 +1,380 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <math.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/volume.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/io-executor.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblockq.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+
+#define RATE 48000
+#define CHANNELS 2
+#define BLOCK_FRAMES 256
+#define MAX_REWIND_FRAMES 1024
+#define N_STREAMS 3
+#define TOLERANCE 1e-5f
+
+/* The stream whose volume changes, the others are left alone */
+#define CHANGED 1
+
+/* What stream n plays on channel c of frame k. Small values, so that
+ * taking a stream out of the mix again is exact up to rounding. */
+#define VALUE(n, k, c) ((float) (((k) * 7 + (c) * 3 + (n) * 5) % 64 - 32) / 64.0f)
+
+/* A null sink like module-null-sink's, except that it only renders when
+ * it is told to, so the test knows exactly what was played */
+enum {
+    NULL_SINK_MESSAGE_RENDER = PA_SINK_MESSAGE_MAX,
+    NULL_SINK_MESSAGE_REWIND,
+};
+
+struct stream_data {
+    unsigned n;
+
+    /* The next frame played, only accessed from the I/O thread */
+    int64_t frame;
+};
+
+/* A null sink with its streams. The same things are done to one that
+ * rewinds incrementally and to one that always re-renders everything,
+ * which have to play the same. */
+struct player {
+    pa_sink *sink;
+
+    /* What was rendered and could still be rewound, only accessed from
+     * the I/O thread */
+    size_t buffered;
+
+    pa_sink_input *streams[N_STREAMS];
+    struct stream_data stream_data[N_STREAMS];
+};
+
+static pa_mainloop *mainloop;
+static pa_core *core;
+static pa_io_executor_slot *slot;
+
+/* Called from the I/O thread */
+static pa_usec_t null_sink_process_cb(pa_io_executor_slot *s, void *userdata) {
+    return 0;
+}
+
+/* Called from the I/O thread */
+static int null_sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    pa_sink *s = PA_SINK(o);
+    struct player *p = s->userdata;
+    size_t nbytes;
+
+    switch (code) {
+        case NULL_SINK_MESSAGE_RENDER:
+            /* Requests that came in since are not rewound */
+            if (s->thread_info.rewind_requested)
+                pa_sink_process_rewind(s, 0);
+
+            pa_sink_render_full(s, (size_t) offset, data);
+            p->buffered = PA_MIN(p->buffered + (size_t) offset, s->thread_info.max_rewind);
+            return 0;
+
+        case NULL_SINK_MESSAGE_REWIND:
+            /* Pretend that nothing was played yet, like a device with a
+             * buffer of max_rewind would. What was rewound is gone. */
+            nbytes = s->thread_info.rewind_requested ? PA_MIN(s->thread_info.rewind_nbytes, p->buffered) : 0;
+            p->buffered -= nbytes;
+            pa_sink_process_rewind(s, nbytes);
+
+            /* An incremental rewind mixes ahead into the history */
+            *((bool*) data) = s->thread_info.mix_history && pa_memblockq_is_readable(s->thread_info.mix_history);
+            return 0;
+    }
+
+    return pa_sink_process_msg(o, code, data, offset, chunk);
+}
+
+static pa_sink *null_sink_new(struct player *p, const char *name, bool incremental) {
+    pa_sample_spec ss = { PA_SAMPLE_FLOAT32NE, RATE, CHANNELS };
+    pa_sink_new_data data;
+    pa_sink *s;
+
+    /* The sink decides whether to keep a mix history when it is made */
+    core->incremental_rewind = incremental;
+
+    pa_sink_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_new_data_set_name(&data, name);
+    pa_sink_new_data_set_sample_spec(&data, &ss);
+
+    s = pa_sink_new(core, &data, PA_SINK_LATENCY|PA_SINK_DYNAMIC_LATENCY);
+    pa_sink_new_data_done(&data);
+    fail_unless(s != NULL);
+    fail_unless(!s->thread_info.mix_history == !incremental);
+
+    s->parent.process_msg = null_sink_process_msg;
+    s->userdata = p;
+
+    pa_sink_set_asyncmsgq(s, pa_io_executor_slot_get_asyncmsgq(slot));
+    pa_sink_set_rtpoll(s, pa_io_executor_slot_get_rtpoll(slot));
+    pa_sink_set_max_rewind(s, MAX_REWIND_FRAMES * pa_frame_size(&ss));
+    pa_sink_set_max_request(s, BLOCK_FRAMES * pa_frame_size(&ss));
+    pa_sink_set_latency_range(s, 0, pa_bytes_to_usec(BLOCK_FRAMES * pa_frame_size(&ss), &ss));
+
+    pa_sink_put(s);
+
+    return s;
+}
+
+/* Called from the I/O thread */
+static int stream_pop_cb(pa_sink_input *i, size_t nbytes, pa_memchunk *chunk) {
+    struct stream_data *d = i->userdata;
+    unsigned channels = i->sample_spec.channels, n, j, c;
+    float *p;
+
+    n = (unsigned) (nbytes / pa_frame_size(&i->sample_spec));
+
+    chunk->index = 0;
+    chunk->length = n * pa_frame_size(&i->sample_spec);
+    chunk->memblock = pa_memblock_new(i->core->mempool, chunk->length);
+
+    p = pa_memblock_acquire(chunk->memblock);
+
+    for (j = 0; j < n; j++, d->frame++)
+        for (c = 0; c < channels; c++)
+            *(p++) = VALUE(d->n, d->frame, c);
+
+    pa_memblock_release(chunk->memblock);
+
+    return 0;
+}
+
+/* Called from the I/O thread. Whatever is rewritten is played again. */
+static void stream_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
+    struct stream_data *d = i->userdata;
+
+    d->frame -= (int64_t) (nbytes / pa_frame_size(&i->sample_spec));
+}
+
+static void stream_kill_cb(pa_sink_input *i) {
+    ck_abort();
+}
+
+static pa_sink_input *stream_new(pa_sink *sink, struct stream_data *d) {
+    pa_sink_input_new_data data;
+    pa_sink_input *i = NULL;
+
+    pa_sink_input_new_data_init(&data);
+    data.driver = __FILE__;
+    pa_sink_input_new_data_set_sink(&data, sink, false, true);
+    pa_sink_input_new_data_set_sample_spec(&data, &sink->sample_spec);
+    pa_sink_input_new_data_set_channel_map(&data, &sink->channel_map);
+
+    pa_sink_input_new(&i, core, &data);
+    pa_sink_input_new_data_done(&data);
+    fail_unless(i != NULL);
+
+    i->pop = stream_pop_cb;
+    i->process_rewind = stream_process_rewind_cb;
+    i->kill = stream_kill_cb;
+    i->userdata = d;
+
+    pa_sink_input_put(i);
+
+    return i;
+}
+
+static void player_init(struct player *p, const char *name, bool incremental) {
+    pa_cvolume v;
+    unsigned n;
+
+    p->buffered = 0;
+    p->sink = null_sink_new(p, name, incremental);
+
+    for (n = 0; n < N_STREAMS; n++) {
+        p->stream_data[n].n = n;
+        p->stream_data[n].frame = 0;
+        p->streams[n] = stream_new(p->sink, &p->stream_data[n]);
+
+        /* None of them plays at unity volume, so what is taken out of
+         * the mix again has to be scaled like it was mixed */
+        pa_cvolume_set(&v, CHANNELS, pa_sw_volume_from_linear(0.25 * (n + 1)));
+        pa_sink_input_set_volume(p->streams[n], &v, false, true);
+    }
+}
+
+static void player_done(struct player *p) {
+    unsigned n;
+
+    for (n = 0; n < N_STREAMS; n++) {
+        pa_sink_input_unlink(p->streams[n]);
+        pa_sink_input_unref(p->streams[n]);
+    }
+
+    pa_sink_unlink(p->sink);
+    pa_sink_unref(p->sink);
+}
+
+static void render(pa_sink *s, pa_memchunk *chunk) {
+    size_t nbytes = BLOCK_FRAMES * pa_frame_size(&s->sample_spec);
+
+    fail_unless(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), NULL_SINK_MESSAGE_RENDER, chunk, (int64_t) nbytes, NULL) == 0);
+    fail_unless(chunk->length == nbytes);
+}
+
+/* Returns whether the sink rewound incrementally */
+static bool rewind_sink(pa_sink *s) {
+    bool incremental = false;
+
+    fail_unless(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), NULL_SINK_MESSAGE_REWIND, &incremental, 0, NULL) == 0);
+
+    return incremental;
+}
+
+/* Renders n blocks on both and checks that they play the same */
+static void render_and_compare(struct player *a, struct player *b, unsigned n) {
+    unsigned k;
+
+    for (k = 0; k < n; k++) {
+        pa_memchunk ca, cb;
+        const float *pa, *pb;
+        size_t j;
+
+        render(a->sink, &ca);
+        render(b->sink, &cb);
+
+        pa = pa_memblock_acquire_chunk(&ca);
+        pb = pa_memblock_acquire_chunk(&cb);
+
+        for (j = 0; j < ca.length / sizeof(float); j++)
+            if (fabsf(pa[j] - pb[j]) > TOLERANCE) {
+                pa_log("Sample %lu of block %u came out as %f instead of %f", (unsigned long) j, k, pa[j], pb[j]);
+                ck_abort();
+            }
+
+        pa_memblock_release(ca.memblock);
+        pa_memblock_release(cb.memblock);
+        pa_memblock_unref(ca.memblock);
+        pa_memblock_unref(cb.memblock);
+    }
+}
+
+static void set_volume(struct player *p, unsigned n, double linear) {
+    pa_cvolume v;
+
+    pa_cvolume_set(&v, CHANNELS, pa_sw_volume_from_linear(linear));
+    pa_sink_input_set_volume(p->streams[n], &v, false, true);
+}
+
+START_TEST (incremental_rewind_test) {
+    struct player a, b;
+
+    mainloop = pa_mainloop_new();
+    fail_unless(mainloop != NULL);
+
+    core = pa_core_new(pa_mainloop_get_api(mainloop), false, false, 0);
+    fail_unless(core != NULL);
+
+    slot = pa_io_executor_slot_new(core, NULL, "null-sink", null_sink_process_cb, NULL);
+    fail_unless(slot != NULL);
+
+    player_init(&a, "incremental", true);
+    player_init(&b, "full", false);
+    pa_io_executor_slot_start(slot);
+
+    render_and_compare(&a, &b, 8);
+
+    /* A volume change of one stream only re-mixes that stream */
+    set_volume(&a, CHANGED, 0.3);
+    set_volume(&b, CHANGED, 0.3);
+    fail_unless(rewind_sink(a.sink));
+    fail_unless(!rewind_sink(b.sink));
+
+    render_and_compare(&a, &b, 8);
+
+    /* Muted, the stream's old contribution is taken out and nothing is
+     * added back */
+    pa_sink_input_set_mute(a.streams[CHANGED], true, false);
+    pa_sink_input_set_mute(b.streams[CHANGED], true, false);
+    fail_unless(rewind_sink(a.sink));
+    fail_unless(!rewind_sink(b.sink));
+
+    render_and_compare(&a, &b, 8);
+
+    /* Unmuted, nothing is taken out, since it was mixed muted */
+    pa_sink_input_set_mute(a.streams[CHANGED], false, false);
+    pa_sink_input_set_mute(b.streams[CHANGED], false, false);
+    fail_unless(rewind_sink(a.sink));
+    fail_unless(!rewind_sink(b.sink));
+
+    /* What was mixed ahead and not played yet is redone, too */
+    render_and_compare(&a, &b, 2);
+
+    set_volume(&a, CHANGED, 0.6);
+    set_volume(&b, CHANGED, 0.6);
+    fail_unless(rewind_sink(a.sink));
+    fail_unless(!rewind_sink(b.sink));
+
+    render_and_compare(&a, &b, 8);
+
+    /* If most streams change, everything is re-rendered */
+    set_volume(&a, 0, 0.9);
+    set_volume(&b, 0, 0.9);
+    set_volume(&a, 2, 0.1);
+    set_volume(&b, 2, 0.1);
+    fail_unless(!rewind_sink(a.sink));
+    fail_unless(!rewind_sink(b.sink));
+
+    render_and_compare(&a, &b, 8);
+
+    player_done(&a);
+    player_done(&b);
+
+    pa_io_executor_slot_free(slot);
+    pa_core_unref(core);
+    pa_mainloop_free(mainloop);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Incremental Rewind");
+    tc = tcase_create("incremental-rewind");
+    tcase_add_test(tc, incremental_rewind_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,248 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/util.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/core.h>
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/io-executor.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/msgobject.h>
+#include <pulsecore/shared.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+
+#define INTERVAL_USEC (1 * PA_USEC_PER_MSEC)
+#define WAIT_USEC (5 * PA_USEC_PER_SEC)
+
+typedef struct device {
+    pa_msgobject parent;
+
+    pa_atomic_t calls;
+    bool timer;
+
+    pa_io_executor_slot *slot;
+
+    /* Set from the I/O thread */
+    pa_thread *thread;
+} device;
+
+PA_DEFINE_PRIVATE_CLASS(device, pa_msgobject);
+#define DEVICE(o) (device_cast(o))
+
+enum {
+    DEVICE_MESSAGE_GET_THREAD,
+    DEVICE_MESSAGE_WAKEUP,
+};
+
+/* Called from the I/O thread */
+static int device_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    device_assert_ref(DEVICE(o));
+
+    switch (code) {
+        case DEVICE_MESSAGE_GET_THREAD:
+            /* Messages are dispatched by the thread that runs the slot */
+            fail_unless(pa_thread_mq_get() != NULL);
+            *((pa_thread**) data) = pa_thread_self();
+            return 0;
+
+        case DEVICE_MESSAGE_WAKEUP:
+            pa_io_executor_slot_wakeup(DEVICE(o)->slot);
+            return 0;
+    }
+
+    return -1;
+}
+
+/* Called from the I/O thread */
+static pa_usec_t device_process_cb(pa_io_executor_slot *s, void *userdata) {
+    device *d = userdata;
+
+    fail_unless(pa_thread_mq_get() != NULL);
+
+    d->thread = pa_thread_self();
+    pa_atomic_inc(&d->calls);
+
+    return d->timer ? pa_rtclock_now() + INTERVAL_USEC : 0;
+}
+
+static device *device_new(bool timer) {
+    device *d;
+
+    d = pa_msgobject_new(device);
+    d->parent.process_msg = device_process_msg;
+    pa_atomic_store(&d->calls, 0);
+    d->timer = timer;
+    d->slot = NULL;
+    d->thread = NULL;
+
+    return d;
+}
+
+/* Waits until the slot of d was called at least n times in total */
+static bool device_wait_calls(device *d, int n) {
+    pa_usec_t timeout = pa_rtclock_now() + WAIT_USEC;
+
+    while (pa_atomic_load(&d->calls) < n) {
+        if (pa_rtclock_now() > timeout)
+            return false;
+
+        pa_msleep(1);
+    }
+
+    return true;
+}
+
+/* Waits until the slot of d was called at least n more times */
+static bool device_wait(device *d, int n) {
+    return device_wait_calls(d, pa_atomic_load(&d->calls) + n);
+}
+
+static pa_thread *device_get_thread(device *d, pa_io_executor_slot *s) {
+    pa_thread *thread = NULL;
+
+    fail_unless(pa_asyncmsgq_send(pa_io_executor_slot_get_asyncmsgq(s), PA_MSGOBJECT(d), DEVICE_MESSAGE_GET_THREAD, &thread, 0, NULL) == 0);
+
+    return thread;
+}
+
+START_TEST (io_executor_test) {
+    pa_mainloop *m;
+    pa_core *c;
+    device *d1, *d2, *d3;
+    pa_io_executor_slot *s1, *s2, *s3;
+    pa_thread *thread;
+    int calls;
+
+    m = pa_mainloop_new();
+    fail_unless(m != NULL);
+
+    c = pa_core_new(pa_mainloop_get_api(m), false, false, 0);
+    fail_unless(c != NULL);
+
+    d1 = device_new(true);
+    d2 = device_new(true);
+    d3 = device_new(false);
+
+    /* Attaching starts a thread, but the callback isn't run before the
+     * slot is started */
+    s1 = pa_io_executor_slot_new(c, NULL, "device-1", device_process_cb, d1);
+    fail_unless(s1 != NULL);
+    fail_unless(pa_shared_get(c, "io-executor") != NULL);
+    fail_unless(pa_io_executor_slot_get_asyncmsgq(s1) != NULL);
+    fail_unless(pa_io_executor_slot_get_rtpoll(s1) != NULL);
+
+    thread = device_get_thread(d1, s1);
+    fail_unless(thread != NULL);
+    fail_unless(pa_atomic_load(&d1->calls) == 0);
+
+    /* Started, the callback runs on the thread of the slot, and again
+     * whenever the time it asked for comes */
+    pa_io_executor_slot_start(s1);
+    fail_unless(device_wait(d1, 10));
+    fail_unless(d1->thread == thread);
+
+    /* A second device goes to a thread of its own as long as there are
+     * CPUs to spare, and runs along with the first one */
+    s2 = pa_io_executor_slot_new(c, NULL, "device-2", device_process_cb, d2);
+    fail_unless(s2 != NULL);
+    pa_io_executor_slot_start(s2);
+
+    fail_unless(device_wait(d2, 10));
+    fail_unless(device_wait(d1, 10));
+
+    if (pa_ncpus() > 1)
+        fail_unless(device_get_thread(d2, s2) != thread);
+    else
+        fail_unless(device_get_thread(d2, s2) == thread);
+
+    fail_unless(d2->thread == device_get_thread(d2, s2));
+
+    /* A slot without a timer is run once when started, and then only
+     * when it is woken up, not along with the others */
+    s3 = pa_io_executor_slot_new(c, NULL, "device-3", device_process_cb, d3);
+    fail_unless(s3 != NULL);
+    d3->slot = s3;
+    pa_io_executor_slot_start(s3);
+
+    fail_unless(device_wait_calls(d3, 1));
+    fail_unless(device_wait(d1, 10));
+    fail_unless(device_wait(d2, 10));
+    fail_unless(pa_atomic_load(&d3->calls) == 1);
+
+    fail_unless(pa_asyncmsgq_send(pa_io_executor_slot_get_asyncmsgq(s3), PA_MSGOBJECT(d3), DEVICE_MESSAGE_WAKEUP, NULL, 0, NULL) == 0);
+    fail_unless(device_wait_calls(d3, 2));
+    fail_unless(device_wait(d1, 10));
+    fail_unless(pa_atomic_load(&d3->calls) == 2);
+
+    pa_io_executor_slot_free(s3);
+
+    /* Once detached, the callback isn't run anymore, while the other
+     * device keeps going */
+    pa_io_executor_slot_free(s1);
+    calls = pa_atomic_load(&d1->calls);
+
+    fail_unless(device_wait(d2, 10));
+    fail_unless(pa_atomic_load(&d1->calls) == calls);
+
+    /* The threads stop with the last slot */
+    pa_io_executor_slot_free(s2);
+    fail_unless(pa_shared_get(c, "io-executor") == NULL);
+
+    device_unref(d1);
+    device_unref(d2);
+    device_unref(d3);
+
+    pa_core_unref(c);
+    pa_mainloop_free(m);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("I/O Executor");
+    tc = tcase_create("io-executor");
+    tcase_add_test(tc, io_executor_test);
+    tcase_set_timeout(tc, 30);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
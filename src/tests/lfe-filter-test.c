@@ -21,10 +21,16 @@
 
 #include <check.h>
 
+#include <math.h>
+
 #include <pulse/pulseaudio.h>
+#include <pulse/rtclock.h>
 #include <pulse/sample.h>
+#include <pulsecore/cpu-arm.h>
+#include <pulsecore/cpu-x86.h>
 #include <pulsecore/memblock.h>
 
+#include <pulsecore/filter/crossover.h>
 #include <pulsecore/filter/lfe-filter.h>
 
 struct lfe_filter_test {
@@ -121,6 +127,133 @@ static int lfe_filter_rewind_test(struct lfe_filter_test *lft, int rewind_sample
     return ret;
 }
 
+#define BENCH_FRAMES 1024
+#define BENCH_TIMES 200
+
+/* CPU cycles where there is a cycle counter, nanoseconds otherwise */
+#if defined (__i386__) || defined (__amd64__)
+#define TICKS_UNIT "cycles"
+static uint64_t read_ticks(void) {
+    uint32_t lo, hi;
+
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+
+    return ((uint64_t) hi << 32) | lo;
+}
+#else
+#define TICKS_UNIT "ns"
+static uint64_t read_ticks(void) {
+    return pa_rtclock_now() * PA_NSEC_PER_USEC;
+}
+#endif
+
+/* Filters BENCH_TIMES blocks of float samples with the current group
+ * function, returns the ticks per frame of the fastest block and leaves
+ * the output of the last block in out */
+static double run_lfe_filter_bench(pa_mempool *pool, const pa_sample_spec *ss, const pa_channel_map *map, const float *in, float *out) {
+    pa_lfe_filter_t *lf;
+    uint64_t best = UINT64_MAX;
+    size_t length = BENCH_FRAMES * pa_frame_size(ss);
+    unsigned i;
+
+    pa_assert_se(lf = pa_lfe_filter_new(ss, map, 120, 0));
+
+    for (i = 0; i < BENCH_TIMES; i++) {
+        pa_memchunk mc;
+        uint64_t start;
+
+        mc.memblock = pa_memblock_new(pool, length);
+        mc.index = 0;
+        mc.length = length;
+        memcpy(pa_memblock_acquire(mc.memblock), in, length);
+        pa_memblock_release(mc.memblock);
+
+        start = read_ticks();
+        pa_lfe_filter_process(lf, &mc);
+        best = PA_MIN(best, read_ticks() - start);
+
+        memcpy(out, pa_memblock_acquire(mc.memblock), length);
+        pa_memblock_release(mc.memblock);
+        pa_memblock_unref(mc.memblock);
+    }
+
+    pa_lfe_filter_free(lf);
+
+    return (double) best / BENCH_FRAMES;
+}
+
+/* The cost of the crossover for 5.1 and 7.1 float streams, with the
+ * generic code and with the SIMD code the CPU supports, which must give
+ * the same output */
+START_TEST (lfe_filter_multichannel_test) {
+    const unsigned channels[] = { 6, 8 };
+    lr4_group_process_func_t orig_func, simd_func;
+    pa_mempool *pool;
+    unsigned k, j;
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+
+    orig_func = pa_get_lr4_group_process_func();
+
+#if defined (__i386__) || defined (__amd64__)
+    {
+        pa_cpu_x86_flag_t flags = 0;
+
+        pa_cpu_get_x86_flags(&flags);
+        pa_crossover_func_init_sse(flags);
+    }
+#elif defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
+    {
+        pa_cpu_arm_flag_t flags = 0;
+
+        pa_cpu_get_arm_flags(&flags);
+        if (flags & PA_CPU_ARM_NEON)
+            pa_crossover_func_init_neon(flags);
+    }
+#endif
+
+    simd_func = pa_get_lr4_group_process_func();
+
+    for (k = 0; k < PA_ELEMENTSOF(channels); k++) {
+        pa_sample_spec ss;
+        pa_channel_map map;
+        float *in, *out, *simd_out;
+        double orig_ticks, simd_ticks;
+
+        ss.format = PA_SAMPLE_FLOAT32NE;
+        ss.rate = 48000;
+        ss.channels = channels[k];
+        pa_assert_se(pa_channel_map_init_auto(&map, ss.channels, PA_CHANNEL_MAP_ALSA));
+
+        in = pa_xnew(float, BENCH_FRAMES * ss.channels);
+        out = pa_xnew(float, BENCH_FRAMES * ss.channels);
+        simd_out = pa_xnew(float, BENCH_FRAMES * ss.channels);
+
+        for (j = 0; j < BENCH_FRAMES * ss.channels; j++)
+            in[j] = (float) (0.5 * sin(0.001 * j * (j % ss.channels + 1)));
+
+        pa_set_lr4_group_process_func(orig_func);
+        orig_ticks = run_lfe_filter_bench(pool, &ss, &map, in, out);
+
+        pa_set_lr4_group_process_func(simd_func);
+        simd_ticks = run_lfe_filter_bench(pool, &ss, &map, in, simd_out);
+
+        pa_log_debug("%s: %0.1f %s per frame generic, %0.1f with SIMD",
+                     ss.channels == 6 ? "5.1" : "7.1", orig_ticks, TICKS_UNIT, simd_ticks);
+
+        fail_unless(memcmp(out, simd_out, BENCH_FRAMES * pa_frame_size(&ss)) == 0);
+
+        pa_xfree(in);
+        pa_xfree(out);
+        pa_xfree(simd_out);
+    }
+
+    pa_set_lr4_group_process_func(orig_func);
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
 START_TEST (lfe_filter_test) {
     pa_sample_spec a;
     int ret = -1;
@@ -184,7 +317,8 @@ int main(int argc, char *argv[]) {
     s = suite_create("lfe-filter");
     tc = tcase_create("lfe-filter");
     tcase_add_test(tc, lfe_filter_test);
-    tcase_set_timeout(tc, 10);
+    tcase_add_test(tc, lfe_filter_multichannel_test);
+    tcase_set_timeout(tc, 30);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
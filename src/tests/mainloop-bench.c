@@ -0,0 +1,134 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+/* Measures the cost of creating, restarting, dispatching and freeing time
+ * events on a pa_mainloop that carries a lot of them, and checks that
+ * they are dispatched in order. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#define N_TIMERS 10000
+#define N_RESTARTS 100000
+
+static unsigned n_fired = 0;
+static pa_usec_t last_fired = 0;
+
+static void timer_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    pa_usec_t t = pa_timeval_load(tv);
+
+    /* The heap hands out events in time order */
+    pa_assert_se(t >= last_fired);
+    last_fired = t;
+
+    n_fired++;
+}
+
+static struct timeval *random_time(struct timeval *tv, pa_usec_t base) {
+    return pa_timeval_rtstore(tv, base + (pa_usec_t) rand() % (10 * PA_USEC_PER_SEC), true);
+}
+
+static void report(const char *label, pa_usec_t start, unsigned n) {
+    pa_usec_t stop = pa_rtclock_now();
+
+    printf("%-32s %8llu usec, %6.1f ns/op\n",
+           label,
+           (unsigned long long) (stop - start),
+           (double) (stop - start) * 1000.0 / n);
+}
+
+int main(int argc, char *argv[]) {
+    pa_mainloop *m;
+    pa_mainloop_api *a;
+    pa_time_event **events;
+    struct timeval tv;
+    pa_usec_t base, start;
+    unsigned i;
+
+    pa_log_set_level(PA_LOG_WARN);
+    srand(0);
+
+    pa_assert_se(m = pa_mainloop_new());
+    a = pa_mainloop_get_api(m);
+    events = pa_xnew(pa_time_event*, N_TIMERS);
+
+    printf("%u timers\n", N_TIMERS);
+
+    /* All timers are far enough in the future to not fire until we move
+     * them into the past below */
+    base = pa_rtclock_now() + 3600 * PA_USEC_PER_SEC;
+
+    start = pa_rtclock_now();
+    for (i = 0; i < N_TIMERS; i++)
+        pa_assert_se(events[i] = a->time_new(a, random_time(&tv, base), timer_cb, NULL));
+    report("time_new", start, N_TIMERS);
+
+    /* Like stream-restore or suspend-on-idle pushing their timers back */
+    start = pa_rtclock_now();
+    for (i = 0; i < N_RESTARTS; i++)
+        a->time_restart(events[rand() % N_TIMERS], random_time(&tv, base));
+    report("time_restart", start, N_RESTARTS);
+
+    /* Every iteration needs the next timeout */
+    start = pa_rtclock_now();
+    for (i = 0; i < N_RESTARTS; i++) {
+        a->time_restart(events[rand() % N_TIMERS], random_time(&tv, base));
+        pa_assert_se(pa_mainloop_prepare(m, 0) >= 0);
+        pa_assert_se(pa_mainloop_poll(m) >= 0);
+        pa_assert_se(pa_mainloop_dispatch(m) >= 0);
+    }
+    report("time_restart + iterate", start, N_RESTARTS);
+    pa_assert_se(n_fired == 0);
+
+    start = pa_rtclock_now();
+    for (i = 0; i < N_TIMERS; i += 2) {
+        a->time_free(events[i]);
+        events[i] = NULL;
+    }
+    report("time_free", start, N_TIMERS / 2);
+
+    /* Move the remaining timers into the past and let them all fire */
+    base = pa_rtclock_now() - 20 * PA_USEC_PER_SEC;
+    for (i = 1; i < N_TIMERS; i += 2)
+        a->time_restart(events[i], random_time(&tv, base));
+
+    start = pa_rtclock_now();
+    while (n_fired < N_TIMERS / 2)
+        pa_assert_se(pa_mainloop_iterate(m, 0, NULL) >= 0);
+    report("dispatch", start, N_TIMERS / 2);
+
+    for (i = 1; i < N_TIMERS; i += 2)
+        a->time_free(events[i]);
+
+    pa_xfree(events);
+    pa_mainloop_free(m);
+
+    return 0;
+}
@@ -20,7 +20,9 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/time.h>
 #include <assert.h>
 #include <check.h>
@@ -30,6 +32,7 @@
 
 #include <pulsecore/core-util.h>
 #include <pulsecore/core-rtclock.h>
+#include <pulsecore/socket.h>
 
 #ifdef GLIB_MAIN_LOOP
 
@@ -120,6 +123,122 @@ START_TEST (mainloop_test) {
 }
 END_TEST
 
+#ifndef GLIB_MAIN_LOOP
+
+#define N_PAIRS 64
+
+static unsigned n_io[N_PAIRS], n_shared, n_null;
+static pa_io_event *shared[2];
+
+static void pair_cb(pa_mainloop_api*a, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
+    unsigned char c;
+
+    fail_unless(f & PA_IO_EVENT_INPUT);
+    pa_assert_se(read(fd, &c, sizeof(c)) == 1);
+    n_io[PA_PTR_TO_UINT(userdata)]++;
+}
+
+/* Two events on the same fd, whichever runs first frees the other one */
+static void shared_cb(pa_mainloop_api*a, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
+    unsigned i = PA_PTR_TO_UINT(userdata);
+
+    fail_unless(f & PA_IO_EVENT_OUTPUT);
+    fail_unless(shared[i] == e);
+
+    a->io_free(shared[!i]);
+    shared[!i] = NULL;
+    a->io_enable(e, PA_IO_EVENT_NULL);
+    n_shared++;
+}
+
+static void null_cb(pa_mainloop_api*a, pa_io_event *e, int fd, pa_io_event_flags_t f, void *userdata) {
+    a->io_enable(e, PA_IO_EVENT_NULL);
+    n_null++;
+}
+
+static void iterate(pa_mainloop *m) {
+    unsigned i;
+
+    /* Level triggered, so a few rounds pick up everything */
+    for (i = 0; i < 4; i++)
+        fail_unless(pa_mainloop_iterate(m, 0, NULL) >= 0);
+}
+
+static void io_test(bool epoll) {
+    pa_mainloop *m;
+    pa_mainloop_api *a;
+    int fds[N_PAIRS][2], null_fd;
+    pa_io_event *e[N_PAIRS], *null_e;
+    unsigned i;
+
+    if (epoll)
+        unsetenv("PULSE_NO_EPOLL");
+    else
+        setenv("PULSE_NO_EPOLL", "1", 1);
+
+    m = pa_mainloop_new();
+    fail_unless(m != NULL);
+    a = pa_mainloop_get_api(m);
+
+    for (i = 0; i < N_PAIRS; i++) {
+        fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]) == 0);
+        e[i] = a->io_new(a, fds[i][0], PA_IO_EVENT_INPUT, pair_cb, PA_UINT_TO_PTR(i));
+        n_io[i] = 0;
+    }
+
+    /* Only the even pairs get data */
+    for (i = 0; i < N_PAIRS; i += 2)
+        pa_assert_se(write(fds[i][1], "x", 1) == 1);
+
+    iterate(m);
+
+    for (i = 0; i < N_PAIRS; i++)
+        fail_unless(n_io[i] == (i % 2 == 0 ? 1 : 0));
+
+    n_shared = 0;
+    shared[0] = a->io_new(a, fds[0][1], PA_IO_EVENT_OUTPUT, shared_cb, PA_UINT_TO_PTR(0));
+    shared[1] = a->io_new(a, fds[0][1], PA_IO_EVENT_OUTPUT, shared_cb, PA_UINT_TO_PTR(1));
+
+    iterate(m);
+    fail_unless(n_shared == 1);
+
+    /* epoll can't watch /dev/null, so this makes the loop fall back to
+     * poll() and everything still has to work */
+    n_null = 0;
+    null_fd = open("/dev/null", O_RDONLY);
+    fail_unless(null_fd >= 0);
+    null_e = a->io_new(a, null_fd, PA_IO_EVENT_INPUT, null_cb, NULL);
+
+    for (i = 1; i < N_PAIRS; i += 2)
+        pa_assert_se(write(fds[i][1], "x", 1) == 1);
+
+    iterate(m);
+
+    fail_unless(n_null == 1);
+    for (i = 0; i < N_PAIRS; i++)
+        fail_unless(n_io[i] == 1);
+
+    a->io_free(null_e);
+    pa_close(null_fd);
+
+    a->io_free(shared[0] ? shared[0] : shared[1]);
+
+    for (i = 0; i < N_PAIRS; i++) {
+        a->io_free(e[i]);
+        pa_close_pipe(fds[i]);
+    }
+
+    pa_mainloop_free(m);
+}
+
+START_TEST (mainloop_io_test) {
+    io_test(true);
+    io_test(false);
+}
+END_TEST
+
+#endif /* GLIB_MAIN_LOOP */
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -129,6 +248,9 @@ int main(int argc, char *argv[]) {
     s = suite_create("MainLoop");
     tc = tcase_create("mainloop");
     tcase_add_test(tc, mainloop_test);
+#ifndef GLIB_MAIN_LOOP
+    tcase_add_test(tc, mainloop_io_test);
+#endif
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
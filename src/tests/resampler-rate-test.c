@@ -0,0 +1,171 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <check.h>
+#include <math.h>
+
+#include <pulse/sample.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/resampler.h>
+
+/* Feed a sine through a variable rate resampler in tiny blocks and
+ * change the input rate before every block, which is a lot more often
+ * than any module does it. The output must neither jump nor drift away
+ * from the number of frames the rates ask for. */
+
+#define NOMINAL_RATE 44100
+#define OUTPUT_RATE 48000
+#define BLOCK_FRAMES 16
+#define N_BLOCKS 40000
+#define WARMUP_BLOCKS 100
+#define FREQUENCY 440.0
+#define AMPLITUDE 0.5
+#define MAX_DRIFT 8.0
+
+static const pa_resample_method_t methods[] = {
+    PA_RESAMPLER_TRIVIAL,
+    PA_RESAMPLER_SPEEX_FLOAT_BASE + 1,
+    PA_RESAMPLER_SPEEX_FIXED_BASE + 1,
+    PA_RESAMPLER_SRC_LINEAR,
+    PA_RESAMPLER_SRC_SINC_FASTEST,
+};
+
+static void rate_test(pa_mempool *pool, pa_resample_method_t method) {
+    pa_sample_spec iss, oss;
+    pa_resampler *r;
+    pa_memchunk in, out;
+    double phase = 0, expected = 0, drift, min_drift = 0, max_drift = 0, max_step = 0, bound, last = 0;
+    uint64_t produced = 0;
+    unsigned k, j;
+
+    iss.format = oss.format = PA_SAMPLE_FLOAT32NE;
+    iss.channels = oss.channels = 1;
+    iss.rate = NOMINAL_RATE;
+    oss.rate = OUTPUT_RATE;
+
+    pa_assert_se(r = pa_resampler_new(pool, &iss, NULL, &oss, NULL, 0, method, PA_RESAMPLER_VARIABLE_RATE));
+
+    for (k = 0; k < N_BLOCKS; k++) {
+        uint32_t rate;
+        float *d;
+
+        rate = NOMINAL_RATE + (int) (300 * sin(k * 0.01)) + (int) (k % 7) - 3;
+        pa_resampler_set_input_rate(r, rate);
+
+        in.memblock = pa_memblock_new(pool, BLOCK_FRAMES * sizeof(float));
+        in.index = 0;
+        in.length = BLOCK_FRAMES * sizeof(float);
+
+        d = pa_memblock_acquire(in.memblock);
+        for (j = 0; j < BLOCK_FRAMES; j++) {
+            d[j] = (float) (AMPLITUDE * sin(phase));
+            phase += 2 * M_PI * FREQUENCY / NOMINAL_RATE;
+        }
+        pa_memblock_release(in.memblock);
+
+        pa_resampler_run(r, &in, &out);
+        pa_memblock_unref(in.memblock);
+
+        expected += (double) BLOCK_FRAMES * OUTPUT_RATE / rate;
+
+        if (out.memblock) {
+            unsigned n = out.length / sizeof(float);
+
+            d = pa_memblock_acquire_chunk(&out);
+            for (j = 0; j < n; j++) {
+                if (k >= WARMUP_BLOCKS && fabs(d[j] - last) > max_step)
+                    max_step = fabs(d[j] - last);
+                last = d[j];
+            }
+            pa_memblock_release(out.memblock);
+            pa_memblock_unref(out.memblock);
+
+            produced += n;
+        }
+
+        if (k < WARMUP_BLOCKS)
+            continue;
+
+        drift = produced - expected;
+
+        if (k == WARMUP_BLOCKS)
+            min_drift = max_drift = drift;
+        else {
+            min_drift = PA_MIN(min_drift, drift);
+            max_drift = PA_MAX(max_drift, drift);
+        }
+    }
+
+    pa_resampler_free(r);
+
+    /* A sample-and-hold resampler never moves by more than one input
+     * frame per output frame, the others by less */
+    bound = 1.1 * AMPLITUDE * 2 * M_PI * FREQUENCY / NOMINAL_RATE;
+
+    pa_log_debug("%s: drift between %0.2f and %0.2f frames, largest step %0.4f (bound %0.4f)",
+                 pa_resample_method_to_string(method), min_drift, max_drift, max_step, bound);
+
+    fail_unless(max_drift - min_drift < MAX_DRIFT);
+    fail_unless(max_step < bound);
+}
+
+START_TEST (resampler_rate_test) {
+    pa_mempool *pool;
+    unsigned i;
+
+    pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
+
+    for (i = 0; i < PA_ELEMENTSOF(methods); i++) {
+        if (!pa_resample_method_supported(methods[i]))
+            continue;
+
+        rate_test(pool, methods[i]);
+    }
+
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Resampler Rate");
+    tc = tcase_create("resampler-rate");
+    tcase_add_test(tc, resampler_rate_test);
+    tcase_set_timeout(tc, 60);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
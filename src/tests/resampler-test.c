@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <getopt.h>
 #include <locale.h>
+#include <math.h>
 
 #include <pulse/pulseaudio.h>
 
@@ -29,6 +30,7 @@
 #include <pulse/sample.h>
 #include <pulse/volume.h>
 
+#include <pulsecore/cpu.h>
 #include <pulsecore/i18n.h>
 #include <pulsecore/log.h>
 #include <pulsecore/resampler.h>
@@ -251,6 +253,128 @@ static pa_memblock* generate_block(pa_mempool *pool, const pa_sample_spec *ss) {
     return r;
 }
 
+/* Resample a sine wave and return the ratio of the sine to everything
+ * else in the output, in dB. The sine is fitted to the output instead
+ * of being compared to a reference, so the filter delay doesn't matter. */
+static double sine_snr(pa_mempool *pool, pa_resampler *r, uint32_t from, uint32_t to, unsigned n_seconds, pa_usec_t *time) {
+    const double freq = 1000.0, amplitude = 0.5;
+    double ss = 0, sc = 0, cc = 0, sy = 0, cy = 0, yy = 0, a, b, det, signal, noise;
+    unsigned n_in = from / 10, n_out = 0, skip = to / 10, k, j;
+    uint64_t in_pos = 0;
+    pa_usec_t ts;
+
+    *time = 0;
+
+    for (k = 0; k < n_seconds * 10; k++) {
+        pa_memchunk in, out;
+        float *d;
+
+        in.memblock = pa_memblock_new(pool, n_in * sizeof(float));
+        in.index = 0;
+        in.length = n_in * sizeof(float);
+
+        d = pa_memblock_acquire(in.memblock);
+        for (j = 0; j < n_in; j++, in_pos++)
+            d[j] = (float) (amplitude * sin(2 * M_PI * freq * in_pos / from));
+        pa_memblock_release(in.memblock);
+
+        ts = pa_rtclock_now();
+        pa_resampler_run(r, &in, &out);
+        *time += pa_rtclock_now() - ts;
+
+        pa_memblock_unref(in.memblock);
+
+        if (!out.memblock)
+            continue;
+
+        d = pa_memblock_acquire_chunk(&out);
+        for (j = 0; j < out.length / sizeof(float); j++, n_out++) {
+            double w = 2 * M_PI * freq * n_out / to, s, c;
+
+            /* Skip the start, the filter is still filling up there */
+            if (n_out < skip)
+                continue;
+
+            s = sin(w);
+            c = cos(w);
+
+            ss += s * s;
+            sc += s * c;
+            cc += c * c;
+            sy += s * d[j];
+            cy += c * d[j];
+            yy += d[j] * d[j];
+        }
+        pa_memblock_release(out.memblock);
+        pa_memblock_unref(out.memblock);
+    }
+
+    /* Least squares fit of y = a sin + b cos */
+    det = ss * cc - sc * sc;
+    a = (sy * cc - cy * sc) / det;
+    b = (cy * ss - sy * sc) / det;
+
+    signal = a * sy + b * cy;
+    noise = PA_MAX(yy - signal, 1e-20);
+
+    return 10 * log10(signal / noise);
+}
+
+/* Compare the integer ratio fast path to the generic resampler with the
+ * same method, in quality and in speed. The fast path must not be
+ * noticeably worse. */
+static int compare_fast_path(pa_mempool *pool, pa_resample_method_t method, unsigned n_seconds) {
+    static const uint32_t ratios[][2] = {
+        { 48000, 96000 },
+        { 96000, 48000 },
+        { 22050, 44100 },
+        { 16000, 48000 },
+    };
+    unsigned i;
+    int ret = 0;
+
+    if (method < PA_RESAMPLER_SPEEX_FLOAT_BASE || method > PA_RESAMPLER_SPEEX_FLOAT_MAX)
+        method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 1;
+
+    for (i = 0; i < PA_ELEMENTSOF(ratios); i++) {
+        pa_sample_spec a, b;
+        pa_resampler *fast, *generic;
+        double fast_snr, generic_snr;
+        pa_usec_t fast_time, generic_time;
+
+        a.format = b.format = PA_SAMPLE_FLOAT32NE;
+        a.channels = b.channels = 1;
+        a.rate = ratios[i][0];
+        b.rate = ratios[i][1];
+
+        pa_assert_se(fast = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, method, 0));
+        fast_snr = sine_snr(pool, fast, a.rate, b.rate, n_seconds, &fast_time);
+        pa_resampler_free(fast);
+
+        if (!(generic = pa_resampler_new(pool, &a, NULL, &b, NULL, 0, method, PA_RESAMPLER_NO_FAST_PATH))) {
+            pa_log_info("%u -> %u Hz (%s): fast path %0.1f dB, %llu us; no generic resampler to compare to",
+                        a.rate, b.rate, pa_resample_method_to_string(method),
+                        fast_snr, (long long unsigned) fast_time);
+            continue;
+        }
+
+        generic_snr = sine_snr(pool, generic, a.rate, b.rate, n_seconds, &generic_time);
+        pa_resampler_free(generic);
+
+        pa_log_info("%u -> %u Hz (%s): fast path %0.1f dB, %llu us; generic %0.1f dB, %llu us",
+                    a.rate, b.rate, pa_resample_method_to_string(method),
+                    fast_snr, (long long unsigned) fast_time,
+                    generic_snr, (long long unsigned) generic_time);
+
+        if (fast_snr < generic_snr - 3) {
+            pa_log_error("Fast path is worse than the generic resampler for %u -> %u Hz", a.rate, b.rate);
+            ret = 1;
+        }
+    }
+
+    return ret;
+}
+
 static void help(const char *argv0) {
     printf("%s [options]\n\n"
            "-h, --help                            Show this help\n"
@@ -263,6 +387,8 @@ static void help(const char *argv0) {
            "      --to-channels=CHANNELS          To number of channels (defaults to 1)\n"
            "      --resample-method=METHOD        Resample method (defaults to auto)\n"
            "      --seconds=SECONDS               From stream duration (defaults to 60)\n"
+           "      --compare-fast-path             Compare the integer ratio fast path to the\n"
+           "                                      generic resampler of the same method\n"
            "\n"
            "If the formats are not specified, the test performs all formats combinations,\n"
            "back and forth.\n"
@@ -284,7 +410,8 @@ enum {
     ARG_TO_CHANNELS,
     ARG_SECONDS,
     ARG_RESAMPLE_METHOD,
-    ARG_DUMP_RESAMPLE_METHODS
+    ARG_DUMP_RESAMPLE_METHODS,
+    ARG_COMPARE_FAST_PATH
 };
 
 static void dump_resample_methods(void) {
@@ -300,7 +427,7 @@ int main(int argc, char *argv[]) {
     pa_mempool *pool = NULL;
     pa_sample_spec a, b;
     int ret = 1, c;
-    bool all_formats = true;
+    bool all_formats = true, compare = false;
     pa_resample_method_t method;
     int seconds;
     unsigned crossover_freq = 120;
@@ -318,6 +445,7 @@ int main(int argc, char *argv[]) {
         {"seconds",               1, NULL, ARG_SECONDS},
         {"resample-method",       1, NULL, ARG_RESAMPLE_METHOD},
         {"dump-resample-methods", 0, NULL, ARG_DUMP_RESAMPLE_METHODS},
+        {"compare-fast-path",     0, NULL, ARG_COMPARE_FAST_PATH},
         {NULL,                    0, NULL, 0}
     };
 
@@ -398,6 +526,10 @@ int main(int argc, char *argv[]) {
                 method = pa_parse_resample_method(optarg);
                 break;
 
+            case ARG_COMPARE_FAST_PATH:
+                compare = true;
+                break;
+
             default:
                 goto quit;
         }
@@ -406,6 +538,16 @@ int main(int argc, char *argv[]) {
     ret = 0;
     pa_assert_se(pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true));
 
+    if (compare) {
+        pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
+
+        /* Pick up the SIMD versions of the inner loops */
+        pa_cpu_init(&cpu_info);
+
+        ret = compare_fast_path(pool, method, seconds);
+        goto quit;
+    }
+
     if (!all_formats) {
 
         pa_resampler *resampler;
@@ -471,6 +613,8 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    ret = compare_fast_path(pool, method, 1);
+
  quit:
     if (pool)
         pa_mempool_unref(pool);
@@ -21,10 +21,20 @@
 
 #include <check.h>
 #include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
 
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/util.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
 #include <pulsecore/poll.h>
 #include <pulsecore/log.h>
 #include <pulsecore/rtpoll.h>
+#include <pulsecore/socket.h>
 
 static int before(pa_rtpoll_item *i) {
     pa_log("before");
@@ -82,6 +92,222 @@ START_TEST (rtpoll_test) {
 }
 END_TEST
 
+static unsigned n_before, n_after;
+
+static int count_before(pa_rtpoll_item *i) {
+    n_before++;
+    return 0;
+}
+
+static void count_after(pa_rtpoll_item *i) {
+    n_after++;
+}
+
+static void set_pollfd(pa_rtpoll_item *i, unsigned n, int fd, short events) {
+    struct pollfd *pollfd;
+
+    pollfd = pa_rtpoll_item_get_pollfd(i, NULL);
+    pollfd[n].fd = fd;
+    pollfd[n].events = events;
+}
+
+static short get_revents(pa_rtpoll_item *i, unsigned n) {
+    return pa_rtpoll_item_get_pollfd(i, NULL)[n].revents;
+}
+
+/* Runs the same checks with the ppoll() and with the epoll backend */
+static void backend_test(bool epoll) {
+    pa_rtpoll *p;
+    pa_rtpoll_item *a, *b, *c;
+    int fds[2], fds2[2], reused_fd, null_fd;
+    pa_usec_t start;
+    char x;
+
+    if (epoll)
+        unsetenv("PULSE_NO_EPOLL");
+    else
+        setenv("PULSE_NO_EPOLL", "1", 1);
+
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    p = pa_rtpoll_new();
+    n_before = n_after = 0;
+
+    a = pa_rtpoll_item_new(p, PA_RTPOLL_EARLY, 1);
+    pa_rtpoll_item_set_before_callback(a, count_before);
+    pa_rtpoll_item_set_after_callback(a, count_after);
+    set_pollfd(a, 0, fds[0], POLLIN);
+
+    /* Nothing to read, so the timer has to wake us up */
+    start = pa_rtclock_now();
+    pa_rtpoll_set_timer_relative(p, 2 * PA_USEC_PER_MSEC);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(pa_rtclock_now() - start >= 2 * PA_USEC_PER_MSEC);
+    fail_unless(pa_rtpoll_timer_elapsed(p));
+    fail_unless(get_revents(a, 0) == 0);
+    fail_unless(n_before == 1 && n_after == 1);
+
+    /* A second item watching the same fd, next to one that is never ready */
+    b = pa_rtpoll_item_new(p, PA_RTPOLL_NORMAL, 2);
+    set_pollfd(b, 0, fds[1], POLLIN);
+    set_pollfd(b, 1, fds[0], POLLIN);
+
+    pa_assert_se(write(fds[1], "x", 1) == 1);
+
+    pa_rtpoll_set_timer_relative(p, 10 * PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(!pa_rtpoll_timer_elapsed(p));
+    fail_unless(get_revents(a, 0) == POLLIN);
+    fail_unless(get_revents(b, 0) == 0);
+    fail_unless(get_revents(b, 1) == POLLIN);
+    fail_unless(n_before == 2 && n_after == 2);
+
+    /* Once a no longer asks for it, only b is told */
+    set_pollfd(a, 0, fds[0], 0);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(get_revents(a, 0) == 0);
+    fail_unless(get_revents(b, 1) == POLLIN);
+
+    pa_rtpoll_item_free(b);
+    set_pollfd(a, 0, fds[0], POLLIN);
+    pa_assert_se(read(fds[0], &x, 1) == 1);
+
+    pa_rtpoll_set_timer_relative(p, PA_USEC_PER_MSEC);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(pa_rtpoll_timer_elapsed(p));
+    fail_unless(get_revents(a, 0) == 0);
+
+    /* An fd that is closed and whose number is reused by another one
+     * before the next run has to be watched anew */
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds2) == 0);
+    reused_fd = fds2[0];
+    c = pa_rtpoll_item_new(p, PA_RTPOLL_LATE, 1);
+    set_pollfd(c, 0, reused_fd, POLLIN);
+
+    pa_rtpoll_set_timer_relative(p, PA_USEC_PER_MSEC);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(pa_rtpoll_timer_elapsed(p));
+
+    pa_rtpoll_item_free(c);
+    pa_close_pipe(fds2);
+
+    fail_unless(socketpair(AF_UNIX, SOCK_STREAM, 0, fds2) == 0);
+    if (fds2[0] != reused_fd) {
+        fail_unless(dup2(fds2[0], reused_fd) == reused_fd);
+        pa_close(fds2[0]);
+        fds2[0] = reused_fd;
+    }
+
+    c = pa_rtpoll_item_new(p, PA_RTPOLL_LATE, 1);
+    set_pollfd(c, 0, reused_fd, POLLIN);
+    pa_assert_se(write(fds2[1], "x", 1) == 1);
+
+    pa_rtpoll_set_timer_relative(p, 10 * PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(!pa_rtpoll_timer_elapsed(p));
+    fail_unless(get_revents(c, 0) == POLLIN);
+
+    pa_rtpoll_item_free(c);
+    pa_close_pipe(fds2);
+
+    /* epoll can't watch /dev/null, which makes us fall back to ppoll() */
+    null_fd = open("/dev/null", O_RDONLY);
+    fail_unless(null_fd >= 0);
+    c = pa_rtpoll_item_new(p, PA_RTPOLL_LATE, 1);
+    set_pollfd(c, 0, null_fd, POLLIN);
+
+    pa_rtpoll_set_timer_relative(p, 10 * PA_USEC_PER_SEC);
+    fail_unless(pa_rtpoll_run(p) == 1);
+    fail_unless(!pa_rtpoll_timer_elapsed(p));
+    fail_unless(get_revents(c, 0) & POLLIN);
+    fail_unless(get_revents(a, 0) == 0);
+
+    pa_rtpoll_item_free(c);
+    pa_rtpoll_item_free(a);
+    pa_rtpoll_free(p);
+
+    pa_close(null_fd);
+    pa_close_pipe(fds);
+}
+
+START_TEST (rtpoll_backend_test) {
+    backend_test(true);
+    backend_test(false);
+}
+END_TEST
+
+static int slow_worker(pa_rtpoll_item *w) {
+    pa_msleep(2);
+    return 0;
+}
+
+START_TEST (rtpoll_stats_test) {
+    pa_rtpoll *p;
+    pa_rtpoll_item *w;
+    pa_rtpoll_stats stats;
+    uint64_t histogram[PA_RTPOLL_HISTOGRAM_BUCKETS];
+    uint64_t n;
+    unsigned k;
+    char *t;
+
+    p = pa_rtpoll_new();
+
+    w = pa_rtpoll_item_new(p, PA_RTPOLL_NORMAL, 0);
+    pa_rtpoll_item_set_work_callback(w, slow_worker);
+    pa_rtpoll_item_set_name(w, "slow");
+
+    for (k = 0; k < 5; k++) {
+        pa_rtpoll_set_timer_relative(p, 5 * PA_USEC_PER_MSEC);
+        fail_unless(pa_rtpoll_run(p) >= 0);
+        fail_unless(pa_rtpoll_timer_elapsed(p));
+    }
+
+    pa_rtpoll_get_stats(p, &stats);
+
+    fail_unless(stats.iterations == 5);
+    fail_unless(stats.timer_wakeups == 5);
+
+    /* The work callback runs between two sleeps, so it is part of the
+     * awake time */
+    fail_unless(stats.awake_max_usec >= 2 * PA_USEC_PER_MSEC);
+    fail_unless(stats.sleep_total_usec > 0);
+    fail_unless(stats.sleep_max_usec <= 5 * PA_USEC_PER_SEC);
+
+    for (n = 0, k = 0; k < PA_RTPOLL_HISTOGRAM_BUCKETS; k++)
+        n += stats.awake_histogram[k];
+    fail_unless(n == 4);
+
+    for (n = 0, k = 0; k < PA_RTPOLL_HISTOGRAM_BUCKETS; k++)
+        n += stats.overshoot_histogram[k];
+    fail_unless(n == 5);
+
+    fail_unless(stats.n_items == 1);
+    fail_unless(pa_streq(stats.items[0].name, "slow"));
+    fail_unless(stats.items[0].calls == 5);
+    fail_unless(stats.items[0].max_usec >= 2 * PA_USEC_PER_MSEC);
+    fail_unless(stats.items[0].total_usec >= 10 * PA_USEC_PER_MSEC);
+
+    pa_log("awake %llu/%llu usec, sleep %llu/%llu usec, overshoot %llu/%llu usec",
+           (unsigned long long) (stats.awake_total_usec / 4), (unsigned long long) stats.awake_max_usec,
+           (unsigned long long) (stats.sleep_total_usec / 5), (unsigned long long) stats.sleep_max_usec,
+           (unsigned long long) (stats.overshoot_total_usec / 5), (unsigned long long) stats.overshoot_max_usec);
+
+    pa_rtpoll_item_free(w);
+    pa_rtpoll_free(p);
+
+    memset(histogram, 0, sizeof(histogram));
+    t = pa_rtpoll_histogram_to_string(histogram);
+    fail_unless(pa_streq(t, "0"));
+    pa_xfree(t);
+
+    histogram[0] = 1;
+    histogram[3] = 7;
+    t = pa_rtpoll_histogram_to_string(histogram);
+    fail_unless(pa_streq(t, "1,0,0,7"));
+    pa_xfree(t);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -91,6 +317,8 @@ int main(int argc, char *argv[]) {
     s = suite_create("RT Poll");
     tc = tcase_create("rtpoll");
     tcase_add_test(tc, rtpoll_test);
+    tcase_add_test(tc, rtpoll_backend_test);
+    tcase_add_test(tc, rtpoll_stats_test);
     /* the default timeout is too small,
      * set it to a reasonable large one.
      */
@@ -29,6 +29,13 @@
 #include <pulsecore/pstream.h>
 #include <pulsecore/iochannel.h>
 #include <pulsecore/memblock.h>
+#include <pulsecore/srbchannel.h>
+#include <pulsecore/thread.h>
+
+/* Messages are written with shorter gaps than the reader spins */
+#define SPIN_MESSAGES 2000
+#define SPIN_GAP_USEC 100
+#define SPIN_USEC 1000
 
 static unsigned packets_received;
 static unsigned packets_checksum;
@@ -90,6 +97,7 @@ START_TEST (srbchannel_test) {
     pa_pstream *p1, *p2;
     pa_srbchannel *sr1, *sr2;
     pa_srbchannel_template srt;
+    pa_srbchannel_stats stats;
 
     fail_unless(pipe(pipefd) == 0);
     fail_unless(pipe(&pipefd[2]) == 0);
@@ -114,6 +122,21 @@ START_TEST (srbchannel_test) {
     packet_test(250, 5, ml, p1, p2);
     packet_test(10, 1234567, ml, p1, p2);
 
+    pa_log_debug("And now the same thing with busy polling...");
+
+    pa_srbchannel_set_busy_poll(sr1, 50);
+    pa_srbchannel_set_busy_poll(sr2, 50);
+
+    packet_test(250, 5, ml, p1, p2);
+    packet_test(10, 1234567, ml, p1, p2);
+
+    pa_srbchannel_get_stats(sr2, &stats);
+    pa_log_debug("Receiver: %llu wakeups, %llu spin hits, %llu spin misses",
+                 (unsigned long long) stats.wakeups,
+                 (unsigned long long) stats.spin_hits,
+                 (unsigned long long) stats.spin_misses);
+    fail_unless(stats.wakeups > 0);
+
     pa_pstream_unref(p1);
     pa_pstream_unref(p2);
     pa_mempool_unref(mp);
@@ -121,6 +144,81 @@ START_TEST (srbchannel_test) {
 }
 END_TEST
 
+static void spin_writer(void *userdata) {
+    pa_srbchannel *sr = userdata;
+    uint32_t k;
+
+    for (k = 0; k < SPIN_MESSAGES; k++) {
+        size_t done = 0;
+
+        usleep(SPIN_GAP_USEC);
+
+        while ((done += pa_srbchannel_write(sr, (uint8_t*) &k + done, sizeof(k) - done)) < sizeof(k))
+            usleep(SPIN_GAP_USEC);
+    }
+}
+
+static bool spin_read_cb(pa_srbchannel *sr, void *userdata) {
+    size_t *received = userdata;
+    uint8_t buf[256];
+    size_t n;
+
+    while ((n = pa_srbchannel_read(sr, buf, sizeof(buf))) > 0)
+        *received += n;
+
+    return true;
+}
+
+/* Data arriving shortly after the reader went idle has to be picked up
+ * while spinning, without a wakeup through the fdsem */
+START_TEST (srbchannel_busy_poll_test) {
+    pa_mainloop *ml, *writer_ml;
+    pa_mempool *mp;
+    pa_srbchannel *writer, *reader;
+    pa_srbchannel_template srt;
+    pa_srbchannel_stats stats;
+    pa_thread *thread;
+    size_t received = 0;
+
+    ml = pa_mainloop_new();
+    writer_ml = pa_mainloop_new();
+    mp = pa_mempool_new(PA_MEM_TYPE_SHARED_POSIX, 0, true);
+
+    /* The writer never needs its mainloop, as the reader keeps up */
+    writer = pa_srbchannel_new(pa_mainloop_get_api(writer_ml), mp);
+    pa_srbchannel_export(writer, &srt);
+    reader = pa_srbchannel_new_from_template(pa_mainloop_get_api(ml), &srt);
+
+    pa_srbchannel_set_callback(reader, spin_read_cb, &received);
+    pa_srbchannel_set_busy_poll(reader, SPIN_USEC);
+
+    thread = pa_thread_new("srb-writer", spin_writer, writer);
+
+    while (received < SPIN_MESSAGES * sizeof(uint32_t))
+        pa_mainloop_iterate(ml, 1, NULL);
+
+    pa_thread_free(thread);
+
+    pa_srbchannel_get_stats(reader, &stats);
+    pa_log_debug("Reader: %llu wakeups, %llu spin hits, %llu spin misses",
+                 (unsigned long long) stats.wakeups,
+                 (unsigned long long) stats.spin_hits,
+                 (unsigned long long) stats.spin_misses);
+
+    fail_unless(received == SPIN_MESSAGES * sizeof(uint32_t));
+
+    if (stats.busy_poll_allowed)
+        fail_unless(stats.spin_hits > 0);
+    else
+        pa_log_info("Busy polling suspended by the battery or CPU state, not checking spin hits.");
+
+    pa_srbchannel_free(reader);
+    pa_srbchannel_free(writer);
+    pa_mempool_unref(mp);
+    pa_mainloop_free(writer_ml);
+    pa_mainloop_free(ml);
+}
+END_TEST
 
 int main(int argc, char *argv[]) {
     int failed = 0;
@@ -134,6 +232,7 @@ int main(int argc, char *argv[]) {
     s = suite_create("srbchannel");
     tc = tcase_create("srbchannel");
     tcase_add_test(tc, srbchannel_test);
+    tcase_add_test(tc, srbchannel_busy_poll_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);